@@ -0,0 +1,113 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW\glfw3.h>
+
+#include <stdexcept>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <functional>
+#include <memory>
+
+#include "vulkan_renderer.h"
+#include "perf_baseline.h"
+
+struct FrameTimings {
+	uint32_t frame_count = 0;
+	double average_ms = 0.0;
+	double min_ms = 0.0;
+	double max_ms = 0.0;
+
+	// Nearest rank, one slow frame in a hundred shows in p99 long before it moves the average
+	double p50_ms = 0.0;
+	double p95_ms = 0.0;
+	double p99_ms = 0.0;
+
+	// Host allocator calls made by the driver while recording and submitting
+	double host_allocations_per_frame = 0.0;
+
+	double average_record_ms = 0.0;
+};
+
+// Renders a fixed number of frames per configuration and prints the frame times
+class benchmark {
+
+	vulkan_renderer* renderer;
+	GLFWwindow* window;
+
+	uint32_t warmup_frames = 60;
+	uint32_t measured_frames = 600;
+
+	// Called before every frame measure_frames draws, for work that is redone each frame
+	std::function<void(uint32_t)> before_frame;
+
+	// Kept between calls so measuring allocates nothing once it has seen the longest run
+	std::vector<double> frame_times;
+
+	// Offscreen runs have no window to close or poll
+	bool is_window_closed();
+	void poll_events();
+
+	FrameTimings measure_frames();
+
+	// Measures one scenario of the regression suite and prints its frame times, record time and device memory
+	FrameTimings measure_scenario(const std::string& scenario);
+
+	// Reads the next frame back with frame capture, false when no frame of this size arrives
+	bool read_back_frame(VkExtent2D extent);
+
+public:
+	benchmark(vulkan_renderer* new_renderer, GLFWwindow* new_window);
+
+	// Measure every sample count the device supports
+	int run_msaa();
+
+	// Compare loader trampolines against direct device functions on draw heavy frames
+	int run_dispatch();
+
+	// Transform propagation and culling on the CPU, single threaded and on every core
+	int run_scene();
+
+	// Bind and draw counts of a mixed scene with and without sorting the draw list
+	int run_draw_list();
+
+	// Triangles drawn as the object count grows, with every object at LOD 0 and with LOD selection
+	int run_lod();
+
+	// Objects hidden behind a wall, drawn and shaded with and without occlusion culling
+	int run_occlusion();
+
+	// Uber shader against specialized variants as the per fragment light loop grows
+	int run_shader_variants();
+
+	// Render target recreation cost and frame times with render passes and with dynamic rendering
+	int run_render_targets();
+
+	// Frame times as more windows are presented from the same device
+	int run_windows();
+
+	// Frame and simulation times of the GPU particle system as the particle count grows
+	int run_particles();
+
+	// Frame times without post-processing and with a growing bloom chain, and the GPU time of each pass
+	int run_post_processing();
+
+	// Frame and flush times of the sprite batch as the sprite count grows, on one page and spread over several
+	int run_sprites();
+
+	int run();
+
+	// Regression suite on an offscreen renderer: how frame and record times scale with draw count, instance count,
+	// triangle count and resolution, the worst frame time spike, and memory left behind by resizing the target.
+	// Compared with the baseline file, or written into it when write_baseline is set. Fails when a metric is over
+	// the tolerance of its baseline or is missing on either side
+	int run_regression(const std::string& baseline_file, bool write_baseline);
+
+	// Grid of small hierarchies, shared with the --scene option
+	static void build_test_scene(scene* target, uint32_t object_count);
+
+	// Sprites drifting across a width by height area, cycling through pages. Shared with the --sprites option
+	static void add_test_sprites(sprite_batch* target, uint32_t sprite_count, float width, float height, uint32_t frame,
+		const std::vector<uint32_t>& pages);
+};
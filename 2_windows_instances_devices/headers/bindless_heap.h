@@ -0,0 +1,109 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW\glfw3.h>
+
+#include <stdexcept>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+
+#include "vulkan_loader.h"
+#include "utilities.h"
+
+// Bindless descriptor heap.
+// One descriptor set holds large update-after-bind arrays of sampled images and
+// storage buffers. It is bound once per command buffer and draws pick their
+// resources by index through push constants. Each frame in flight has its own
+// copy of the set, writes are queued and applied to a copy when its frame starts
+// so sets still in use by the GPU are never modified.
+
+const uint32_t BINDLESS_INVALID_INDEX = ~0u;
+
+const uint32_t BINDLESS_TEXTURE_BINDING = 0;
+const uint32_t BINDLESS_STORAGE_BUFFER_BINDING = 1;
+
+// Push constant block shared by the pipelines that use the heap.
+// Texture, buffer and tint come from the material, the rest from the geometry:
+// the storage buffer with its packed vertices and the range of its quantized uvs.
+// The tint is RGBA8, the uber shader always applies it so white is the default
+struct DrawPushConstants {
+	uint32_t texture_index = BINDLESS_INVALID_INDEX;
+	uint32_t buffer_index = BINDLESS_INVALID_INDEX;
+	uint32_t tint = 0xFFFFFFFF;
+	uint32_t vertex_buffer_index = BINDLESS_INVALID_INDEX;
+	float uv_offset[2] = { 0.0f, 0.0f };
+	float uv_scale[2] = { 1.0f, 1.0f };
+};
+
+struct BindlessWrite {
+	uint32_t binding;
+	uint32_t index;
+	VkDescriptorImageInfo image_info;
+	VkDescriptorBufferInfo buffer_info;
+
+	// Frame sets that have not received the write yet
+	uint32_t pending_frames;
+};
+
+// Freed slots are only reused once no frame in flight can still reference them
+struct BindlessRetiredSlot {
+	uint32_t binding;
+	uint32_t index;
+	uint32_t frames_left;
+};
+
+class bindless_heap {
+
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+	VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> sets;
+
+	uint32_t max_textures = 0;
+	uint32_t max_storage_buffers = 0;
+
+	// Init stages running in parallel register resources at the same time
+	std::mutex heap_mutex;
+
+	uint32_t texture_count = 0;
+	uint32_t storage_buffer_count = 0;
+	std::vector<uint32_t> free_textures;
+	std::vector<uint32_t> free_storage_buffers;
+
+	std::vector<BindlessWrite> pending_writes;
+	std::vector<BindlessRetiredSlot> retired_slots;
+
+	uint32_t allocate_slot(uint32_t binding);
+	void queue_write(BindlessWrite write);
+
+public:
+	bindless_heap();
+
+	// Descriptor indexing features the heap relies on
+	static bool check_device_support(VkPhysicalDevice physical_device);
+	static VkPhysicalDeviceVulkan12Features get_required_features();
+
+	void init(VkPhysicalDevice physical_device, VkDevice new_device, uint32_t frame_count, const VkAllocationCallbacks* new_allocator);
+	void destroy();
+
+	// Textures
+	uint32_t add_texture(VkImageView image_view, VkSampler sampler);
+	void update_texture(uint32_t index, VkImageView image_view, VkSampler sampler);
+	void remove_texture(uint32_t index);
+
+	// Storage buffers
+	uint32_t add_storage_buffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+	void update_storage_buffer(uint32_t index, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+	void remove_storage_buffer(uint32_t index);
+
+	// Apply the queued writes to the set of this frame, call once its fence has been waited on
+	void begin_frame(uint32_t frame);
+	void bind(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, VkPipelineBindPoint bind_point, uint32_t frame);
+
+	// Getters
+	VkDescriptorSetLayout get_set_layout();
+	VkPushConstantRange get_push_constant_range();
+	uint32_t get_texture_count();
+	uint32_t get_storage_buffer_count();
+};
@@ -0,0 +1,104 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW\glfw3.h>
+
+#include <stdexcept>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <unordered_map>
+
+#include "vulkan_loader.h"
+#include "utilities.h"
+
+// Descriptor sets outside the bindless heap.
+// Each frame in flight has a list of pools. Sets for one frame are allocated
+// linearly from its current pool, and when the pool is full the next one is
+// used, or created, so allocation never fails with VK_ERROR_OUT_OF_POOL_MEMORY.
+// Sets are never freed one by one: once the fence of the frame has been waited
+// on, all its pools are reset with vkResetDescriptorPool.
+//
+// Sets whose contents never change are cached by a hash of their layout and
+// bindings, in pools of their own for each layout. Asking for the same bindings
+// again returns the same set, without allocating or writing descriptors. The sets
+// of a layout have to be cleared before an image view or buffer they reference is
+// destroyed, the sets cached for other layouts stay.
+
+// Sets per pool, descriptors of each type are reserved for that many sets in the ratios below
+const uint32_t DESCRIPTOR_SETS_PER_POOL = 256;
+
+// One descriptor of a set, image_info or buffer_info is used depending on the type
+struct DescriptorBinding {
+	uint32_t binding = 0;
+	VkDescriptorType type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	VkDescriptorImageInfo image_info = {};
+	VkDescriptorBufferInfo buffer_info = {};
+};
+
+struct DescriptorFramePools {
+	std::vector<VkDescriptorPool> pools;
+	uint32_t current = 0;
+	uint32_t set_count = 0;
+};
+
+// Cached sets of one layout, cleared together by resetting their pools
+struct DescriptorLayoutCache {
+	DescriptorFramePools pools;
+	std::unordered_map<uint64_t, VkDescriptorSet> sets;
+};
+
+struct DescriptorAllocatorStats {
+	uint32_t pool_count = 0;
+
+	// Frame being recorded
+	uint32_t frame_sets = 0;
+	uint64_t total_frame_sets = 0;
+
+	uint32_t cached_sets = 0;
+	uint64_t cache_hits = 0;
+	uint64_t cache_misses = 0;
+	uint32_t cache_clears = 0;
+};
+
+class descriptor_allocator {
+
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+
+	std::vector<DescriptorFramePools> frames;
+	uint32_t current_frame = 0;
+
+	// Cached sets live until clear_cache of their layout, keyed by the hash of their layout and bindings
+	std::unordered_map<VkDescriptorSetLayout, DescriptorLayoutCache> cache;
+
+	DescriptorAllocatorStats stats;
+
+	VkDescriptorPool create_pool();
+	VkDescriptorSet allocate_from(DescriptorFramePools* pools, VkDescriptorSetLayout layout);
+
+	static uint64_t hash_bindings(VkDescriptorSetLayout layout, const DescriptorBinding* bindings, uint32_t binding_count);
+
+public:
+	descriptor_allocator();
+
+	void init(VkDevice new_device, uint32_t frame_count, const VkAllocationCallbacks* new_allocator);
+	void destroy();
+
+	// The fence of frame_slot was waited on, every set allocated for it is released
+	void begin_frame(uint32_t frame_slot);
+
+	// Valid until the frame slot comes around again
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout, const DescriptorBinding* bindings, uint32_t binding_count);
+
+	// Written once on the first request, the same set for the same bindings after that
+	VkDescriptorSet get_cached(VkDescriptorSetLayout layout, const DescriptorBinding* bindings, uint32_t binding_count);
+
+	// Only the sets cached for layout. The device must be idle, they may still be in use otherwise
+	void clear_cache(VkDescriptorSetLayout layout);
+
+	void write(VkDescriptorSet set, const DescriptorBinding* bindings, uint32_t binding_count);
+
+	const DescriptorAllocatorStats& get_stats();
+	void print_stats();
+};
@@ -0,0 +1,98 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW\glfw3.h>
+
+#include <stdexcept>
+#include <vector>
+#include <chrono>
+
+#include "vulkan_loader.h"
+#include "bindless_heap.h"
+
+// Per frame draw list.
+// Every draw carries a 64 bit key, from the most to the least significant bits:
+// pass (4), pipeline (12), material (16), geometry (12), depth (20). After a
+// radix sort draws sharing a pipeline and material sit next to each other, so
+// the pipeline is bound once per pipeline, the material push constants are
+// pushed once per material, and consecutive draws of the same state and
+// geometry become one instanced draw.
+
+const uint32_t DRAW_KEY_PASS_BITS = 4;
+const uint32_t DRAW_KEY_PIPELINE_BITS = 12;
+const uint32_t DRAW_KEY_MATERIAL_BITS = 16;
+const uint32_t DRAW_KEY_GEOMETRY_BITS = 12;
+const uint32_t DRAW_KEY_DEPTH_BITS = 20;
+
+const uint32_t DRAW_KEY_DEPTH_SHIFT = 0;
+const uint32_t DRAW_KEY_GEOMETRY_SHIFT = DRAW_KEY_DEPTH_SHIFT + DRAW_KEY_DEPTH_BITS;
+const uint32_t DRAW_KEY_MATERIAL_SHIFT = DRAW_KEY_GEOMETRY_SHIFT + DRAW_KEY_GEOMETRY_BITS;
+const uint32_t DRAW_KEY_PIPELINE_SHIFT = DRAW_KEY_MATERIAL_SHIFT + DRAW_KEY_MATERIAL_BITS;
+const uint32_t DRAW_KEY_PASS_SHIFT = DRAW_KEY_PIPELINE_SHIFT + DRAW_KEY_PIPELINE_BITS;
+
+struct DrawItem {
+	uint64_t key;
+	uint32_t object;
+};
+
+// What a geometry id draws. Without an index buffer the draw is vertex_count vertices
+// generated in the shader, otherwise index_count indices starting at first_index and
+// the shader pulls the vertices from the bindless storage buffer vertex_buffer
+struct DrawGeometry {
+	VkBuffer index_buffer = VK_NULL_HANDLE;
+	VkDeviceSize index_buffer_offset = 0;
+	uint32_t first_index = 0;
+	uint32_t index_count = 0;
+	uint32_t vertex_count = 0;
+
+	uint32_t vertex_buffer = BINDLESS_INVALID_INDEX;
+	float uv_offset[2] = { 0.0f, 0.0f };
+	float uv_scale[2] = { 1.0f, 1.0f };
+};
+
+struct DrawListStats {
+	uint32_t draw_count = 0;
+	uint32_t triangle_count = 0;
+	uint32_t batch_count = 0;
+	uint32_t pipeline_binds = 0;
+	uint32_t material_binds = 0;
+	double sort_ms = 0.0;
+};
+
+class draw_list {
+
+	std::vector<DrawItem> items;
+	std::vector<DrawItem> scratch;
+
+	bool sort_enabled = true;
+	DrawListStats stats;
+
+	void radix_sort();
+
+public:
+	draw_list();
+
+	static uint64_t make_key(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t geometry, uint32_t depth);
+
+	// Depth bits that sort near to far, or far to near for blended draws
+	static uint32_t make_depth(float view_depth, bool back_to_front);
+
+	static uint32_t get_pass(uint64_t key);
+	static uint32_t get_pipeline(uint64_t key);
+	static uint32_t get_material(uint64_t key);
+	static uint32_t get_geometry(uint64_t key);
+
+	void clear();
+	void add(uint64_t key, uint32_t object);
+
+	// Radix sort by key, without sorting the draws stay in the order they were added
+	void sort();
+	void set_sort_enabled(bool enabled);
+
+	// Draw i of the list reads instance slot i, materials hold the push constants of each material id
+	// and geometries what each geometry id draws
+	void record(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, const std::vector<VkPipeline>& pipelines,
+		const std::vector<DrawPushConstants>& materials, const std::vector<DrawGeometry>& geometries);
+
+	const std::vector<DrawItem>& get_items();
+	const DrawListStats& get_stats();
+};
@@ -0,0 +1,133 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW\glfw3.h>
+
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <memory>
+
+#include "vulkan_loader.h"
+#include "utilities.h"
+#include "memory_tracker.h"
+
+// Asynchronous frame readback.
+// After the frame is rendered its swap chain or offscreen image is copied into the
+// next free buffer of a ring of host visible buffers, in the same command buffer. The
+// renderer reports when the fence of a frame has been waited on, the buffers of
+// that frame are then handed to a writer thread which runs the consumer and
+// releases them. When every buffer is still queued the frame is dropped instead
+// of waiting, so capturing never stalls the render loop.
+
+// Frame handed to the consumer, 4 bytes per pixel with rows tightly packed
+struct CaptureFrame {
+	uint64_t frame_number = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+
+	// Swap chains are often BGRA, consumers swap the channels when this is set
+	bool bgra = false;
+	const uint8_t* pixels = nullptr;
+};
+
+enum class CaptureSlotState {
+	free,
+	pending,
+	writing
+};
+
+struct CaptureSlot {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	void* mapped = nullptr;
+	CaptureSlotState state = CaptureSlotState::free;
+
+	// Frame in flight whose fence covers the copy
+	uint32_t frame_slot = 0;
+	uint64_t frame_number = 0;
+};
+
+struct CaptureStats {
+	uint64_t captured = 0;
+	uint64_t written = 0;
+	uint64_t dropped = 0;
+	double consumer_ms = 0.0;
+};
+
+using CaptureConsumer = std::function<void(const CaptureFrame&)>;
+
+class frame_capture {
+
+	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	memory_tracker* tracker = nullptr;
+	const VkAllocationCallbacks* allocator = nullptr;
+
+	VkExtent2D extent = {};
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	uint32_t slot_count = 0;
+
+	std::vector<CaptureSlot> slots;
+	uint32_t next_slot = 0;
+
+	CaptureConsumer consumer;
+	bool capturing = false;
+	uint64_t frames_left = 0;
+	uint64_t frame_number = 0;
+
+	// Writer thread, slots is guarded by the mutex once it runs
+	std::thread writer;
+	std::mutex mutex;
+	std::condition_variable ready_condition;
+	std::condition_variable idle_condition;
+	std::deque<uint32_t> ready_slots;
+	bool stopping = false;
+
+	CaptureStats stats;
+
+	void create_slots();
+	void writer_loop();
+
+public:
+	frame_capture();
+
+	static bool is_format_supported(VkFormat format);
+
+	// Buffers are only allocated once a capture starts
+	void init(VkPhysicalDevice new_physical_device, VkDevice new_device, VkExtent2D new_extent, VkFormat new_format,
+		uint32_t new_slot_count, memory_tracker* new_tracker, const VkAllocationCallbacks* new_allocator);
+
+	// Writes every captured frame out and stops the writer, the device must be idle
+	void destroy();
+
+	// Runs on the writer thread, one frame at a time in capture order
+	void set_consumer(CaptureConsumer new_consumer);
+
+	// Capture the next frame_count frames, or every frame until stop when zero
+	void start(uint64_t frame_count = 0);
+	void stop();
+	bool is_capturing();
+
+	// Render thread: copy image, which the frame has left in layout and gets back in it.
+	// PRESENT_SRC_KHR for a swap chain image, TRANSFER_SRC_OPTIMAL for an offscreen one
+	void record(VkCommandBuffer command_buffer, VkImage image, VkImageLayout layout, uint32_t frame_slot);
+
+	// Render thread: the fence of frame_slot was waited on, its copies can be read
+	void frame_complete(uint32_t frame_slot);
+
+	// Block until the writer has consumed every completed frame
+	void flush();
+
+	const CaptureStats& get_stats();
+	void print_stats();
+
+	// Consumers writing prefix_00000.ppm per frame, or every frame appended to one raw file
+	static CaptureConsumer ppm_writer(const std::string& prefix);
+	static CaptureConsumer raw_writer(const std::string& file_name);
+};
@@ -0,0 +1,114 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW\glfw3.h>
+
+#include <stdexcept>
+#include <vector>
+#include <string>
+
+#include "vulkan_loader.h"
+
+// GPU query pools.
+// Labelled regions of a command buffer are wrapped in a pipeline statistics query
+// and an occlusion query. Each frame in flight has its own pools, they are read
+// back when the frame's fence has been waited on and the slot is recorded again,
+// so the CPU never waits for a result. Results that are still unavailable are
+// dropped and counted instead.
+
+enum QueryStatistic {
+	QUERY_STATISTIC_INPUT_VERTICES,
+	QUERY_STATISTIC_INPUT_PRIMITIVES,
+	QUERY_STATISTIC_VERTEX_INVOCATIONS,
+	QUERY_STATISTIC_CLIPPING_INVOCATIONS,
+	QUERY_STATISTIC_CLIPPING_PRIMITIVES,
+	QUERY_STATISTIC_FRAGMENT_INVOCATIONS,
+	QUERY_STATISTIC_COMPUTE_INVOCATIONS,
+	QUERY_STATISTIC_COUNT
+};
+
+struct GpuQueryRegion {
+	std::string name;
+
+	// Last resolved frame, a region begun several times in a frame is summed
+	uint64_t statistics[QUERY_STATISTIC_COUNT] = {};
+	uint64_t samples_passed = 0;
+
+	// Every resolved frame, for averages
+	uint64_t total_statistics[QUERY_STATISTIC_COUNT] = {};
+	uint64_t total_samples_passed = 0;
+	uint64_t frame_count = 0;
+};
+
+// Pools and the regions recorded into them for one frame in flight
+struct GpuQueryFrame {
+	VkQueryPool statistics_pool = VK_NULL_HANDLE;
+	VkQueryPool occlusion_pool = VK_NULL_HANDLE;
+	std::vector<uint32_t> regions;
+};
+
+struct GpuQueryStats {
+	uint64_t resolved_frames = 0;
+
+	// Results not yet available when the slot came around again
+	uint64_t unavailable_queries = 0;
+
+	// Regions begun after every query of the frame was used
+	uint64_t overflowed_queries = 0;
+};
+
+class gpu_queries {
+
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+
+	bool statistics_supported = false;
+	bool precise_occlusion = false;
+	bool enabled = false;
+
+	// Whether the current frame reset its pools
+	bool recording = false;
+
+	uint32_t max_queries = 0;
+	std::vector<GpuQueryFrame> frames;
+	uint32_t current_frame = 0;
+
+	std::vector<GpuQueryRegion> regions;
+
+	// Query of the region being recorded, regions can not nest
+	int active_query = -1;
+
+	std::vector<uint64_t> results;
+	GpuQueryStats stats;
+
+	void resolve_frame(GpuQueryFrame& frame);
+
+public:
+	gpu_queries();
+
+	// Features to enable on the device, pipelineStatisticsQuery and occlusionQueryPrecise when supported
+	static VkPhysicalDeviceFeatures get_optional_features(VkPhysicalDevice physical_device);
+
+	void init(VkDevice new_device, const VkPhysicalDeviceFeatures& enabled_features, uint32_t frame_count,
+		uint32_t queries_per_frame, const VkAllocationCallbacks* new_allocator);
+	void destroy();
+
+	// Disabled queries record nothing, switching them on takes effect the next frame
+	void set_enabled(bool enable);
+	bool is_enabled();
+	bool has_pipeline_statistics();
+
+	uint32_t add_region(const std::string& name);
+
+	// Reads the results of the last use of frame_slot and resets its pools, outside of any render pass
+	void begin_frame(VkCommandBuffer command_buffer, uint32_t frame_slot);
+
+	// Inside a render pass both calls must be in the same subpass
+	void begin_region(VkCommandBuffer command_buffer, uint32_t region);
+	void end_region(VkCommandBuffer command_buffer);
+
+	const std::vector<GpuQueryRegion>& get_regions();
+	const GpuQueryStats& get_stats();
+
+	// Averages per frame, overdraw is given against pixel_count samples
+	void print_stats(uint64_t pixel_count);
+};
@@ -0,0 +1,99 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW\glfw3.h>
+
+#include <stdexcept>
+#include <vector>
+#include <mutex>
+#include <cstdlib>
+#include <cstring>
+
+// Host allocation callbacks handed to every vkCreate / vkDestroy call.
+// system   : no callbacks, the driver uses its own allocator
+// tracking : malloc backed, counts calls and bytes per allocation scope
+// arena    : as tracking, but COMMAND and OBJECT scope allocations are served
+//            from power of two size classes carved out of large chunks, so the
+//            short lived driver allocations stop hitting the general heap
+
+enum class HostAllocatorMode {
+	system,
+	tracking,
+	arena
+};
+
+const uint32_t HOST_ALLOCATION_SCOPE_COUNT = 5;
+
+struct HostScopeStats {
+	uint64_t allocation_count = 0;
+	uint64_t reallocation_count = 0;
+	uint64_t free_count = 0;
+	uint64_t total_bytes = 0;
+	int64_t current_bytes = 0;
+	int64_t peak_bytes = 0;
+};
+
+struct HostAllocatorStats {
+	HostScopeStats scopes[HOST_ALLOCATION_SCOPE_COUNT];
+
+	// Allocations the driver made itself and only reported
+	uint64_t internal_allocation_count = 0;
+	int64_t internal_bytes = 0;
+
+	// Arena mode
+	uint64_t arena_allocation_count = 0;
+	uint32_t arena_chunk_count = 0;
+};
+
+// Stored in front of every allocation so free can find its size and origin
+struct HostAllocationHeader {
+	void* block;
+	size_t size;
+	uint32_t scope;
+	uint32_t size_class;
+};
+
+class host_allocator {
+
+	HostAllocatorMode mode = HostAllocatorMode::system;
+	VkAllocationCallbacks callbacks = {};
+
+	std::mutex allocator_mutex;
+	HostAllocatorStats stats;
+
+	// Arena size classes, 64 bytes up to 64 KB
+	static const uint32_t min_class_shift = 6;
+	static const uint32_t class_count = 11;
+	static const size_t chunk_size = 1024 * 1024;
+	static const uint32_t system_class = ~0u;
+
+	std::vector<void*> free_blocks[class_count];
+	std::vector<void*> chunks;
+	char* chunk_cursor = nullptr;
+	size_t chunk_remaining = 0;
+
+	void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+	void* reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	void release(void* memory);
+
+	void* allocate_block(uint32_t size_class);
+
+	static VKAPI_ATTR void* VKAPI_CALL allocation_callback(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void* VKAPI_CALL reallocation_callback(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void VKAPI_CALL free_callback(void* user_data, void* memory);
+	static VKAPI_ATTR void VKAPI_CALL internal_allocation_callback(void* user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void VKAPI_CALL internal_free_callback(void* user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+public:
+	host_allocator();
+	~host_allocator();
+
+	void init(HostAllocatorMode new_mode);
+
+	// nullptr in system mode
+	const VkAllocationCallbacks* get_callbacks();
+	HostAllocatorMode get_mode();
+
+	HostAllocatorStats get_stats();
+	void reset_counters();
+	void print_stats();
+};
@@ -0,0 +1,90 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW\glfw3.h>
+
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <algorithm>
+
+#include "vulkan_loader.h"
+
+// Device memory telemetry.
+// Allocations made through the tracker are counted per heap and per tag. Each
+// allocation also records how many bytes of it are covered by bound resources,
+// the rest is reported as fragmentation. When VK_EXT_memory_budget is enabled
+// the driver budget and usage of each heap are reported next to the tracked
+// numbers, otherwise the heap size stands in for the budget.
+
+struct MemoryAllocationInfo {
+	VkDeviceSize size = 0;
+	VkDeviceSize bound_bytes = 0;
+	uint32_t memory_type = 0;
+	uint32_t heap = 0;
+	std::string tag;
+};
+
+struct MemoryHeapReport {
+	VkDeviceSize heap_size = 0;
+	bool device_local = false;
+
+	// From VK_EXT_memory_budget, or heap size and tracked bytes without it
+	VkDeviceSize budget = 0;
+	VkDeviceSize usage = 0;
+
+	uint32_t allocation_count = 0;
+	VkDeviceSize allocated_bytes = 0;
+	VkDeviceSize peak_allocated_bytes = 0;
+	VkDeviceSize bound_bytes = 0;
+
+	// Share of the allocated bytes not covered by bound resources
+	float fragmentation = 0.0f;
+};
+
+struct MemoryTagReport {
+	std::string tag;
+	uint32_t allocation_count = 0;
+	VkDeviceSize allocated_bytes = 0;
+};
+
+struct MemoryReport {
+	bool budget_extension = false;
+	uint32_t allocation_count = 0;
+	uint32_t max_allocation_count = 0;
+	std::vector<MemoryHeapReport> heaps;
+	std::vector<MemoryTagReport> tags;
+};
+
+class memory_tracker {
+
+	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+	bool budget_extension = false;
+
+	VkPhysicalDeviceMemoryProperties memory_properties = {};
+	uint32_t max_allocation_count = 0;
+
+	// Allocations may come from worker threads
+	std::mutex allocations_mutex;
+	std::unordered_map<VkDeviceMemory, MemoryAllocationInfo> allocations;
+	std::vector<VkDeviceSize> heap_bytes;
+	std::vector<VkDeviceSize> peak_heap_bytes;
+
+public:
+	memory_tracker();
+
+	void init(VkPhysicalDevice new_physical_device, VkDevice new_device, bool memory_budget_extension,
+		const VkAllocationCallbacks* new_allocator);
+
+	VkResult allocate(const VkMemoryAllocateInfo* allocate_info, VkDeviceMemory* memory, const char* tag);
+	void free(VkDeviceMemory memory);
+
+	// Bytes of the allocation used by a resource bound to it
+	void add_bound_bytes(VkDeviceMemory memory, VkDeviceSize bytes);
+
+	MemoryReport get_report();
+	void print_report();
+};
@@ -0,0 +1,81 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW\glfw3.h>
+
+#include <stdexcept>
+#include <vector>
+#include <string>
+
+#include "vulkan_loader.h"
+#include "utilities.h"
+#include "mesh_format.h"
+#include "mapped_file.h"
+#include "bindless_heap.h"
+#include "memory_tracker.h"
+
+// Meshes written by mesh_converter.
+// The file is memory mapped and its vertex and index sections, which are
+// adjacent, are copied into the staging buffer in one memcpy. Nothing is parsed
+// or converted on the CPU, the header is only validated against the file size.
+// Both sections live in one device local buffer that is also registered in the
+// bindless heap so shaders can fetch the packed vertices themselves.
+
+struct GpuMesh {
+	std::string file;
+
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize bytes = 0;
+	uint32_t bindless_index = BINDLESS_INVALID_INDEX;
+
+	// Byte offsets inside the buffer
+	VkDeviceSize vertex_offset = 0;
+	VkDeviceSize index_offset = 0;
+
+	// Header of the file, holds the counts and the quantization ranges
+	MeshFileHeader header = {};
+	std::vector<MeshLod> lods;
+	std::vector<Meshlet> meshlets;
+};
+
+struct MeshLoadStats {
+	uint32_t mesh_count = 0;
+	VkDeviceSize bytes_uploaded = 0;
+	double map_ms = 0.0;
+	double copy_ms = 0.0;
+	double upload_ms = 0.0;
+};
+
+class mesh_manager {
+
+	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueue queue = VK_NULL_HANDLE;
+	VkCommandPool command_pool = VK_NULL_HANDLE;
+
+	bindless_heap* heap = nullptr;
+	memory_tracker* tracker = nullptr;
+	const VkAllocationCallbacks* allocator = nullptr;
+
+	std::vector<GpuMesh> meshes;
+	MeshLoadStats stats;
+
+	void create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+		const char* tag, VkBuffer* buffer, VkDeviceMemory* memory);
+
+public:
+	mesh_manager();
+
+	void init(VkPhysicalDevice new_physical_device, VkDevice new_device, VkQueue new_queue, uint32_t queue_family,
+		bindless_heap* new_heap, memory_tracker* new_tracker, const VkAllocationCallbacks* new_allocator);
+
+	// Blocks until the mesh is on the GPU
+	uint32_t load(const std::string& file);
+	void destroy();
+
+	// Getters
+	const GpuMesh& get_mesh(uint32_t mesh);
+	uint32_t get_mesh_count();
+	const MeshLoadStats& get_stats();
+	void print_stats();
+};
@@ -0,0 +1,137 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW\glfw3.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm\glm.hpp>
+
+#include <stdexcept>
+#include <vector>
+
+#include "vulkan_loader.h"
+#include "utilities.h"
+#include "memory_tracker.h"
+#include "descriptor_allocator.h"
+
+// Occlusion culling against a hierarchical depth buffer.
+// A compute pass reduces the depth of the frame into a pyramid where every
+// texel holds the farthest depth below it, then copies the coarse levels into a
+// host buffer of the frame in flight. Once the fence of that frame has been
+// waited on, the levels and the view projection they were rendered with become
+// the CPU pyramid. Object bounds are projected with that matrix and dropped when
+// they lie behind every texel they cover, before they reach the draw list.
+//
+// The pyramid is MAX_FRAME_DRAWS frames old when it is tested, so an object
+// uncovered by a moving occluder can be missing for that many frames.
+
+// Coarse levels are read back from the first one no larger than this
+const uint32_t HIZ_READBACK_SIZE = 128;
+
+// Must match HiZPushConstants in hiz_reduce.comp
+struct HiZPushConstants {
+	uint32_t source_size[2];
+	uint32_t target_size[2];
+};
+
+struct HiZLevel {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	VkImageView image_view = VK_NULL_HANDLE;
+
+	// Offset in floats into the readback, for levels that are read back
+	size_t readback_offset = 0;
+};
+
+// Levels copied by one frame in flight
+struct HiZReadback {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	void* mapped = nullptr;
+	glm::mat4 view_projection = glm::mat4(1.0f);
+	bool recorded = false;
+};
+
+struct OcclusionStats {
+	// Last frame
+	uint32_t tested = 0;
+	uint32_t occluded = 0;
+
+	uint64_t total_tested = 0;
+	uint64_t total_occluded = 0;
+};
+
+class occlusion_culler {
+
+	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	memory_tracker* tracker = nullptr;
+	descriptor_allocator* descriptors = nullptr;
+	const VkAllocationCallbacks* allocator = nullptr;
+
+	bool available = false;
+
+	// Pyramid, level 0 is the depth buffer size rounded down to powers of two
+	VkImage image = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkImageView image_view = VK_NULL_HANDLE;
+	std::vector<HiZLevel> levels;
+	uint32_t readback_level = 0;
+	size_t readback_floats = 0;
+
+	// Depth only view of the depth buffer, recreated with the render targets
+	VkImageView depth_view = VK_NULL_HANDLE;
+	VkExtent2D source_extent = {};
+
+	VkSampler sampler = VK_NULL_HANDLE;
+
+	// A cached set per level, its source and target views
+	VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	std::vector<HiZReadback> readbacks;
+
+	// Levels from readback_level down, with the matrix they were rendered with
+	std::vector<float> pyramid;
+	glm::mat4 pyramid_view_projection = glm::mat4(1.0f);
+	bool pyramid_valid = false;
+
+	OcclusionStats stats;
+
+	void create_pyramid(VkExtent2D depth_extent);
+	void create_pipeline(const std::vector<char>& shader_code);
+	void create_readbacks(uint32_t frame_count);
+
+public:
+	occlusion_culler();
+
+	// Without the compiled reduction shader the culler stays unavailable and tests nothing
+	void init(VkPhysicalDevice new_physical_device, VkDevice new_device, VkExtent2D depth_extent, uint32_t frame_count,
+		const std::vector<char>& shader_code, memory_tracker* new_tracker, descriptor_allocator* new_descriptors,
+		const VkAllocationCallbacks* new_allocator);
+	void destroy();
+
+	bool is_available();
+
+	// Pyramid image for the render graph, written in VK_IMAGE_LAYOUT_GENERAL
+	VkImage get_image();
+	VkImageView get_image_view();
+	VkExtent2D get_extent();
+
+	// The device must be idle, the old pyramid is dropped and so is the descriptor cache.
+	// Level 0 keeps its size, a depth buffer that grew is reduced by more than two texels per axis
+	void set_depth_source(VkImage depth_image, VkFormat depth_format, VkExtent2D depth_extent);
+	void reset();
+
+	// Inside a compute pass that samples the depth buffer and writes the pyramid image
+	void record(VkCommandBuffer command_buffer, uint32_t frame_slot, const glm::mat4& view_projection);
+
+	// The fence of frame_slot was waited on, its levels become the CPU pyramid
+	void frame_complete(uint32_t frame_slot);
+
+	// World space bounding sphere, never occluded while there is no pyramid yet
+	bool is_occluded(const float* center, float radius);
+
+	const OcclusionStats& get_stats();
+};
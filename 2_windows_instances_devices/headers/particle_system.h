@@ -0,0 +1,233 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW\glfw3.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm\glm.hpp>
+
+#include <stdexcept>
+#include <vector>
+#include <array>
+#include <chrono>
+
+#include "vulkan_loader.h"
+#include "utilities.h"
+#include "memory_tracker.h"
+#include "descriptor_allocator.h"
+
+// Particles simulated and drawn without the CPU touching a single one.
+// One storage buffer holds every particle, two alive lists and a dead list of
+// particle indices. Each frame a compute pass pops new particles off the dead
+// list onto the alive list of the frame, ages and moves that list, and compacts
+// the survivors into the other list while the dead go back onto the dead list.
+//
+// The list lengths are atomics in a second buffer laid out as indirect
+// arguments: the simulation is dispatched from the alive count and the quads are
+// drawn with the survivor count as instance count. Recording costs the same few
+// commands whatever the particle count, and the counts reach the CPU only as
+// statistics, read back once the frame's fence has been waited on.
+//
+// Both buffers are imported into the render graph, which places the barriers
+// between the compute pass and the draw, and from the draw to the next frame.
+
+// Invocations per group of particles.comp
+const uint32_t PARTICLE_GROUP_SIZE = 256;
+
+// Specialization constant PARTICLE_STAGE of particles.comp, a compute pipeline each
+enum class ParticleStage : uint32_t {
+	reset = 0,
+	emit = 1,
+	prepare = 2,
+	simulate = 3
+};
+
+const uint32_t PARTICLE_STAGE_COUNT = 4;
+
+// Must match Particle in particles.comp
+struct GpuParticle {
+	float position_life[4];
+	float velocity_age[4];
+};
+
+// Must match Counters in particles.comp, the instance count of draws[i] is the length of alive list i
+struct ParticleCounters {
+	VkDispatchIndirectCommand simulate;
+	uint32_t dead_count;
+	VkDrawIndirectCommand draws[2];
+};
+
+// Must match ParticlePushConstants in particles.comp
+struct ParticlePushConstants {
+	float emitter[4];
+	float gravity[4];
+	uint32_t emit_count;
+	uint32_t source_index;
+	uint32_t capacity;
+	uint32_t seed;
+	float lifetime;
+	float speed;
+};
+
+// Must match ParticleDrawPushConstants in particle.vert
+struct ParticleDrawPushConstants {
+	glm::mat4 view_projection;
+	float camera_right[4];
+	float camera_up[4];
+};
+
+struct ParticleEmitter {
+	float position[3] = { 0.0f, 0.0f, 0.0f };
+	float radius = 0.25f;
+
+	// Particles per second, they stop coming while every particle is alive
+	float rate = 100000.0f;
+
+	// Seconds, each particle lives between half and one and a half times this
+	float lifetime = 4.0f;
+	float speed = 2.0f;
+	float size = 0.02f;
+	float gravity[3] = { 0.0f, -9.81f, 0.0f };
+};
+
+// Counters copied by one frame in flight
+struct ParticleReadback {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	void* mapped = nullptr;
+
+	// Alive list the frame drew, the other one is the list it simulated
+	uint32_t draw_index = 0;
+	uint32_t emitted = 0;
+	bool recorded = false;
+};
+
+struct ParticleStats {
+	uint32_t capacity = 0;
+
+	// Last completed frame
+	uint32_t alive = 0;
+	uint32_t emitted = 0;
+	double gpu_ms = 0.0;
+
+	uint64_t frames = 0;
+	uint64_t total_simulated = 0;
+	double total_gpu_ms = 0.0;
+};
+
+class particle_system {
+
+	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	memory_tracker* tracker = nullptr;
+	descriptor_allocator* descriptors = nullptr;
+	const VkAllocationCallbacks* allocator = nullptr;
+
+	bool available = false;
+	bool enabled = false;
+
+	// Rounded up to whole groups
+	uint32_t capacity = 0;
+
+	// Particles, then alive list 0, alive list 1 and the dead list, each aligned for a storage buffer offset
+	VkBuffer particle_buffer = VK_NULL_HANDLE;
+	VkDeviceMemory particle_memory = VK_NULL_HANDLE;
+	std::array<VkDeviceSize, 4> section_offsets = {};
+	std::array<VkDeviceSize, 4> section_sizes = {};
+
+	// ParticleCounters, read by the indirect dispatch and draw
+	VkBuffer counter_buffer = VK_NULL_HANDLE;
+	VkDeviceMemory counter_memory = VK_NULL_HANDLE;
+
+	// Every stage and the draw share the set layout, one cached set per source list
+	VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+	VkPipelineLayout compute_layout = VK_NULL_HANDLE;
+	std::array<VkPipeline, PARTICLE_STAGE_COUNT> compute_pipelines = {};
+
+	// The draw pipeline follows the render targets, the modules are kept for it
+	VkShaderModule vertex_module = VK_NULL_HANDLE;
+	VkShaderModule fragment_module = VK_NULL_HANDLE;
+	VkPipelineLayout draw_layout = VK_NULL_HANDLE;
+	VkPipeline draw_pipeline = VK_NULL_HANDLE;
+
+	// Two timestamps per frame in flight around the compute pass
+	VkQueryPool timestamp_pool = VK_NULL_HANDLE;
+	bool timestamps_available = false;
+	double timestamp_period = 1.0;
+	uint64_t timestamp_mask = ~0ull;
+
+	std::vector<ParticleReadback> readbacks;
+
+	// Alive list the last simulation wrote, drawn this frame and simulated the next
+	uint32_t source_index = 0;
+	bool needs_reset = true;
+
+	ParticleEmitter emitter;
+	float emit_remainder = 0.0f;
+	float fixed_time_step = 0.0f;
+	std::chrono::steady_clock::time_point last_time;
+	bool clock_started = false;
+	uint32_t seed = 0;
+
+	ParticleStats stats;
+
+	void create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, const char* name, VkBuffer* buffer, VkDeviceMemory* memory);
+	void create_buffers();
+	void destroy_buffers();
+	void create_compute_pipelines(const std::vector<char>& shader_code);
+	void create_draw_layout(const std::vector<char>& vertex_code, const std::vector<char>& fragment_code);
+	void create_readbacks(uint32_t queue_family, uint32_t frame_count);
+
+	VkDescriptorSet get_set(uint32_t source);
+	float next_time_step();
+
+public:
+	particle_system();
+
+	// Without particles.spv and both draw shaders the system stays unavailable and records nothing
+	void init(VkPhysicalDevice new_physical_device, VkDevice new_device, uint32_t queue_family, uint32_t new_capacity,
+		uint32_t frame_count, const std::vector<char>& compute_code, const std::vector<char>& vertex_code,
+		const std::vector<char>& fragment_code, memory_tracker* new_tracker, descriptor_allocator* new_descriptors,
+		const VkAllocationCallbacks* new_allocator);
+	void destroy();
+
+	bool is_available();
+
+	// Off by default, the renderer only adds the pass and the draw while enabled
+	void set_enabled(bool enable);
+	bool is_enabled();
+
+	// The device must be idle. The buffers are replaced, so every graph importing them is rebuilt after this
+	void set_capacity(uint32_t new_capacity);
+	uint32_t get_capacity();
+
+	// Every particle is dead again at the start of the next frame
+	void reset();
+
+	void set_emitter(const ParticleEmitter& new_emitter);
+	const ParticleEmitter& get_emitter();
+
+	// Seconds simulated per frame for repeatable runs, zero follows the clock
+	void set_fixed_time_step(float seconds);
+
+	// For import into the render graph
+	VkBuffer get_particle_buffer();
+	VkBuffer get_counter_buffer();
+
+	// Rebuilt with the render targets, rendering_info replaces the render pass with dynamic rendering
+	void create_draw_pipeline(VkRenderPass render_pass, const VkPipelineRenderingCreateInfoKHR* rendering_info,
+		VkSampleCountFlagBits samples);
+	void destroy_draw_pipeline();
+
+	// Inside a compute pass that writes both buffers
+	void record_simulation(VkCommandBuffer command_buffer, uint32_t frame_slot);
+
+	// Inside a graphics pass that reads both buffers, after the opaque geometry it is depth tested against
+	void record_draw(VkCommandBuffer command_buffer, const glm::mat4& view, const glm::mat4& view_projection);
+
+	// The fence of frame_slot was waited on, its counters and timestamps become the stats
+	void frame_complete(uint32_t frame_slot);
+
+	const ParticleStats& get_stats();
+	void print_stats();
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdexcept>
+#include <vector>
+#include <string>
+
+// Performance metrics checked against a baseline file.
+// The file has one metric per line: its name, its value and the increase over
+// the value that is still accepted, in percent. Lines starting with # are
+// comments. Every metric is a cost, so only a measurement above
+// value * (1 + tolerance / 100) fails.
+//
+// A metric missing on either side fails the check as well, so a scenario that
+// did not run can not pass unnoticed. Comment lines and tolerances survive
+// writing new values into an existing file.
+
+struct PerfMetric {
+	std::string name;
+	double value = 0.0;
+
+	// Percent
+	double tolerance = 0.0;
+};
+
+class perf_baseline {
+
+	std::vector<PerfMetric> metrics;
+
+	// Written back on top of the file when it is saved again
+	std::vector<std::string> comments;
+
+public:
+	perf_baseline();
+
+	// Throws when the file can not be opened or a line can not be read
+	void load(const std::string& file);
+	void save(const std::string& file);
+
+	// The tolerance is only used for a metric that is not in the baseline yet
+	void set(const std::string& name, double value, double tolerance);
+	const PerfMetric* find(const std::string& name) const;
+	const std::vector<PerfMetric>& get_metrics() const;
+
+	// Takes the values of measured, keeping the tolerances already in the baseline
+	void update(const perf_baseline& measured);
+
+	// Prints every metric of both next to each other, returns how many failed.
+	// Metrics found on one side only are failures too
+	uint32_t compare(const perf_baseline& measured) const;
+};
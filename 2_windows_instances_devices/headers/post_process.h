@@ -0,0 +1,151 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW\glfw3.h>
+
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <array>
+
+#include "vulkan_loader.h"
+#include "utilities.h"
+#include "descriptor_allocator.h"
+#include "render_graph.h"
+
+// Post-processing of the HDR target in compute passes.
+// The scene is drawn into a 16 bit float image. Bloom halves it level by level,
+// the first level keeping only what is brighter than the threshold, then adds the
+// levels back up from the smallest. Tone mapping applies the exposure and the ACES
+// curve into an 8 bit image, which is blitted into the swap chain image.
+//
+// The down and up sampling passes load the texels of their group into shared
+// memory once and filter from there. Every pass is a render graph pass on
+// transient images, so the levels share memory with the images around them.
+//
+// Each pass is timed with two timestamps, read back once the fence of its frame
+// has been waited on, to budget post-processing per frame.
+
+const VkFormat POST_HDR_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+const VkFormat POST_LDR_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+// Levels below this size are not worth a pass
+const uint32_t POST_MIN_BLOOM_SIZE = 8;
+const uint32_t POST_MAX_BLOOM_LEVELS = 8;
+
+// Timed passes per frame in flight, passes past it in a frame are not timed
+const uint32_t POST_MAX_TIMED_PASSES = 64;
+
+enum class PostStage {
+	prefilter,
+	downsample,
+	upsample,
+	tonemap
+};
+
+const uint32_t POST_STAGE_COUNT = 4;
+
+// Must match PostPushConstants in bloom_downsample.comp, bloom_upsample.comp and tonemap.comp
+struct PostPushConstants {
+	int32_t source_size[2];
+	int32_t target_size[2];
+	float threshold;
+	float knee;
+	float intensity;
+	float exposure;
+};
+
+struct PostSettings {
+	float exposure = 1.0f;
+
+	// Brightness bloom starts at, and the fraction of it over which it fades in
+	float bloom_threshold = 1.0f;
+	float bloom_knee = 0.5f;
+	float bloom_intensity = 0.05f;
+
+	// Changing the level count rebuilds the render graph, zero turns bloom off
+	uint32_t bloom_levels = 5;
+};
+
+struct PostPassTiming {
+	std::string name;
+
+	// Last resolved frame, a pass recorded for several windows is summed
+	double last_ms = 0.0;
+
+	double total_ms = 0.0;
+	uint64_t frame_count = 0;
+};
+
+// Timestamps of one frame in flight, pass i wrote queries 2i and 2i + 1
+struct PostFrame {
+	VkQueryPool pool = VK_NULL_HANDLE;
+	std::vector<uint32_t> timings;
+	bool recorded = false;
+};
+
+class post_process {
+
+	VkDevice device = VK_NULL_HANDLE;
+	descriptor_allocator* descriptors = nullptr;
+	const VkAllocationCallbacks* allocator = nullptr;
+
+	bool available = false;
+	PostSettings settings;
+
+	// Three storage images for every stage: source, second source and target
+	VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+	std::vector<VkPipeline> pipelines;
+
+	bool timestamps_available = false;
+	double timestamp_period = 1.0;
+	uint64_t timestamp_mask = ~0ull;
+
+	std::vector<PostFrame> frames;
+	uint32_t current_frame = 0;
+	std::vector<PostPassTiming> timings;
+	std::vector<uint64_t> results;
+	double last_total_ms = 0.0;
+
+	void create_pipelines(const std::vector<char>& downsample_code, const std::vector<char>& upsample_code,
+		const std::vector<char>& tonemap_code);
+	void create_timestamps(VkPhysicalDevice physical_device, uint32_t queue_family, uint32_t frame_count);
+	void resolve_frame(PostFrame& frame);
+
+	uint32_t add_timing(const std::string& name);
+	// False once the pool of the frame is full, the pass then goes untimed
+	bool begin_timing(VkCommandBuffer command_buffer, uint32_t timing);
+	void end_timing(VkCommandBuffer command_buffer);
+
+	void dispatch(VkCommandBuffer command_buffer, PostStage stage, VkImageView source, VkImageView second_source,
+		VkImageView target, VkExtent2D source_extent, VkExtent2D target_extent);
+
+public:
+	post_process();
+
+	// Without all three compute shaders it stays unavailable, the scene is then drawn straight into the swap chain
+	void init(VkPhysicalDevice physical_device, VkDevice new_device, uint32_t queue_family, uint32_t frame_count,
+		const std::vector<char>& downsample_code, const std::vector<char>& upsample_code, const std::vector<char>& tonemap_code,
+		descriptor_allocator* new_descriptors, const VkAllocationCallbacks* new_allocator);
+	void destroy();
+
+	bool is_available();
+
+	void set_settings(const PostSettings& new_settings);
+	const PostSettings& get_settings();
+
+	// Bloom levels that fit an image of this size
+	uint32_t get_bloom_levels(VkExtent2D extent);
+
+	// The chain after the passes drawing hdr_image, ending with a blit into output.
+	// Output is written whole, nothing drawn into it before is kept
+	void add_passes(render_graph* graph, uint32_t hdr_image, uint32_t output, VkExtent2D extent);
+
+	// Reads the timings of the last use of frame_slot and resets its queries, outside of any render pass
+	void begin_frame(VkCommandBuffer command_buffer, uint32_t frame_slot);
+
+	const std::vector<PostPassTiming>& get_timings();
+	double get_last_total_ms();
+	void reset_timings();
+	void print_stats();
+};
@@ -0,0 +1,173 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW\glfw3.h>
+
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+
+#include "vulkan_loader.h"
+#include "utilities.h"
+
+// Timeline of CPU and GPU zones, written as a Chrome trace.
+// A CPU zone reads the host clock when it opens and when it closes, and lands on
+// the track of the thread it ran on. A GPU zone writes a timestamp at the top and
+// at the bottom of the pipe into the query pool of the frame in flight, and is
+// read back once the fence of that frame has been waited on.
+//
+// GPU ticks are moved onto the host clock with VK_EXT_calibrated_timestamps,
+// which samples both clocks at once when a frame is recorded. Without it the
+// first GPU zone of a frame is placed at the submit of that frame, so the queue
+// latency is lost but durations and the order of zones are right.
+//
+// The file is the JSON trace event format opened by chrome://tracing and
+// Perfetto. While nothing is captured a zone costs one relaxed load and a branch.
+
+// Timestamps per frame in flight, a GPU zone takes two
+const uint32_t PROFILER_GPU_QUERIES_PER_FRAME = 128;
+
+// Zones recorded after this many are dropped, a long capture does not grow without bound
+const size_t PROFILER_MAX_EVENTS = 1 << 20;
+
+// Track of the GPU zones, CPU threads are numbered from 1 in the order they record their first zone
+const uint32_t PROFILER_GPU_TRACK = 0;
+
+struct ProfileEvent {
+	const char* name = nullptr;
+	uint64_t begin_ns = 0;
+	uint64_t end_ns = 0;
+	uint32_t track = PROFILER_GPU_TRACK;
+};
+
+// Timestamps begin_query and begin_query + 1 of the pool of its frame
+struct ProfilerGpuZone {
+	const char* name = nullptr;
+	uint32_t begin_query = 0;
+};
+
+struct ProfilerGpuFrame {
+	VkQueryPool pool = VK_NULL_HANDLE;
+	std::vector<ProfilerGpuZone> zones;
+	uint32_t query_count = 0;
+
+	// Host nanoseconds minus GPU nanoseconds, sampled while the frame was recorded
+	double clock_offset_ns = 0.0;
+	bool calibrated = false;
+
+	// Host time of the submit, where the frame starts without calibration
+	uint64_t submit_ns = 0;
+};
+
+struct ProfilerStats {
+	uint64_t cpu_zones = 0;
+	uint64_t gpu_zones = 0;
+	uint64_t dropped_zones = 0;
+	uint64_t calibrations = 0;
+
+	// Largest uncertainty reported by vkGetCalibratedTimestampsEXT
+	uint64_t max_deviation_ns = 0;
+};
+
+class profiler {
+
+	std::atomic<bool> capturing{ false };
+	std::string trace_file;
+	uint64_t start_ns = 0;
+
+	// CPU zones are recorded from the worker threads too
+	std::mutex event_mutex;
+	std::vector<ProfileEvent> events;
+	std::unordered_set<std::string> names;
+
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+
+	bool gpu_available = false;
+	bool calibration_available = false;
+	VkTimeDomainEXT host_domain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+	double timestamp_period = 1.0;
+	uint64_t timestamp_mask = ~0ull;
+
+	std::vector<ProfilerGpuFrame> frames;
+	uint32_t current_frame = 0;
+	bool frame_active = false;
+
+	// Zones begun and not ended yet, dropped ones are kept as UINT32_MAX so ends still pair up
+	std::vector<uint32_t> open_zones;
+	std::vector<uint64_t> results;
+
+	ProfilerStats stats;
+
+	void calibrate(ProfilerGpuFrame& frame);
+	void resolve_frame(ProfilerGpuFrame& frame);
+	void add_event(const ProfileEvent& event);
+	void write_trace();
+
+	static uint32_t get_track();
+	static uint64_t host_ticks_to_ns(uint64_t ticks);
+
+public:
+	profiler();
+
+	// CPU zones can be recorded before this. Without timestamps on the queue family there are no GPU zones
+	void init(VkPhysicalDevice physical_device, VkDevice new_device, uint32_t queue_family, uint32_t frame_count,
+		bool calibrated_timestamps, const VkAllocationCallbacks* new_allocator);
+	void destroy();
+
+	// Zones are kept from start until stop, which writes them to file.
+	// The device must be idle for the GPU zones of the last frames to be in the file
+	void start(const std::string& file);
+	void stop();
+
+	bool is_capturing()
+	{
+		return capturing.load(std::memory_order_relaxed);
+	}
+
+	// Host clock of every zone, the one the GPU is calibrated against
+	static uint64_t now_ns();
+
+	// Zone names are not copied, names that do not outlive the capture are interned here first
+	const char* intern(const std::string& name);
+
+	void add_cpu_zone(const char* name, uint64_t begin_ns, uint64_t end_ns);
+
+	// The fence of frame_slot was waited on, called before any zone of the command buffer
+	void begin_frame(VkCommandBuffer command_buffer, uint32_t frame_slot);
+	void begin_gpu_zone(VkCommandBuffer command_buffer, const char* name);
+	void end_gpu_zone(VkCommandBuffer command_buffer);
+
+	// Right after the command buffer of frame_slot was submitted
+	void frame_submitted(uint32_t frame_slot);
+
+	const ProfilerStats& get_stats();
+	void print_stats();
+};
+
+// CPU zone from construction to the end of the scope, name has to outlive the capture
+class profile_zone {
+
+	profiler* owner;
+	const char* name;
+	uint64_t begin_ns = 0;
+
+public:
+	profile_zone(profiler* new_owner, const char* new_name)
+		: owner(new_owner->is_capturing() ? new_owner : nullptr), name(new_name)
+	{
+		if (owner != nullptr)
+			begin_ns = profiler::now_ns();
+	}
+
+	~profile_zone()
+	{
+		if (owner != nullptr)
+			owner->add_cpu_zone(name, begin_ns, profiler::now_ns());
+	}
+
+	profile_zone(const profile_zone&) = delete;
+	profile_zone& operator=(const profile_zone&) = delete;
+};
@@ -0,0 +1,268 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW\glfw3.h>
+
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+
+#include "vulkan_loader.h"
+#include "utilities.h"
+#include "memory_tracker.h"
+#include "profiler.h"
+
+// Frame render graph.
+// Passes declare the images they read and write. From that the graph works out
+// which passes contribute to the output, the layout transitions and barriers
+// between passes, and how the memory of transient images can be shared.
+//
+// Graphics passes become a VkRenderPass with a framebuffer per swap chain image,
+// or with dynamic rendering they begin rendering straight on the image views.
+// Attachments are then transitioned by the graph's own barriers, and imported
+// images get a last barrier into their final layout.
+//
+// Buffers are imported only. They have no layout, so they only get a barrier on
+// a hazard, and as they keep their contents between frames the first use in a
+// frame waits on the last use of the frame before.
+
+class render_graph;
+
+// Passes that look up their own images get the graph and the swap chain image being
+// recorded, transient images are only known once the graph is compiled
+using RenderGraphRecord = std::function<void(VkCommandBuffer, render_graph&, uint32_t)>;
+
+enum class PassType {
+	graphics,
+	compute,
+	transfer
+};
+
+enum class ResourceUsage {
+	color_attachment,
+	depth_attachment,
+	sampled,
+	storage_read,
+	storage_write,
+	transfer_src,
+	transfer_dst,
+	buffer_read,
+	buffer_write,
+	indirect_read
+};
+
+struct RenderGraphImageInfo {
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkExtent2D extent = {};
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+	VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+};
+
+// Where a resource was last touched, used to derive the next barrier
+struct ResourceState {
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkPipelineStageFlags write_stages = 0;
+	VkAccessFlags write_access = 0;
+	VkPipelineStageFlags read_stages = 0;
+	VkPipelineStageFlags visible_stages = 0;
+};
+
+struct RenderGraphResource {
+	std::string name;
+	RenderGraphImageInfo info;
+	bool imported = false;
+	VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkImageUsageFlags usage = 0;
+
+	// Attachment only used inside a single pass, backed by lazily allocated memory when available
+	bool lazily_allocated = false;
+
+	// Imported images may have one handle per swap chain image
+	std::vector<VkImage> images;
+	std::vector<VkImageView> image_views;
+
+	// Set for imported buffers, which have no images
+	VkBuffer buffer = VK_NULL_HANDLE;
+
+	// Compile results
+	int first_pass = -1;
+	int last_pass = -1;
+	uint32_t memory_type = 0;
+	VkDeviceSize memory_offset = 0;
+	VkMemoryRequirements memory_requirements = {};
+	ResourceState initial_state;
+};
+
+struct PassAccess {
+	uint32_t resource;
+	ResourceUsage usage;
+	VkImageLayout layout;
+	VkPipelineStageFlags stages;
+	VkAccessFlags access;
+	bool write;
+	bool read;
+};
+
+// Attachment of a graphics pass with dynamic rendering, resolve is -1 without one
+struct RenderGraphAttachment {
+	uint32_t resource;
+	int resolve = -1;
+	VkAttachmentLoadOp load_op = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	VkAttachmentStoreOp store_op = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	VkClearValue clear_value = {};
+};
+
+struct PassBarrier {
+	uint32_t resource;
+	VkImageLayout old_layout;
+	VkImageLayout new_layout;
+	VkAccessFlags src_access;
+	VkAccessFlags dst_access;
+};
+
+struct RenderGraphPass {
+	std::string name;
+	PassType type;
+	std::vector<PassAccess> accesses;
+	std::vector<uint32_t> color_outputs;
+	std::vector<VkClearValue> color_clear_values;
+	std::vector<bool> color_clear;
+	std::vector<int> color_resolves;
+	int depth_output = -1;
+	VkClearValue depth_clear_value = {};
+	bool depth_clear = false;
+	RenderGraphRecord record;
+
+	// Compile results
+	bool culled = false;
+	std::vector<VkClearValue> clear_values;
+	std::vector<PassBarrier> barriers;
+	VkPipelineStageFlags barrier_src_stages = 0;
+	VkPipelineStageFlags barrier_dst_stages = 0;
+	VkRenderPass render_pass = VK_NULL_HANDLE;
+	std::vector<VkFramebuffer> framebuffers;
+	VkExtent2D extent = {};
+
+	// Dynamic rendering, colour attachments first and the depth attachment last
+	std::vector<RenderGraphAttachment> attachments;
+
+	// Name of its GPU zone, interned the first time the pass is profiled
+	const char* profile_name = nullptr;
+};
+
+struct RenderGraphStats {
+	uint32_t pass_count = 0;
+	uint32_t culled_pass_count = 0;
+	uint32_t barrier_count = 0;
+	uint32_t image_barrier_count = 0;
+	uint32_t buffer_barrier_count = 0;
+	VkDeviceSize transient_bytes = 0;
+	VkDeviceSize aliased_bytes = 0;
+	VkDeviceSize lazily_allocated_bytes = 0;
+	uint32_t render_pass_count = 0;
+	uint32_t framebuffer_count = 0;
+	double compile_ms = 0.0;
+};
+
+class render_graph {
+
+	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	memory_tracker* tracker = nullptr;
+	const VkAllocationCallbacks* allocator = nullptr;
+
+	std::vector<RenderGraphResource> resources;
+	std::vector<RenderGraphPass> passes;
+	std::vector<uint32_t> outputs;
+
+	// Passes that survived culling, in submission order
+	std::vector<uint32_t> pass_order;
+
+	std::vector<VkDeviceMemory> memory_blocks;
+	RenderGraphStats stats;
+
+	// VK_KHR_dynamic_rendering instead of render pass objects
+	bool dynamic_rendering = false;
+	std::vector<VkRenderingAttachmentInfoKHR> rendering_attachments;
+
+	// Imported images moved into their final layout after the last pass
+	std::vector<PassBarrier> final_barriers;
+	VkPipelineStageFlags final_src_stages = 0;
+
+	// Each pass and its barriers become a GPU zone while the profiler captures
+	profiler* profile = nullptr;
+
+	void add_access(uint32_t pass, uint32_t resource, ResourceUsage usage);
+
+	void cull_passes();
+	void compute_lifetimes();
+	void allocate_transient_images();
+	void build_barriers();
+	void create_render_pass(RenderGraphPass& pass, size_t order_index, std::vector<ResourceState>& states);
+	void create_framebuffers(RenderGraphPass& pass);
+	void create_rendering_attachments(RenderGraphPass& pass, size_t order_index, const std::vector<ResourceState>& states);
+	void build_final_barriers(const std::vector<ResourceState>& states);
+	void record_barriers(VkCommandBuffer command_buffer, const std::vector<PassBarrier>& barriers, VkPipelineStageFlags src_stages,
+		VkPipelineStageFlags dst_stages, uint32_t image_index);
+	void begin_rendering(VkCommandBuffer command_buffer, const RenderGraphPass& pass, uint32_t image_index);
+
+	std::vector<uint32_t> get_attachment_resources(const RenderGraphPass& pass);
+	int find_next_use(uint32_t resource, size_t order_index);
+	const PassAccess* find_access(const RenderGraphPass& pass, uint32_t resource);
+
+public:
+	render_graph();
+
+	// Resources
+	uint32_t add_image(const std::string& name, const RenderGraphImageInfo& info);
+	uint32_t import_image(const std::string& name, const RenderGraphImageInfo& info, const std::vector<VkImage>& images,
+		const std::vector<VkImageView>& image_views, VkImageLayout final_layout);
+	uint32_t import_buffer(const std::string& name, VkBuffer buffer);
+
+	// Passes
+	uint32_t add_pass(const std::string& name, PassType type);
+	void add_color_output(uint32_t pass, uint32_t resource, const VkClearValue* clear_value = nullptr);
+	void set_depth_output(uint32_t pass, uint32_t resource, const VkClearValue* clear_value = nullptr);
+	void add_resolve_output(uint32_t pass, uint32_t color_resource, uint32_t resolve_resource);
+	void add_texture_input(uint32_t pass, uint32_t resource);
+	void add_storage_input(uint32_t pass, uint32_t resource);
+	void add_storage_output(uint32_t pass, uint32_t resource);
+	void add_transfer_input(uint32_t pass, uint32_t resource);
+	void add_transfer_output(uint32_t pass, uint32_t resource);
+
+	// Storage buffers read or written by the shaders of the pass, written ones are read too
+	void add_buffer_input(uint32_t pass, uint32_t resource);
+	void add_buffer_output(uint32_t pass, uint32_t resource);
+
+	// Draw or dispatch arguments read by the indirect commands of the pass
+	void add_indirect_input(uint32_t pass, uint32_t resource);
+	void set_record(uint32_t pass, std::function<void(VkCommandBuffer)> record);
+	void set_record(uint32_t pass, RenderGraphRecord record);
+
+	// Resources that must be produced each frame. Anything not feeding them is culled.
+	void set_output(uint32_t resource);
+
+	// Needs the extension and its feature enabled on the device, set before compile
+	void set_dynamic_rendering(bool enable);
+	bool is_dynamic_rendering();
+
+	void set_profiler(profiler* new_profile);
+
+	void compile(VkPhysicalDevice new_physical_device, VkDevice new_device, memory_tracker* new_tracker,
+		const VkAllocationCallbacks* new_allocator);
+	void execute(VkCommandBuffer command_buffer, uint32_t image_index);
+	void destroy();
+
+	// Getters
+	VkRenderPass get_render_pass(uint32_t pass);
+
+	// Formats a pipeline drawing in the pass is created with when there is no render pass
+	void get_attachment_formats(uint32_t pass, std::vector<VkFormat>* color_formats, VkFormat* depth_format);
+	VkImage get_image(uint32_t resource, uint32_t image_index = 0);
+	VkImageView get_image_view(uint32_t resource, uint32_t image_index = 0);
+	VkBuffer get_buffer(uint32_t resource);
+	VkPipelineStageFlags get_first_use_stages(uint32_t resource);
+	const RenderGraphStats& get_stats();
+	void print_stats();
+};
@@ -0,0 +1,126 @@
+#pragma once
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm\glm.hpp>
+#include <glm\mat4x4.hpp>
+
+#include <stdexcept>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <functional>
+
+#include "thread_pool.h"
+
+// Data oriented scene.
+// Objects are stored as structure of arrays: every transform component, bound
+// and draw key lives in its own array so the kernels stream through memory and
+// work on four objects per SSE instruction. Arrays are kept sorted by depth in
+// the hierarchy, so a level only reads world transforms of the level above and
+// each level can be split across the worker threads.
+//
+// Objects are referred to by the handle returned from add_object, the index of
+// an object in the arrays changes whenever the layout is sorted again.
+
+const uint32_t SCENE_NO_PARENT = ~0u;
+
+// Affine transform, three rows of a 3x4 row major matrix
+struct SceneTransform {
+	float rows[3][4] = {
+		{ 1.0f, 0.0f, 0.0f, 0.0f },
+		{ 0.0f, 1.0f, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f, 0.0f }
+	};
+};
+
+// Bounding sphere in the local space of the object
+struct SceneBounds {
+	float center[3] = { 0.0f, 0.0f, 0.0f };
+	float radius = 0.0f;
+};
+
+// Plane equations (a, b, c, d), a point is inside when a*x + b*y + c*z + d >= 0 for all of them
+struct FrustumPlanes {
+	float planes[6][4];
+};
+
+struct SceneStats {
+	uint32_t object_count = 0;
+	uint32_t visible_count = 0;
+	uint32_t level_count = 0;
+	double transform_ms = 0.0;
+	double cull_ms = 0.0;
+};
+
+class scene {
+
+	static const uint32_t transform_components = 12;
+
+	// Objects per job for the parallel kernels
+	uint32_t grain = 2048;
+
+	thread_pool* workers = nullptr;
+
+	// Local and world transforms, one array per matrix component
+	std::array<std::vector<float>, transform_components> local_transforms;
+	std::array<std::vector<float>, transform_components> world_transforms;
+
+	// Local bounds, and world bounds written by the transform kernel
+	std::vector<float> bounds_x, bounds_y, bounds_z, bounds_radius;
+	std::vector<float> world_x, world_y, world_z, world_radius;
+
+	std::vector<uint32_t> parents;
+	std::vector<uint32_t> depths;
+	std::vector<uint64_t> draw_keys;
+
+	// handle -> index and index -> handle
+	std::vector<uint32_t> handle_indices;
+	std::vector<uint32_t> handles;
+
+	// End of each depth level in the arrays
+	std::vector<uint32_t> level_ends;
+	bool layout_dirty = false;
+
+	// Visible indices, gathered per job and joined in order
+	std::vector<uint32_t> visible;
+	std::vector<std::vector<uint32_t>> job_visible;
+
+	SceneStats stats;
+
+	void sort_by_depth();
+	void update_level(uint32_t begin, uint32_t end, bool root);
+	void cull_range(const FrustumPlanes& frustum, uint32_t begin, uint32_t end, std::vector<uint32_t>& out_visible);
+
+	// Split [begin, end) into chunks of grain objects, the job gets the chunk number and its range
+	void run(uint32_t begin, uint32_t end, const std::function<void(uint32_t, uint32_t, uint32_t)>& job);
+
+public:
+	scene();
+
+	// Without a pool every kernel runs on the calling thread
+	void init(thread_pool* new_workers);
+	void clear();
+
+	uint32_t add_object(uint32_t parent, const SceneTransform& transform, const SceneBounds& bounds, uint64_t draw_key);
+	void set_local_transform(uint32_t handle, const SceneTransform& transform);
+	void set_draw_key(uint32_t handle, uint64_t draw_key);
+
+	// Propagate transforms down the hierarchy, then cull the world bounds against the frustum
+	void update(const FrustumPlanes& frustum);
+	void update_transforms();
+	void cull(const FrustumPlanes& frustum);
+
+	// Frustum of a view projection matrix with a zero to one depth range
+	static FrustumPlanes extract_frustum(const glm::mat4& view_projection);
+
+	// Indices of the objects that passed the last cull, valid until the next update
+	const std::vector<uint32_t>& get_visible();
+
+	uint32_t get_object_count();
+	uint32_t get_handle(uint32_t index);
+	uint64_t get_draw_key(uint32_t index);
+	void get_world_transform(uint32_t index, float* rows);
+	void get_world_bounds(uint32_t index, float* center, float* radius);
+
+	const SceneStats& get_stats();
+};
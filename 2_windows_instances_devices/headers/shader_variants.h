@@ -0,0 +1,56 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW\glfw3.h>
+
+#include <stdexcept>
+#include <vector>
+#include <array>
+
+#include "vulkan_loader.h"
+
+// Shader permutations through specialization constants.
+// shader.vert and shader.frag are compiled once. Every pipeline specializes
+// them with a feature mask and a light count, so the driver folds the feature
+// tests and unrolls the light loop while compiling the pipeline. Variant 0 is
+// the uber shader: its features are decided per draw from the push constants.
+// The other variants have a fixed feature set and no branches on them, one for
+// each combination of the feature bits.
+
+// Feature bits, must match shader.vert and shader.frag
+const uint32_t SHADER_FEATURE_TEXTURE = 1 << 0;		// Samples the material texture
+const uint32_t SHADER_FEATURE_TINT = 1 << 1;		// Multiplies by the material tint
+const uint32_t SHADER_FEATURE_MESH = 1 << 2;		// Pulls mesh vertices instead of the generated triangle
+const uint32_t SHADER_FEATURE_BITS = 3;
+
+// Uber shader, every feature is tested at run time
+const uint32_t SHADER_FEATURE_DYNAMIC = 1u << 31;
+
+const uint32_t SHADER_VARIANT_UBER = 0;
+
+// Values of constant_id 0 and 1, in that order
+struct ShaderSpecialization {
+	uint32_t features = SHADER_FEATURE_DYNAMIC;
+	uint32_t light_count = 0;
+};
+
+class shader_variants {
+
+	std::vector<ShaderSpecialization> specializations;
+	std::vector<VkSpecializationInfo> specialization_infos;
+	std::array<VkSpecializationMapEntry, 2> map_entries;
+
+public:
+	shader_variants();
+
+	// Rebuilds the table, pipelines created from the old one must be recreated
+	void init(uint32_t light_count);
+
+	uint32_t get_variant_count();
+
+	// Specialized variant with exactly these features
+	static uint32_t get_variant(uint32_t features);
+
+	// Stays valid until the next init, for the stages of every pipeline of the variant
+	const VkSpecializationInfo* get_specialization_info(uint32_t variant);
+	const ShaderSpecialization& get_specialization(uint32_t variant);
+};
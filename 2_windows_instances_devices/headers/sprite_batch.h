@@ -0,0 +1,165 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW\glfw3.h>
+
+#include <stdexcept>
+#include <vector>
+
+#include "vulkan_loader.h"
+#include "utilities.h"
+#include "memory_tracker.h"
+#include "bindless_heap.h"
+#include "texture_manager.h"
+
+// Batched 2D quads drawn over the finished frame.
+// Sprites are added between frames into a list that only grows, so a frame of
+// sprites costs no allocation once the list has seen its largest frame. When the
+// frame is drawn the list is ordered by layer and atlas page, and written in that
+// order into the vertex stream of the frame: a host visible buffer per frame in
+// flight that stays mapped, with one instance of six vertices per sprite.
+//
+// Each run of sprites sharing a layer and a page is one batch, drawn with a single
+// vkCmdDraw whose first instance is the start of the run. Pages are textures of the
+// texture manager sampled through the bindless heap, so a batch only changes a push
+// constant. Sprites keep the order they were added in within their layer and page.
+
+// Sprite without a texture, drawn in its colour
+const uint32_t SPRITE_NO_TEXTURE = 0xFFFFFFFF;
+
+// Sprites per frame in flight the vertex streams start with, they double when a frame needs more
+const uint32_t SPRITE_INITIAL_CAPACITY = 16384;
+
+struct Sprite {
+	// Top left corner and size in pixels of the main window, y down
+	float position[2] = { 0.0f, 0.0f };
+	float size[2] = { 0.0f, 0.0f };
+
+	// Region of the page
+	float uv_min[2] = { 0.0f, 0.0f };
+	float uv_max[2] = { 1.0f, 1.0f };
+
+	// RGBA8, multiplied with the page
+	uint32_t colour = 0xFFFFFFFF;
+
+	// Texture handle of the atlas page, or SPRITE_NO_TEXTURE
+	uint32_t texture = SPRITE_NO_TEXTURE;
+
+	// Higher layers are drawn over lower ones
+	uint32_t layer = 0;
+};
+
+// Must match the vertex input of sprite.vert, one per sprite at instance rate
+struct SpriteInstance {
+	float rect[4];
+	float uv_rect[4];
+	uint32_t colour;
+};
+
+// Must match SpritePushConstants in sprite.vert and sprite.frag
+struct SpritePushConstants {
+	float scale[2];
+	float offset[2];
+	uint32_t texture_index;
+};
+
+// Persistently mapped vertex stream of one frame in flight
+struct SpriteStream {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	SpriteInstance* mapped = nullptr;
+	uint32_t capacity = 0;
+};
+
+// Sort key of a sprite, the layer in the high half and the page in the low half
+struct SpriteSortEntry {
+	uint64_t key;
+	uint32_t sprite;
+};
+
+struct SpriteDrawBatch {
+	uint32_t texture_index;
+	uint32_t first_instance;
+	uint32_t instance_count;
+};
+
+struct SpriteStats {
+	// Last frame
+	uint32_t sprites = 0;
+	uint32_t batches = 0;
+
+	// Sprites whose page had no bindless slot yet, they are left out until it is resident
+	uint32_t skipped = 0;
+	double flush_ms = 0.0;
+
+	uint32_t capacity = 0;
+	uint32_t stream_resizes = 0;
+
+	uint64_t frames = 0;
+	uint64_t total_sprites = 0;
+	uint64_t total_batches = 0;
+	double total_flush_ms = 0.0;
+};
+
+class sprite_batch {
+
+	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	memory_tracker* tracker = nullptr;
+	bindless_heap* bindless = nullptr;
+	texture_manager* textures = nullptr;
+	const VkAllocationCallbacks* allocator = nullptr;
+
+	bool available = false;
+
+	// Added since the last flush, and their order once sorted. Cleared, never shrunk
+	std::vector<Sprite> sprites;
+	std::vector<SpriteSortEntry> order;
+
+	std::vector<SpriteStream> streams;
+
+	// Batches of the frame last flushed, drawn from the stream of that frame
+	std::vector<SpriteDrawBatch> batches;
+	uint32_t flushed_frame = 0;
+
+	// The pipeline follows the render targets, the modules are kept for it
+	VkShaderModule vertex_module = VK_NULL_HANDLE;
+	VkShaderModule fragment_module = VK_NULL_HANDLE;
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	SpriteStats stats;
+
+	void create_stream(SpriteStream* stream, uint32_t capacity);
+	void destroy_stream(SpriteStream* stream);
+	void create_layout(const std::vector<char>& vertex_code, const std::vector<char>& fragment_code);
+
+public:
+	sprite_batch();
+
+	// Without sprite_vert.spv and sprite_frag.spv the batch stays unavailable, sprites added to it are dropped
+	void init(VkPhysicalDevice new_physical_device, VkDevice new_device, uint32_t frame_count,
+		const std::vector<char>& vertex_code, const std::vector<char>& fragment_code, memory_tracker* new_tracker,
+		bindless_heap* new_bindless, texture_manager* new_textures, const VkAllocationCallbacks* new_allocator);
+	void destroy();
+
+	bool is_available();
+
+	// Drawn with the next frame, then forgotten: sprites that stay on screen are added every frame
+	void add(const Sprite& sprite);
+	void add_rect(float x, float y, float width, float height, uint32_t colour, uint32_t layer = 0);
+	void clear();
+	uint32_t get_pending_count();
+
+	// Rebuilt with the render targets, rendering_info replaces the render pass with dynamic rendering
+	void create_pipeline(VkRenderPass render_pass, const VkPipelineRenderingCreateInfoKHR* rendering_info);
+	void destroy_pipeline();
+
+	// The fence of frame_slot was waited on. Orders the pending sprites into its stream and clears them
+	void flush(uint32_t frame_slot);
+
+	// Inside a graphics pass over the swap chain image, after the frame has been flushed
+	void record(VkCommandBuffer command_buffer, VkExtent2D extent);
+
+	const SpriteStats& get_stats();
+	void print_stats();
+};
@@ -0,0 +1,166 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW\glfw3.h>
+
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <algorithm>
+
+#include "vulkan_loader.h"
+#include "utilities.h"
+#include "thread_pool.h"
+#include "bindless_heap.h"
+#include "memory_tracker.h"
+
+// Texture streaming.
+// Files are decoded on the worker threads and uploaded through a staging buffer,
+// the mip tail is generated on the GPU with vkCmdBlitImage. Textures start with
+// only their smallest mips resident and are promoted one level at a time while
+// the budget allows. When the budget is exceeded the least recently used
+// textures drop their top mip.
+
+enum class TextureState {
+	loading,
+	resident,
+	failed
+};
+
+// GPU copy of a texture, holding the levels from top_mip down to 1x1
+struct TextureImage {
+	VkImage image = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkImageView image_view = VK_NULL_HANDLE;
+	VkExtent2D extent = {};
+	uint32_t top_mip = 0;
+	uint32_t mip_levels = 0;
+	VkDeviceSize bytes = 0;
+};
+
+struct Texture {
+	std::string file;
+	TextureState state = TextureState::loading;
+	uint32_t full_width = 0;
+	uint32_t full_height = 0;
+	uint32_t mip_count = 0;
+	TextureImage resident;
+
+	// Slot in the bindless heap, written whenever the resident image changes
+	uint32_t bindless_index = BINDLESS_INVALID_INDEX;
+
+	// Only one residency change in flight per texture
+	bool request_in_flight = false;
+	uint64_t last_used_frame = 0;
+};
+
+// Produced by a worker thread, consumed by update()
+struct TextureDecodeResult {
+	uint32_t texture;
+	uint32_t full_width = 0;
+	uint32_t full_height = 0;
+	uint32_t mip_count = 0;
+	uint32_t top_mip = 0;
+	VkExtent2D extent = {};
+	std::vector<unsigned char> pixels;
+};
+
+struct TextureUpload {
+	uint32_t texture;
+	TextureImage image;
+	VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+	VkBuffer staging_buffer = VK_NULL_HANDLE;
+	VkDeviceMemory staging_memory = VK_NULL_HANDLE;
+};
+
+// Images replaced while frames in flight may still sample them
+struct RetiredTextureImage {
+	TextureImage image;
+	uint64_t retire_frame;
+};
+
+struct TextureStats {
+	uint32_t texture_count = 0;
+	uint32_t resident_count = 0;
+	VkDeviceSize resident_bytes = 0;
+	VkDeviceSize budget_bytes = 0;
+	uint32_t uploads_in_flight = 0;
+	uint32_t mips_streamed_in = 0;
+	uint32_t mips_streamed_out = 0;
+};
+
+class texture_manager {
+
+	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueue queue = VK_NULL_HANDLE;
+	VkCommandPool command_pool = VK_NULL_HANDLE;
+	VkSampler sampler = VK_NULL_HANDLE;
+
+	thread_pool* workers = nullptr;
+	bindless_heap* heap = nullptr;
+	memory_tracker* tracker = nullptr;
+	const VkAllocationCallbacks* allocator = nullptr;
+
+	std::vector<Texture> textures;
+	std::vector<TextureUpload> uploads;
+	std::vector<RetiredTextureImage> retired_images;
+
+	std::mutex results_mutex;
+	std::vector<TextureDecodeResult> decode_results;
+
+	const VkFormat texture_format = VK_FORMAT_R8G8B8A8_UNORM;
+
+	// Largest dimension of the mip a texture starts with
+	uint32_t initial_size = 64;
+	uint32_t max_uploads_per_frame = 4;
+	VkDeviceSize budget = 256ull * 1024 * 1024;
+
+	uint64_t frame_index = 0;
+	TextureStats stats;
+
+	// Worker side
+	void decode_texture(uint32_t texture, const std::string& file, int requested_mip);
+
+	// Main thread side
+	void request_mip(uint32_t texture, uint32_t top_mip);
+	void begin_upload(TextureDecodeResult& result);
+	void begin_demote(uint32_t texture);
+	void finish_uploads();
+	void destroy_retired_images(bool force);
+	void update_residency();
+
+	TextureImage create_texture_image(VkExtent2D extent, uint32_t top_mip, uint32_t mip_levels);
+	void destroy_texture_image(TextureImage& image);
+	VkCommandBuffer begin_commands(VkFence* fence);
+	void submit_commands(VkCommandBuffer command_buffer, VkFence fence);
+
+	VkDeviceSize get_resident_bytes();
+
+public:
+	texture_manager();
+
+	void init(VkPhysicalDevice new_physical_device, VkDevice new_device, VkQueue new_queue,
+		uint32_t queue_family, thread_pool* new_workers, bindless_heap* new_heap, memory_tracker* new_tracker,
+		const VkAllocationCallbacks* new_allocator);
+
+	// Returns immediately, the texture becomes resident once its first mips are uploaded
+	uint32_t load_texture(const std::string& file);
+
+	// Call once per frame from the render thread
+	void update();
+	void destroy();
+
+	// Mark a texture as used this frame, recently used textures are promoted first
+	void mark_used(uint32_t texture);
+	void set_budget(VkDeviceSize new_budget);
+
+	// Getters
+	bool is_resident(uint32_t texture);
+	VkImageView get_image_view(uint32_t texture);
+	uint32_t get_bindless_index(uint32_t texture);
+	VkSampler get_sampler();
+	const TextureStats& get_stats();
+	void print_stats();
+};
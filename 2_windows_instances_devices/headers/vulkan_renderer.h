@@ -3,17 +3,111 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW\glfw3.h>
 
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm\glm.hpp>
+#include <glm\gtc\matrix_transform.hpp>
+
 #include <stdexcept>
 #include <vector>
+#include <string>
 #include <set>
 #include <algorithm>
 #include <array>
+#include <chrono>
+#include <cmath>
 
+#include "vulkan_loader.h"
 #include "utilities.h"
+#include "render_graph.h"
+#include "memory_tracker.h"
+#include "host_allocator.h"
+#include "bindless_heap.h"
+#include "descriptor_allocator.h"
+#include "texture_manager.h"
+#include "mesh_manager.h"
+#include "frame_capture.h"
+#include "gpu_queries.h"
+#include "occlusion_culler.h"
+#include "particle_system.h"
+#include "post_process.h"
+#include "sprite_batch.h"
+#include "profiler.h"
+#include "shader_variants.h"
+#include "scene.h"
+#include "draw_list.h"
+#include "thread_pool.h"
+#include "task_graph.h"
+
+// Pipelines a draw key can select
+const uint32_t SCENE_PIPELINE_BLENDED = 0;
+const uint32_t SCENE_PIPELINE_OPAQUE = 1;
+const uint32_t SCENE_PIPELINE_COUNT = 2;
+
+// Geometry id of the triangle generated in the vertex shader, meshes get the ids after it
+const uint32_t SCENE_GEOMETRY_TRIANGLE = 0;
+const uint32_t SCENE_NO_MESH = ~0u;
+
+// Host visible buffer with the camera and the world transforms of the visible objects
+struct SceneObjectBuffer {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	void* mapped = nullptr;
+	uint32_t capacity = 0;
+	uint32_t bindless_index = BINDLESS_INVALID_INDEX;
+};
+
+// Layout of the start of a SceneObjectBuffer, followed by three vec4 rows per object
+struct SceneObjectHeader {
+	glm::mat4 view_projection;
+};
+
+// A window the frame is presented to. Every window shares the device, the pipelines
+// and the scene, it only adds a surface, a swap chain and its own render targets.
+// An offscreen target has no window, surface or swap chain, only images it owns
+struct WindowTarget {
+	GLFWwindow* window = nullptr;
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
+	VkSwapchainKHR swap_chain = VK_NULL_HANDLE;
+	VkExtent2D extent = {};
+	std::vector<SwapChainImage> images;
+
+	// Offscreen only, the memory of an image per frame in flight
+	std::vector<VkDeviceMemory> image_memory;
+
+	// Acquire of each frame in flight, the frame submit waits on the semaphores of every window
+	std::array<VkSemaphore, MAX_FRAME_DRAWS> image_available = {};
+	uint32_t image_index = 0;
+
+	// A window without an image this frame is neither recorded nor presented
+	bool acquired = false;
+
+	// Swap chain recreated before the next acquire, put off while the window is minimized
+	bool out_of_date = false;
+
+	// Owns the render passes, framebuffers and transient images of the window
+	render_graph graph;
+	uint32_t backbuffer = 0;
+	uint32_t main_pass = 0;
+
+	// Overlay drawn last into the swap chain image, only in the main window
+	uint32_t sprite_pass = 0;
+};
 
 class vulkan_renderer {
 	
-	GLFWwindow* window;
+	// The window given to init comes first, it drives the camera, frame capture and occlusion culling
+	std::vector<WindowTarget> windows;
+
+	// Host allocation callbacks passed to every create and destroy call. The driver's own
+	// allocator unless tracking or the arena is asked for, then allocator is set
+	host_allocator host_memory;
+	HostAllocatorMode host_allocator_mode = HostAllocatorMode::system;
+	const VkAllocationCallbacks* allocator = nullptr;
+
+	// Device level functions are called straight into the driver unless set otherwise
+	VulkanDispatch dispatch_mode = VulkanDispatch::device_direct;
+
 	VkInstance instance;
 
 	struct {
@@ -21,41 +115,202 @@ class vulkan_renderer {
 		VkDevice			logical_device;
 	}main_device;
 
+	// Optional extensions found on the device
+	std::vector<const char*> enabled_optional_extensions;
+	bool memory_budget_supported = false;
+	bool dynamic_rendering_supported = false;
+	bool calibrated_timestamps_supported = false;
+
+	// Core features turned on when the device supports them
+	VkPhysicalDeviceFeatures enabled_features = {};
+
+	// Every device allocation goes through the tracker
+	memory_tracker memory;
+
 	VkQueue graphics_queue;
 	VkQueue presentation_queue;
-	VkSurfaceKHR surface;
-	VkSwapchainKHR swap_chain;
 
+	// Every swap chain uses this format so the windows can share the pipelines
 	VkFormat swap_chain_image_format;
-	VkExtent2D swap_chain_extent;
+
+	VkFormat depth_format;
+	VkSampleCountFlagBits msaa_samples = VK_SAMPLE_COUNT_1_BIT;
 
 	VkCommandPool graphics_cmd_pool;
 
-	std::vector<SwapChainImage> swap_chain_images;
-	std::vector<VkFramebuffer> swapchain_framebuffers;
 	std::vector<VkCommandBuffer> commandbuffers;
 
+	// Dynamic rendering where the device has it, render passes otherwise
+	bool use_dynamic_rendering = true;
+	double last_recreate_ms = 0.0;
+
+	// Scene pipelines of the last create_graphic_pipeline, all variants in one call
+	double pipeline_creation_ms = 0.0;
+
+	// Empty picks the first suitable device
+	std::string preferred_device;
+
+	// The main target renders into images of this size instead of a window
+	bool offscreen = false;
+	VkExtent2D offscreen_extent = {};
+
+	// Shaders are read and compiled while the device objects are created
+	std::vector<char> vertex_shader_code;
+	std::vector<char> fragment_shader_code;
+	std::vector<char> hiz_shader_code;
+	std::vector<char> particle_compute_code;
+	std::vector<char> particle_vertex_code;
+	std::vector<char> particle_fragment_code;
+	std::vector<char> bloom_downsample_code;
+	std::vector<char> bloom_upsample_code;
+	std::vector<char> tonemap_code;
+	std::vector<char> sprite_vertex_code;
+	std::vector<char> sprite_fragment_code;
+	VkShaderModule vertex_shader_module = VK_NULL_HANDLE;
+	VkShaderModule fragment_shader_module = VK_NULL_HANDLE;
+
 	VkPipelineLayout pipeline_layout;
 	VkRenderPass render_pass;
-	VkPipeline graphics_pipeline = {};
+	std::vector<VkPipeline> graphics_pipelines;
+
+	// Each shader variant has a pipeline per blend mode. Scene draws use the uber
+	// shader unless specialized, then the variant is picked from their material and geometry
+	shader_variants variants;
+	bool specialized_shaders = false;
+	uint32_t shader_light_count = 0;
+
+	// Synchronization, one set for each frame in flight
+	std::vector<VkSemaphore> render_finished;
+	std::vector<VkFence> draw_fences;
+	int current_frame = 0;
+
+	// Refilled every frame with an entry per window, all windows are submitted and presented together
+	std::vector<VkSemaphore> acquire_semaphores;
+	std::vector<VkPipelineStageFlags> acquire_stages;
+	std::vector<VkSwapchainKHR> present_swap_chains;
+	std::vector<uint32_t> present_image_indices;
+	std::vector<VkResult> present_results;
+	std::vector<WindowTarget*> present_targets;
+
+	// Worker threads shared by the subsystems that load or build data in the background
+	thread_pool workers;
+	texture_manager textures;
+	mesh_manager meshes;
+
+	// Copies presented frames to host memory while capturing
+	frame_capture capture;
+	bool capture_supported = false;
+
+	// Pipeline statistics and occlusion counts of labelled regions of the frame
+	gpu_queries queries;
+	uint32_t main_query_region = 0;
+
+	// Objects behind the depth of an earlier frame are dropped before the draw list
+	occlusion_culler occlusion;
+	bool occlusion_enabled = false;
+
+	// Simulated by a compute pass and drawn over the scene of the main window
+	particle_system particles;
+	uint32_t particle_capacity = 65536;
+
+	// The scene is drawn into an HDR image, bloomed and tone mapped into the swap chain image.
+	// On for every window or none, the graphics pipelines are built for one colour format
+	post_process post;
+	bool post_enabled = true;
+	bool post_blit_supported = false;
+
+	// 2D quads added between frames, drawn over the finished image of the main window
+	sprite_batch sprites;
+
+	// Sets of the passes that do not go through the bindless heap
+	descriptor_allocator descriptors;
+
+	// CPU zones of init and of each frame, GPU zones of the graph passes
+	profiler profile;
+
+	// Every texture and storage buffer is reached through this heap
+	bindless_heap bindless;
+	uint32_t display_texture = BINDLESS_INVALID_INDEX;
+
+	// Scene objects are culled on the CPU, the visible ones are drawn instanced
+	scene frame_scene;
+	glm::mat4 camera_view = glm::mat4(1.0f);
+	glm::mat4 view_projection = glm::mat4(1.0f);
+	std::vector<SceneObjectBuffer> scene_buffers;
+
+	// Visible objects sorted by pipeline and material, materials are texture handles and RGBA8 tints
+	draw_list draws;
+	std::vector<uint32_t> materials;
+	std::vector<uint32_t> material_tints;
+	std::vector<uint32_t> material_features;
+	std::vector<DrawPushConstants> material_constants;
 
-	VkSemaphore image_available;
-	VkSemaphore render_finished;
+	// Every LOD of every mesh is a geometry id, geometry_meshes maps them back to the mesh
+	// and mesh_geometries gives the id of LOD 0, the other levels follow it
+	std::vector<DrawGeometry> geometries;
+	std::vector<uint32_t> geometry_meshes;
+	std::vector<uint32_t> mesh_geometries;
+
+	// The coarsest LOD whose error projects to at most this many pixels is drawn
+	float lod_error_pixels = 1.0f;
+	float lod_projection_scale = 1.0f;
+	std::array<uint32_t, MESH_MAX_LODS> lod_counts = {};
+
+	// Draws per frame and the CPU time spent recording them
+	uint32_t draw_count = 1;
+	double last_record_ms = 0.0;
+
+	// Init stages run as a task graph on the worker threads unless set otherwise
+	bool parallel_init = true;
+	double init_ms = 0.0;
 
 	// Create the vulkan instance
 	void create_instance();
 	void create_logical_device();
-	void create_surface();
-	void create_swap_chain();
+	void create_memory_tracker();
+	void create_surface(WindowTarget* target);
+	void create_swap_chain(WindowTarget* target);
+	void create_offscreen_target(WindowTarget* target);
+	void create_window_graph(WindowTarget* target, bool main_window);
+	void create_window_semaphores(WindowTarget* target);
+	void destroy_window(WindowTarget* target);
+
+	// New swap chain, semaphores and render graph at the current size of the window,
+	// false while it is minimized
+	bool recreate_window(WindowTarget* target);
+	void load_shader_files();
+	void create_shader_modules();
+	void create_pipeline_layout();
 	void create_graphic_pipeline();
-	void create_renderpass();
-	void create_framebuffers();
+	void create_render_graph();
+	void create_bindless_heap();
+	void create_descriptor_allocator();
 	void create_command_pool();
+	void create_texture_manager();
+	void create_mesh_manager();
+	void create_frame_capture();
+	void create_gpu_queries();
+	void create_profiler();
+	void create_occlusion_culler();
+	void create_particle_system();
+	void create_post_process();
+	void create_sprite_batch();
 	void create_commandbuffer();
 	void create_synchronization();
+	void create_scene();
+	void create_scene_buffer(SceneObjectBuffer* scene_buffer, uint32_t capacity);
+	void destroy_scene_buffer(SceneObjectBuffer* scene_buffer);
+
+	// Cull the scene and write the visible transforms for the current frame
+	void update_scene();
+	uint32_t select_lod(uint32_t mesh, uint32_t object, float view_depth, float radius);
+
+	// Rebuild everything that depends on the render targets
+	void recreate_render_targets();
 
 	// Record function
 	void record_commands();
+	void record_scene(VkCommandBuffer command_buffer, VkExtent2D extent, bool main_window);
 
 	// Get functions
 	void get_physical_device();
@@ -63,16 +318,19 @@ class vulkan_renderer {
 	// Check whether the extension for the instance are supported
 	bool check_instance_extension_support( std::vector<const char*>* extensions );
 	bool check_device_extension_support( VkPhysicalDevice physical_device);
+	std::vector<const char*> get_required_device_extensions();
+	std::vector<const char*> get_supported_optional_extensions( VkPhysicalDevice physical_device );
 	bool check_device_suitable( VkPhysicalDevice physical_device );
 	
 	// Getter
 	QueueFamilyIndicies get_queue_family(VkPhysicalDevice physical_device);
-	SwapChainDetails get_swap_chain_details(VkPhysicalDevice physical_device);
+	SwapChainDetails get_swap_chain_details(VkPhysicalDevice physical_device, VkSurfaceKHR surface);
 
 	// Choose
 	VkSurfaceFormatKHR choose_best_surface_format( std::vector<VkSurfaceFormatKHR> formats );
 	VkPresentModeKHR choose_best_present_mode( std::vector<VkPresentModeKHR> modes );
-	VkExtent2D choose_swap_extent(const VkSurfaceCapabilitiesKHR surface_capabilities );
+	VkExtent2D choose_swap_extent(const VkSurfaceCapabilitiesKHR surface_capabilities, GLFWwindow* window );
+	VkFormat choose_supported_format( const std::vector<VkFormat>& formats, VkImageTiling tiling, VkFormatFeatureFlags feature_flags );
 
 	VkImageView create_image_view( VkImage image, VkFormat format, VkImageAspectFlags flags );
 	VkShaderModule create_shader_module( const std::vector<char> code );
@@ -81,6 +339,134 @@ public:
 	vulkan_renderer();
 
 	int init(GLFWwindow* new_window);
+
+	// Renders into images of this size instead of a window, without a surface, a swap chain or a
+	// display server. Nothing is presented, frame capture reads the images back
+	int init_offscreen(VkExtent2D extent);
+	bool is_offscreen();
+
+	// Offscreen only, recreates the images and the render targets at the new size
+	void set_offscreen_extent(VkExtent2D extent);
+	VkExtent2D get_offscreen_extent();
+
 	void draw();
+	void wait_idle();
 	void cleanup();
+
+	// More windows on the same device, each costs a swap chain and render targets.
+	// The window given to init can not be removed, it is destroyed by cleanup.
+	// An offscreen renderer has no surface support, it can not add windows
+	void add_window(GLFWwindow* new_window);
+	void remove_window(GLFWwindow* old_window);
+	uint32_t get_window_count();
+
+	// Run the init stages one after the other, must be set before init
+	void set_parallel_init(bool parallel);
+	double get_init_ms();
+
+	// Pick the first suitable device whose name contains this, llvmpipe for lavapipe. Must be set before init
+	void set_preferred_device(const std::string& name);
+	std::string get_device_name();
+	double get_pipeline_creation_ms();
+
+	// Multisampling
+	std::vector<VkSampleCountFlagBits> get_supported_sample_counts();
+	VkSampleCountFlagBits get_msaa_samples();
+	void set_msaa_samples(VkSampleCountFlagBits samples);
+
+	const RenderGraphStats& get_render_graph_stats();
+
+	// Function dispatch, can be switched between frames
+	void set_dispatch(VulkanDispatch dispatch);
+
+	// Repeat the triangle draw to make recording heavy
+	void set_draw_count(uint32_t count);
+	double get_last_record_ms();
+
+	// Host allocator, the mode must be set before init
+	void set_host_allocator_mode(HostAllocatorMode mode);
+	host_allocator& get_host_allocator();
+
+	// Memory telemetry
+	MemoryReport get_memory_report();
+	void print_memory_report();
+
+	// Textures
+	uint32_t load_texture(const std::string& file);
+	void set_texture_budget(VkDeviceSize budget);
+	texture_manager& get_textures();
+
+	// Meshes written by mesh_converter, loaded synchronously
+	uint32_t load_mesh(const std::string& file);
+	mesh_manager& get_meshes();
+
+	// Geometry id of a mesh for draw keys, the renderer adds the LOD to it every frame
+	uint32_t get_mesh_geometry(uint32_t mesh);
+
+	// Screen space error allowed when picking LODs, zero always draws LOD 0
+	void set_lod_error(float pixels);
+	const std::array<uint32_t, MESH_MAX_LODS>& get_lod_counts();
+
+	// Frame readback, set a consumer and start it to capture the presented frames
+	frame_capture& get_capture();
+
+	// Per frame and cached descriptor sets
+	descriptor_allocator& get_descriptors();
+
+	// Start it before init for the init stages to be in the trace
+	profiler& get_profiler();
+
+	// GPU work per region, off by default
+	void set_gpu_queries_enabled(bool enable);
+	gpu_queries& get_queries();
+	void print_gpu_stats();
+
+	// Occlusion culling needs hiz_reduce.spv and single sampled depth, off by default
+	void set_occlusion_culling(bool enable);
+	bool is_occlusion_culling_active();
+	const OcclusionStats& get_occlusion_stats();
+
+	// GPU particles need particles.spv, particle_vert.spv and particle_frag.spv, off by default.
+	// The capacity can be set before init, after it the buffers are replaced and the particles start over
+	void set_particles_enabled(bool enable);
+	bool is_particles_active();
+	void set_particle_capacity(uint32_t capacity);
+	particle_system& get_particles();
+
+	// Post-processing needs bloom_downsample.spv, bloom_upsample.spv and tonemap.spv and swap chain
+	// images that can be blitted to, on by default. Off, the scene is drawn straight into the swap chain
+	void set_post_processing(bool enable);
+	bool is_post_processing_active();
+	void set_post_settings(const PostSettings& settings);
+	post_process& get_post_process();
+
+	// Sprites need sprite_vert.spv and sprite_frag.spv, those added before draw() are drawn with that frame
+	sprite_batch& get_sprites();
+
+	// Scene
+	scene& get_scene();
+	void set_camera(const glm::mat4& view, const glm::mat4& projection);
+
+	// Material ids for draw keys, the texture is a texture handle or BINDLESS_INVALID_INDEX
+	uint32_t add_material(uint32_t texture, uint32_t tint = 0xFFFFFFFF);
+
+	// Render passes and framebuffers instead of dynamic rendering, for comparison
+	void set_dynamic_rendering(bool enable);
+	bool is_dynamic_rendering_active();
+
+	// Time spent rebuilding the render graph, pipelines and command buffers, after MSAA changes for example
+	double get_last_recreate_ms();
+
+	// Branch free shader variants for scene draws instead of the uber shader
+	void set_specialized_shaders(bool specialized);
+
+	// Lights evaluated per fragment, a specialization constant so the pipelines are rebuilt
+	void set_shader_light_count(uint32_t count);
+
+	// Unsorted draws keep the cull order, to compare bind counts
+	void set_sort_draws(bool sort);
+	const DrawListStats& get_draw_list_stats();
+
+	// Texture drawn on the triangle, sampled through its bindless index
+	void set_display_texture(uint32_t texture);
 };
\ No newline at end of file
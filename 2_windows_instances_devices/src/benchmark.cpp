@@ -0,0 +1,1156 @@
+#include "..\headers\benchmark.h"
+
+#include <fstream>
+
+benchmark::benchmark(vulkan_renderer* new_renderer, GLFWwindow* new_window)
+{
+	renderer = new_renderer;
+	window = new_window;
+}
+
+
+bool benchmark::is_window_closed()
+{
+	return window != nullptr && glfwWindowShouldClose(window);
+}
+
+
+void benchmark::poll_events()
+{
+	if (window != nullptr)
+		glfwPollEvents();
+}
+
+
+FrameTimings benchmark::measure_frames()
+{
+	for (uint32_t i = 0; i < warmup_frames && !is_window_closed(); i++)
+	{
+		poll_events();
+		if (before_frame)
+			before_frame(i);
+		renderer->draw();
+	}
+	renderer->wait_idle();
+
+	FrameTimings timings = {};
+	timings.min_ms = std::numeric_limits<double>::max();
+
+	renderer->get_host_allocator().reset_counters();
+
+	double total_ms = 0.0;
+	double total_record_ms = 0.0;
+	frame_times.clear();
+	auto last_time = std::chrono::high_resolution_clock::now();
+
+	for (uint32_t i = 0; i < measured_frames && !is_window_closed(); i++)
+	{
+		poll_events();
+		if (before_frame)
+			before_frame(warmup_frames + i);
+		renderer->draw();
+
+		auto now = std::chrono::high_resolution_clock::now();
+		double frame_ms = std::chrono::duration<double, std::milli>(now - last_time).count();
+		last_time = now;
+
+		total_ms += frame_ms;
+		total_record_ms += renderer->get_last_record_ms();
+		timings.min_ms = std::min(timings.min_ms, frame_ms);
+		timings.max_ms = std::max(timings.max_ms, frame_ms);
+		timings.frame_count++;
+		frame_times.push_back(frame_ms);
+	}
+	renderer->wait_idle();
+
+	if (timings.frame_count > 0)
+	{
+		timings.average_ms = total_ms / timings.frame_count;
+		timings.average_record_ms = total_record_ms / timings.frame_count;
+
+		HostAllocatorStats host_stats = renderer->get_host_allocator().get_stats();
+		uint64_t host_allocations = 0;
+		for (const HostScopeStats& scope_stats : host_stats.scopes)
+		{
+			host_allocations += scope_stats.allocation_count + scope_stats.reallocation_count;
+		}
+		timings.host_allocations_per_frame = static_cast<double>(host_allocations) / timings.frame_count;
+
+		std::sort(frame_times.begin(), frame_times.end());
+		auto percentile = [this](double fraction) {
+			size_t rank = static_cast<size_t>(std::ceil(fraction * frame_times.size()));
+			return frame_times[std::max<size_t>(rank, 1) - 1];
+		};
+		timings.p50_ms = percentile(0.50);
+		timings.p95_ms = percentile(0.95);
+		timings.p99_ms = percentile(0.99);
+	}
+	else
+	{
+		timings.min_ms = 0.0;
+	}
+
+	return timings;
+}
+
+
+int benchmark::run_msaa()
+{
+	VkSampleCountFlagBits original_samples = renderer->get_msaa_samples();
+
+	printf("\nMSAA benchmark, %u frames per sample count \n", measured_frames);
+	printf("samples   avg ms    min ms    max ms    fps       transient KB  lazy KB   host allocs/frame \n");
+
+	for (VkSampleCountFlagBits samples : renderer->get_supported_sample_counts())
+	{
+		renderer->set_msaa_samples(samples);
+
+		FrameTimings timings = measure_frames();
+		const RenderGraphStats& stats = renderer->get_render_graph_stats();
+
+		printf("%-9u %-9.3f %-9.3f %-9.3f %-9.1f %-13llu %-9llu %.2f \n",
+			static_cast<uint32_t>(samples), timings.average_ms, timings.min_ms, timings.max_ms,
+			timings.average_ms > 0.0 ? 1000.0 / timings.average_ms : 0.0,
+			static_cast<unsigned long long>(stats.transient_bytes / 1024),
+			static_cast<unsigned long long>(stats.lazily_allocated_bytes / 1024),
+			timings.host_allocations_per_frame);
+	}
+
+	renderer->set_msaa_samples(original_samples);
+
+	return EXIT_SUCCESS;
+}
+
+
+int benchmark::run_dispatch()
+{
+	const uint32_t draw_counts[] = { 1000, 10000 };
+
+	// Each draw is one vkCmdPushConstants and one vkCmdDraw
+	const uint32_t calls_per_draw = 2;
+
+	printf("\nDispatch benchmark, %u frames per configuration \n", measured_frames);
+	printf("draws     dispatch     avg ms    record ms   ns/call \n");
+
+	for (uint32_t draw_count : draw_counts)
+	{
+		renderer->set_draw_count(draw_count);
+
+		double record_ms[2] = {};
+		const VulkanDispatch dispatches[2] = { VulkanDispatch::loader_trampoline, VulkanDispatch::device_direct };
+
+		for (int i = 0; i < 2; i++)
+		{
+			renderer->set_dispatch(dispatches[i]);
+
+			FrameTimings timings = measure_frames();
+			record_ms[i] = timings.average_record_ms;
+
+			printf("%-9u %-12s %-9.3f %-11.3f %.2f \n", draw_count,
+				i == 0 ? "trampoline" : "direct", timings.average_ms, timings.average_record_ms,
+				timings.average_record_ms * 1000000.0 / (draw_count * calls_per_draw));
+		}
+
+		printf("%-9u saved %.2f ns per call \n", draw_count,
+			(record_ms[0] - record_ms[1]) * 1000000.0 / (draw_count * calls_per_draw));
+	}
+
+	renderer->set_draw_count(1);
+	renderer->set_dispatch(VulkanDispatch::device_direct);
+
+	return EXIT_SUCCESS;
+}
+
+
+void benchmark::build_test_scene(scene* target, uint32_t object_count)
+{
+	// Groups of a root and three smaller children, the roots on a square grid around the origin
+	uint32_t group_count = (object_count + 3) / 4;
+	uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(group_count))));
+	const float spacing = 2.0f;
+	const float child_offsets[3][2] = { { -0.6f, -0.6f }, { 0.6f, -0.6f }, { 0.0f, 0.6f } };
+
+	SceneBounds bounds = {};
+	bounds.radius = 0.6f;
+
+	uint32_t added = 0;
+	for (uint32_t group = 0; group < group_count && added < object_count; group++)
+	{
+		SceneTransform root_transform;
+		root_transform.rows[0][3] = (static_cast<float>(group % side) - side * 0.5f) * spacing;
+		root_transform.rows[1][3] = (static_cast<float>(group / side) - side * 0.5f) * spacing;
+
+		uint32_t root = target->add_object(SCENE_NO_PARENT, root_transform, bounds, 0);
+		added++;
+
+		for (uint32_t child = 0; child < 3 && added < object_count; child++)
+		{
+			SceneTransform child_transform;
+			child_transform.rows[0][0] = 0.4f;
+			child_transform.rows[1][1] = 0.4f;
+			child_transform.rows[2][2] = 0.4f;
+			child_transform.rows[0][3] = child_offsets[child][0];
+			child_transform.rows[1][3] = child_offsets[child][1];
+
+			target->add_object(root, child_transform, bounds, 0);
+			added++;
+		}
+	}
+}
+
+
+void benchmark::add_test_sprites(sprite_batch* target, uint32_t sprite_count, float width, float height, uint32_t frame,
+	const std::vector<uint32_t>& pages)
+{
+	// Square cells filling the area, each sprite circles inside its own cell
+	uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(sprite_count) * width / height)));
+	columns = std::max(columns, 1u);
+	uint32_t rows = (sprite_count + columns - 1) / columns;
+	float cell = std::min(width / columns, height / std::max(rows, 1u));
+	float phase = static_cast<float>(frame) * 0.05f;
+
+	Sprite sprite;
+	sprite.size[0] = std::max(cell * 0.5f, 1.0f);
+	sprite.size[1] = sprite.size[0];
+
+	for (uint32_t i = 0; i < sprite_count; i++)
+	{
+		float angle = phase + static_cast<float>(i) * 0.37f;
+		sprite.position[0] = (i % columns + 0.25f) * cell + std::cos(angle) * cell * 0.25f;
+		sprite.position[1] = (i / columns + 0.25f) * cell + std::sin(angle) * cell * 0.25f;
+
+		// Interleaved pages are the worst order for batching, the flush has to sort them
+		sprite.texture = pages.empty() ? SPRITE_NO_TEXTURE : pages[i % pages.size()];
+		sprite.colour = 0xC0000000 | ((i * 2654435761u) & 0x00FFFFFF);
+
+		target->add(sprite);
+	}
+}
+
+
+int benchmark::run_scene()
+{
+	const uint32_t object_count = 100000;
+	const uint32_t iterations = 100;
+
+	scene test_scene;
+	build_test_scene(&test_scene, object_count);
+
+	// Same camera as the renderer default
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 1000.0f);
+	projection[1][1] *= -1.0f;
+	FrustumPlanes frustum = scene::extract_frustum(projection * view);
+
+	thread_pool pool;
+
+	printf("\nScene benchmark, %u objects, %u updates per configuration \n", object_count, iterations);
+	printf("threads   transform ms   cull ms   visible   ns/object \n");
+
+	thread_pool* pools[2] = { nullptr, &pool };
+	for (thread_pool* workers : pools)
+	{
+		test_scene.init(workers);
+
+		// The first update sorts the hierarchy by depth
+		test_scene.update(frustum);
+
+		double transform_ms = 0.0;
+		double cull_ms = 0.0;
+
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			test_scene.update(frustum);
+			transform_ms += test_scene.get_stats().transform_ms;
+			cull_ms += test_scene.get_stats().cull_ms;
+		}
+
+		transform_ms /= iterations;
+		cull_ms /= iterations;
+
+		printf("%-9u %-14.3f %-9.3f %-9u %.2f \n",
+			workers != nullptr ? workers->get_thread_count() + 1 : 1, transform_ms, cull_ms,
+			test_scene.get_stats().visible_count, (transform_ms + cull_ms) * 1000000.0 / object_count);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+
+int benchmark::run_draw_list()
+{
+	const uint32_t object_count = 20000;
+	const uint32_t material_count = 8;
+
+	scene& frame_scene = renderer->get_scene();
+	bool built_scene = frame_scene.get_object_count() == 0;
+	if (built_scene)
+	{
+		build_test_scene(&frame_scene, object_count);
+	}
+
+	// Far enough back to keep the whole test grid in view
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 200.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 1000.0f);
+	projection[1][1] *= -1.0f;
+	renderer->set_camera(view, projection);
+
+	// Random pipeline and material per object, the worst case for submission order
+	uint32_t first_material = renderer->add_material(BINDLESS_INVALID_INDEX);
+	for (uint32_t i = 1; i < material_count; i++)
+	{
+		renderer->add_material(BINDLESS_INVALID_INDEX);
+	}
+
+	std::mt19937 random(7);
+	for (uint32_t handle = 0; handle < frame_scene.get_object_count(); handle++)
+	{
+		uint32_t pipeline = random() % SCENE_PIPELINE_COUNT;
+		uint32_t material = first_material + random() % material_count;
+		frame_scene.set_draw_key(handle, draw_list::make_key(0, pipeline, material, SCENE_GEOMETRY_TRIANGLE, 0));
+	}
+
+	printf("\nDraw list benchmark, %u objects, %u frames per configuration \n", frame_scene.get_object_count(), measured_frames);
+	printf("order      avg ms    record ms   draws     batches   pipeline binds   material binds   sort ms \n");
+
+	for (int sorted = 0; sorted < 2; sorted++)
+	{
+		renderer->set_sort_draws(sorted == 1);
+
+		FrameTimings timings = measure_frames();
+		const DrawListStats& stats = renderer->get_draw_list_stats();
+
+		printf("%-10s %-9.3f %-11.3f %-9u %-9u %-16u %-16u %.3f \n", sorted == 1 ? "sorted" : "unsorted",
+			timings.average_ms, timings.average_record_ms, stats.draw_count, stats.batch_count,
+			stats.pipeline_binds, stats.material_binds, stats.sort_ms);
+	}
+
+	if (built_scene)
+	{
+		frame_scene.clear();
+	}
+
+	return EXIT_SUCCESS;
+}
+
+
+int benchmark::run_lod()
+{
+	if (renderer->get_meshes().get_mesh_count() == 0)
+	{
+		printf("\nLOD benchmark skipped, load a mesh with --mesh \n");
+		return EXIT_SUCCESS;
+	}
+
+	scene& frame_scene = renderer->get_scene();
+	if (frame_scene.get_object_count() > 0)
+	{
+		printf("\nLOD benchmark skipped, the scene is not empty \n");
+		return EXIT_SUCCESS;
+	}
+
+	const GpuMesh& mesh = renderer->get_meshes().get_mesh(0);
+	uint32_t geometry = renderer->get_mesh_geometry(0);
+	uint64_t draw_key = draw_list::make_key(0, SCENE_PIPELINE_OPAQUE, 0, geometry, 0);
+
+	// A strip of copies running away from the camera, more objects only add distant ones
+	const uint32_t columns = 16;
+	const uint32_t object_counts[] = { 1024, 4096, 16384, 65536 };
+	float spacing = mesh.header.radius * 3.0f;
+
+	SceneBounds bounds;
+	bounds.center[0] = mesh.header.center[0];
+	bounds.center[1] = mesh.header.center[1];
+	bounds.center[2] = mesh.header.center[2];
+	bounds.radius = mesh.header.radius;
+
+	printf("\nLOD benchmark, %s, %u LODs, %u frames per configuration \n", mesh.file.c_str(), mesh.header.lod_count, measured_frames);
+	printf("objects   LOD   avg ms    visible   batches   triangles   triangles/object \n");
+
+	for (uint32_t object_count : object_counts)
+	{
+		frame_scene.clear();
+
+		uint32_t rows = object_count / columns;
+		for (uint32_t i = 0; i < object_count; i++)
+		{
+			SceneTransform transform;
+			transform.rows[0][3] = (static_cast<float>(i % columns) - columns * 0.5f) * spacing;
+			transform.rows[2][3] = -static_cast<float>(i / columns) * spacing;
+			frame_scene.add_object(SCENE_NO_PARENT, transform, bounds, draw_key);
+		}
+
+		glm::mat4 view = glm::lookAt(glm::vec3(0.0f, spacing * 4.0f, spacing * 8.0f), glm::vec3(0.0f, 0.0f, -spacing * 16.0f),
+			glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, spacing * (rows + 16));
+		projection[1][1] *= -1.0f;
+		renderer->set_camera(view, projection);
+
+		for (int lod = 0; lod < 2; lod++)
+		{
+			renderer->set_lod_error(lod == 1 ? 1.0f : 0.0f);
+
+			FrameTimings timings = measure_frames();
+			const DrawListStats& stats = renderer->get_draw_list_stats();
+
+			printf("%-9u %-5s %-9.3f %-9u %-9u %-11u %.1f \n", object_count, lod == 1 ? "on" : "off", timings.average_ms,
+				stats.draw_count, stats.batch_count, stats.triangle_count,
+				stats.draw_count > 0 ? static_cast<double>(stats.triangle_count) / stats.draw_count : 0.0);
+		}
+	}
+
+	frame_scene.clear();
+	renderer->set_lod_error(1.0f);
+
+	return EXIT_SUCCESS;
+}
+
+
+int benchmark::run_occlusion()
+{
+	if (renderer->get_meshes().get_mesh_count() == 0)
+	{
+		printf("\nOcclusion benchmark skipped, load a mesh with --mesh \n");
+		return EXIT_SUCCESS;
+	}
+
+	scene& frame_scene = renderer->get_scene();
+	if (frame_scene.get_object_count() > 0)
+	{
+		printf("\nOcclusion benchmark skipped, the scene is not empty \n");
+		return EXIT_SUCCESS;
+	}
+
+	const GpuMesh& mesh = renderer->get_meshes().get_mesh(0);
+	uint64_t draw_key = draw_list::make_key(0, SCENE_PIPELINE_OPAQUE, 0, renderer->get_mesh_geometry(0), 0);
+
+	SceneBounds bounds;
+	bounds.center[0] = mesh.header.center[0];
+	bounds.center[1] = mesh.header.center[1];
+	bounds.center[2] = mesh.header.center[2];
+	bounds.radius = mesh.header.radius;
+
+	// Copies scaled to a world radius, centred on the position
+	float unit_scale = mesh.header.radius > 0.0f ? 1.0f / mesh.header.radius : 1.0f;
+	auto add_copy = [&](float x, float y, float z, float radius) {
+		SceneTransform transform;
+		float scale = unit_scale * radius;
+		float position[3] = { x, y, z };
+		for (int axis = 0; axis < 3; axis++)
+		{
+			transform.rows[axis][axis] = scale;
+			transform.rows[axis][3] = position[axis] - mesh.header.center[axis] * scale;
+		}
+		frame_scene.add_object(SCENE_NO_PARENT, transform, bounds, draw_key);
+	};
+
+	// Overlapping copies make a wall that fills the view
+	const uint32_t wall_columns = 21;
+	const uint32_t wall_rows = 15;
+	const float wall_spacing = 1.2f;
+	for (uint32_t row = 0; row < wall_rows; row++)
+	{
+		for (uint32_t column = 0; column < wall_columns; column++)
+		{
+			add_copy((static_cast<float>(column) - wall_columns * 0.5f) * wall_spacing,
+				(static_cast<float>(row) - wall_rows * 0.5f) * wall_spacing, 0.0f, 1.0f);
+		}
+	}
+
+	// Small copies behind it, inside the frustum but hidden
+	const uint32_t hidden_count = 16384;
+	std::mt19937 random(11);
+	std::uniform_real_distribution<float> spread_x(-6.0f, 6.0f);
+	std::uniform_real_distribution<float> spread_y(-4.5f, 4.5f);
+	std::uniform_real_distribution<float> spread_z(-60.0f, -4.0f);
+	for (uint32_t i = 0; i < hidden_count; i++)
+	{
+		float x = spread_x(random);
+		float y = spread_y(random);
+		add_copy(x, y, spread_z(random), 0.5f);
+	}
+
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 12.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+	projection[1][1] *= -1.0f;
+	renderer->set_camera(view, projection);
+
+	// The pyramid is built from single sampled depth only
+	VkSampleCountFlagBits previous_samples = renderer->get_msaa_samples();
+	renderer->set_msaa_samples(VK_SAMPLE_COUNT_1_BIT);
+
+	gpu_queries& queries = renderer->get_queries();
+	bool queries_enabled = queries.is_enabled();
+	queries.set_enabled(true);
+
+	printf("\nOcclusion benchmark, %s, %u hidden objects, %u frames per configuration \n", mesh.file.c_str(), hidden_count,
+		measured_frames);
+	printf("culling   avg ms    draws     occluded   vertex shader   fragment shader \n");
+
+	for (int culling = 0; culling < 2; culling++)
+	{
+		renderer->set_occlusion_culling(culling == 1);
+		if (culling == 1 && !renderer->is_occlusion_culling_active())
+		{
+			printf("on        skipped, occlusion culling is not available \n");
+			break;
+		}
+
+		FrameTimings timings = measure_frames();
+		const DrawListStats& draw_stats = renderer->get_draw_list_stats();
+		const OcclusionStats& occlusion_stats = renderer->get_occlusion_stats();
+
+		uint64_t vertex_invocations = 0;
+		uint64_t fragment_invocations = 0;
+		if (!queries.get_regions().empty())
+		{
+			const GpuQueryRegion& region = queries.get_regions()[0];
+			vertex_invocations = region.statistics[QUERY_STATISTIC_VERTEX_INVOCATIONS];
+			fragment_invocations = region.statistics[QUERY_STATISTIC_FRAGMENT_INVOCATIONS];
+		}
+
+		printf("%-9s %-9.3f %-9u %-10u %-15llu %llu \n", culling == 1 ? "on" : "off", timings.average_ms, draw_stats.draw_count,
+			occlusion_stats.occluded, static_cast<unsigned long long>(vertex_invocations),
+			static_cast<unsigned long long>(fragment_invocations));
+	}
+
+	renderer->set_occlusion_culling(false);
+	queries.set_enabled(queries_enabled);
+	renderer->set_msaa_samples(previous_samples);
+	frame_scene.clear();
+
+	return EXIT_SUCCESS;
+}
+
+
+int benchmark::run_shader_variants()
+{
+	const uint32_t object_count = 20000;
+	const uint32_t light_counts[] = { 0, 4, 16, 64 };
+
+	scene& frame_scene = renderer->get_scene();
+	bool built_scene = frame_scene.get_object_count() == 0;
+	if (built_scene)
+	{
+		build_test_scene(&frame_scene, object_count);
+	}
+
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 200.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 1000.0f);
+	projection[1][1] *= -1.0f;
+	renderer->set_camera(view, projection);
+
+	// Plain and tinted materials, textured ones too when a texture was loaded, so several variants are drawn
+	std::vector<uint32_t> materials;
+	materials.push_back(renderer->add_material(BINDLESS_INVALID_INDEX));
+	materials.push_back(renderer->add_material(BINDLESS_INVALID_INDEX, 0xFF80C0FF));
+	if (renderer->get_textures().get_stats().texture_count > 0)
+	{
+		materials.push_back(renderer->add_material(0));
+		materials.push_back(renderer->add_material(0, 0xFFC0C0C0));
+	}
+
+	std::mt19937 random(5);
+	for (uint32_t handle = 0; handle < frame_scene.get_object_count(); handle++)
+	{
+		uint32_t material = materials[random() % materials.size()];
+		frame_scene.set_draw_key(handle, draw_list::make_key(0, SCENE_PIPELINE_OPAQUE, material, SCENE_GEOMETRY_TRIANGLE, 0));
+	}
+
+	printf("\nShader variant benchmark, %u objects, %zu materials, %u frames per configuration \n", frame_scene.get_object_count(),
+		materials.size(), measured_frames);
+	printf("lights   shaders       avg ms    record ms   pipeline binds \n");
+
+	for (uint32_t light_count : light_counts)
+	{
+		renderer->set_shader_light_count(light_count);
+
+		for (int specialized = 0; specialized < 2; specialized++)
+		{
+			renderer->set_specialized_shaders(specialized == 1);
+
+			FrameTimings timings = measure_frames();
+			const DrawListStats& stats = renderer->get_draw_list_stats();
+
+			printf("%-8u %-13s %-9.3f %-11.3f %u \n", light_count, specialized == 1 ? "specialized" : "uber",
+				timings.average_ms, timings.average_record_ms, stats.pipeline_binds);
+		}
+	}
+
+	renderer->set_specialized_shaders(false);
+	renderer->set_shader_light_count(0);
+
+	if (built_scene)
+	{
+		frame_scene.clear();
+	}
+
+	return EXIT_SUCCESS;
+}
+
+
+int benchmark::run_render_targets()
+{
+	const uint32_t toggle_count = 10;
+
+	VkSampleCountFlagBits original_samples = renderer->get_msaa_samples();
+	bool original_dynamic = renderer->is_dynamic_rendering_active();
+
+	std::vector<VkSampleCountFlagBits> sample_counts = renderer->get_supported_sample_counts();
+	VkSampleCountFlagBits max_samples = sample_counts.back();
+
+	printf("\nRender target benchmark, MSAA toggled between 1 and %u samples %u times, %u frames per path \n",
+		static_cast<uint32_t>(max_samples), toggle_count, measured_frames);
+	printf("path                recreate ms   render passes   framebuffers   compile ms   avg ms \n");
+
+	for (int dynamic = 0; dynamic < 2; dynamic++)
+	{
+		renderer->set_dynamic_rendering(dynamic == 1);
+		if (dynamic == 1 && !renderer->is_dynamic_rendering_active())
+		{
+			printf("dynamic rendering   not supported by the device \n");
+			continue;
+		}
+
+		renderer->set_msaa_samples(VK_SAMPLE_COUNT_1_BIT);
+
+		double total_recreate_ms = 0.0;
+		uint32_t recreate_count = 0;
+		for (uint32_t toggle = 0; toggle < toggle_count && max_samples != VK_SAMPLE_COUNT_1_BIT; toggle++)
+		{
+			renderer->set_msaa_samples(max_samples);
+			total_recreate_ms += renderer->get_last_recreate_ms();
+			renderer->set_msaa_samples(VK_SAMPLE_COUNT_1_BIT);
+			total_recreate_ms += renderer->get_last_recreate_ms();
+			recreate_count += 2;
+		}
+
+		FrameTimings timings = measure_frames();
+		const RenderGraphStats& stats = renderer->get_render_graph_stats();
+
+		printf("%-19s %-13.3f %-15u %-14u %-12.3f %.3f \n", dynamic == 1 ? "dynamic rendering" : "render passes",
+			recreate_count > 0 ? total_recreate_ms / recreate_count : 0.0, stats.render_pass_count, stats.framebuffer_count,
+			stats.compile_ms, timings.average_ms);
+	}
+
+	renderer->set_dynamic_rendering(original_dynamic);
+	renderer->set_msaa_samples(original_samples);
+
+	return EXIT_SUCCESS;
+}
+
+
+int benchmark::run_windows()
+{
+	const uint32_t max_extra_windows = 3;
+
+	printf("\nWindow benchmark, %u frames per window count \n", measured_frames);
+	printf("windows   avg ms    min ms    max ms    record ms \n");
+
+	std::vector<GLFWwindow*> extra_windows;
+	for (uint32_t extra = 0; extra <= max_extra_windows; extra++)
+	{
+		if (extra > 0)
+		{
+			GLFWwindow* extra_window = glfwCreateWindow(400, 300, "Benchmark view", nullptr, nullptr);
+			renderer->add_window(extra_window);
+			extra_windows.push_back(extra_window);
+		}
+
+		FrameTimings timings = measure_frames();
+
+		printf("%-9u %-9.3f %-9.3f %-9.3f %.3f \n", renderer->get_window_count(), timings.average_ms,
+			timings.min_ms, timings.max_ms, timings.average_record_ms);
+	}
+
+	for (GLFWwindow* extra_window : extra_windows)
+	{
+		renderer->remove_window(extra_window);
+		glfwDestroyWindow(extra_window);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+
+int benchmark::run_particles()
+{
+	particle_system& particles = renderer->get_particles();
+	if (!particles.is_available())
+	{
+		printf("\nParticle benchmark skipped, the particle shaders are missing \n");
+		return EXIT_SUCCESS;
+	}
+
+	const uint32_t capacities[] = { 65536, 262144, 1048576, 2097152 };
+
+	// Fixed steps, so every run simulates the same particles whatever the frame rate
+	const float time_step = 1.0f / 60.0f;
+
+	ParticleEmitter previous_emitter = particles.get_emitter();
+	uint32_t previous_capacity = particles.get_capacity();
+	particles.set_fixed_time_step(time_step);
+	renderer->set_particles_enabled(true);
+
+	printf("\nParticle benchmark, %u frames per particle count \n", measured_frames);
+	printf("capacity  alive     avg ms    gpu ms    million particles/s \n");
+
+	for (uint32_t capacity : capacities)
+	{
+		renderer->set_particle_capacity(capacity);
+
+		// Filled by the first frame, then emitted faster than they die so the pool stays close to full
+		ParticleEmitter emitter = previous_emitter;
+		emitter.lifetime = 2.0f;
+		emitter.rate = static_cast<float>(capacity) / time_step;
+		particles.set_emitter(emitter);
+		renderer->draw();
+
+		emitter.rate = static_cast<float>(capacity) / emitter.lifetime * 1.5f;
+		particles.set_emitter(emitter);
+
+		// The GPU totals cover the warmup frames too, the pool is already full by then
+		ParticleStats before = particles.get_stats();
+		FrameTimings timings = measure_frames();
+		const ParticleStats& after = particles.get_stats();
+
+		uint32_t frames = static_cast<uint32_t>(after.frames - before.frames);
+		double gpu_ms = after.total_gpu_ms - before.total_gpu_ms;
+		double simulated = static_cast<double>(after.total_simulated - before.total_simulated);
+
+		printf("%-9u %-9u %-9.3f %-9.3f %.1f \n", particles.get_capacity(), after.alive, timings.average_ms,
+			frames > 0 ? gpu_ms / frames : 0.0, gpu_ms > 0.0 ? simulated / (gpu_ms / 1000.0) / 1000000.0 : 0.0);
+	}
+
+	renderer->set_particles_enabled(false);
+	renderer->set_particle_capacity(previous_capacity);
+	particles.set_emitter(previous_emitter);
+	particles.set_fixed_time_step(0.0f);
+
+	return EXIT_SUCCESS;
+}
+
+
+int benchmark::run_post_processing()
+{
+	post_process& post = renderer->get_post_process();
+	if (!post.is_available())
+	{
+		printf("\nPost-processing benchmark skipped, the post-processing shaders are missing \n");
+		return EXIT_SUCCESS;
+	}
+
+	const uint32_t bloom_levels[] = { 0, 1, 3, 5, 8 };
+
+	PostSettings previous_settings = post.get_settings();
+
+	printf("\nPost-processing benchmark, %u frames per configuration \n", measured_frames);
+	printf("bloom     avg ms    max ms    post gpu ms \n");
+
+	renderer->set_post_processing(false);
+	FrameTimings off_timings = measure_frames();
+	printf("%-9s %-9.3f %-9.3f %-9s \n", "post off", off_timings.average_ms, off_timings.max_ms, "-");
+
+	renderer->set_post_processing(true);
+	if (!renderer->is_post_processing_active())
+	{
+		printf("Post-processing benchmark stopped, the swap chain images can not be blitted to \n");
+		return EXIT_SUCCESS;
+	}
+
+	for (uint32_t levels : bloom_levels)
+	{
+		PostSettings settings = previous_settings;
+		settings.bloom_levels = levels;
+		renderer->set_post_settings(settings);
+
+		post.reset_timings();
+		FrameTimings timings = measure_frames();
+
+		// Passes recorded for several windows are summed per frame
+		double gpu_ms = 0.0;
+		for (const PostPassTiming& pass : post.get_timings())
+		{
+			if (pass.frame_count > 0)
+			{
+				gpu_ms += pass.total_ms / static_cast<double>(pass.frame_count);
+			}
+		}
+
+		printf("%-9u %-9.3f %-9.3f %-9.3f \n", levels, timings.average_ms, timings.max_ms, gpu_ms);
+	}
+
+	// Where the budget of the last, widest chain goes
+	for (const PostPassTiming& pass : post.get_timings())
+	{
+		if (pass.frame_count > 0)
+		{
+			printf("    %-20s %.3f ms \n", pass.name.c_str(), pass.total_ms / static_cast<double>(pass.frame_count));
+		}
+	}
+
+	renderer->set_post_settings(previous_settings);
+	post.reset_timings();
+
+	return EXIT_SUCCESS;
+}
+
+
+int benchmark::run_sprites()
+{
+	sprite_batch& sprites = renderer->get_sprites();
+	if (!sprites.is_available())
+	{
+		printf("\nSprite benchmark skipped, the sprite shaders are missing \n");
+		return EXIT_SUCCESS;
+	}
+
+	const uint32_t sprite_counts[] = { 1000, 10000, 50000, 100000 };
+
+	// Textures loaded with --texture stand in for atlas pages, without them every sprite is a plain rectangle
+	std::vector<uint32_t> pages;
+	for (uint32_t texture = 0; texture < renderer->get_textures().get_stats().texture_count && texture < 4; texture++)
+	{
+		pages.push_back(texture);
+	}
+
+	int width = 0;
+	int height = 0;
+	glfwGetFramebufferSize(window, &width, &height);
+
+	printf("\nSprite benchmark, %u frames per sprite count, %zu textures as pages \n", measured_frames, pages.size());
+	printf("sprites   pages  avg ms    flush ms  batches \n");
+
+	for (uint32_t sprite_count : sprite_counts)
+	{
+		for (uint32_t page_count = 1; page_count <= std::max(static_cast<uint32_t>(pages.size()), 1u); page_count *= 2)
+		{
+			std::vector<uint32_t> used_pages(pages.begin(), pages.begin() + std::min(static_cast<size_t>(page_count), pages.size()));
+
+			before_frame = [&sprites, sprite_count, width, height, &used_pages](uint32_t frame) {
+				add_test_sprites(&sprites, sprite_count, static_cast<float>(width), static_cast<float>(height), frame, used_pages);
+			};
+
+			SpriteStats before = sprites.get_stats();
+			FrameTimings timings = measure_frames();
+			const SpriteStats& after = sprites.get_stats();
+
+			double frames = static_cast<double>(after.frames - before.frames);
+			double flush_ms = frames > 0.0 ? (after.total_flush_ms - before.total_flush_ms) / frames : 0.0;
+			double batches = frames > 0.0 ? static_cast<double>(after.total_batches - before.total_batches) / frames : 0.0;
+
+			printf("%-9u %-6u %-9.3f %-9.3f %.1f \n", sprite_count, page_count, timings.average_ms, flush_ms, batches);
+		}
+	}
+
+	before_frame = nullptr;
+	sprites.clear();
+
+	return EXIT_SUCCESS;
+}
+
+
+int benchmark::run()
+{
+	try
+	{
+		printf("Benchmark : renderer init took %.2f ms \n", renderer->get_init_ms());
+
+		int result = run_msaa();
+		if (result == EXIT_SUCCESS)
+		{
+			result = run_dispatch();
+		}
+		if (result == EXIT_SUCCESS)
+		{
+			result = run_scene();
+		}
+		if (result == EXIT_SUCCESS)
+		{
+			result = run_draw_list();
+		}
+		if (result == EXIT_SUCCESS)
+		{
+			result = run_lod();
+		}
+		if (result == EXIT_SUCCESS)
+		{
+			result = run_occlusion();
+		}
+		if (result == EXIT_SUCCESS)
+		{
+			result = run_shader_variants();
+		}
+		if (result == EXIT_SUCCESS)
+		{
+			result = run_render_targets();
+		}
+		if (result == EXIT_SUCCESS)
+		{
+			result = run_windows();
+		}
+		if (result == EXIT_SUCCESS)
+		{
+			result = run_particles();
+		}
+		if (result == EXIT_SUCCESS)
+		{
+			result = run_post_processing();
+		}
+		if (result == EXIT_SUCCESS)
+		{
+			result = run_sprites();
+		}
+
+		// Memory creep shows up as growing usage between runs
+		renderer->print_memory_report();
+		renderer->get_host_allocator().print_stats();
+
+		return result;
+	}
+	catch (const std::runtime_error &e)
+	{
+		printf("ERROR : %s \n", e.what());
+		return EXIT_FAILURE;
+	}
+}
+
+
+FrameTimings benchmark::measure_scenario(const std::string& scenario)
+{
+	FrameTimings timings = measure_frames();
+
+	MemoryReport report = renderer->get_memory_report();
+	VkDeviceSize allocated_bytes = 0;
+	for (const MemoryHeapReport& heap : report.heaps)
+	{
+		allocated_bytes += heap.allocated_bytes;
+	}
+
+	printf("%-24s %-9u %-9.3f %-9.3f %-9.3f %-9.3f %-9.1f %.2f \n", scenario.c_str(), timings.frame_count, timings.p50_ms,
+		timings.p95_ms, timings.p99_ms, timings.average_record_ms, static_cast<double>(allocated_bytes) / (1024.0 * 1024.0),
+		timings.host_allocations_per_frame);
+
+	return timings;
+}
+
+
+bool benchmark::read_back_frame(VkExtent2D extent)
+{
+	frame_capture& capture = renderer->get_capture();
+
+	// Written on the writer thread, flush waits for it. Pixels are only valid inside the consumer
+	auto read_back = std::make_shared<CaptureFrame>();
+	capture.set_consumer([read_back](const CaptureFrame& frame) {
+		*read_back = frame;
+		read_back->pixels = nullptr;
+	});
+	capture.start(1);
+
+	// The copy is handed to the writer once the fence of its frame is waited on, a round of frames in flight later
+	for (int i = 0; i <= MAX_FRAME_DRAWS; i++)
+	{
+		renderer->draw();
+	}
+	capture.flush();
+
+	return read_back->width == extent.width && read_back->height == extent.height;
+}
+
+
+int benchmark::run_regression(const std::string& baseline_file, bool write_baseline)
+{
+	try
+	{
+		if (!renderer->is_offscreen())
+		{
+			printf("ERROR : The regression suite needs a renderer created with init_offscreen \n");
+			return EXIT_FAILURE;
+		}
+
+		scene& frame_scene = renderer->get_scene();
+		if (frame_scene.get_object_count() > 0)
+		{
+			printf("ERROR : The regression suite needs an empty scene, run it without --scene \n");
+			return EXIT_FAILURE;
+		}
+
+		perf_baseline measured;
+
+		// Cost per unit of work at the larger size over the cost per unit at the smaller one. Fixed costs
+		// of the frame are spread over more work at the larger size, so linear scaling stays at or below 1
+		auto per_unit_ratio = [](double small_cost, double small_units, double large_cost, double large_units) {
+			return small_cost > 0.0 ? (large_cost / large_units) / (small_cost / small_units) : 0.0;
+		};
+
+		// Worst p99 over p50 of every scenario, a frame in a hundred that is that much slower is a hitch
+		double worst_hitch = 0.0;
+		auto track_hitch = [&worst_hitch](const FrameTimings& timings) {
+			if (timings.p50_ms > 0.0)
+				worst_hitch = std::max(worst_hitch, timings.p99_ms / timings.p50_ms);
+		};
+
+		printf("\nRegression suite on %s, %u frames per scenario \n", renderer->get_device_name().c_str(), measured_frames);
+		printf("init %.2f ms, pipeline creation %.2f ms \n", renderer->get_init_ms(), renderer->get_pipeline_creation_ms());
+		printf("scenario                 frames    p50 ms    p95 ms    p99 ms    record ms device MB host allocs/frame \n");
+
+		// Command recording, every draw is a push constant and a draw
+		renderer->set_draw_count(1000);
+		FrameTimings few_draws = measure_scenario("draws_1000");
+		renderer->set_draw_count(10000);
+		FrameTimings many_draws = measure_scenario("draws_10000");
+		renderer->set_draw_count(1);
+		track_hitch(few_draws);
+		track_hitch(many_draws);
+
+		measured.set("draws.record_ms_per_draw_ratio", per_unit_ratio(few_draws.average_record_ms, 1000.0,
+			many_draws.average_record_ms, 10000.0), 25.0);
+
+		// Scene updates, culling and the instanced batches of the draw list
+		const uint32_t object_counts[] = { 1000, 10000, 50000 };
+		std::vector<FrameTimings> object_timings;
+		for (uint32_t object_count : object_counts)
+		{
+			frame_scene.clear();
+			build_test_scene(&frame_scene, object_count);
+			object_timings.push_back(measure_scenario("instances_" + std::to_string(object_count)));
+			track_hitch(object_timings.back());
+		}
+		frame_scene.clear();
+
+		measured.set("instances.frame_ms_per_object_ratio", per_unit_ratio(object_timings.front().p50_ms, object_counts[0],
+			object_timings.back().p50_ms, object_counts[2]), 25.0);
+
+		// Vertex work, copies of the first mesh at LOD 0, all of them in view
+		if (renderer->get_meshes().get_mesh_count() > 0)
+		{
+			const GpuMesh& mesh = renderer->get_meshes().get_mesh(0);
+			uint64_t draw_key = draw_list::make_key(0, SCENE_PIPELINE_OPAQUE, 0, renderer->get_mesh_geometry(0), 0);
+
+			const uint32_t columns = 16;
+			float spacing = mesh.header.radius * 2.5f;
+
+			SceneBounds bounds;
+			bounds.center[0] = mesh.header.center[0];
+			bounds.center[1] = mesh.header.center[1];
+			bounds.center[2] = mesh.header.center[2];
+			bounds.radius = mesh.header.radius;
+
+			glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, spacing * columns * 1.5f), glm::vec3(0.0f, 0.0f, 0.0f),
+				glm::vec3(0.0f, 1.0f, 0.0f));
+			glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, spacing * columns * 4.0f);
+			projection[1][1] *= -1.0f;
+			renderer->set_camera(view, projection);
+			renderer->set_lod_error(0.0f);
+
+			const uint32_t mesh_counts[] = { 16, 64, 256 };
+			std::vector<FrameTimings> mesh_timings;
+			std::vector<double> triangle_counts;
+			for (uint32_t mesh_count : mesh_counts)
+			{
+				frame_scene.clear();
+				for (uint32_t i = 0; i < mesh_count; i++)
+				{
+					SceneTransform transform;
+					transform.rows[0][3] = (static_cast<float>(i % columns) - columns * 0.5f) * spacing;
+					transform.rows[1][3] = (static_cast<float>(i / columns) - columns * 0.5f) * spacing;
+					frame_scene.add_object(SCENE_NO_PARENT, transform, bounds, draw_key);
+				}
+
+				mesh_timings.push_back(measure_scenario("meshes_" + std::to_string(mesh_count)));
+				track_hitch(mesh_timings.back());
+				triangle_counts.push_back(static_cast<double>(renderer->get_draw_list_stats().triangle_count));
+				printf("%-24s %u triangles \n", "", renderer->get_draw_list_stats().triangle_count);
+			}
+			frame_scene.clear();
+
+			measured.set("meshes.frame_ms_per_triangle_ratio", per_unit_ratio(mesh_timings.front().p50_ms,
+				triangle_counts.front(), mesh_timings.back().p50_ms, triangle_counts.back()), 25.0);
+
+			// Back to the default camera and LOD error
+			view = glm::lookAt(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 1000.0f);
+			projection[1][1] *= -1.0f;
+			renderer->set_camera(view, projection);
+			renderer->set_lod_error(1.0f);
+		}
+		else
+		{
+			// Its metric is then missing, which fails the check against the baseline
+			printf("Triangle scenarios skipped, load a mesh with --mesh \n");
+		}
+
+		// Fill rate and post-processing. The offscreen target is resized for each resolution and one frame
+		// of it read back, going back to the first size must give back every allocation of the others
+		VkExtent2D first_extent = renderer->get_offscreen_extent();
+		MemoryReport before_report = renderer->get_memory_report();
+
+		const VkExtent2D resolutions[] = { { 640, 360 }, { 1280, 720 }, { 1920, 1080 } };
+		std::vector<FrameTimings> resolution_timings;
+		for (VkExtent2D resolution : resolutions)
+		{
+			std::string scenario = "resolution_" + std::to_string(resolution.height) + "p";
+
+			renderer->set_offscreen_extent(resolution);
+			resolution_timings.push_back(measure_scenario(scenario));
+			track_hitch(resolution_timings.back());
+
+			if (!read_back_frame(resolution))
+			{
+				printf("ERROR : No %ux%u frame was read back in %s \n", resolution.width, resolution.height, scenario.c_str());
+				return EXIT_FAILURE;
+			}
+		}
+		renderer->set_offscreen_extent(first_extent);
+
+		measured.set("resolution.frame_ms_per_pixel_ratio", per_unit_ratio(resolution_timings.front().p50_ms,
+			640.0 * 360.0, resolution_timings.back().p50_ms, 1920.0 * 1080.0), 25.0);
+
+		MemoryReport after_report = renderer->get_memory_report();
+		double leaked_bytes = 0.0;
+		for (size_t i = 0; i < after_report.heaps.size(); i++)
+		{
+			leaked_bytes += static_cast<double>(after_report.heaps[i].allocated_bytes)
+				- static_cast<double>(before_report.heaps[i].allocated_bytes);
+		}
+		measured.set("resolution.device_mb_leaked", leaked_bytes / (1024.0 * 1024.0), 0.0);
+		measured.set("resolution.allocations_leaked", static_cast<double>(after_report.allocation_count)
+			- static_cast<double>(before_report.allocation_count), 0.0);
+
+		measured.set("frames.worst_p99_over_p50", worst_hitch, 100.0);
+
+		perf_baseline baseline;
+		if (write_baseline)
+		{
+			// Tolerances edited into an existing baseline are kept
+			std::ifstream existing(baseline_file);
+			if (existing.is_open())
+			{
+				existing.close();
+				baseline.load(baseline_file);
+			}
+
+			baseline.update(measured);
+			baseline.save(baseline_file);
+			return EXIT_SUCCESS;
+		}
+
+		baseline.load(baseline_file);
+
+		printf("\nRegression check against %s \n", baseline_file.c_str());
+		uint32_t failures = baseline.compare(measured);
+		if (failures > 0)
+		{
+			printf("%u metrics failed \n", failures);
+			return EXIT_FAILURE;
+		}
+
+		printf("No metric failed \n");
+		return EXIT_SUCCESS;
+	}
+	catch (const std::runtime_error &e)
+	{
+		printf("ERROR : %s \n", e.what());
+		return EXIT_FAILURE;
+	}
+}
@@ -0,0 +1,372 @@
+#include "..\headers\bindless_heap.h"
+
+// Upper bounds for the arrays, clamped to the device limits
+static const uint32_t max_bindless_textures = 16384;
+static const uint32_t max_bindless_storage_buffers = 4096;
+
+bindless_heap::bindless_heap()
+{
+}
+
+
+bool bindless_heap::check_device_support(VkPhysicalDevice physical_device)
+{
+	VkPhysicalDeviceVulkan12Features vulkan12_features = {};
+	vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &vulkan12_features;
+
+	vkGetPhysicalDeviceFeatures2(physical_device, &features);
+
+	return vulkan12_features.descriptorIndexing
+		&& vulkan12_features.runtimeDescriptorArray
+		&& vulkan12_features.descriptorBindingPartiallyBound
+		&& vulkan12_features.descriptorBindingUpdateUnusedWhilePending
+		&& vulkan12_features.descriptorBindingSampledImageUpdateAfterBind
+		&& vulkan12_features.descriptorBindingStorageBufferUpdateAfterBind
+		&& vulkan12_features.shaderSampledImageArrayNonUniformIndexing
+		&& vulkan12_features.shaderStorageBufferArrayNonUniformIndexing;
+}
+
+
+VkPhysicalDeviceVulkan12Features bindless_heap::get_required_features()
+{
+	VkPhysicalDeviceVulkan12Features vulkan12_features = {};
+	vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan12_features.descriptorIndexing = VK_TRUE;
+	vulkan12_features.runtimeDescriptorArray = VK_TRUE;
+	vulkan12_features.descriptorBindingPartiallyBound = VK_TRUE;
+	vulkan12_features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+	vulkan12_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	vulkan12_features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+	vulkan12_features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+	vulkan12_features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+
+	return vulkan12_features;
+}
+
+
+void bindless_heap::init(VkPhysicalDevice physical_device, VkDevice new_device, uint32_t frame_count, const VkAllocationCallbacks* new_allocator)
+{
+	device = new_device;
+	allocator = new_allocator;
+
+	VkPhysicalDeviceVulkan12Properties vulkan12_properties = {};
+	vulkan12_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 properties = {};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &vulkan12_properties;
+
+	vkGetPhysicalDeviceProperties2(physical_device, &properties);
+
+	max_textures = std::min({ max_bindless_textures,
+		vulkan12_properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		vulkan12_properties.maxDescriptorSetUpdateAfterBindSampledImages });
+	max_storage_buffers = std::min({ max_bindless_storage_buffers,
+		vulkan12_properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+		vulkan12_properties.maxDescriptorSetUpdateAfterBindStorageBuffers });
+
+	// SET LAYOUT
+	std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+	bindings[BINDLESS_TEXTURE_BINDING].binding = BINDLESS_TEXTURE_BINDING;
+	bindings[BINDLESS_TEXTURE_BINDING].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[BINDLESS_TEXTURE_BINDING].descriptorCount = max_textures;
+	bindings[BINDLESS_TEXTURE_BINDING].stageFlags = VK_SHADER_STAGE_ALL;
+	bindings[BINDLESS_TEXTURE_BINDING].pImmutableSamplers = nullptr;
+
+	bindings[BINDLESS_STORAGE_BUFFER_BINDING].binding = BINDLESS_STORAGE_BUFFER_BINDING;
+	bindings[BINDLESS_STORAGE_BUFFER_BINDING].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[BINDLESS_STORAGE_BUFFER_BINDING].descriptorCount = max_storage_buffers;
+	bindings[BINDLESS_STORAGE_BUFFER_BINDING].stageFlags = VK_SHADER_STAGE_ALL;
+	bindings[BINDLESS_STORAGE_BUFFER_BINDING].pImmutableSamplers = nullptr;
+
+	// Slots may be empty and may be written while other slots are in use by the GPU
+	VkDescriptorBindingFlags binding_flag = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+		| VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+	std::vector<VkDescriptorBindingFlags> binding_flags(bindings.size(), binding_flag);
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_create_info = {};
+	binding_flags_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	binding_flags_create_info.bindingCount = static_cast<uint32_t>(binding_flags.size());
+	binding_flags_create_info.pBindingFlags = binding_flags.data();
+
+	VkDescriptorSetLayoutCreateInfo layout_create_info = {};
+	layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layout_create_info.pNext = &binding_flags_create_info;
+	layout_create_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	layout_create_info.bindingCount = static_cast<uint32_t>(bindings.size());
+	layout_create_info.pBindings = bindings.data();
+
+	VkResult result = vkCreateDescriptorSetLayout(device, &layout_create_info, allocator, &set_layout);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the bindless descriptor set layout \n");
+	}
+
+	// POOL
+	VkDescriptorPoolSize pool_sizes[2] = {};
+	pool_sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	pool_sizes[0].descriptorCount = max_textures * frame_count;
+	pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	pool_sizes[1].descriptorCount = max_storage_buffers * frame_count;
+
+	VkDescriptorPoolCreateInfo pool_create_info = {};
+	pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_create_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	pool_create_info.maxSets = frame_count;
+	pool_create_info.poolSizeCount = 2;
+	pool_create_info.pPoolSizes = pool_sizes;
+
+	result = vkCreateDescriptorPool(device, &pool_create_info, allocator, &descriptor_pool);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the bindless descriptor pool \n");
+	}
+
+	// SETS, one per frame in flight
+	std::vector<VkDescriptorSetLayout> set_layouts(frame_count, set_layout);
+	sets.resize(frame_count);
+
+	VkDescriptorSetAllocateInfo set_allocate_info = {};
+	set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	set_allocate_info.descriptorPool = descriptor_pool;
+	set_allocate_info.descriptorSetCount = frame_count;
+	set_allocate_info.pSetLayouts = set_layouts.data();
+
+	result = vkAllocateDescriptorSets(device, &set_allocate_info, sets.data());
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to allocate the bindless descriptor sets \n");
+	}
+
+	printf("Bindless heap creation is  a success, %u textures and %u storage buffers \n", max_textures, max_storage_buffers);
+}
+
+
+void bindless_heap::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+		return;
+
+	// The sets are freed with the pool
+	vkDestroyDescriptorPool(device, descriptor_pool, allocator);
+	vkDestroyDescriptorSetLayout(device, set_layout, allocator);
+
+	sets.clear();
+	pending_writes.clear();
+	retired_slots.clear();
+	free_textures.clear();
+	free_storage_buffers.clear();
+	texture_count = 0;
+	storage_buffer_count = 0;
+
+	descriptor_pool = VK_NULL_HANDLE;
+	set_layout = VK_NULL_HANDLE;
+	device = VK_NULL_HANDLE;
+}
+
+
+uint32_t bindless_heap::allocate_slot(uint32_t binding)
+{
+	std::lock_guard<std::mutex> lock(heap_mutex);
+
+	bool textures = binding == BINDLESS_TEXTURE_BINDING;
+	std::vector<uint32_t>& free_slots = textures ? free_textures : free_storage_buffers;
+	uint32_t& count = textures ? texture_count : storage_buffer_count;
+
+	if (!free_slots.empty())
+	{
+		uint32_t index = free_slots.back();
+		free_slots.pop_back();
+		return index;
+	}
+
+	if (count >= (textures ? max_textures : max_storage_buffers))
+	{
+		throw std::runtime_error(" Error: Bindless heap is full \n");
+	}
+
+	return count++;
+}
+
+
+void bindless_heap::queue_write(BindlessWrite write)
+{
+	std::lock_guard<std::mutex> lock(heap_mutex);
+
+	write.pending_frames = (1u << sets.size()) - 1;
+
+	// A newer write to the same slot replaces the queued one
+	for (BindlessWrite& pending : pending_writes)
+	{
+		if (pending.binding == write.binding && pending.index == write.index)
+		{
+			pending = write;
+			return;
+		}
+	}
+
+	pending_writes.push_back(write);
+}
+
+
+uint32_t bindless_heap::add_texture(VkImageView image_view, VkSampler sampler)
+{
+	uint32_t index = allocate_slot(BINDLESS_TEXTURE_BINDING);
+	update_texture(index, image_view, sampler);
+	return index;
+}
+
+
+void bindless_heap::update_texture(uint32_t index, VkImageView image_view, VkSampler sampler)
+{
+	BindlessWrite write = {};
+	write.binding = BINDLESS_TEXTURE_BINDING;
+	write.index = index;
+	write.image_info.imageView = image_view;
+	write.image_info.sampler = sampler;
+	write.image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	queue_write(write);
+}
+
+
+void bindless_heap::remove_texture(uint32_t index)
+{
+	std::lock_guard<std::mutex> lock(heap_mutex);
+	retired_slots.push_back({ BINDLESS_TEXTURE_BINDING, index, static_cast<uint32_t>(sets.size()) });
+}
+
+
+uint32_t bindless_heap::add_storage_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	uint32_t index = allocate_slot(BINDLESS_STORAGE_BUFFER_BINDING);
+	update_storage_buffer(index, buffer, offset, range);
+	return index;
+}
+
+
+void bindless_heap::update_storage_buffer(uint32_t index, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	BindlessWrite write = {};
+	write.binding = BINDLESS_STORAGE_BUFFER_BINDING;
+	write.index = index;
+	write.buffer_info.buffer = buffer;
+	write.buffer_info.offset = offset;
+	write.buffer_info.range = range;
+
+	queue_write(write);
+}
+
+
+void bindless_heap::remove_storage_buffer(uint32_t index)
+{
+	std::lock_guard<std::mutex> lock(heap_mutex);
+	retired_slots.push_back({ BINDLESS_STORAGE_BUFFER_BINDING, index, static_cast<uint32_t>(sets.size()) });
+}
+
+
+void bindless_heap::begin_frame(uint32_t frame)
+{
+	std::lock_guard<std::mutex> lock(heap_mutex);
+
+	// Slots freed a full round of frames ago are no longer referenced by any set in flight
+	for (size_t i = 0; i < retired_slots.size();)
+	{
+		if (--retired_slots[i].frames_left == 0)
+		{
+			if (retired_slots[i].binding == BINDLESS_TEXTURE_BINDING)
+				free_textures.push_back(retired_slots[i].index);
+			else
+				free_storage_buffers.push_back(retired_slots[i].index);
+
+			retired_slots.erase(retired_slots.begin() + i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	if (pending_writes.empty())
+		return;
+
+	std::vector<VkWriteDescriptorSet> writes;
+	writes.reserve(pending_writes.size());
+
+	uint32_t frame_bit = 1u << frame;
+	for (BindlessWrite& pending : pending_writes)
+	{
+		if (!(pending.pending_frames & frame_bit))
+			continue;
+
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = sets[frame];
+		write.dstBinding = pending.binding;
+		write.dstArrayElement = pending.index;
+		write.descriptorCount = 1;
+
+		if (pending.binding == BINDLESS_TEXTURE_BINDING)
+		{
+			write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			write.pImageInfo = &pending.image_info;
+		}
+		else
+		{
+			write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			write.pBufferInfo = &pending.buffer_info;
+		}
+
+		writes.push_back(write);
+		pending.pending_frames &= ~frame_bit;
+	}
+
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+	pending_writes.erase(std::remove_if(pending_writes.begin(), pending_writes.end(),
+		[](const BindlessWrite& pending) { return pending.pending_frames == 0; }), pending_writes.end());
+}
+
+
+void bindless_heap::bind(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, VkPipelineBindPoint bind_point, uint32_t frame)
+{
+	vkCmdBindDescriptorSets(command_buffer, bind_point, pipeline_layout, 0, 1, &sets[frame], 0, nullptr);
+}
+
+
+VkDescriptorSetLayout bindless_heap::get_set_layout()
+{
+	return set_layout;
+}
+
+
+VkPushConstantRange bindless_heap::get_push_constant_range()
+{
+	VkPushConstantRange range = {};
+	range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	range.offset = 0;
+	range.size = sizeof(DrawPushConstants);
+
+	return range;
+}
+
+
+uint32_t bindless_heap::get_texture_count()
+{
+	std::lock_guard<std::mutex> lock(heap_mutex);
+	return texture_count - static_cast<uint32_t>(free_textures.size());
+}
+
+
+uint32_t bindless_heap::get_storage_buffer_count()
+{
+	std::lock_guard<std::mutex> lock(heap_mutex);
+	return storage_buffer_count - static_cast<uint32_t>(free_storage_buffers.size());
+}
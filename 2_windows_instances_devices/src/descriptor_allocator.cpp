@@ -0,0 +1,307 @@
+#include "..\headers\descriptor_allocator.h"
+
+descriptor_allocator::descriptor_allocator()
+{
+}
+
+
+void descriptor_allocator::init(VkDevice new_device, uint32_t frame_count, const VkAllocationCallbacks* new_allocator)
+{
+	device = new_device;
+	allocator = new_allocator;
+
+	frames.assign(frame_count, DescriptorFramePools());
+	current_frame = 0;
+	stats = {};
+
+	// One pool per frame up front, more are only created by frames that need them
+	for (DescriptorFramePools& frame : frames)
+	{
+		frame.pools.push_back(create_pool());
+	}
+	cache.clear();
+
+	printf("Descriptor allocator creation is  a success \n");
+}
+
+
+void descriptor_allocator::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+		return;
+
+	// The sets are freed with their pools
+	for (DescriptorFramePools& frame : frames)
+	{
+		for (VkDescriptorPool pool : frame.pools)
+		{
+			vkDestroyDescriptorPool(device, pool, allocator);
+		}
+	}
+	for (auto& layout_cache : cache)
+	{
+		for (VkDescriptorPool pool : layout_cache.second.pools.pools)
+		{
+			vkDestroyDescriptorPool(device, pool, allocator);
+		}
+	}
+
+	frames.clear();
+	cache.clear();
+	device = VK_NULL_HANDLE;
+}
+
+
+VkDescriptorPool descriptor_allocator::create_pool()
+{
+	// Descriptors per set of each type, pools are shared by every layout so they hold a mix
+	const std::pair<VkDescriptorType, float> ratios[] = {
+		{ VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+		{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 4.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2.0f },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f }
+	};
+
+	std::vector<VkDescriptorPoolSize> pool_sizes;
+	for (const auto& ratio : ratios)
+	{
+		VkDescriptorPoolSize pool_size = {};
+		pool_size.type = ratio.first;
+		pool_size.descriptorCount = static_cast<uint32_t>(ratio.second * DESCRIPTOR_SETS_PER_POOL);
+		pool_sizes.push_back(pool_size);
+	}
+
+	// No FREE_DESCRIPTOR_SET_BIT, sets only go away with a reset of the whole pool
+	VkDescriptorPoolCreateInfo pool_create_info = {};
+	pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_create_info.flags = 0;
+	pool_create_info.maxSets = DESCRIPTOR_SETS_PER_POOL;
+	pool_create_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+	pool_create_info.pPoolSizes = pool_sizes.data();
+
+	VkDescriptorPool pool;
+	VkResult result = vkCreateDescriptorPool(device, &pool_create_info, allocator, &pool);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create a descriptor pool \n");
+	}
+
+	stats.pool_count++;
+	return pool;
+}
+
+
+VkDescriptorSet descriptor_allocator::allocate_from(DescriptorFramePools* pools, VkDescriptorSetLayout layout)
+{
+	VkDescriptorSetAllocateInfo set_allocate_info = {};
+	set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	set_allocate_info.descriptorSetCount = 1;
+	set_allocate_info.pSetLayouts = &layout;
+
+	// Full pools are skipped until the next reset, a fresh pool is only tried once
+	while (true)
+	{
+		if (pools->current == pools->pools.size())
+		{
+			pools->pools.push_back(create_pool());
+		}
+
+		bool fresh_pool = pools->set_count == 0;
+		set_allocate_info.descriptorPool = pools->pools[pools->current];
+
+		VkDescriptorSet set;
+		VkResult result = vkAllocateDescriptorSets(device, &set_allocate_info, &set);
+
+		if (result == VK_SUCCESS)
+		{
+			pools->set_count++;
+			return set;
+		}
+
+		if ((result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) || fresh_pool)
+		{
+			throw std::runtime_error(" Error: Failed to allocate a descriptor set \n");
+		}
+
+		pools->current++;
+		pools->set_count = 0;
+	}
+}
+
+
+void descriptor_allocator::begin_frame(uint32_t frame_slot)
+{
+	if (device == VK_NULL_HANDLE)
+		return;
+
+	DescriptorFramePools& frame = frames[frame_slot];
+
+	uint32_t used_pools = frame.current + (frame.set_count > 0 ? 1 : 0);
+	for (uint32_t i = 0; i < used_pools; i++)
+	{
+		vkResetDescriptorPool(device, frame.pools[i], 0);
+	}
+
+	frame.current = 0;
+	frame.set_count = 0;
+
+	// Sets of the frame that is about to be recorded
+	stats.frame_sets = 0;
+	current_frame = frame_slot;
+}
+
+
+VkDescriptorSet descriptor_allocator::allocate(VkDescriptorSetLayout layout)
+{
+	stats.frame_sets++;
+	stats.total_frame_sets++;
+
+	return allocate_from(&frames[current_frame], layout);
+}
+
+
+VkDescriptorSet descriptor_allocator::allocate(VkDescriptorSetLayout layout, const DescriptorBinding* bindings, uint32_t binding_count)
+{
+	VkDescriptorSet set = allocate(layout);
+	write(set, bindings, binding_count);
+
+	return set;
+}
+
+
+VkDescriptorSet descriptor_allocator::get_cached(VkDescriptorSetLayout layout, const DescriptorBinding* bindings, uint32_t binding_count)
+{
+	uint64_t hash = hash_bindings(layout, bindings, binding_count);
+
+	// The first set of a layout creates its first pool
+	DescriptorLayoutCache& layout_cache = cache[layout];
+
+	auto cached = layout_cache.sets.find(hash);
+	if (cached != layout_cache.sets.end())
+	{
+		stats.cache_hits++;
+		return cached->second;
+	}
+
+	VkDescriptorSet set = allocate_from(&layout_cache.pools, layout);
+	write(set, bindings, binding_count);
+	layout_cache.sets[hash] = set;
+
+	stats.cache_misses++;
+	stats.cached_sets++;
+
+	return set;
+}
+
+
+void descriptor_allocator::clear_cache(VkDescriptorSetLayout layout)
+{
+	if (device == VK_NULL_HANDLE)
+		return;
+
+	auto layout_cache = cache.find(layout);
+	if (layout_cache == cache.end())
+		return;
+
+	// Pools are kept for the sets cached next with this layout
+	DescriptorFramePools& pools = layout_cache->second.pools;
+	uint32_t used_pools = pools.current + (pools.set_count > 0 ? 1 : 0);
+	for (uint32_t i = 0; i < used_pools; i++)
+	{
+		vkResetDescriptorPool(device, pools.pools[i], 0);
+	}
+
+	pools.current = 0;
+	pools.set_count = 0;
+
+	stats.cached_sets -= static_cast<uint32_t>(layout_cache->second.sets.size());
+	layout_cache->second.sets.clear();
+	stats.cache_clears++;
+}
+
+
+void descriptor_allocator::write(VkDescriptorSet set, const DescriptorBinding* bindings, uint32_t binding_count)
+{
+	// Sets have a handful of bindings, larger ones are written in batches
+	const uint32_t batch_size = 16;
+	VkWriteDescriptorSet writes[batch_size];
+
+	for (uint32_t first = 0; first < binding_count; first += batch_size)
+	{
+		uint32_t count = std::min(batch_size, binding_count - first);
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const DescriptorBinding& binding = bindings[first + i];
+			bool buffer = binding.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER || binding.type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+				|| binding.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || binding.type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+
+			VkWriteDescriptorSet& write = writes[i];
+			write = {};
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = set;
+			write.dstBinding = binding.binding;
+			write.dstArrayElement = 0;
+			write.descriptorCount = 1;
+			write.descriptorType = binding.type;
+			write.pImageInfo = buffer ? nullptr : &binding.image_info;
+			write.pBufferInfo = buffer ? &binding.buffer_info : nullptr;
+		}
+
+		vkUpdateDescriptorSets(device, count, writes, 0, nullptr);
+	}
+}
+
+
+// FNV-1a over the layout and every field that ends up in the descriptors.
+// A 64 bit collision between two live sets is not guarded against
+uint64_t descriptor_allocator::hash_bindings(VkDescriptorSetLayout layout, const DescriptorBinding* bindings, uint32_t binding_count)
+{
+	uint64_t hash = 14695981039346656037ull;
+
+	auto mix = [&hash](uint64_t value) {
+		for (int byte = 0; byte < 8; byte++)
+		{
+			hash ^= (value >> (byte * 8)) & 0xFF;
+			hash *= 1099511628211ull;
+		}
+	};
+
+	mix(reinterpret_cast<uint64_t>(layout));
+
+	for (uint32_t i = 0; i < binding_count; i++)
+	{
+		const DescriptorBinding& binding = bindings[i];
+
+		mix(binding.binding);
+		mix(static_cast<uint64_t>(binding.type));
+		mix(reinterpret_cast<uint64_t>(binding.image_info.sampler));
+		mix(reinterpret_cast<uint64_t>(binding.image_info.imageView));
+		mix(static_cast<uint64_t>(binding.image_info.imageLayout));
+		mix(reinterpret_cast<uint64_t>(binding.buffer_info.buffer));
+		mix(binding.buffer_info.offset);
+		mix(binding.buffer_info.range);
+	}
+
+	return hash;
+}
+
+
+const DescriptorAllocatorStats& descriptor_allocator::get_stats()
+{
+	return stats;
+}
+
+
+void descriptor_allocator::print_stats()
+{
+	printf("Descriptors : %u pools, %u sets last frame, %llu frame sets in total \n",
+		stats.pool_count, stats.frame_sets, (unsigned long long)stats.total_frame_sets);
+	printf("Descriptors : %u cached sets, %llu cache hits, %llu misses, %u cache clears \n",
+		stats.cached_sets, (unsigned long long)stats.cache_hits, (unsigned long long)stats.cache_misses, stats.cache_clears);
+}
@@ -0,0 +1,254 @@
+#include "..\headers\draw_list.h"
+
+#include <cstring>
+#include <cstddef>
+
+draw_list::draw_list()
+{
+}
+
+
+uint64_t draw_list::make_key(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t geometry, uint32_t depth)
+{
+	if (pass >= (1u << DRAW_KEY_PASS_BITS) || pipeline >= (1u << DRAW_KEY_PIPELINE_BITS)
+		|| material >= (1u << DRAW_KEY_MATERIAL_BITS) || geometry >= (1u << DRAW_KEY_GEOMETRY_BITS)
+		|| depth >= (1u << DRAW_KEY_DEPTH_BITS))
+	{
+		throw std::runtime_error(" Error: Draw key field out of range \n");
+	}
+
+	return (static_cast<uint64_t>(pass) << DRAW_KEY_PASS_SHIFT)
+		| (static_cast<uint64_t>(pipeline) << DRAW_KEY_PIPELINE_SHIFT)
+		| (static_cast<uint64_t>(material) << DRAW_KEY_MATERIAL_SHIFT)
+		| (static_cast<uint64_t>(geometry) << DRAW_KEY_GEOMETRY_SHIFT)
+		| (static_cast<uint64_t>(depth) << DRAW_KEY_DEPTH_SHIFT);
+}
+
+
+uint32_t draw_list::make_depth(float view_depth, bool back_to_front)
+{
+	// Bits of a positive float sort the same way as its value
+	if (!(view_depth > 0.0f))
+		view_depth = 0.0f;
+
+	uint32_t bits;
+	memcpy(&bits, &view_depth, sizeof(bits));
+
+	// The top bits keep the sign, the exponent and the leading mantissa bits
+	bits >>= 32 - DRAW_KEY_DEPTH_BITS;
+
+	return back_to_front ? ~bits & ((1u << DRAW_KEY_DEPTH_BITS) - 1) : bits;
+}
+
+
+uint32_t draw_list::get_pass(uint64_t key)
+{
+	return static_cast<uint32_t>(key >> DRAW_KEY_PASS_SHIFT) & ((1u << DRAW_KEY_PASS_BITS) - 1);
+}
+
+
+uint32_t draw_list::get_pipeline(uint64_t key)
+{
+	return static_cast<uint32_t>(key >> DRAW_KEY_PIPELINE_SHIFT) & ((1u << DRAW_KEY_PIPELINE_BITS) - 1);
+}
+
+
+uint32_t draw_list::get_material(uint64_t key)
+{
+	return static_cast<uint32_t>(key >> DRAW_KEY_MATERIAL_SHIFT) & ((1u << DRAW_KEY_MATERIAL_BITS) - 1);
+}
+
+
+uint32_t draw_list::get_geometry(uint64_t key)
+{
+	return static_cast<uint32_t>(key >> DRAW_KEY_GEOMETRY_SHIFT) & ((1u << DRAW_KEY_GEOMETRY_BITS) - 1);
+}
+
+
+void draw_list::clear()
+{
+	items.clear();
+}
+
+
+void draw_list::add(uint64_t key, uint32_t object)
+{
+	items.push_back({ key, object });
+}
+
+
+void draw_list::radix_sort()
+{
+	size_t count = items.size();
+	scratch.resize(count);
+
+	DrawItem* source = items.data();
+	DrawItem* destination = scratch.data();
+
+	// Least significant byte first, eight passes of a stable counting sort
+	for (uint32_t shift = 0; shift < 64; shift += 8)
+	{
+		uint32_t histogram[256] = {};
+		for (size_t i = 0; i < count; i++)
+		{
+			histogram[(source[i].key >> shift) & 0xFF]++;
+		}
+
+		// Every key has the same byte here, the pass would not move anything
+		if (histogram[(source[0].key >> shift) & 0xFF] == count)
+			continue;
+
+		uint32_t offset = 0;
+		for (uint32_t digit = 0; digit < 256; digit++)
+		{
+			uint32_t digit_count = histogram[digit];
+			histogram[digit] = offset;
+			offset += digit_count;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			destination[histogram[(source[i].key >> shift) & 0xFF]++] = source[i];
+		}
+
+		std::swap(source, destination);
+	}
+
+	if (source != items.data())
+	{
+		items.swap(scratch);
+	}
+}
+
+
+void draw_list::sort()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	if (sort_enabled && items.size() > 1)
+	{
+		radix_sort();
+	}
+
+	stats.sort_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+
+void draw_list::set_sort_enabled(bool enabled)
+{
+	sort_enabled = enabled;
+}
+
+
+void draw_list::record(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, const std::vector<VkPipeline>& pipelines,
+	const std::vector<DrawPushConstants>& materials, const std::vector<DrawGeometry>& geometries)
+{
+	stats.draw_count = static_cast<uint32_t>(items.size());
+	stats.triangle_count = 0;
+	stats.batch_count = 0;
+	stats.pipeline_binds = 0;
+	stats.material_binds = 0;
+
+	const VkShaderStageFlags push_stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	// Materials own the start of the push constants, geometries the rest
+	const uint32_t geometry_constants_offset = offsetof(DrawPushConstants, vertex_buffer_index);
+
+	uint32_t bound_pipeline = ~0u;
+	uint32_t bound_material = ~0u;
+	uint32_t bound_geometry = ~0u;
+	VkBuffer bound_index_buffer = VK_NULL_HANDLE;
+	VkDeviceSize bound_index_offset = 0;
+
+	uint32_t i = 0;
+	while (i < items.size())
+	{
+		uint32_t pipeline = get_pipeline(items[i].key);
+		uint32_t material = get_material(items[i].key);
+		uint32_t geometry = get_geometry(items[i].key);
+
+		if (pipeline != bound_pipeline)
+		{
+			if (pipeline >= pipelines.size())
+			{
+				throw std::runtime_error(" Error: Draw uses an unknown pipeline \n");
+			}
+
+			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[pipeline]);
+			bound_pipeline = pipeline;
+			stats.pipeline_binds++;
+		}
+
+		if (material != bound_material)
+		{
+			if (material >= materials.size())
+			{
+				throw std::runtime_error(" Error: Draw uses an unknown material \n");
+			}
+
+			vkCmdPushConstants(command_buffer, pipeline_layout, push_stages, 0, geometry_constants_offset, &materials[material]);
+			bound_material = material;
+			stats.material_binds++;
+		}
+
+		if (geometry >= geometries.size())
+		{
+			throw std::runtime_error(" Error: Draw uses an unknown geometry \n");
+		}
+
+		const DrawGeometry& draw_geometry = geometries[geometry];
+
+		if (geometry != bound_geometry)
+		{
+			DrawPushConstants geometry_constants = {};
+			geometry_constants.vertex_buffer_index = draw_geometry.vertex_buffer;
+			memcpy(geometry_constants.uv_offset, draw_geometry.uv_offset, sizeof(geometry_constants.uv_offset));
+			memcpy(geometry_constants.uv_scale, draw_geometry.uv_scale, sizeof(geometry_constants.uv_scale));
+
+			vkCmdPushConstants(command_buffer, pipeline_layout, push_stages, geometry_constants_offset,
+				sizeof(DrawPushConstants) - geometry_constants_offset,
+				reinterpret_cast<const uint8_t*>(&geometry_constants) + geometry_constants_offset);
+			bound_geometry = geometry;
+		}
+
+		if (draw_geometry.index_buffer != VK_NULL_HANDLE
+			&& (draw_geometry.index_buffer != bound_index_buffer || draw_geometry.index_buffer_offset != bound_index_offset))
+		{
+			vkCmdBindIndexBuffer(command_buffer, draw_geometry.index_buffer, draw_geometry.index_buffer_offset, VK_INDEX_TYPE_UINT32);
+			bound_index_buffer = draw_geometry.index_buffer;
+			bound_index_offset = draw_geometry.index_buffer_offset;
+		}
+
+		// Following draws with the same state only differ by their instance slot
+		uint32_t first = i;
+		const uint64_t state_mask = ~((1ull << DRAW_KEY_GEOMETRY_SHIFT) - 1);
+		while (i < items.size() && (items[i].key & state_mask) == (items[first].key & state_mask))
+		{
+			i++;
+		}
+
+		if (draw_geometry.index_buffer != VK_NULL_HANDLE)
+		{
+			vkCmdDrawIndexed(command_buffer, draw_geometry.index_count, i - first, draw_geometry.first_index, 0, first);
+			stats.triangle_count += draw_geometry.index_count / 3 * (i - first);
+		}
+		else
+		{
+			vkCmdDraw(command_buffer, draw_geometry.vertex_count, i - first, 0, first);
+			stats.triangle_count += draw_geometry.vertex_count / 3 * (i - first);
+		}
+		stats.batch_count++;
+	}
+}
+
+
+const std::vector<DrawItem>& draw_list::get_items()
+{
+	return items;
+}
+
+
+const DrawListStats& draw_list::get_stats()
+{
+	return stats;
+}
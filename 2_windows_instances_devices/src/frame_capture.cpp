@@ -0,0 +1,476 @@
+#include "..\headers\frame_capture.h"
+
+#include <chrono>
+#include <fstream>
+
+// Slots of the ring, three cover both frames in flight plus one being written
+const uint32_t CAPTURE_DEFAULT_SLOTS = 3;
+
+frame_capture::frame_capture()
+{
+}
+
+
+bool frame_capture::is_format_supported(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+		return true;
+	default:
+		return false;
+	}
+}
+
+
+void frame_capture::init(VkPhysicalDevice new_physical_device, VkDevice new_device, VkExtent2D new_extent, VkFormat new_format,
+	uint32_t new_slot_count, memory_tracker* new_tracker, const VkAllocationCallbacks* new_allocator)
+{
+	if (!is_format_supported(new_format))
+	{
+		throw std::runtime_error(" Error: Frame capture only supports 8 bit RGBA and BGRA formats \n");
+	}
+
+	physical_device = new_physical_device;
+	device = new_device;
+	extent = new_extent;
+	format = new_format;
+	slot_count = new_slot_count > 0 ? new_slot_count : CAPTURE_DEFAULT_SLOTS;
+	tracker = new_tracker;
+	allocator = new_allocator;
+
+	printf("Frame capture creation is  a success \n");
+}
+
+
+void frame_capture::create_slots()
+{
+	VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+
+	slots.resize(slot_count);
+	for (CaptureSlot& slot : slots)
+	{
+		VkBufferCreateInfo buffer_create_info = {};
+		buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		buffer_create_info.size = size;
+		buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkResult result = vkCreateBuffer(device, &buffer_create_info, allocator, &slot.buffer);
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(" Error: Failed to create a capture buffer \n");
+		}
+
+		VkMemoryRequirements memory_requirements;
+		vkGetBufferMemoryRequirements(device, slot.buffer, &memory_requirements);
+
+		// Cached memory makes the reads on the writer thread fast, uncached memory is read at bus speed
+		uint32_t memory_type;
+		try
+		{
+			memory_type = find_memory_type_index(physical_device, memory_requirements.memoryTypeBits,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+		}
+		catch (const std::runtime_error&)
+		{
+			memory_type = find_memory_type_index(physical_device, memory_requirements.memoryTypeBits,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		}
+
+		VkMemoryAllocateInfo allocate_info = {};
+		allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocate_info.allocationSize = memory_requirements.size;
+		allocate_info.memoryTypeIndex = memory_type;
+
+		result = tracker->allocate(&allocate_info, &slot.memory, "frame capture");
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(" Error: Failed to allocate capture memory \n");
+		}
+
+		vkBindBufferMemory(device, slot.buffer, slot.memory, 0);
+		tracker->add_bound_bytes(slot.memory, size);
+
+		// Stays mapped for the lifetime of the slot
+		result = vkMapMemory(device, slot.memory, 0, VK_WHOLE_SIZE, 0, &slot.mapped);
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(" Error: Failed to map capture memory \n");
+		}
+	}
+}
+
+
+void frame_capture::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+		return;
+
+	// The device is idle, so copies of frames that were never reported complete are done too
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (uint32_t s = 0; s < slots.size(); s++)
+		{
+			if (slots[s].state == CaptureSlotState::pending)
+			{
+				VkMappedMemoryRange range = {};
+				range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+				range.memory = slots[s].memory;
+				range.offset = 0;
+				range.size = VK_WHOLE_SIZE;
+				vkInvalidateMappedMemoryRanges(device, 1, &range);
+
+				slots[s].state = CaptureSlotState::writing;
+				ready_slots.push_back(s);
+			}
+		}
+	}
+	ready_condition.notify_one();
+
+	flush();
+
+	if (writer.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		ready_condition.notify_one();
+		writer.join();
+	}
+
+	for (CaptureSlot& slot : slots)
+	{
+		vkUnmapMemory(device, slot.memory);
+		vkDestroyBuffer(device, slot.buffer, allocator);
+		tracker->free(slot.memory);
+	}
+	slots.clear();
+
+	capturing = false;
+	stopping = false;
+	device = VK_NULL_HANDLE;
+}
+
+
+void frame_capture::set_consumer(CaptureConsumer new_consumer)
+{
+	if (writer.joinable())
+	{
+		throw std::runtime_error(" Error: The capture consumer can not change once capturing started \n");
+	}
+
+	consumer = std::move(new_consumer);
+}
+
+
+void frame_capture::start(uint64_t frame_count)
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		throw std::runtime_error(" Error: Frame capture is not available for this swap chain \n");
+	}
+
+	if (!consumer)
+	{
+		throw std::runtime_error(" Error: Frame capture started without a consumer \n");
+	}
+
+	if (slots.empty())
+	{
+		create_slots();
+	}
+
+	if (!writer.joinable())
+	{
+		writer = std::thread([this] { writer_loop(); });
+	}
+
+	frames_left = frame_count;
+	capturing = true;
+}
+
+
+void frame_capture::stop()
+{
+	capturing = false;
+}
+
+
+bool frame_capture::is_capturing()
+{
+	return capturing;
+}
+
+
+void frame_capture::record(VkCommandBuffer command_buffer, VkImage image, VkImageLayout layout, uint32_t frame_slot)
+{
+	if (!capturing)
+		return;
+
+	uint32_t slot_index = 0;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		bool found = false;
+		for (uint32_t i = 0; i < slots.size() && !found; i++)
+		{
+			slot_index = (next_slot + i) % slot_count;
+			found = slots[slot_index].state == CaptureSlotState::free;
+		}
+
+		// The writer is behind, skip the frame rather than wait for it
+		if (!found)
+		{
+			stats.dropped++;
+			return;
+		}
+
+		slots[slot_index].state = CaptureSlotState::pending;
+		slots[slot_index].frame_slot = frame_slot;
+		slots[slot_index].frame_number = frame_number++;
+		stats.captured++;
+	}
+	next_slot = (slot_index + 1) % slot_count;
+
+	if (frames_left > 0 && --frames_left == 0)
+	{
+		capturing = false;
+	}
+
+	CaptureSlot& slot = slots[slot_index];
+
+	VkImageMemoryBarrier image_barrier = {};
+	image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	// The last pass of the graph may draw or blit to the backbuffer
+	image_barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	image_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	image_barrier.oldLayout = layout;
+	image_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	image_barrier.image = image;
+	image_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	image_barrier.subresourceRange.baseMipLevel = 0;
+	image_barrier.subresourceRange.levelCount = 1;
+	image_barrier.subresourceRange.baseArrayLayer = 0;
+	image_barrier.subresourceRange.layerCount = 1;
+
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_barrier);
+
+	VkBufferImageCopy copy_region = {};
+	copy_region.bufferOffset = 0;
+	copy_region.bufferRowLength = 0;
+	copy_region.bufferImageHeight = 0;
+	copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	copy_region.imageSubresource.mipLevel = 0;
+	copy_region.imageSubresource.baseArrayLayer = 0;
+	copy_region.imageSubresource.layerCount = 1;
+	copy_region.imageOffset = { 0, 0, 0 };
+	copy_region.imageExtent = { extent.width, extent.height, 1 };
+
+	vkCmdCopyImageToBuffer(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &copy_region);
+
+	// Presentation waits on the semaphore, which covers every stage
+	image_barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	image_barrier.dstAccessMask = 0;
+	image_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	image_barrier.newLayout = layout;
+
+	VkBufferMemoryBarrier buffer_barrier = {};
+	buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	buffer_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	buffer_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	buffer_barrier.buffer = slot.buffer;
+	buffer_barrier.offset = 0;
+	buffer_barrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+		0, 0, nullptr, 1, &buffer_barrier, 1, &image_barrier);
+}
+
+
+void frame_capture::frame_complete(uint32_t frame_slot)
+{
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (uint32_t s = 0; s < slots.size(); s++)
+		{
+			if (slots[s].state != CaptureSlotState::pending || slots[s].frame_slot != frame_slot)
+				continue;
+
+			// No-op on coherent memory
+			VkMappedMemoryRange range = {};
+			range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			range.memory = slots[s].memory;
+			range.offset = 0;
+			range.size = VK_WHOLE_SIZE;
+			vkInvalidateMappedMemoryRanges(device, 1, &range);
+
+			slots[s].state = CaptureSlotState::writing;
+			ready_slots.push_back(s);
+			queued = true;
+		}
+	}
+
+	if (queued)
+	{
+		ready_condition.notify_one();
+	}
+}
+
+
+void frame_capture::writer_loop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true)
+	{
+		ready_condition.wait(lock, [this] { return stopping || !ready_slots.empty(); });
+
+		if (ready_slots.empty())
+			break;
+
+		uint32_t slot_index = ready_slots.front();
+		ready_slots.pop_front();
+
+		CaptureFrame frame;
+		frame.frame_number = slots[slot_index].frame_number;
+		frame.width = extent.width;
+		frame.height = extent.height;
+		frame.format = format;
+		frame.bgra = format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+		frame.pixels = static_cast<const uint8_t*>(slots[slot_index].mapped);
+
+		// The render thread only takes free slots, this one is safe to read unlocked
+		lock.unlock();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		try
+		{
+			consumer(frame);
+		}
+		catch (const std::runtime_error& e)
+		{
+			printf("ERROR : %s \n", e.what());
+		}
+		double consumer_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		lock.lock();
+
+		slots[slot_index].state = CaptureSlotState::free;
+		stats.written++;
+		stats.consumer_ms += consumer_ms;
+
+		idle_condition.notify_all();
+	}
+}
+
+
+void frame_capture::flush()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	idle_condition.wait(lock, [this] {
+		for (const CaptureSlot& slot : slots)
+		{
+			if (slot.state == CaptureSlotState::writing)
+				return false;
+		}
+		return true;
+	});
+}
+
+
+const CaptureStats& frame_capture::get_stats()
+{
+	return stats;
+}
+
+
+void frame_capture::print_stats()
+{
+	if (stats.captured == 0 && stats.dropped == 0)
+		return;
+
+	printf("Frame capture : %llu captured, %llu written, %llu dropped, consumer %.2f ms per frame \n",
+		static_cast<unsigned long long>(stats.captured), static_cast<unsigned long long>(stats.written),
+		static_cast<unsigned long long>(stats.dropped),
+		stats.written > 0 ? stats.consumer_ms / stats.written : 0.0);
+}
+
+
+CaptureConsumer frame_capture::ppm_writer(const std::string& prefix)
+{
+	// Reused between frames, only the writer thread touches it
+	auto row = std::make_shared<std::vector<uint8_t>>();
+
+	return [prefix, row](const CaptureFrame& frame)
+	{
+		char file_name[32];
+		snprintf(file_name, sizeof(file_name), "_%05llu.ppm", static_cast<unsigned long long>(frame.frame_number));
+
+		std::string path = prefix + file_name;
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+		if (!file.is_open())
+		{
+			std::string error_msg(" Error: Failed to open " + path + " \n");
+			throw std::runtime_error(error_msg.c_str());
+		}
+
+		file << "P6\n" << frame.width << " " << frame.height << "\n255\n";
+
+		// PPM is packed RGB, alpha is dropped and BGRA swapped
+		row->resize(static_cast<size_t>(frame.width) * 3);
+		int red = frame.bgra ? 2 : 0;
+		int blue = frame.bgra ? 0 : 2;
+
+		for (uint32_t y = 0; y < frame.height; y++)
+		{
+			const uint8_t* source = frame.pixels + static_cast<size_t>(y) * frame.width * 4;
+			uint8_t* target = row->data();
+
+			for (uint32_t x = 0; x < frame.width; x++)
+			{
+				target[x * 3 + 0] = source[x * 4 + red];
+				target[x * 3 + 1] = source[x * 4 + 1];
+				target[x * 3 + 2] = source[x * 4 + blue];
+			}
+
+			file.write(reinterpret_cast<const char*>(row->data()), row->size());
+		}
+	};
+}
+
+
+CaptureConsumer frame_capture::raw_writer(const std::string& file_name)
+{
+	// Shared by the copies of the consumer, closed when the last one goes away
+	auto file = std::make_shared<std::ofstream>(file_name, std::ios::binary | std::ios::trunc);
+
+	if (!file->is_open())
+	{
+		std::string error_msg(" Error: Failed to open " + file_name + " \n");
+		throw std::runtime_error(error_msg.c_str());
+	}
+
+	// Frames are appended as is, e.g. ffmpeg -f rawvideo -pixel_format bgra -video_size WxH -i file
+	return [file](const CaptureFrame& frame)
+	{
+		file->write(reinterpret_cast<const char*>(frame.pixels), static_cast<std::streamsize>(frame.width) * frame.height * 4);
+	};
+}
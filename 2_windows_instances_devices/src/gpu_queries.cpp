@@ -0,0 +1,319 @@
+#include "..\headers\gpu_queries.h"
+
+#include <algorithm>
+#include <iterator>
+
+// Result order follows the bits, lowest first, which is the order of QueryStatistic
+const VkQueryPipelineStatisticFlags QUERY_STATISTIC_FLAGS =
+	VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+gpu_queries::gpu_queries()
+{
+}
+
+
+VkPhysicalDeviceFeatures gpu_queries::get_optional_features(VkPhysicalDevice physical_device)
+{
+	VkPhysicalDeviceFeatures supported_features;
+	vkGetPhysicalDeviceFeatures(physical_device, &supported_features);
+
+	VkPhysicalDeviceFeatures features = {};
+	features.pipelineStatisticsQuery = supported_features.pipelineStatisticsQuery;
+	features.occlusionQueryPrecise = supported_features.occlusionQueryPrecise;
+
+	return features;
+}
+
+
+void gpu_queries::init(VkDevice new_device, const VkPhysicalDeviceFeatures& enabled_features, uint32_t frame_count,
+	uint32_t queries_per_frame, const VkAllocationCallbacks* new_allocator)
+{
+	device = new_device;
+	allocator = new_allocator;
+	statistics_supported = enabled_features.pipelineStatisticsQuery == VK_TRUE;
+	precise_occlusion = enabled_features.occlusionQueryPrecise == VK_TRUE;
+	max_queries = queries_per_frame;
+
+	frames.resize(frame_count);
+	for (GpuQueryFrame& frame : frames)
+	{
+		VkQueryPoolCreateInfo pool_create_info = {};
+		pool_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		pool_create_info.queryType = VK_QUERY_TYPE_OCCLUSION;
+		pool_create_info.queryCount = max_queries;
+
+		VkResult result = vkCreateQueryPool(device, &pool_create_info, allocator, &frame.occlusion_pool);
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(" Error: Failed to create an occlusion query pool \n");
+		}
+
+		if (statistics_supported)
+		{
+			pool_create_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+			pool_create_info.pipelineStatistics = QUERY_STATISTIC_FLAGS;
+
+			result = vkCreateQueryPool(device, &pool_create_info, allocator, &frame.statistics_pool);
+
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error(" Error: Failed to create a pipeline statistics query pool \n");
+			}
+		}
+	}
+
+	// One availability word after the values of each query
+	results.resize(static_cast<size_t>(max_queries) * (QUERY_STATISTIC_COUNT + 1));
+
+	printf("GPU query pools creation is  a success \n");
+}
+
+
+void gpu_queries::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+		return;
+
+	for (GpuQueryFrame& frame : frames)
+	{
+		vkDestroyQueryPool(device, frame.occlusion_pool, allocator);
+		if (frame.statistics_pool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(device, frame.statistics_pool, allocator);
+		}
+	}
+	frames.clear();
+
+	recording = false;
+	device = VK_NULL_HANDLE;
+}
+
+
+void gpu_queries::set_enabled(bool enable)
+{
+	enabled = enable;
+}
+
+
+bool gpu_queries::is_enabled()
+{
+	return enabled;
+}
+
+
+bool gpu_queries::has_pipeline_statistics()
+{
+	return statistics_supported;
+}
+
+
+uint32_t gpu_queries::add_region(const std::string& name)
+{
+	GpuQueryRegion region;
+	region.name = name;
+
+	regions.push_back(region);
+	return static_cast<uint32_t>(regions.size() - 1);
+}
+
+
+void gpu_queries::resolve_frame(GpuQueryFrame& frame)
+{
+	uint32_t query_count = static_cast<uint32_t>(frame.regions.size());
+
+	std::vector<bool> seen(regions.size(), false);
+	std::vector<bool> available(query_count, true);
+
+	// Without the wait bit this returns VK_NOT_READY instead of blocking, the availability words say which ones are missing
+	const uint32_t occlusion_stride = 2;
+	vkGetQueryPoolResults(device, frame.occlusion_pool, 0, query_count, results.size() * sizeof(uint64_t), results.data(),
+		occlusion_stride * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+	std::vector<uint64_t> samples(query_count);
+	for (uint32_t q = 0; q < query_count; q++)
+	{
+		samples[q] = results[q * occlusion_stride];
+		available[q] = available[q] && results[q * occlusion_stride + 1] != 0;
+	}
+
+	std::vector<uint64_t> statistics(static_cast<size_t>(query_count) * QUERY_STATISTIC_COUNT, 0);
+	if (frame.statistics_pool != VK_NULL_HANDLE)
+	{
+		const uint32_t statistics_stride = QUERY_STATISTIC_COUNT + 1;
+		vkGetQueryPoolResults(device, frame.statistics_pool, 0, query_count, results.size() * sizeof(uint64_t), results.data(),
+			statistics_stride * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+		for (uint32_t q = 0; q < query_count; q++)
+		{
+			for (uint32_t s = 0; s < QUERY_STATISTIC_COUNT; s++)
+			{
+				statistics[q * QUERY_STATISTIC_COUNT + s] = results[q * statistics_stride + s];
+			}
+			available[q] = available[q] && results[q * statistics_stride + QUERY_STATISTIC_COUNT] != 0;
+		}
+	}
+
+	for (uint32_t q = 0; q < query_count; q++)
+	{
+		if (!available[q])
+		{
+			stats.unavailable_queries++;
+			continue;
+		}
+
+		GpuQueryRegion& region = regions[frame.regions[q]];
+		if (!seen[frame.regions[q]])
+		{
+			seen[frame.regions[q]] = true;
+			std::fill(std::begin(region.statistics), std::end(region.statistics), 0);
+			region.samples_passed = 0;
+			region.frame_count++;
+		}
+
+		for (uint32_t s = 0; s < QUERY_STATISTIC_COUNT; s++)
+		{
+			region.statistics[s] += statistics[q * QUERY_STATISTIC_COUNT + s];
+			region.total_statistics[s] += statistics[q * QUERY_STATISTIC_COUNT + s];
+		}
+		region.samples_passed += samples[q];
+		region.total_samples_passed += samples[q];
+	}
+
+	stats.resolved_frames++;
+	frame.regions.clear();
+}
+
+
+void gpu_queries::begin_frame(VkCommandBuffer command_buffer, uint32_t frame_slot)
+{
+	if (device == VK_NULL_HANDLE)
+		return;
+
+	current_frame = frame_slot;
+	GpuQueryFrame& frame = frames[current_frame];
+
+	// The fence of this slot was waited on, so everything recorded into it has finished
+	if (!frame.regions.empty())
+	{
+		resolve_frame(frame);
+	}
+
+	recording = enabled;
+	if (!recording)
+		return;
+
+	vkCmdResetQueryPool(command_buffer, frame.occlusion_pool, 0, max_queries);
+	if (frame.statistics_pool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(command_buffer, frame.statistics_pool, 0, max_queries);
+	}
+}
+
+
+void gpu_queries::begin_region(VkCommandBuffer command_buffer, uint32_t region)
+{
+	if (!recording)
+		return;
+
+	if (active_query >= 0)
+	{
+		throw std::runtime_error(" Error: Query regions can not nest \n");
+	}
+
+	GpuQueryFrame& frame = frames[current_frame];
+	if (frame.regions.size() >= max_queries)
+	{
+		stats.overflowed_queries++;
+		return;
+	}
+
+	active_query = static_cast<int>(frame.regions.size());
+	frame.regions.push_back(region);
+
+	uint32_t query = static_cast<uint32_t>(active_query);
+
+	// Without the precise bit an occlusion query may only report zero or non zero
+	vkCmdBeginQuery(command_buffer, frame.occlusion_pool, query, precise_occlusion ? VK_QUERY_CONTROL_PRECISE_BIT : 0);
+	if (frame.statistics_pool != VK_NULL_HANDLE)
+	{
+		vkCmdBeginQuery(command_buffer, frame.statistics_pool, query, 0);
+	}
+}
+
+
+void gpu_queries::end_region(VkCommandBuffer command_buffer)
+{
+	if (active_query < 0)
+		return;
+
+	GpuQueryFrame& frame = frames[current_frame];
+	uint32_t query = static_cast<uint32_t>(active_query);
+
+	if (frame.statistics_pool != VK_NULL_HANDLE)
+	{
+		vkCmdEndQuery(command_buffer, frame.statistics_pool, query);
+	}
+	vkCmdEndQuery(command_buffer, frame.occlusion_pool, query);
+
+	active_query = -1;
+}
+
+
+const std::vector<GpuQueryRegion>& gpu_queries::get_regions()
+{
+	return regions;
+}
+
+
+const GpuQueryStats& gpu_queries::get_stats()
+{
+	return stats;
+}
+
+
+void gpu_queries::print_stats(uint64_t pixel_count)
+{
+	if (stats.resolved_frames == 0)
+		return;
+
+	printf("GPU queries : %llu frames resolved, %llu unavailable, %llu overflowed, %s \n",
+		static_cast<unsigned long long>(stats.resolved_frames), static_cast<unsigned long long>(stats.unavailable_queries),
+		static_cast<unsigned long long>(stats.overflowed_queries),
+		statistics_supported ? "pipeline statistics" : "occlusion only");
+
+	for (const GpuQueryRegion& region : regions)
+	{
+		if (region.frame_count == 0)
+			continue;
+
+		double frames_resolved = static_cast<double>(region.frame_count);
+		double average[QUERY_STATISTIC_COUNT];
+		for (uint32_t s = 0; s < QUERY_STATISTIC_COUNT; s++)
+		{
+			average[s] = region.total_statistics[s] / frames_resolved;
+		}
+		double samples = region.total_samples_passed / frames_resolved;
+
+		printf("  %-12s samples passed %.0f (%.2f per pixel%s) \n", region.name.c_str(), samples,
+			pixel_count > 0 ? samples / pixel_count : 0.0, precise_occlusion ? "" : ", not precise");
+
+		if (!statistics_supported)
+			continue;
+
+		printf("  %-12s vertices %.0f, primitives %.0f, vertex shader %.0f \n", "",
+			average[QUERY_STATISTIC_INPUT_VERTICES], average[QUERY_STATISTIC_INPUT_PRIMITIVES],
+			average[QUERY_STATISTIC_VERTEX_INVOCATIONS]);
+		printf("  %-12s clipping in %.0f, out %.0f, fragment shader %.0f (%.2f per pixel), compute %.0f \n", "",
+			average[QUERY_STATISTIC_CLIPPING_INVOCATIONS], average[QUERY_STATISTIC_CLIPPING_PRIMITIVES],
+			average[QUERY_STATISTIC_FRAGMENT_INVOCATIONS],
+			pixel_count > 0 ? average[QUERY_STATISTIC_FRAGMENT_INVOCATIONS] / pixel_count : 0.0,
+			average[QUERY_STATISTIC_COMPUTE_INVOCATIONS]);
+	}
+}
@@ -0,0 +1,268 @@
+#include "..\headers\host_allocator.h"
+
+static const char* scope_names[HOST_ALLOCATION_SCOPE_COUNT] = { "command", "object", "cache", "device", "instance" };
+
+host_allocator::host_allocator()
+{
+}
+
+
+host_allocator::~host_allocator()
+{
+	// Chunks outlive every object created with the callbacks, so they are only released here
+	for (void* chunk : chunks)
+	{
+		std::free(chunk);
+	}
+}
+
+
+void host_allocator::init(HostAllocatorMode new_mode)
+{
+	mode = new_mode;
+
+	callbacks = {};
+	callbacks.pUserData = this;
+	callbacks.pfnAllocation = allocation_callback;
+	callbacks.pfnReallocation = reallocation_callback;
+	callbacks.pfnFree = free_callback;
+	callbacks.pfnInternalAllocation = internal_allocation_callback;
+	callbacks.pfnInternalFree = internal_free_callback;
+}
+
+
+const VkAllocationCallbacks* host_allocator::get_callbacks()
+{
+	return mode == HostAllocatorMode::system ? nullptr : &callbacks;
+}
+
+
+HostAllocatorMode host_allocator::get_mode()
+{
+	return mode;
+}
+
+
+void* host_allocator::allocate_block(uint32_t size_class)
+{
+	if (!free_blocks[size_class].empty())
+	{
+		void* block = free_blocks[size_class].back();
+		free_blocks[size_class].pop_back();
+		return block;
+	}
+
+	size_t block_size = static_cast<size_t>(1) << (size_class + min_class_shift);
+
+	if (chunk_remaining < block_size)
+	{
+		// The tail of the old chunk is left unused, it is smaller than the block anyway
+		chunk_cursor = static_cast<char*>(std::malloc(chunk_size));
+		if (chunk_cursor == nullptr)
+			return nullptr;
+
+		chunks.push_back(chunk_cursor);
+		chunk_remaining = chunk_size;
+		stats.arena_chunk_count++;
+	}
+
+	void* block = chunk_cursor;
+	chunk_cursor += block_size;
+	chunk_remaining -= block_size;
+
+	return block;
+}
+
+
+void* host_allocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	if (size == 0)
+		return nullptr;
+
+	if (alignment < alignof(HostAllocationHeader))
+		alignment = alignof(HostAllocationHeader);
+
+	// Room for the header plus the worst case alignment padding
+	size_t total_size = size + alignment + sizeof(HostAllocationHeader);
+
+	std::lock_guard<std::mutex> lock(allocator_mutex);
+
+	uint32_t size_class = system_class;
+	if (mode == HostAllocatorMode::arena
+		&& (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND || scope == VK_SYSTEM_ALLOCATION_SCOPE_OBJECT))
+	{
+		for (uint32_t i = 0; i < class_count; i++)
+		{
+			if (total_size <= (static_cast<size_t>(1) << (i + min_class_shift)))
+			{
+				size_class = i;
+				break;
+			}
+		}
+	}
+
+	void* block = size_class == system_class ? std::malloc(total_size) : allocate_block(size_class);
+	if (block == nullptr)
+		return nullptr;
+
+	uintptr_t user_address = reinterpret_cast<uintptr_t>(block) + sizeof(HostAllocationHeader);
+	user_address = (user_address + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+
+	HostAllocationHeader* header = reinterpret_cast<HostAllocationHeader*>(user_address) - 1;
+	header->block = block;
+	header->size = size;
+	header->scope = static_cast<uint32_t>(scope);
+	header->size_class = size_class;
+
+	HostScopeStats& scope_stats = stats.scopes[scope];
+	scope_stats.allocation_count++;
+	scope_stats.total_bytes += size;
+	scope_stats.current_bytes += size;
+	scope_stats.peak_bytes = std::max(scope_stats.peak_bytes, scope_stats.current_bytes);
+
+	if (size_class != system_class)
+		stats.arena_allocation_count++;
+
+	return reinterpret_cast<void*>(user_address);
+}
+
+
+void* host_allocator::reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	if (original == nullptr)
+		return allocate(size, alignment, scope);
+
+	if (size == 0)
+	{
+		release(original);
+		return nullptr;
+	}
+
+	size_t original_size = (reinterpret_cast<HostAllocationHeader*>(original) - 1)->size;
+
+	void* memory = allocate(size, alignment, scope);
+	if (memory == nullptr)
+		return nullptr;
+
+	memcpy(memory, original, std::min(original_size, size));
+	release(original);
+
+	std::lock_guard<std::mutex> lock(allocator_mutex);
+	stats.scopes[scope].reallocation_count++;
+
+	return memory;
+}
+
+
+void host_allocator::release(void* memory)
+{
+	if (memory == nullptr)
+		return;
+
+	HostAllocationHeader* header = reinterpret_cast<HostAllocationHeader*>(memory) - 1;
+
+	std::lock_guard<std::mutex> lock(allocator_mutex);
+
+	HostScopeStats& scope_stats = stats.scopes[header->scope];
+	scope_stats.free_count++;
+	scope_stats.current_bytes -= header->size;
+
+	if (header->size_class == system_class)
+		std::free(header->block);
+	else
+		free_blocks[header->size_class].push_back(header->block);
+}
+
+
+VKAPI_ATTR void* VKAPI_CALL host_allocator::allocation_callback(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	return static_cast<host_allocator*>(user_data)->allocate(size, alignment, scope);
+}
+
+
+VKAPI_ATTR void* VKAPI_CALL host_allocator::reallocation_callback(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	return static_cast<host_allocator*>(user_data)->reallocate(original, size, alignment, scope);
+}
+
+
+VKAPI_ATTR void VKAPI_CALL host_allocator::free_callback(void* user_data, void* memory)
+{
+	static_cast<host_allocator*>(user_data)->release(memory);
+}
+
+
+VKAPI_ATTR void VKAPI_CALL host_allocator::internal_allocation_callback(void* user_data, size_t size, VkInternalAllocationType, VkSystemAllocationScope)
+{
+	host_allocator* allocator = static_cast<host_allocator*>(user_data);
+
+	std::lock_guard<std::mutex> lock(allocator->allocator_mutex);
+	allocator->stats.internal_allocation_count++;
+	allocator->stats.internal_bytes += size;
+}
+
+
+VKAPI_ATTR void VKAPI_CALL host_allocator::internal_free_callback(void* user_data, size_t size, VkInternalAllocationType, VkSystemAllocationScope)
+{
+	host_allocator* allocator = static_cast<host_allocator*>(user_data);
+
+	std::lock_guard<std::mutex> lock(allocator->allocator_mutex);
+	allocator->stats.internal_bytes -= size;
+}
+
+
+HostAllocatorStats host_allocator::get_stats()
+{
+	std::lock_guard<std::mutex> lock(allocator_mutex);
+	return stats;
+}
+
+
+void host_allocator::reset_counters()
+{
+	// Live byte counts are kept, only the call counters start over
+	std::lock_guard<std::mutex> lock(allocator_mutex);
+
+	for (HostScopeStats& scope_stats : stats.scopes)
+	{
+		scope_stats.allocation_count = 0;
+		scope_stats.reallocation_count = 0;
+		scope_stats.free_count = 0;
+		scope_stats.total_bytes = 0;
+		scope_stats.peak_bytes = scope_stats.current_bytes;
+	}
+	stats.internal_allocation_count = 0;
+	stats.arena_allocation_count = 0;
+}
+
+
+void host_allocator::print_stats()
+{
+	if (mode == HostAllocatorMode::system)
+	{
+		printf("Host allocator : driver default, no statistics \n");
+		return;
+	}
+
+	HostAllocatorStats current = get_stats();
+
+	printf("Host allocator : %s mode \n", mode == HostAllocatorMode::arena ? "arena" : "tracking");
+
+	for (uint32_t i = 0; i < HOST_ALLOCATION_SCOPE_COUNT; i++)
+	{
+		const HostScopeStats& scope_stats = current.scopes[i];
+		printf("Host allocator : %-8s %llu allocs, %llu reallocs, %llu frees, %llu bytes total, %lld live, %lld peak \n",
+			scope_names[i], (unsigned long long)scope_stats.allocation_count, (unsigned long long)scope_stats.reallocation_count,
+			(unsigned long long)scope_stats.free_count, (unsigned long long)scope_stats.total_bytes,
+			(long long)scope_stats.current_bytes, (long long)scope_stats.peak_bytes);
+	}
+
+	printf("Host allocator : %llu internal driver allocations, %lld bytes live \n",
+		(unsigned long long)current.internal_allocation_count, (long long)current.internal_bytes);
+
+	if (mode == HostAllocatorMode::arena)
+	{
+		printf("Host allocator : %llu allocations served by the arena from %u chunks \n",
+			(unsigned long long)current.arena_allocation_count, current.arena_chunk_count);
+	}
+}
@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "..\headers\vulkan_renderer.h"
+#include "..\headers\benchmark.h"
 
 GLFWwindow* window;
 vulkan_renderer renderer;
@@ -22,29 +23,394 @@ void init_window(std::string w_name = "Test window", const int width = 800, cons
 	window = glfwCreateWindow(width, height, w_name.c_str(), nullptr, nullptr);
 }
 
-int main()
+int main(int argc, char* argv[])
 {
-	//create window
-	init_window();
+	// --benchmark measures frame times, --msaa N picks the sample count
+	// --texture FILE streams a texture in, --texture-budget MB limits their memory
+	// --host-allocator system|tracking|arena picks the Vulkan host allocation callbacks, system passes none.
+	// Host allocations per frame in the benchmarks are only counted with tracking or arena
+	// --scene N fills the scene with N objects
+	// --mesh FILE loads a mesh written by mesh_converter
+	// --lod-error PX screen space error allowed when picking mesh LODs, 0 keeps LOD 0
+	// --capture PREFIX writes presented frames to PREFIX_00000.ppm, --capture-raw FILE appends them to one raw file
+	// --capture-frames N stops capturing after N frames
+	// --gpu-stats prints pipeline statistics and occlusion counts of the frame
+	// --occlusion culls objects hidden behind the depth of earlier frames
+	// --specialized-shaders draws the scene with branch free shader variants, --lights N adds N lights per fragment
+	// --windows N opens N windows rendered from the same device, closing the first one quits
+	// --render-passes records the frame graph with render passes and framebuffers instead of dynamic rendering
+	// --serial-init runs the init stages one after the other to compare startup times
+	// --trace FILE writes CPU and GPU zones from init to exit as a Chrome trace, open it in chrome://tracing or Perfetto
+	// --particles N simulates and draws up to N particles on the GPU
+	// --no-post draws straight into the swap chain, --exposure E scales the HDR image before tone mapping
+	// --bloom N blurs N halved levels of the HDR image, 0 turns bloom off
+	// --sprites N draws N batched 2D sprites over the frame, textures given with --texture become their pages
+	// --perf-baseline FILE runs the regression suite and fails when a metric is worse than FILE allows,
+	// --perf-write-baseline FILE records the metrics of this machine into FILE instead. The suite renders
+	// offscreen without a window, so it runs on machines without a display server
+	// --device NAME picks the GPU whose name contains NAME, llvmpipe for lavapipe
+	bool run_benchmark = false;
+	uint32_t msaa_samples = 1;
+	std::vector<std::string> texture_files;
+	std::vector<std::string> mesh_files;
+	uint32_t texture_budget_mb = 0;
+	uint32_t scene_objects = 0;
+	std::string capture_prefix;
+	std::string capture_raw_file;
+	uint64_t capture_frames = 0;
+	bool gpu_stats = false;
+	bool occlusion_culling = false;
+	bool specialized_shaders = false;
+	uint32_t light_count = 0;
+	uint32_t window_count = 1;
+	std::string trace_file;
+	uint32_t particle_count = 0;
+	uint32_t sprite_count = 0;
+	std::string perf_baseline_file;
+	bool write_perf_baseline = false;
+	PostSettings post_settings = renderer.get_post_process().get_settings();
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--benchmark")
+		{
+			run_benchmark = true;
+		}
+		else if (arg == "--msaa" && i + 1 < argc)
+		{
+			msaa_samples = static_cast<uint32_t>(std::atoi(argv[++i]));
+		}
+		else if (arg == "--host-allocator" && i + 1 < argc)
+		{
+			std::string mode = argv[++i];
+			if (mode == "system")
+				renderer.set_host_allocator_mode(HostAllocatorMode::system);
+			else if (mode == "arena")
+				renderer.set_host_allocator_mode(HostAllocatorMode::arena);
+			else
+				renderer.set_host_allocator_mode(HostAllocatorMode::tracking);
+		}
+		else if (arg == "--scene" && i + 1 < argc)
+		{
+			scene_objects = static_cast<uint32_t>(std::atoi(argv[++i]));
+		}
+		else if (arg == "--serial-init")
+		{
+			renderer.set_parallel_init(false);
+		}
+		else if (arg == "--windows" && i + 1 < argc)
+		{
+			window_count = static_cast<uint32_t>(std::atoi(argv[++i]));
+		}
+		else if (arg == "--trace" && i + 1 < argc)
+		{
+			trace_file = argv[++i];
+		}
+		else if (arg == "--particles" && i + 1 < argc)
+		{
+			particle_count = static_cast<uint32_t>(std::atoi(argv[++i]));
+			renderer.set_particle_capacity(particle_count);
+		}
+		else if (arg == "--sprites" && i + 1 < argc)
+		{
+			sprite_count = static_cast<uint32_t>(std::atoi(argv[++i]));
+		}
+		else if ((arg == "--perf-baseline" || arg == "--perf-write-baseline") && i + 1 < argc)
+		{
+			perf_baseline_file = argv[++i];
+			write_perf_baseline = arg == "--perf-write-baseline";
+			run_benchmark = true;
+		}
+		else if (arg == "--device" && i + 1 < argc)
+		{
+			renderer.set_preferred_device(argv[++i]);
+		}
+		else if (arg == "--no-post")
+		{
+			renderer.set_post_processing(false);
+		}
+		else if (arg == "--exposure" && i + 1 < argc)
+		{
+			post_settings.exposure = static_cast<float>(std::atof(argv[++i]));
+		}
+		else if (arg == "--bloom" && i + 1 < argc)
+		{
+			post_settings.bloom_levels = static_cast<uint32_t>(std::atoi(argv[++i]));
+		}
+		else if (arg == "--render-passes")
+		{
+			renderer.set_dynamic_rendering(false);
+		}
+		else if (arg == "--gpu-stats")
+		{
+			gpu_stats = true;
+		}
+		else if (arg == "--occlusion")
+		{
+			occlusion_culling = true;
+		}
+		else if (arg == "--specialized-shaders")
+		{
+			specialized_shaders = true;
+		}
+		else if (arg == "--lights" && i + 1 < argc)
+		{
+			light_count = static_cast<uint32_t>(std::atoi(argv[++i]));
+		}
+		else if (arg == "--texture" && i + 1 < argc)
+		{
+			texture_files.push_back(argv[++i]);
+		}
+		else if (arg == "--mesh" && i + 1 < argc)
+		{
+			mesh_files.push_back(argv[++i]);
+		}
+		else if (arg == "--lod-error" && i + 1 < argc)
+		{
+			renderer.set_lod_error(static_cast<float>(std::atof(argv[++i])));
+		}
+		else if (arg == "--capture" && i + 1 < argc)
+		{
+			capture_prefix = argv[++i];
+		}
+		else if (arg == "--capture-raw" && i + 1 < argc)
+		{
+			capture_raw_file = argv[++i];
+		}
+		else if (arg == "--capture-frames" && i + 1 < argc)
+		{
+			capture_frames = static_cast<uint64_t>(std::atoll(argv[++i]));
+		}
+		else if (arg == "--texture-budget" && i + 1 < argc)
+		{
+			texture_budget_mb = static_cast<uint32_t>(std::atoi(argv[++i]));
+		}
+	}
+
+	//create window, the regression suite renders offscreen instead
+	bool offscreen = !perf_baseline_file.empty();
+	if (!offscreen)
+	{
+		init_window();
+	}
+
+	// Started before init so its stages are in the trace
+	if (!trace_file.empty())
+	{
+		try
+		{
+			renderer.get_profiler().start(trace_file);
+		}
+		catch (const std::runtime_error &e)
+		{
+			printf("ERROR : %s \n", e.what());
+		}
+	}
 
 	//create a vulkan renderer instance
-	if (renderer.init(window) == EXIT_FAILURE)
+	int init_result = offscreen ? renderer.init_offscreen({ 800, 600 }) : renderer.init(window);
+	if (init_result == EXIT_FAILURE)
 	{
 		return EXIT_FAILURE;
 	}
 
-	//loop until closed
-	while (!(glfwWindowShouldClose(window)))
+	int result = EXIT_SUCCESS;
+
+	renderer.set_gpu_queries_enabled(gpu_stats);
+
+	// Views next to the main window, they show the same scene. Resized, their swap chain is recreated on the next frame
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+	std::vector<GLFWwindow*> extra_windows;
+	for (uint32_t i = 1; i < window_count && !offscreen; i++)
+	{
+		GLFWwindow* extra_window = glfwCreateWindow(400, 300, ("View " + std::to_string(i)).c_str(), nullptr, nullptr);
+
+		try
+		{
+			renderer.add_window(extra_window);
+			extra_windows.push_back(extra_window);
+		}
+		catch (const std::runtime_error &e)
+		{
+			printf("ERROR : %s \n", e.what());
+			glfwDestroyWindow(extra_window);
+		}
+	}
+
+	try
 	{
-		glfwPollEvents();
-		renderer.draw();
+		renderer.set_msaa_samples(static_cast<VkSampleCountFlagBits>(msaa_samples));
 	}
+	catch (const std::runtime_error &e)
+	{
+		printf("ERROR : %s \n", e.what());
+	}
+
+	renderer.set_post_settings(post_settings);
+	renderer.set_occlusion_culling(occlusion_culling);
+	renderer.set_specialized_shaders(specialized_shaders);
+	renderer.set_shader_light_count(light_count);
+
+	// Emitted fast enough to keep the pool about full, every particle lives four seconds on average
+	if (particle_count > 0)
+	{
+		ParticleEmitter emitter = renderer.get_particles().get_emitter();
+		emitter.rate = static_cast<float>(particle_count) / emitter.lifetime;
+		renderer.get_particles().set_emitter(emitter);
+		renderer.set_particles_enabled(true);
+	}
+
+	if (texture_budget_mb > 0)
+	{
+		renderer.set_texture_budget(static_cast<VkDeviceSize>(texture_budget_mb) * 1024 * 1024);
+	}
+
+	std::vector<uint32_t> sprite_pages;
+	for (const std::string& file : texture_files)
+	{
+		uint32_t texture = renderer.load_texture(file);
+		sprite_pages.push_back(texture);
+		if (file == texture_files.front())
+		{
+			renderer.set_display_texture(texture);
+		}
+	}
+
+	for (const std::string& file : mesh_files)
+	{
+		try
+		{
+			uint32_t mesh = renderer.load_mesh(file);
 
+			// Shown next to each other at the origin when nothing else fills the scene
+			if (!run_benchmark && scene_objects == 0)
+			{
+				const MeshFileHeader& header = renderer.get_meshes().get_mesh(mesh).header;
+
+				SceneTransform transform;
+				transform.rows[0][3] = mesh * 3.0f;
+
+				// Scaled to a radius of one, the default camera frames the origin
+				float scale = header.radius > 0.0f ? 1.0f / header.radius : 1.0f;
+				for (int axis = 0; axis < 3; axis++)
+				{
+					transform.rows[axis][axis] = scale;
+					transform.rows[axis][3] -= header.center[axis] * scale;
+				}
+
+				SceneBounds bounds;
+				bounds.center[0] = header.center[0];
+				bounds.center[1] = header.center[1];
+				bounds.center[2] = header.center[2];
+				bounds.radius = header.radius;
+
+				renderer.get_scene().add_object(SCENE_NO_PARENT, transform, bounds,
+					draw_list::make_key(0, SCENE_PIPELINE_OPAQUE, 0, renderer.get_mesh_geometry(mesh), 0));
+			}
+		}
+		catch (const std::runtime_error &e)
+		{
+			printf("ERROR : %s \n", e.what());
+		}
+	}
+
+	if (scene_objects > 0)
+	{
+		benchmark::build_test_scene(&renderer.get_scene(), scene_objects);
+	}
+
+	if (!capture_prefix.empty() || !capture_raw_file.empty())
+	{
+		try
+		{
+			frame_capture& capture = renderer.get_capture();
+			capture.set_consumer(capture_raw_file.empty() ? frame_capture::ppm_writer(capture_prefix)
+				: frame_capture::raw_writer(capture_raw_file));
+			capture.start(capture_frames);
+		}
+		catch (const std::runtime_error &e)
+		{
+			printf("ERROR : %s \n", e.what());
+		}
+	}
+
+	if (run_benchmark)
+	{
+		benchmark bench(&renderer, window);
+		if (!perf_baseline_file.empty())
+			result = bench.run_regression(perf_baseline_file, write_perf_baseline);
+		else
+			result = bench.run();
+	}
+	else
+	{
+		//loop until closed
+		uint32_t frame = 0;
+		while (!(glfwWindowShouldClose(window)))
+		{
+			glfwPollEvents();
+
+			// Sprites last one frame, they are added again before every draw
+			if (sprite_count > 0)
+			{
+				int width = 0;
+				int height = 0;
+				glfwGetFramebufferSize(window, &width, &height);
+				benchmark::add_test_sprites(&renderer.get_sprites(), sprite_count, static_cast<float>(width),
+					static_cast<float>(height), frame++, sprite_pages);
+			}
+
+			for (size_t i = 0; i < extra_windows.size(); i++)
+			{
+				if (glfwWindowShouldClose(extra_windows[i]))
+				{
+					renderer.remove_window(extra_windows[i]);
+					glfwDestroyWindow(extra_windows[i]);
+					extra_windows.erase(extra_windows.begin() + i--);
+				}
+			}
+
+			renderer.draw();
+		}
+	}
+
+	renderer.wait_idle();
+	renderer.get_textures().print_stats();
+	renderer.get_meshes().print_stats();
+	renderer.get_descriptors().print_stats();
+	renderer.print_gpu_stats();
+	renderer.get_particles().print_stats();
+	renderer.get_post_process().print_stats();
+	renderer.get_sprites().print_stats();
+
+	if (renderer.get_profiler().is_capturing())
+	{
+		try
+		{
+			renderer.get_profiler().stop();
+			renderer.get_profiler().print_stats();
+		}
+		catch (const std::runtime_error &e)
+		{
+			printf("ERROR : %s \n", e.what());
+		}
+	}
+
+	// Flushes the frames still being captured
 	renderer.cleanup();
+	renderer.get_capture().print_stats();
 
 	//clean things up
-	glfwDestroyWindow(window);
-	glfwTerminate();
+	for (GLFWwindow* extra_window : extra_windows)
+	{
+		glfwDestroyWindow(extra_window);
+	}
+	if (!offscreen)
+	{
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
 
-	return EXIT_SUCCESS;
+	return result;
 }
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include "..\headers\memory_tracker.h"
+
+memory_tracker::memory_tracker()
+{
+}
+
+
+void memory_tracker::init(VkPhysicalDevice new_physical_device, VkDevice new_device, bool memory_budget_extension,
+	const VkAllocationCallbacks* new_allocator)
+{
+	physical_device = new_physical_device;
+	device = new_device;
+	allocator = new_allocator;
+	budget_extension = memory_budget_extension;
+
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+
+	VkPhysicalDeviceProperties device_properties;
+	vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+	max_allocation_count = device_properties.limits.maxMemoryAllocationCount;
+
+	heap_bytes.assign(memory_properties.memoryHeapCount, 0);
+	peak_heap_bytes.assign(memory_properties.memoryHeapCount, 0);
+
+	printf("Memory tracker creation is  a success, budget extension %s \n", budget_extension ? "enabled" : "not available");
+}
+
+
+VkResult memory_tracker::allocate(const VkMemoryAllocateInfo* allocate_info, VkDeviceMemory* memory, const char* tag)
+{
+	VkResult result = vkAllocateMemory(device, allocate_info, allocator, memory);
+
+	if (result != VK_SUCCESS)
+		return result;
+
+	MemoryAllocationInfo allocation = {};
+	allocation.size = allocate_info->allocationSize;
+	allocation.memory_type = allocate_info->memoryTypeIndex;
+	allocation.heap = memory_properties.memoryTypes[allocate_info->memoryTypeIndex].heapIndex;
+	allocation.tag = tag;
+
+	std::lock_guard<std::mutex> lock(allocations_mutex);
+	allocations[*memory] = allocation;
+
+	heap_bytes[allocation.heap] += allocation.size;
+	peak_heap_bytes[allocation.heap] = std::max(peak_heap_bytes[allocation.heap], heap_bytes[allocation.heap]);
+
+	return result;
+}
+
+
+void memory_tracker::free(VkDeviceMemory memory)
+{
+	if (memory == VK_NULL_HANDLE)
+		return;
+
+	// Forgotten before it is freed, the driver may hand the same handle to an allocation on another thread
+	{
+		std::lock_guard<std::mutex> lock(allocations_mutex);
+
+		auto allocation = allocations.find(memory);
+		if (allocation != allocations.end())
+		{
+			heap_bytes[allocation->second.heap] -= allocation->second.size;
+			allocations.erase(allocation);
+		}
+	}
+
+	vkFreeMemory(device, memory, allocator);
+}
+
+
+void memory_tracker::add_bound_bytes(VkDeviceMemory memory, VkDeviceSize bytes)
+{
+	std::lock_guard<std::mutex> lock(allocations_mutex);
+
+	auto allocation = allocations.find(memory);
+	if (allocation != allocations.end())
+	{
+		allocation->second.bound_bytes += bytes;
+	}
+}
+
+
+MemoryReport memory_tracker::get_report()
+{
+	MemoryReport report = {};
+	report.budget_extension = budget_extension;
+	report.max_allocation_count = max_allocation_count;
+	report.heaps.resize(memory_properties.memoryHeapCount);
+
+	for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++)
+	{
+		report.heaps[i].heap_size = memory_properties.memoryHeaps[i].size;
+		report.heaps[i].device_local = (memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(allocations_mutex);
+
+		for (const auto& entry : allocations)
+		{
+			const MemoryAllocationInfo& allocation = entry.second;
+			MemoryHeapReport& heap = report.heaps[allocation.heap];
+
+			heap.allocation_count++;
+			heap.allocated_bytes += allocation.size;
+
+			// Aliased allocations can have more bound than allocated
+			heap.bound_bytes += std::min(allocation.bound_bytes, allocation.size);
+
+			auto tag = std::find_if(report.tags.begin(), report.tags.end(),
+				[&allocation](const MemoryTagReport& t) { return t.tag == allocation.tag; });
+
+			if (tag == report.tags.end())
+			{
+				report.tags.push_back({ allocation.tag, 1, allocation.size });
+			}
+			else
+			{
+				tag->allocation_count++;
+				tag->allocated_bytes += allocation.size;
+			}
+		}
+
+		for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++)
+		{
+			report.heaps[i].peak_allocated_bytes = peak_heap_bytes[i];
+		}
+
+		report.allocation_count = static_cast<uint32_t>(allocations.size());
+	}
+
+	if (budget_extension)
+	{
+		// The driver numbers include memory the tracker never sees, like the swap chain
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties = {};
+		budget_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		VkPhysicalDeviceMemoryProperties2 memory_properties2 = {};
+		memory_properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memory_properties2.pNext = &budget_properties;
+
+		vkGetPhysicalDeviceMemoryProperties2(physical_device, &memory_properties2);
+
+		for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++)
+		{
+			report.heaps[i].budget = budget_properties.heapBudget[i];
+			report.heaps[i].usage = budget_properties.heapUsage[i];
+		}
+	}
+	else
+	{
+		for (MemoryHeapReport& heap : report.heaps)
+		{
+			heap.budget = heap.heap_size;
+			heap.usage = heap.allocated_bytes;
+		}
+	}
+
+	for (MemoryHeapReport& heap : report.heaps)
+	{
+		if (heap.allocated_bytes > 0)
+		{
+			heap.fragmentation = 1.0f - static_cast<float>(heap.bound_bytes) / static_cast<float>(heap.allocated_bytes);
+		}
+	}
+
+	return report;
+}
+
+
+void memory_tracker::print_report()
+{
+	MemoryReport report = get_report();
+
+	printf("Memory : %u of %u allocations, budget %s \n", report.allocation_count, report.max_allocation_count,
+		report.budget_extension ? "from VK_EXT_memory_budget" : "is the heap size");
+
+	for (size_t i = 0; i < report.heaps.size(); i++)
+	{
+		const MemoryHeapReport& heap = report.heaps[i];
+		printf("Memory : heap %zu%s usage %llu MB of %llu MB budget, %u allocations, %llu KB tracked (peak %llu KB), %.1f%% fragmentation \n",
+			i, heap.device_local ? " (device local)" : "",
+			(unsigned long long)(heap.usage >> 20), (unsigned long long)(heap.budget >> 20), heap.allocation_count,
+			(unsigned long long)(heap.allocated_bytes >> 10), (unsigned long long)(heap.peak_allocated_bytes >> 10),
+			heap.fragmentation * 100.0f);
+	}
+
+	for (const MemoryTagReport& tag : report.tags)
+	{
+		printf("Memory : %s, %u allocations, %llu KB \n", tag.tag.c_str(), tag.allocation_count,
+			(unsigned long long)(tag.allocated_bytes >> 10));
+	}
+}
@@ -0,0 +1,284 @@
+#include "..\headers\mesh_manager.h"
+
+#include <chrono>
+#include <cstring>
+
+static double elapsed_ms(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+
+mesh_manager::mesh_manager()
+{
+}
+
+
+void mesh_manager::init(VkPhysicalDevice new_physical_device, VkDevice new_device, VkQueue new_queue, uint32_t queue_family,
+	bindless_heap* new_heap, memory_tracker* new_tracker, const VkAllocationCallbacks* new_allocator)
+{
+	physical_device = new_physical_device;
+	device = new_device;
+	queue = new_queue;
+	heap = new_heap;
+	tracker = new_tracker;
+	allocator = new_allocator;
+
+	VkCommandPoolCreateInfo pool_create_info = {};
+	pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	pool_create_info.queueFamilyIndex = queue_family;
+
+	VkResult result = vkCreateCommandPool(device, &pool_create_info, allocator, &command_pool);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the mesh command pool \n");
+	}
+
+	printf("Mesh manager creation is  a success \n");
+}
+
+
+void mesh_manager::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+	const char* tag, VkBuffer* buffer, VkDeviceMemory* memory)
+{
+	VkBufferCreateInfo buffer_create_info = {};
+	buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_create_info.size = size;
+	buffer_create_info.usage = usage;
+	buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkResult result = vkCreateBuffer(device, &buffer_create_info, allocator, buffer);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create a mesh buffer \n");
+	}
+
+	VkMemoryRequirements memory_requirements;
+	vkGetBufferMemoryRequirements(device, *buffer, &memory_requirements);
+
+	VkMemoryAllocateInfo allocate_info = {};
+	allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocate_info.allocationSize = memory_requirements.size;
+	allocate_info.memoryTypeIndex = find_memory_type_index(physical_device, memory_requirements.memoryTypeBits, properties);
+
+	result = tracker->allocate(&allocate_info, memory, tag);
+
+	if (result != VK_SUCCESS)
+	{
+		vkDestroyBuffer(device, *buffer, allocator);
+		*buffer = VK_NULL_HANDLE;
+		throw std::runtime_error(" Error: Failed to allocate mesh memory \n");
+	}
+
+	vkBindBufferMemory(device, *buffer, *memory, 0);
+	tracker->add_bound_bytes(*memory, size);
+}
+
+
+uint32_t mesh_manager::load(const std::string& file)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	mapped_file mapping;
+	mapping.open(file);
+
+	const MeshFileHeader* header = reinterpret_cast<const MeshFileHeader*>(mapping.get_data());
+	if (!validate_mesh_header(header, mapping.get_size()))
+	{
+		std::string error_msg(" Error: " + file + " is not a valid mesh file \n");
+		throw std::runtime_error(error_msg.c_str());
+	}
+
+	GpuMesh mesh;
+	mesh.file = file;
+	mesh.header = *header;
+
+	// LODs and meshlets stay on the CPU for selection and culling
+	const MeshLod* lods = reinterpret_cast<const MeshLod*>(mapping.get_data() + header->lod_offset);
+	const Meshlet* meshlets = reinterpret_cast<const Meshlet*>(mapping.get_data() + header->meshlet_offset);
+	mesh.lods.assign(lods, lods + header->lod_count);
+	mesh.meshlets.assign(meshlets, meshlets + header->meshlet_count);
+
+	// The index section directly follows the vertices, one region covers both
+	mesh.vertex_offset = 0;
+	mesh.index_offset = header->index_offset - header->vertex_offset;
+	mesh.bytes = header->file_size - header->vertex_offset;
+
+	double map_ms = elapsed_ms(start);
+	start = std::chrono::high_resolution_clock::now();
+
+	VkBuffer staging_buffer;
+	VkDeviceMemory staging_memory;
+	create_buffer(mesh.bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "mesh staging",
+		&staging_buffer, &staging_memory);
+
+	// Page faults on the mapping read the file in as it is copied
+	void* data;
+	vkMapMemory(device, staging_memory, 0, mesh.bytes, 0, &data);
+	memcpy(data, mapping.get_data() + header->vertex_offset, static_cast<size_t>(mesh.bytes));
+	vkUnmapMemory(device, staging_memory);
+
+	mapping.close();
+
+	double copy_ms = elapsed_ms(start);
+	start = std::chrono::high_resolution_clock::now();
+
+	create_buffer(mesh.bytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+		| VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "mesh", &mesh.buffer, &mesh.memory);
+
+	VkCommandBufferAllocateInfo allocate_info = {};
+	allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocate_info.commandPool = command_pool;
+	allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocate_info.commandBufferCount = 1;
+
+	VkCommandBuffer command_buffer;
+	VkResult result = vkAllocateCommandBuffers(device, &allocate_info, &command_buffer);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to allocate a mesh command buffer \n");
+	}
+
+	VkCommandBufferBeginInfo begin_info = {};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(command_buffer, &begin_info);
+
+	VkBufferCopy copy_region = {};
+	copy_region.srcOffset = 0;
+	copy_region.dstOffset = 0;
+	copy_region.size = mesh.bytes;
+
+	vkCmdCopyBuffer(command_buffer, staging_buffer, mesh.buffer, 1, &copy_region);
+
+	// Visible to vertex input and to shaders pulling the vertices from the storage buffer
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = mesh.buffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	vkEndCommandBuffer(command_buffer);
+
+	VkFenceCreateInfo fence_create_info = {};
+	fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	VkFence fence;
+	result = vkCreateFence(device, &fence_create_info, allocator, &fence);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create a mesh upload fence \n");
+	}
+
+	VkSubmitInfo submit_info = {};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &command_buffer;
+
+	result = vkQueueSubmit(queue, 1, &submit_info, fence);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to submit a mesh upload \n");
+	}
+
+	vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+
+	vkDestroyFence(device, fence, allocator);
+	vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
+	vkDestroyBuffer(device, staging_buffer, allocator);
+	tracker->free(staging_memory);
+
+	mesh.bindless_index = heap->add_storage_buffer(mesh.buffer, 0, mesh.bytes);
+
+	double upload_ms = elapsed_ms(start);
+
+	stats.mesh_count++;
+	stats.bytes_uploaded += mesh.bytes;
+	stats.map_ms += map_ms;
+	stats.copy_ms += copy_ms;
+	stats.upload_ms += upload_ms;
+
+	printf("Mesh %s : %u vertices, %u indices, %u LODs, %u meshlets, %.2f KB in %.2f ms \n",
+		file.c_str(), header->vertex_count, header->index_count, header->lod_count, header->meshlet_count,
+		mesh.bytes / 1024.0, map_ms + copy_ms + upload_ms);
+
+	meshes.push_back(std::move(mesh));
+	return static_cast<uint32_t>(meshes.size() - 1);
+}
+
+
+void mesh_manager::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+		return;
+
+	for (GpuMesh& mesh : meshes)
+	{
+		if (mesh.bindless_index != BINDLESS_INVALID_INDEX)
+		{
+			heap->remove_storage_buffer(mesh.bindless_index);
+		}
+		vkDestroyBuffer(device, mesh.buffer, allocator);
+		tracker->free(mesh.memory);
+	}
+	meshes.clear();
+
+	vkDestroyCommandPool(device, command_pool, allocator);
+
+	command_pool = VK_NULL_HANDLE;
+	device = VK_NULL_HANDLE;
+	stats = {};
+}
+
+
+const GpuMesh& mesh_manager::get_mesh(uint32_t mesh)
+{
+	if (mesh >= meshes.size())
+	{
+		throw std::runtime_error(" Error: Invalid mesh handle \n");
+	}
+
+	return meshes[mesh];
+}
+
+
+uint32_t mesh_manager::get_mesh_count()
+{
+	return static_cast<uint32_t>(meshes.size());
+}
+
+
+const MeshLoadStats& mesh_manager::get_stats()
+{
+	return stats;
+}
+
+
+void mesh_manager::print_stats()
+{
+	if (stats.mesh_count == 0)
+		return;
+
+	double total_ms = stats.map_ms + stats.copy_ms + stats.upload_ms;
+	double megabytes = stats.bytes_uploaded / (1024.0 * 1024.0);
+
+	printf("Meshes : %u loaded, %.2f MB, map %.2f ms, copy %.2f ms, upload %.2f ms, %.1f MB/s \n",
+		stats.mesh_count, megabytes, stats.map_ms, stats.copy_ms, stats.upload_ms,
+		total_ms > 0.0 ? megabytes / (total_ms / 1000.0) : 0.0);
+}
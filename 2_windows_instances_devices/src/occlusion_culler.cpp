@@ -0,0 +1,626 @@
+#include "..\headers\occlusion_culler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Largest power of two not above value
+static uint32_t floor_power_of_two(uint32_t value)
+{
+	uint32_t result = 1;
+	while (result * 2 <= value)
+	{
+		result *= 2;
+	}
+
+	return result;
+}
+
+
+occlusion_culler::occlusion_culler()
+{
+}
+
+
+void occlusion_culler::init(VkPhysicalDevice new_physical_device, VkDevice new_device, VkExtent2D depth_extent, uint32_t frame_count,
+	const std::vector<char>& shader_code, memory_tracker* new_tracker, descriptor_allocator* new_descriptors,
+	const VkAllocationCallbacks* new_allocator)
+{
+	physical_device = new_physical_device;
+	device = new_device;
+	tracker = new_tracker;
+	descriptors = new_descriptors;
+	allocator = new_allocator;
+
+	if (shader_code.empty())
+	{
+		printf("Occlusion culling is not available, hiz_reduce.spv is missing \n");
+		return;
+	}
+
+	create_pyramid(depth_extent);
+	create_pipeline(shader_code);
+	create_readbacks(frame_count);
+
+	available = true;
+
+	printf("Occlusion culler creation is  a success \n");
+}
+
+
+void occlusion_culler::create_pyramid(VkExtent2D depth_extent)
+{
+	uint32_t width = floor_power_of_two(depth_extent.width);
+	uint32_t height = floor_power_of_two(depth_extent.height);
+
+	// Down to a single texel
+	uint32_t level_count = 1;
+	while ((width >> (level_count - 1)) > 1 || (height >> (level_count - 1)) > 1)
+	{
+		level_count++;
+	}
+
+	VkImageCreateInfo image_create_info = {};
+	image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_create_info.imageType = VK_IMAGE_TYPE_2D;
+	image_create_info.format = VK_FORMAT_R32_SFLOAT;
+	image_create_info.extent.width = width;
+	image_create_info.extent.height = height;
+	image_create_info.extent.depth = 1;
+	image_create_info.mipLevels = level_count;
+	image_create_info.arrayLayers = 1;
+	image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_create_info.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	VkResult result = vkCreateImage(device, &image_create_info, allocator, &image);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the depth pyramid \n");
+	}
+
+	VkMemoryRequirements memory_requirements;
+	vkGetImageMemoryRequirements(device, image, &memory_requirements);
+
+	VkMemoryAllocateInfo allocate_info = {};
+	allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocate_info.allocationSize = memory_requirements.size;
+	allocate_info.memoryTypeIndex = find_memory_type_index(physical_device, memory_requirements.memoryTypeBits,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	result = tracker->allocate(&allocate_info, &memory, "depth pyramid");
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to allocate the depth pyramid \n");
+	}
+
+	vkBindImageMemory(device, image, memory, 0);
+	tracker->add_bound_bytes(memory, memory_requirements.size);
+
+	VkImageViewCreateInfo imageview_create_info = {};
+	imageview_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	imageview_create_info.image = image;
+	imageview_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	imageview_create_info.format = VK_FORMAT_R32_SFLOAT;
+	imageview_create_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+	imageview_create_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+	imageview_create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+	imageview_create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+	imageview_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageview_create_info.subresourceRange.baseMipLevel = 0;
+	imageview_create_info.subresourceRange.levelCount = level_count;
+	imageview_create_info.subresourceRange.baseArrayLayer = 0;
+	imageview_create_info.subresourceRange.layerCount = 1;
+
+	result = vkCreateImageView(device, &imageview_create_info, allocator, &image_view);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the depth pyramid view \n");
+	}
+
+	// One view per level, each dispatch reads one level and writes the next
+	levels.resize(level_count);
+	readback_level = level_count - 1;
+
+	for (uint32_t level = 0; level < level_count; level++)
+	{
+		levels[level].width = std::max(width >> level, 1u);
+		levels[level].height = std::max(height >> level, 1u);
+
+		imageview_create_info.subresourceRange.baseMipLevel = level;
+		imageview_create_info.subresourceRange.levelCount = 1;
+
+		result = vkCreateImageView(device, &imageview_create_info, allocator, &levels[level].image_view);
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(" Error: Failed to create a depth pyramid level view \n");
+		}
+
+		if (readback_level == level_count - 1 && std::max(levels[level].width, levels[level].height) <= HIZ_READBACK_SIZE)
+		{
+			readback_level = level;
+		}
+	}
+
+	readback_floats = 0;
+	for (uint32_t level = readback_level; level < level_count; level++)
+	{
+		levels[level].readback_offset = readback_floats;
+		readback_floats += static_cast<size_t>(levels[level].width) * levels[level].height;
+	}
+
+	pyramid.resize(readback_floats);
+}
+
+
+void occlusion_culler::create_pipeline(const std::vector<char>& shader_code)
+{
+	// Only texelFetch reads the source, the sampler is never used for filtering
+	VkSamplerCreateInfo sampler_create_info = {};
+	sampler_create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	sampler_create_info.magFilter = VK_FILTER_NEAREST;
+	sampler_create_info.minFilter = VK_FILTER_NEAREST;
+	sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	sampler_create_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_create_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_create_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_create_info.maxLod = 0.0f;
+
+	VkResult result = vkCreateSampler(device, &sampler_create_info, allocator, &sampler);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the depth pyramid sampler \n");
+	}
+
+	VkDescriptorSetLayoutBinding bindings[2] = {};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo set_layout_create_info = {};
+	set_layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	set_layout_create_info.bindingCount = 2;
+	set_layout_create_info.pBindings = bindings;
+
+	result = vkCreateDescriptorSetLayout(device, &set_layout_create_info, allocator, &set_layout);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the depth pyramid set layout \n");
+	}
+
+	VkPushConstantRange push_constant_range = {};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(HiZPushConstants);
+
+	VkPipelineLayoutCreateInfo layout_create_info = {};
+	layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layout_create_info.setLayoutCount = 1;
+	layout_create_info.pSetLayouts = &set_layout;
+	layout_create_info.pushConstantRangeCount = 1;
+	layout_create_info.pPushConstantRanges = &push_constant_range;
+
+	result = vkCreatePipelineLayout(device, &layout_create_info, allocator, &pipeline_layout);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the depth pyramid pipeline layout \n");
+	}
+
+	VkShaderModuleCreateInfo shader_create_info = {};
+	shader_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shader_create_info.codeSize = shader_code.size();
+	shader_create_info.pCode = reinterpret_cast<const uint32_t*>(shader_code.data());
+
+	VkShaderModule shader_module;
+	result = vkCreateShaderModule(device, &shader_create_info, allocator, &shader_module);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the depth pyramid shader module \n");
+	}
+
+	VkComputePipelineCreateInfo pipeline_create_info = {};
+	pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline_create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeline_create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipeline_create_info.stage.module = shader_module;
+	pipeline_create_info.stage.pName = "main";
+	pipeline_create_info.layout = pipeline_layout;
+
+	result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, allocator, &pipeline);
+
+	vkDestroyShaderModule(device, shader_module, allocator);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the depth pyramid pipeline \n");
+	}
+}
+
+
+void occlusion_culler::create_readbacks(uint32_t frame_count)
+{
+	VkDeviceSize size = readback_floats * sizeof(float);
+
+	readbacks.resize(frame_count);
+	for (HiZReadback& readback : readbacks)
+	{
+		VkBufferCreateInfo buffer_create_info = {};
+		buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		buffer_create_info.size = size;
+		buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkResult result = vkCreateBuffer(device, &buffer_create_info, allocator, &readback.buffer);
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(" Error: Failed to create a depth pyramid readback buffer \n");
+		}
+
+		VkMemoryRequirements memory_requirements;
+		vkGetBufferMemoryRequirements(device, readback.buffer, &memory_requirements);
+
+		// Read on the CPU every frame, cached memory when the device has it
+		uint32_t memory_type;
+		try
+		{
+			memory_type = find_memory_type_index(physical_device, memory_requirements.memoryTypeBits,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+		}
+		catch (const std::runtime_error&)
+		{
+			memory_type = find_memory_type_index(physical_device, memory_requirements.memoryTypeBits,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		}
+
+		VkMemoryAllocateInfo allocate_info = {};
+		allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocate_info.allocationSize = memory_requirements.size;
+		allocate_info.memoryTypeIndex = memory_type;
+
+		result = tracker->allocate(&allocate_info, &readback.memory, "depth pyramid readback");
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(" Error: Failed to allocate a depth pyramid readback \n");
+		}
+
+		vkBindBufferMemory(device, readback.buffer, readback.memory, 0);
+		tracker->add_bound_bytes(readback.memory, size);
+
+		result = vkMapMemory(device, readback.memory, 0, VK_WHOLE_SIZE, 0, &readback.mapped);
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(" Error: Failed to map a depth pyramid readback \n");
+		}
+	}
+}
+
+
+void occlusion_culler::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+		return;
+
+	for (HiZReadback& readback : readbacks)
+	{
+		vkUnmapMemory(device, readback.memory);
+		vkDestroyBuffer(device, readback.buffer, allocator);
+		tracker->free(readback.memory);
+	}
+	readbacks.clear();
+
+	if (available)
+	{
+		vkDestroyPipeline(device, pipeline, allocator);
+		vkDestroyPipelineLayout(device, pipeline_layout, allocator);
+		vkDestroyDescriptorSetLayout(device, set_layout, allocator);
+		vkDestroySampler(device, sampler, allocator);
+
+		for (HiZLevel& level : levels)
+		{
+			vkDestroyImageView(device, level.image_view, allocator);
+		}
+		vkDestroyImageView(device, image_view, allocator);
+		vkDestroyImage(device, image, allocator);
+		tracker->free(memory);
+	}
+	levels.clear();
+
+	if (depth_view != VK_NULL_HANDLE)
+	{
+		vkDestroyImageView(device, depth_view, allocator);
+		depth_view = VK_NULL_HANDLE;
+	}
+
+	available = false;
+	pyramid_valid = false;
+	device = VK_NULL_HANDLE;
+}
+
+
+bool occlusion_culler::is_available()
+{
+	return available;
+}
+
+
+VkImage occlusion_culler::get_image()
+{
+	return image;
+}
+
+
+VkImageView occlusion_culler::get_image_view()
+{
+	return image_view;
+}
+
+
+VkExtent2D occlusion_culler::get_extent()
+{
+	return levels.empty() ? VkExtent2D{} : VkExtent2D{ levels[0].width, levels[0].height };
+}
+
+
+void occlusion_culler::set_depth_source(VkImage depth_image, VkFormat depth_format, VkExtent2D depth_extent)
+{
+	if (!available)
+		return;
+
+	source_extent = depth_extent;
+
+	if (depth_view != VK_NULL_HANDLE)
+	{
+		vkDestroyImageView(device, depth_view, allocator);
+	}
+
+	// Sampled views may only have one aspect, the stencil of combined formats is left out
+	VkImageViewCreateInfo imageview_create_info = {};
+	imageview_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	imageview_create_info.image = depth_image;
+	imageview_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	imageview_create_info.format = depth_format;
+	imageview_create_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+	imageview_create_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+	imageview_create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+	imageview_create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+	imageview_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	imageview_create_info.subresourceRange.baseMipLevel = 0;
+	imageview_create_info.subresourceRange.levelCount = 1;
+	imageview_create_info.subresourceRange.baseArrayLayer = 0;
+	imageview_create_info.subresourceRange.layerCount = 1;
+
+	VkResult result = vkCreateImageView(device, &imageview_create_info, allocator, &depth_view);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the depth view of the depth pyramid \n");
+	}
+
+	// Sets cached with the old view may not be handed out for a new view that reuses its handle
+	descriptors->clear_cache(set_layout);
+
+	reset();
+}
+
+
+void occlusion_culler::reset()
+{
+	pyramid_valid = false;
+
+	for (HiZReadback& readback : readbacks)
+	{
+		readback.recorded = false;
+	}
+}
+
+
+void occlusion_culler::record(VkCommandBuffer command_buffer, uint32_t frame_slot, const glm::mat4& view_projection)
+{
+	if (!available || depth_view == VK_NULL_HANDLE)
+		return;
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+	VkMemoryBarrier level_barrier = {};
+	level_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+
+	for (size_t level = 0; level < levels.size(); level++)
+	{
+		// Each level reads the one before it, level 0 reads the depth buffer
+		DescriptorBinding bindings[2];
+		bindings[0].binding = 0;
+		bindings[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[0].image_info.sampler = sampler;
+		bindings[0].image_info.imageView = level == 0 ? depth_view : levels[level - 1].image_view;
+		bindings[0].image_info.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+		bindings[1].binding = 1;
+		bindings[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[1].image_info.imageView = levels[level].image_view;
+		bindings[1].image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkDescriptorSet descriptor_set = descriptors->get_cached(set_layout, bindings, 2);
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1,
+			&descriptor_set, 0, nullptr);
+
+		// Level 0 reads the whole depth buffer, which is not a power of two
+		HiZPushConstants push_constants = {};
+		push_constants.source_size[0] = level == 0 ? source_extent.width : levels[level - 1].width;
+		push_constants.source_size[1] = level == 0 ? source_extent.height : levels[level - 1].height;
+		push_constants.target_size[0] = levels[level].width;
+		push_constants.target_size[1] = levels[level].height;
+
+		vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(HiZPushConstants), &push_constants);
+		vkCmdDispatch(command_buffer, (levels[level].width + 7) / 8, (levels[level].height + 7) / 8, 1);
+
+		// The next level reads this one, the last one is copied out
+		bool last = level + 1 == levels.size();
+		level_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		level_barrier.dstAccessMask = last ? VK_ACCESS_TRANSFER_READ_BIT : VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			last ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &level_barrier, 0, nullptr, 0, nullptr);
+	}
+
+	HiZReadback& readback = readbacks[frame_slot];
+
+	std::vector<VkBufferImageCopy> copy_regions;
+	for (uint32_t level = readback_level; level < levels.size(); level++)
+	{
+		VkBufferImageCopy copy_region = {};
+		copy_region.bufferOffset = levels[level].readback_offset * sizeof(float);
+		copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copy_region.imageSubresource.mipLevel = level;
+		copy_region.imageSubresource.baseArrayLayer = 0;
+		copy_region.imageSubresource.layerCount = 1;
+		copy_region.imageOffset = { 0, 0, 0 };
+		copy_region.imageExtent = { levels[level].width, levels[level].height, 1 };
+
+		copy_regions.push_back(copy_region);
+	}
+
+	vkCmdCopyImageToBuffer(command_buffer, image, VK_IMAGE_LAYOUT_GENERAL, readback.buffer,
+		static_cast<uint32_t>(copy_regions.size()), copy_regions.data());
+
+	// Compute waits as well, so the layout transition of the next frame's pyramid comes after this copy
+	VkBufferMemoryBarrier buffer_barrier = {};
+	buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	buffer_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	buffer_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	buffer_barrier.buffer = readback.buffer;
+	buffer_barrier.offset = 0;
+	buffer_barrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &buffer_barrier, 0, nullptr);
+
+	readback.view_projection = view_projection;
+	readback.recorded = true;
+}
+
+
+void occlusion_culler::frame_complete(uint32_t frame_slot)
+{
+	stats.tested = 0;
+	stats.occluded = 0;
+
+	if (frame_slot >= readbacks.size() || !readbacks[frame_slot].recorded)
+		return;
+
+	HiZReadback& readback = readbacks[frame_slot];
+
+	VkMappedMemoryRange range = {};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = readback.memory;
+	range.offset = 0;
+	range.size = VK_WHOLE_SIZE;
+	vkInvalidateMappedMemoryRanges(device, 1, &range);
+
+	// Copied out, the slot is written again by the frame recorded next
+	memcpy(pyramid.data(), readback.mapped, pyramid.size() * sizeof(float));
+	pyramid_view_projection = readback.view_projection;
+	pyramid_valid = true;
+	readback.recorded = false;
+}
+
+
+bool occlusion_culler::is_occluded(const float* center, float radius)
+{
+	if (!pyramid_valid)
+		return false;
+
+	stats.tested++;
+	stats.total_tested++;
+
+	// Corners of the box around the sphere, clip(c + d) = clip(c) + clip(d) without the translation
+	glm::vec4 clip_center = pyramid_view_projection * glm::vec4(center[0], center[1], center[2], 1.0f);
+	glm::vec4 axes[3] = {
+		pyramid_view_projection[0] * radius,
+		pyramid_view_projection[1] * radius,
+		pyramid_view_projection[2] * radius
+	};
+
+	float min_x = 1.0f, max_x = -1.0f, min_y = 1.0f, max_y = -1.0f, min_z = 1.0f;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec4 clip = clip_center
+			+ axes[0] * ((corner & 1) ? 1.0f : -1.0f)
+			+ axes[1] * ((corner & 2) ? 1.0f : -1.0f)
+			+ axes[2] * ((corner & 4) ? 1.0f : -1.0f);
+
+		// Bounds reaching behind the camera can not be projected, they are kept
+		if (clip.w <= 1e-5f)
+			return false;
+
+		float inverse_w = 1.0f / clip.w;
+		min_x = std::min(min_x, clip.x * inverse_w);
+		max_x = std::max(max_x, clip.x * inverse_w);
+		min_y = std::min(min_y, clip.y * inverse_w);
+		max_y = std::max(max_y, clip.y * inverse_w);
+		min_z = std::min(min_z, clip.z * inverse_w);
+	}
+
+	if (min_z <= 0.0f)
+		return false;
+
+	// Viewport rectangle in [0, 1], rows go down the same way as the depth buffer
+	float min_u = std::max(min_x * 0.5f + 0.5f, 0.0f);
+	float max_u = std::min(max_x * 0.5f + 0.5f, 1.0f);
+	float min_v = std::max(min_y * 0.5f + 0.5f, 0.0f);
+	float max_v = std::min(max_y * 0.5f + 0.5f, 1.0f);
+
+	if (min_u > max_u || min_v > max_v)
+		return false;
+
+	// Level where the rectangle spans at most two texels per axis
+	float texels = std::max((max_u - min_u) * levels[0].width, (max_v - min_v) * levels[0].height);
+	uint32_t level = texels > 1.0f ? static_cast<uint32_t>(std::ceil(std::log2(texels))) : 0;
+	level = std::min(std::max(level, readback_level), static_cast<uint32_t>(levels.size() - 1));
+
+	const HiZLevel& hiz_level = levels[level];
+	const float* texel_depths = pyramid.data() + (hiz_level.readback_offset - levels[readback_level].readback_offset);
+
+	uint32_t x_begin = std::min(static_cast<uint32_t>(min_u * hiz_level.width), hiz_level.width - 1);
+	uint32_t x_end = std::min(static_cast<uint32_t>(max_u * hiz_level.width), hiz_level.width - 1);
+	uint32_t y_begin = std::min(static_cast<uint32_t>(min_v * hiz_level.height), hiz_level.height - 1);
+	uint32_t y_end = std::min(static_cast<uint32_t>(max_v * hiz_level.height), hiz_level.height - 1);
+
+	for (uint32_t y = y_begin; y <= y_end; y++)
+	{
+		for (uint32_t x = x_begin; x <= x_end; x++)
+		{
+			// Something behind the nearest point of the bounds is visible there
+			if (texel_depths[y * hiz_level.width + x] >= min_z)
+				return false;
+		}
+	}
+
+	stats.occluded++;
+	stats.total_occluded++;
+	return true;
+}
+
+
+const OcclusionStats& occlusion_culler::get_stats()
+{
+	return stats;
+}
@@ -0,0 +1,852 @@
+#include "..\headers\particle_system.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+// Longest step simulated at once, a stall does not throw every particle through the floor
+static const float MAX_TIME_STEP = 0.1f;
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+// Compute writes of one stage made visible to the stages reading them after it
+static void stage_barrier(VkCommandBuffer command_buffer, VkPipelineStageFlags dst_stages, VkAccessFlags dst_access)
+{
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = dst_access;
+
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dst_stages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+
+particle_system::particle_system()
+{
+}
+
+
+void particle_system::init(VkPhysicalDevice new_physical_device, VkDevice new_device, uint32_t queue_family, uint32_t new_capacity,
+	uint32_t frame_count, const std::vector<char>& compute_code, const std::vector<char>& vertex_code,
+	const std::vector<char>& fragment_code, memory_tracker* new_tracker, descriptor_allocator* new_descriptors,
+	const VkAllocationCallbacks* new_allocator)
+{
+	physical_device = new_physical_device;
+	device = new_device;
+	tracker = new_tracker;
+	descriptors = new_descriptors;
+	allocator = new_allocator;
+
+	if (compute_code.empty() || vertex_code.empty() || fragment_code.empty())
+	{
+		printf("Particles are not available, particles.spv, particle_vert.spv or particle_frag.spv is missing \n");
+		return;
+	}
+
+	capacity = new_capacity;
+
+	create_buffers();
+	create_compute_pipelines(compute_code);
+	create_draw_layout(vertex_code, fragment_code);
+	create_readbacks(queue_family, frame_count);
+
+	available = true;
+	reset();
+
+	printf("Particle system creation is  a success \n");
+}
+
+
+void particle_system::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, const char* name, VkBuffer* buffer,
+	VkDeviceMemory* memory)
+{
+	VkBufferCreateInfo buffer_create_info = {};
+	buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_create_info.size = size;
+	buffer_create_info.usage = usage;
+	buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkResult result = vkCreateBuffer(device, &buffer_create_info, allocator, buffer);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create a particle buffer \n");
+	}
+
+	VkMemoryRequirements memory_requirements;
+	vkGetBufferMemoryRequirements(device, *buffer, &memory_requirements);
+
+	VkMemoryAllocateInfo allocate_info = {};
+	allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocate_info.allocationSize = memory_requirements.size;
+	allocate_info.memoryTypeIndex = find_memory_type_index(physical_device, memory_requirements.memoryTypeBits,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	result = tracker->allocate(&allocate_info, memory, name);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to allocate a particle buffer \n");
+	}
+
+	vkBindBufferMemory(device, *buffer, *memory, 0);
+	tracker->add_bound_bytes(*memory, size);
+}
+
+
+void particle_system::create_buffers()
+{
+	// Whole groups, so the reset dispatch fills the dead list without a remainder
+	capacity = std::max((capacity + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE * PARTICLE_GROUP_SIZE, PARTICLE_GROUP_SIZE);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	VkDeviceSize alignment = properties.limits.minStorageBufferOffsetAlignment;
+
+	section_sizes[0] = static_cast<VkDeviceSize>(capacity) * sizeof(GpuParticle);
+	section_sizes[1] = static_cast<VkDeviceSize>(capacity) * sizeof(uint32_t);
+	section_sizes[2] = section_sizes[1];
+	section_sizes[3] = section_sizes[1];
+
+	VkDeviceSize size = 0;
+	for (size_t section = 0; section < section_sizes.size(); section++)
+	{
+		section_offsets[section] = align_up(size, alignment);
+		size = section_offsets[section] + section_sizes[section];
+	}
+
+	create_buffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, "particles", &particle_buffer, &particle_memory);
+	create_buffer(sizeof(ParticleCounters), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+		| VK_BUFFER_USAGE_TRANSFER_SRC_BIT, "particle counters", &counter_buffer, &counter_memory);
+
+	stats.capacity = capacity;
+}
+
+
+void particle_system::destroy_buffers()
+{
+	if (particle_buffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(device, particle_buffer, allocator);
+		tracker->free(particle_memory);
+		particle_buffer = VK_NULL_HANDLE;
+	}
+
+	if (counter_buffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(device, counter_buffer, allocator);
+		tracker->free(counter_memory);
+		counter_buffer = VK_NULL_HANDLE;
+	}
+}
+
+
+void particle_system::create_compute_pipelines(const std::vector<char>& shader_code)
+{
+	// Bindings 1 and 2 swap between the two alive lists, the vertex shader reads the particles and the list drawn
+	VkDescriptorSetLayoutBinding bindings[5] = {};
+	for (uint32_t binding = 0; binding < 5; binding++)
+	{
+		bindings[binding].binding = binding;
+		bindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[binding].descriptorCount = 1;
+		bindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo set_layout_create_info = {};
+	set_layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	set_layout_create_info.bindingCount = 5;
+	set_layout_create_info.pBindings = bindings;
+
+	VkResult result = vkCreateDescriptorSetLayout(device, &set_layout_create_info, allocator, &set_layout);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the particle set layout \n");
+	}
+
+	VkPushConstantRange push_constant_range = {};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(ParticlePushConstants);
+
+	VkPipelineLayoutCreateInfo layout_create_info = {};
+	layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layout_create_info.setLayoutCount = 1;
+	layout_create_info.pSetLayouts = &set_layout;
+	layout_create_info.pushConstantRangeCount = 1;
+	layout_create_info.pPushConstantRanges = &push_constant_range;
+
+	result = vkCreatePipelineLayout(device, &layout_create_info, allocator, &compute_layout);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the particle pipeline layout \n");
+	}
+
+	VkShaderModuleCreateInfo shader_create_info = {};
+	shader_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shader_create_info.codeSize = shader_code.size();
+	shader_create_info.pCode = reinterpret_cast<const uint32_t*>(shader_code.data());
+
+	VkShaderModule shader_module;
+	result = vkCreateShaderModule(device, &shader_create_info, allocator, &shader_module);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the particle shader module \n");
+	}
+
+	// One module, the stage is a specialization constant so each pipeline keeps only its own branch
+	std::array<uint32_t, PARTICLE_STAGE_COUNT> stages = {};
+	std::array<VkSpecializationInfo, PARTICLE_STAGE_COUNT> specialization_infos = {};
+	std::array<VkComputePipelineCreateInfo, PARTICLE_STAGE_COUNT> pipeline_create_infos = {};
+
+	VkSpecializationMapEntry map_entry = {};
+	map_entry.constantID = 0;
+	map_entry.offset = 0;
+	map_entry.size = sizeof(uint32_t);
+
+	for (uint32_t stage = 0; stage < PARTICLE_STAGE_COUNT; stage++)
+	{
+		stages[stage] = stage;
+
+		specialization_infos[stage].mapEntryCount = 1;
+		specialization_infos[stage].pMapEntries = &map_entry;
+		specialization_infos[stage].dataSize = sizeof(uint32_t);
+		specialization_infos[stage].pData = &stages[stage];
+
+		pipeline_create_infos[stage].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipeline_create_infos[stage].stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipeline_create_infos[stage].stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipeline_create_infos[stage].stage.module = shader_module;
+		pipeline_create_infos[stage].stage.pName = "main";
+		pipeline_create_infos[stage].stage.pSpecializationInfo = &specialization_infos[stage];
+		pipeline_create_infos[stage].layout = compute_layout;
+	}
+
+	result = vkCreateComputePipelines(device, VK_NULL_HANDLE, PARTICLE_STAGE_COUNT, pipeline_create_infos.data(), allocator,
+		compute_pipelines.data());
+
+	vkDestroyShaderModule(device, shader_module, allocator);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the particle pipelines \n");
+	}
+}
+
+
+void particle_system::create_draw_layout(const std::vector<char>& vertex_code, const std::vector<char>& fragment_code)
+{
+	VkPushConstantRange push_constant_range = {};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(ParticleDrawPushConstants);
+
+	VkPipelineLayoutCreateInfo layout_create_info = {};
+	layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layout_create_info.setLayoutCount = 1;
+	layout_create_info.pSetLayouts = &set_layout;
+	layout_create_info.pushConstantRangeCount = 1;
+	layout_create_info.pPushConstantRanges = &push_constant_range;
+
+	VkResult result = vkCreatePipelineLayout(device, &layout_create_info, allocator, &draw_layout);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the particle draw layout \n");
+	}
+
+	VkShaderModuleCreateInfo shader_create_info = {};
+	shader_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shader_create_info.codeSize = vertex_code.size();
+	shader_create_info.pCode = reinterpret_cast<const uint32_t*>(vertex_code.data());
+
+	result = vkCreateShaderModule(device, &shader_create_info, allocator, &vertex_module);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the particle vertex shader module \n");
+	}
+
+	shader_create_info.codeSize = fragment_code.size();
+	shader_create_info.pCode = reinterpret_cast<const uint32_t*>(fragment_code.data());
+
+	result = vkCreateShaderModule(device, &shader_create_info, allocator, &fragment_module);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the particle fragment shader module \n");
+	}
+}
+
+
+void particle_system::create_readbacks(uint32_t queue_family, uint32_t frame_count)
+{
+	uint32_t family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+
+	std::vector<VkQueueFamilyProperties> families(family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+
+	uint32_t valid_bits = queue_family < family_count ? families[queue_family].timestampValidBits : 0;
+	timestamps_available = valid_bits > 0;
+
+	if (timestamps_available)
+	{
+		timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physical_device, &properties);
+		timestamp_period = properties.limits.timestampPeriod;
+
+		VkQueryPoolCreateInfo pool_create_info = {};
+		pool_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		pool_create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		pool_create_info.queryCount = frame_count * 2;
+
+		VkResult result = vkCreateQueryPool(device, &pool_create_info, allocator, &timestamp_pool);
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(" Error: Failed to create the particle timestamp pool \n");
+		}
+	}
+
+	readbacks.resize(frame_count);
+	for (ParticleReadback& readback : readbacks)
+	{
+		VkBufferCreateInfo buffer_create_info = {};
+		buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		buffer_create_info.size = sizeof(ParticleCounters);
+		buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkResult result = vkCreateBuffer(device, &buffer_create_info, allocator, &readback.buffer);
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(" Error: Failed to create a particle counter readback \n");
+		}
+
+		VkMemoryRequirements memory_requirements;
+		vkGetBufferMemoryRequirements(device, readback.buffer, &memory_requirements);
+
+		// Read on the CPU every frame, cached memory when the device has it
+		uint32_t memory_type;
+		try
+		{
+			memory_type = find_memory_type_index(physical_device, memory_requirements.memoryTypeBits,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+		}
+		catch (const std::runtime_error&)
+		{
+			memory_type = find_memory_type_index(physical_device, memory_requirements.memoryTypeBits,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		}
+
+		VkMemoryAllocateInfo allocate_info = {};
+		allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocate_info.allocationSize = memory_requirements.size;
+		allocate_info.memoryTypeIndex = memory_type;
+
+		result = tracker->allocate(&allocate_info, &readback.memory, "particle counter readback");
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(" Error: Failed to allocate a particle counter readback \n");
+		}
+
+		vkBindBufferMemory(device, readback.buffer, readback.memory, 0);
+		tracker->add_bound_bytes(readback.memory, sizeof(ParticleCounters));
+
+		result = vkMapMemory(device, readback.memory, 0, VK_WHOLE_SIZE, 0, &readback.mapped);
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(" Error: Failed to map a particle counter readback \n");
+		}
+	}
+}
+
+
+void particle_system::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+		return;
+
+	for (ParticleReadback& readback : readbacks)
+	{
+		vkUnmapMemory(device, readback.memory);
+		vkDestroyBuffer(device, readback.buffer, allocator);
+		tracker->free(readback.memory);
+	}
+	readbacks.clear();
+
+	if (available)
+	{
+		destroy_draw_pipeline();
+
+		if (timestamp_pool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(device, timestamp_pool, allocator);
+			timestamp_pool = VK_NULL_HANDLE;
+		}
+
+		for (VkPipeline pipeline : compute_pipelines)
+		{
+			vkDestroyPipeline(device, pipeline, allocator);
+		}
+		vkDestroyPipelineLayout(device, draw_layout, allocator);
+		vkDestroyPipelineLayout(device, compute_layout, allocator);
+		vkDestroyDescriptorSetLayout(device, set_layout, allocator);
+		vkDestroyShaderModule(device, fragment_module, allocator);
+		vkDestroyShaderModule(device, vertex_module, allocator);
+
+		destroy_buffers();
+	}
+
+	available = false;
+	device = VK_NULL_HANDLE;
+}
+
+
+bool particle_system::is_available()
+{
+	return available;
+}
+
+
+void particle_system::set_enabled(bool enable)
+{
+	enabled = enable;
+}
+
+
+bool particle_system::is_enabled()
+{
+	return enabled;
+}
+
+
+void particle_system::set_capacity(uint32_t new_capacity)
+{
+	capacity = new_capacity;
+
+	if (!available)
+		return;
+
+	destroy_buffers();
+	create_buffers();
+
+	// Sets cached with the old buffers may not be handed out for new buffers that reuse their handles
+	descriptors->clear_cache(set_layout);
+
+	reset();
+}
+
+
+uint32_t particle_system::get_capacity()
+{
+	return capacity;
+}
+
+
+void particle_system::reset()
+{
+	needs_reset = true;
+	source_index = 0;
+	emit_remainder = 0.0f;
+	clock_started = false;
+
+	for (ParticleReadback& readback : readbacks)
+	{
+		readback.recorded = false;
+	}
+}
+
+
+void particle_system::set_emitter(const ParticleEmitter& new_emitter)
+{
+	emitter = new_emitter;
+}
+
+
+const ParticleEmitter& particle_system::get_emitter()
+{
+	return emitter;
+}
+
+
+void particle_system::set_fixed_time_step(float seconds)
+{
+	fixed_time_step = seconds;
+}
+
+
+VkBuffer particle_system::get_particle_buffer()
+{
+	return particle_buffer;
+}
+
+
+VkBuffer particle_system::get_counter_buffer()
+{
+	return counter_buffer;
+}
+
+
+void particle_system::create_draw_pipeline(VkRenderPass render_pass, const VkPipelineRenderingCreateInfoKHR* rendering_info,
+	VkSampleCountFlagBits samples)
+{
+	if (!available)
+		return;
+
+	VkPipelineShaderStageCreateInfo shader_stages[2] = {};
+	shader_stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shader_stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shader_stages[0].module = vertex_module;
+	shader_stages[0].pName = "main";
+	shader_stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shader_stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shader_stages[1].module = fragment_module;
+	shader_stages[1].pName = "main";
+
+	// Quad corners come from the vertex index, the particle from the instance index
+	VkPipelineVertexInputStateCreateInfo vertex_input_state_info = {};
+	vertex_input_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	VkPipelineInputAssemblyStateCreateInfo input_assembly_info = {};
+	input_assembly_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	input_assembly_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	input_assembly_info.primitiveRestartEnable = VK_FALSE;
+
+	VkPipelineViewportStateCreateInfo viewport_create_info = {};
+	viewport_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewport_create_info.viewportCount = 1;
+	viewport_create_info.scissorCount = 1;
+
+	// Set by the pass for the window being drawn
+	VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+	VkPipelineDynamicStateCreateInfo dynamic_state_create_info = {};
+	dynamic_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamic_state_create_info.dynamicStateCount = 2;
+	dynamic_state_create_info.pDynamicStates = dynamic_states;
+
+	// Billboards always face the camera, no culling
+	VkPipelineRasterizationStateCreateInfo rasterizer_create_info = {};
+	rasterizer_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer_create_info.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer_create_info.lineWidth = 1.0f;
+	rasterizer_create_info.cullMode = VK_CULL_MODE_NONE;
+	rasterizer_create_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling_create_info = {};
+	multisampling_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling_create_info.rasterizationSamples = samples;
+
+	// Additive, so the order the particles land in does not matter and nothing is sorted
+	VkPipelineColorBlendAttachmentState blend_attach_state = {};
+	blend_attach_state.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT
+		| VK_COLOR_COMPONENT_A_BIT;
+	blend_attach_state.blendEnable = VK_TRUE;
+	blend_attach_state.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	blend_attach_state.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	blend_attach_state.colorBlendOp = VK_BLEND_OP_ADD;
+	blend_attach_state.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	blend_attach_state.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	blend_attach_state.alphaBlendOp = VK_BLEND_OP_ADD;
+
+	VkPipelineColorBlendStateCreateInfo color_blend_state_create_info = {};
+	color_blend_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	color_blend_state_create_info.logicOpEnable = VK_FALSE;
+	color_blend_state_create_info.attachmentCount = 1;
+	color_blend_state_create_info.pAttachments = &blend_attach_state;
+
+	// Hidden behind the scene, but they do not hide each other
+	VkPipelineDepthStencilStateCreateInfo depth_stencil_create_info = {};
+	depth_stencil_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depth_stencil_create_info.depthTestEnable = VK_TRUE;
+	depth_stencil_create_info.depthWriteEnable = VK_FALSE;
+	depth_stencil_create_info.depthCompareOp = VK_COMPARE_OP_LESS;
+
+	VkGraphicsPipelineCreateInfo pipeline_create_info = {};
+	pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipeline_create_info.pNext = rendering_info;
+	pipeline_create_info.stageCount = 2;
+	pipeline_create_info.pStages = shader_stages;
+	pipeline_create_info.pVertexInputState = &vertex_input_state_info;
+	pipeline_create_info.pInputAssemblyState = &input_assembly_info;
+	pipeline_create_info.pViewportState = &viewport_create_info;
+	pipeline_create_info.pDynamicState = &dynamic_state_create_info;
+	pipeline_create_info.pRasterizationState = &rasterizer_create_info;
+	pipeline_create_info.pMultisampleState = &multisampling_create_info;
+	pipeline_create_info.pColorBlendState = &color_blend_state_create_info;
+	pipeline_create_info.pDepthStencilState = &depth_stencil_create_info;
+	pipeline_create_info.layout = draw_layout;
+	pipeline_create_info.renderPass = rendering_info != nullptr ? VK_NULL_HANDLE : render_pass;
+	pipeline_create_info.subpass = 0;
+
+	VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, allocator, &draw_pipeline);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the particle draw pipeline \n");
+	}
+}
+
+
+void particle_system::destroy_draw_pipeline()
+{
+	if (draw_pipeline != VK_NULL_HANDLE)
+	{
+		vkDestroyPipeline(device, draw_pipeline, allocator);
+		draw_pipeline = VK_NULL_HANDLE;
+	}
+}
+
+
+VkDescriptorSet particle_system::get_set(uint32_t source)
+{
+	DescriptorBinding bindings[5];
+	for (uint32_t binding = 0; binding < 4; binding++)
+	{
+		bindings[binding].binding = binding;
+		bindings[binding].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[binding].buffer_info.buffer = particle_buffer;
+		bindings[binding].buffer_info.offset = section_offsets[binding];
+		bindings[binding].buffer_info.range = section_sizes[binding];
+	}
+
+	// Source list, then the list the survivors go to
+	bindings[1].buffer_info.offset = section_offsets[1 + source];
+	bindings[2].buffer_info.offset = section_offsets[2 - source];
+
+	bindings[4].binding = 4;
+	bindings[4].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[4].buffer_info.buffer = counter_buffer;
+	bindings[4].buffer_info.offset = 0;
+	bindings[4].buffer_info.range = sizeof(ParticleCounters);
+
+	return descriptors->get_cached(set_layout, bindings, 5);
+}
+
+
+float particle_system::next_time_step()
+{
+	if (fixed_time_step > 0.0f)
+		return fixed_time_step;
+
+	auto now = std::chrono::steady_clock::now();
+	float seconds = clock_started ? std::chrono::duration<float>(now - last_time).count() : 0.0f;
+
+	last_time = now;
+	clock_started = true;
+
+	return std::min(seconds, MAX_TIME_STEP);
+}
+
+
+void particle_system::record_simulation(VkCommandBuffer command_buffer, uint32_t frame_slot)
+{
+	if (!available)
+		return;
+
+	ParticleReadback& readback = readbacks[frame_slot];
+
+	if (timestamps_available)
+	{
+		vkCmdResetQueryPool(command_buffer, timestamp_pool, frame_slot * 2, 2);
+		vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamp_pool, frame_slot * 2);
+	}
+
+	// Fractions of a particle are carried over, a low rate still emits at high frame rates
+	float time_step = next_time_step();
+	float emit_exact = emitter.rate * time_step + emit_remainder;
+	uint32_t emit_count = static_cast<uint32_t>(std::min(emit_exact, static_cast<float>(capacity)));
+	emit_remainder = emit_count < capacity ? emit_exact - static_cast<float>(emit_count) : 0.0f;
+
+	ParticlePushConstants push_constants = {};
+	push_constants.emitter[0] = emitter.position[0];
+	push_constants.emitter[1] = emitter.position[1];
+	push_constants.emitter[2] = emitter.position[2];
+	push_constants.emitter[3] = emitter.radius;
+	push_constants.gravity[0] = emitter.gravity[0];
+	push_constants.gravity[1] = emitter.gravity[1];
+	push_constants.gravity[2] = emitter.gravity[2];
+	push_constants.gravity[3] = time_step;
+	push_constants.emit_count = emit_count;
+	push_constants.source_index = source_index;
+	push_constants.capacity = capacity;
+	push_constants.seed = seed++ * 2654435761u;
+	push_constants.lifetime = emitter.lifetime;
+	push_constants.speed = emitter.speed;
+
+	VkDescriptorSet descriptor_set = get_set(source_index);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_layout, 0, 1, &descriptor_set, 0, nullptr);
+	vkCmdPushConstants(command_buffer, compute_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ParticlePushConstants), &push_constants);
+
+	// Everything dead, once after init or a capacity change
+	if (needs_reset)
+	{
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipelines[static_cast<uint32_t>(ParticleStage::reset)]);
+		vkCmdDispatch(command_buffer, capacity / PARTICLE_GROUP_SIZE, 1, 1);
+		stage_barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+		needs_reset = false;
+	}
+
+	if (emit_count > 0)
+	{
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipelines[static_cast<uint32_t>(ParticleStage::emit)]);
+		vkCmdDispatch(command_buffer, (emit_count + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE, 1, 1);
+		stage_barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	}
+
+	// A single invocation turns the alive count into the group count of the simulation
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipelines[static_cast<uint32_t>(ParticleStage::prepare)]);
+	vkCmdDispatch(command_buffer, 1, 1, 1);
+	stage_barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+		VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipelines[static_cast<uint32_t>(ParticleStage::simulate)]);
+	vkCmdDispatchIndirect(command_buffer, counter_buffer, 0);
+
+	if (timestamps_available)
+	{
+		vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamp_pool, frame_slot * 2 + 1);
+	}
+
+	// The counts are copied out for the stats, the particles themselves never leave the GPU
+	stage_barrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+	VkBufferCopy copy_region = {};
+	copy_region.size = sizeof(ParticleCounters);
+	vkCmdCopyBuffer(command_buffer, counter_buffer, readback.buffer, 1, &copy_region);
+
+	// Compute waits as well, the next frame's simulation writes the counters this copy reads
+	VkBufferMemoryBarrier buffer_barrier = {};
+	buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	buffer_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	buffer_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	buffer_barrier.buffer = readback.buffer;
+	buffer_barrier.offset = 0;
+	buffer_barrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &buffer_barrier, 0, nullptr);
+
+	// The survivors are drawn this frame and simulated the next
+	source_index = 1 - source_index;
+
+	readback.draw_index = source_index;
+	readback.emitted = emit_count;
+	readback.recorded = true;
+}
+
+
+void particle_system::record_draw(VkCommandBuffer command_buffer, const glm::mat4& view, const glm::mat4& view_projection)
+{
+	// Nothing to draw before the first simulation has filled the counters
+	if (!available || draw_pipeline == VK_NULL_HANDLE || needs_reset)
+		return;
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw_pipeline);
+
+	// The set of the simulation just recorded, its target list is bound where the vertex shader reads it
+	VkDescriptorSet descriptor_set = get_set(1 - source_index);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw_layout, 0, 1, &descriptor_set, 0, nullptr);
+
+	// Rows of the view rotation are the camera axes in world space
+	ParticleDrawPushConstants push_constants = {};
+	push_constants.view_projection = view_projection;
+	push_constants.camera_right[0] = view[0][0];
+	push_constants.camera_right[1] = view[1][0];
+	push_constants.camera_right[2] = view[2][0];
+	push_constants.camera_right[3] = emitter.size;
+	push_constants.camera_up[0] = view[0][1];
+	push_constants.camera_up[1] = view[1][1];
+	push_constants.camera_up[2] = view[2][1];
+
+	vkCmdPushConstants(command_buffer, draw_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ParticleDrawPushConstants), &push_constants);
+
+	// Six vertices, as many instances as survived the simulation
+	VkDeviceSize draw_offset = offsetof(ParticleCounters, draws) + source_index * sizeof(VkDrawIndirectCommand);
+	vkCmdDrawIndirect(command_buffer, counter_buffer, draw_offset, 1, sizeof(VkDrawIndirectCommand));
+}
+
+
+void particle_system::frame_complete(uint32_t frame_slot)
+{
+	stats.alive = 0;
+	stats.emitted = 0;
+	stats.gpu_ms = 0.0;
+
+	if (frame_slot >= readbacks.size() || !readbacks[frame_slot].recorded)
+		return;
+
+	ParticleReadback& readback = readbacks[frame_slot];
+
+	VkMappedMemoryRange range = {};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = readback.memory;
+	range.offset = 0;
+	range.size = VK_WHOLE_SIZE;
+	vkInvalidateMappedMemoryRanges(device, 1, &range);
+
+	ParticleCounters counters;
+	memcpy(&counters, readback.mapped, sizeof(ParticleCounters));
+
+	// The source list keeps its length, only the target list is cleared by the next prepare
+	stats.alive = counters.draws[readback.draw_index].instanceCount;
+	stats.emitted = readback.emitted;
+	stats.frames++;
+	stats.total_simulated += counters.draws[1 - readback.draw_index].instanceCount;
+
+	if (timestamps_available)
+	{
+		uint64_t timestamps[2] = {};
+		VkResult result = vkGetQueryPoolResults(device, timestamp_pool, frame_slot * 2, 2, sizeof(timestamps), timestamps,
+			sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+		if (result == VK_SUCCESS)
+		{
+			uint64_t ticks = (timestamps[1] - timestamps[0]) & timestamp_mask;
+			stats.gpu_ms = static_cast<double>(ticks) * timestamp_period / 1000000.0;
+			stats.total_gpu_ms += stats.gpu_ms;
+		}
+	}
+
+	readback.recorded = false;
+}
+
+
+const ParticleStats& particle_system::get_stats()
+{
+	return stats;
+}
+
+
+void particle_system::print_stats()
+{
+	if (!available)
+		return;
+
+	printf("Particles : %u capacity, %u alive, %u emitted last frame \n", stats.capacity, stats.alive, stats.emitted);
+
+	if (stats.frames > 0 && stats.total_gpu_ms > 0.0)
+	{
+		double average_ms = stats.total_gpu_ms / static_cast<double>(stats.frames);
+		double per_second = static_cast<double>(stats.total_simulated) / (stats.total_gpu_ms / 1000.0);
+
+		printf("Particles : %.3f ms GPU per frame over %llu frames, %.1f million particles simulated per GPU second \n",
+			average_ms, (unsigned long long)stats.frames, per_second / 1000000.0);
+	}
+}
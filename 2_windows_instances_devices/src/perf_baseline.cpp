@@ -0,0 +1,167 @@
+#include "..\headers\perf_baseline.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+
+perf_baseline::perf_baseline()
+{
+}
+
+
+void perf_baseline::load(const std::string& file)
+{
+	std::ifstream input(file);
+	if (!input.is_open())
+	{
+		throw std::runtime_error(" Error: Failed to open the performance baseline " + file + " \n");
+	}
+
+	metrics.clear();
+	comments.clear();
+
+	std::string line;
+	uint32_t line_number = 0;
+	while (std::getline(input, line))
+	{
+		line_number++;
+
+		std::istringstream fields(line);
+		std::string name;
+		if (!(fields >> name))
+			continue;
+
+		if (name[0] == '#')
+		{
+			comments.push_back(line);
+			continue;
+		}
+
+		PerfMetric metric;
+		metric.name = name;
+
+		if (!(fields >> metric.value >> metric.tolerance) || metric.tolerance < 0.0)
+		{
+			throw std::runtime_error(" Error: Line " + std::to_string(line_number) + " of " + file +
+				" is not a name, a value and a tolerance \n");
+		}
+
+		metrics.push_back(metric);
+	}
+}
+
+
+void perf_baseline::save(const std::string& file)
+{
+	std::ofstream output(file, std::ios::trunc);
+	if (!output.is_open())
+	{
+		throw std::runtime_error(" Error: Failed to write the performance baseline " + file + " \n");
+	}
+
+	if (comments.empty())
+	{
+		output << "# name value tolerance_percent, written by --perf-write-baseline\n";
+	}
+	for (const std::string& comment : comments)
+	{
+		output << comment << "\n";
+	}
+
+	char line[256];
+	for (const PerfMetric& metric : metrics)
+	{
+		snprintf(line, sizeof(line), "%-40s %-14.4f %.1f\n", metric.name.c_str(), metric.value, metric.tolerance);
+		output << line;
+	}
+
+	printf("Performance baseline written to %s \n", file.c_str());
+}
+
+
+void perf_baseline::set(const std::string& name, double value, double tolerance)
+{
+	for (PerfMetric& metric : metrics)
+	{
+		if (metric.name == name)
+		{
+			metric.value = value;
+			return;
+		}
+	}
+
+	PerfMetric metric;
+	metric.name = name;
+	metric.value = value;
+	metric.tolerance = tolerance;
+	metrics.push_back(metric);
+}
+
+
+const PerfMetric* perf_baseline::find(const std::string& name) const
+{
+	for (const PerfMetric& metric : metrics)
+	{
+		if (metric.name == name)
+			return &metric;
+	}
+
+	return nullptr;
+}
+
+
+const std::vector<PerfMetric>& perf_baseline::get_metrics() const
+{
+	return metrics;
+}
+
+
+void perf_baseline::update(const perf_baseline& measured)
+{
+	for (const PerfMetric& metric : measured.metrics)
+	{
+		set(metric.name, metric.value, metric.tolerance);
+	}
+}
+
+
+uint32_t perf_baseline::compare(const perf_baseline& measured) const
+{
+	uint32_t failures = 0;
+
+	printf("metric                                   baseline       measured       change    limit \n");
+
+	for (const PerfMetric& metric : measured.metrics)
+	{
+		const PerfMetric* expected = find(metric.name);
+		if (expected == nullptr)
+		{
+			failures++;
+			printf("%-40s %-14s %-14.4f %-9s %-6s not in baseline, FAILED \n", metric.name.c_str(), "-", metric.value, "", "");
+			continue;
+		}
+
+		double limit = expected->value * (1.0 + expected->tolerance / 100.0);
+		bool regressed = metric.value > limit;
+		if (regressed)
+			failures++;
+
+		char change[32] = "";
+		if (expected->value > 0.0)
+			snprintf(change, sizeof(change), "%+.1f%%", (metric.value - expected->value) * 100.0 / expected->value);
+
+		printf("%-40s %-14.4f %-14.4f %-9s %-5.1f%% %s \n", metric.name.c_str(), expected->value, metric.value, change,
+			expected->tolerance, regressed ? "REGRESSION" : "ok");
+	}
+
+	for (const PerfMetric& metric : metrics)
+	{
+		if (measured.find(metric.name) == nullptr)
+		{
+			failures++;
+			printf("%-40s %-14.4f %-14s %-9s %-6s not measured, FAILED \n", metric.name.c_str(), metric.value, "-", "", "");
+		}
+	}
+
+	return failures;
+}
@@ -0,0 +1,590 @@
+#include "..\headers\post_process.h"
+
+#include <algorithm>
+
+// Invocations per side of a group in all three shaders
+static const uint32_t POST_GROUP_SIZE = 8;
+
+
+post_process::post_process()
+{
+}
+
+
+void post_process::init(VkPhysicalDevice physical_device, VkDevice new_device, uint32_t queue_family, uint32_t frame_count,
+	const std::vector<char>& downsample_code, const std::vector<char>& upsample_code, const std::vector<char>& tonemap_code,
+	descriptor_allocator* new_descriptors, const VkAllocationCallbacks* new_allocator)
+{
+	device = new_device;
+	descriptors = new_descriptors;
+	allocator = new_allocator;
+
+	if (downsample_code.empty() || upsample_code.empty() || tonemap_code.empty())
+	{
+		printf("Post-processing is not available, bloom_downsample.spv, bloom_upsample.spv or tonemap.spv is missing \n");
+		return;
+	}
+
+	create_pipelines(downsample_code, upsample_code, tonemap_code);
+	create_timestamps(physical_device, queue_family, frame_count);
+
+	available = true;
+
+	printf("Post-processing creation is  a success \n");
+}
+
+
+void post_process::create_pipelines(const std::vector<char>& downsample_code, const std::vector<char>& upsample_code,
+	const std::vector<char>& tonemap_code)
+{
+	VkDescriptorSetLayoutBinding bindings[3] = {};
+	for (uint32_t binding = 0; binding < 3; binding++)
+	{
+		bindings[binding].binding = binding;
+		bindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[binding].descriptorCount = 1;
+		bindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo set_layout_create_info = {};
+	set_layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	set_layout_create_info.bindingCount = 3;
+	set_layout_create_info.pBindings = bindings;
+
+	VkResult result = vkCreateDescriptorSetLayout(device, &set_layout_create_info, allocator, &set_layout);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the post-processing set layout \n");
+	}
+
+	VkPushConstantRange push_constant_range = {};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(PostPushConstants);
+
+	VkPipelineLayoutCreateInfo layout_create_info = {};
+	layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layout_create_info.setLayoutCount = 1;
+	layout_create_info.pSetLayouts = &set_layout;
+	layout_create_info.pushConstantRangeCount = 1;
+	layout_create_info.pPushConstantRanges = &push_constant_range;
+
+	result = vkCreatePipelineLayout(device, &layout_create_info, allocator, &pipeline_layout);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the post-processing pipeline layout \n");
+	}
+
+	const std::vector<char>* shader_codes[3] = { &downsample_code, &upsample_code, &tonemap_code };
+	VkShaderModule shader_modules[3] = {};
+
+	for (uint32_t shader = 0; shader < 3; shader++)
+	{
+		VkShaderModuleCreateInfo shader_create_info = {};
+		shader_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		shader_create_info.codeSize = shader_codes[shader]->size();
+		shader_create_info.pCode = reinterpret_cast<const uint32_t*>(shader_codes[shader]->data());
+
+		result = vkCreateShaderModule(device, &shader_create_info, allocator, &shader_modules[shader]);
+
+		if (result != VK_SUCCESS)
+		{
+			for (uint32_t created = 0; created < shader; created++)
+			{
+				vkDestroyShaderModule(device, shader_modules[created], allocator);
+			}
+			throw std::runtime_error(" Error: Failed to create a post-processing shader module \n");
+		}
+	}
+
+	// The prefilter is the downsample with its threshold switched on by a specialization constant
+	VkBool32 prefilter = VK_TRUE;
+
+	VkSpecializationMapEntry map_entry = {};
+	map_entry.constantID = 0;
+	map_entry.offset = 0;
+	map_entry.size = sizeof(VkBool32);
+
+	VkSpecializationInfo specialization_info = {};
+	specialization_info.mapEntryCount = 1;
+	specialization_info.pMapEntries = &map_entry;
+	specialization_info.dataSize = sizeof(VkBool32);
+	specialization_info.pData = &prefilter;
+
+	// Indexed by PostStage
+	VkShaderModule stage_modules[POST_STAGE_COUNT] = { shader_modules[0], shader_modules[0], shader_modules[1], shader_modules[2] };
+
+	std::array<VkComputePipelineCreateInfo, POST_STAGE_COUNT> pipeline_create_infos = {};
+	for (uint32_t stage = 0; stage < POST_STAGE_COUNT; stage++)
+	{
+		pipeline_create_infos[stage].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipeline_create_infos[stage].stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipeline_create_infos[stage].stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipeline_create_infos[stage].stage.module = stage_modules[stage];
+		pipeline_create_infos[stage].stage.pName = "main";
+		pipeline_create_infos[stage].layout = pipeline_layout;
+	}
+	pipeline_create_infos[static_cast<uint32_t>(PostStage::prefilter)].stage.pSpecializationInfo = &specialization_info;
+
+	pipelines.resize(POST_STAGE_COUNT);
+	result = vkCreateComputePipelines(device, VK_NULL_HANDLE, POST_STAGE_COUNT, pipeline_create_infos.data(), allocator,
+		pipelines.data());
+
+	for (VkShaderModule shader_module : shader_modules)
+	{
+		vkDestroyShaderModule(device, shader_module, allocator);
+	}
+
+	if (result != VK_SUCCESS)
+	{
+		pipelines.clear();
+		throw std::runtime_error(" Error: Failed to create the post-processing pipelines \n");
+	}
+}
+
+
+void post_process::create_timestamps(VkPhysicalDevice physical_device, uint32_t queue_family, uint32_t frame_count)
+{
+	frames.resize(frame_count);
+
+	uint32_t family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+
+	std::vector<VkQueueFamilyProperties> families(family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+
+	uint32_t valid_bits = queue_family < family_count ? families[queue_family].timestampValidBits : 0;
+	timestamps_available = valid_bits > 0;
+
+	if (!timestamps_available)
+		return;
+
+	timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	timestamp_period = properties.limits.timestampPeriod;
+
+	for (PostFrame& frame : frames)
+	{
+		VkQueryPoolCreateInfo pool_create_info = {};
+		pool_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		pool_create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		pool_create_info.queryCount = POST_MAX_TIMED_PASSES * 2;
+
+		VkResult result = vkCreateQueryPool(device, &pool_create_info, allocator, &frame.pool);
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(" Error: Failed to create the post-processing timestamp pool \n");
+		}
+	}
+}
+
+
+void post_process::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+		return;
+
+	for (PostFrame& frame : frames)
+	{
+		if (frame.pool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(device, frame.pool, allocator);
+		}
+	}
+	frames.clear();
+
+	for (VkPipeline pipeline : pipelines)
+	{
+		vkDestroyPipeline(device, pipeline, allocator);
+	}
+	pipelines.clear();
+
+	if (pipeline_layout != VK_NULL_HANDLE)
+	{
+		vkDestroyPipelineLayout(device, pipeline_layout, allocator);
+		pipeline_layout = VK_NULL_HANDLE;
+	}
+
+	if (set_layout != VK_NULL_HANDLE)
+	{
+		vkDestroyDescriptorSetLayout(device, set_layout, allocator);
+		set_layout = VK_NULL_HANDLE;
+	}
+
+	available = false;
+	device = VK_NULL_HANDLE;
+}
+
+
+bool post_process::is_available()
+{
+	return available;
+}
+
+
+void post_process::set_settings(const PostSettings& new_settings)
+{
+	settings = new_settings;
+	settings.bloom_levels = std::min(settings.bloom_levels, POST_MAX_BLOOM_LEVELS);
+}
+
+
+const PostSettings& post_process::get_settings()
+{
+	return settings;
+}
+
+
+uint32_t post_process::get_bloom_levels(VkExtent2D extent)
+{
+	uint32_t levels = 0;
+	uint32_t width = extent.width / 2;
+	uint32_t height = extent.height / 2;
+
+	while (levels < settings.bloom_levels && width >= POST_MIN_BLOOM_SIZE && height >= POST_MIN_BLOOM_SIZE)
+	{
+		levels++;
+		width /= 2;
+		height /= 2;
+	}
+
+	return levels;
+}
+
+
+void post_process::add_passes(render_graph* graph, uint32_t hdr_image, uint32_t output, VkExtent2D extent)
+{
+	if (!available)
+	{
+		throw std::runtime_error(" Error: Post-processing is not available \n");
+	}
+
+	uint32_t levels = get_bloom_levels(extent);
+
+	// Level i is half the size of level i - 1, level 0 half the size of the HDR target
+	std::vector<VkExtent2D> level_extents(levels);
+	std::vector<uint32_t> down_images(levels);
+	std::vector<uint32_t> up_images(levels);
+
+	VkExtent2D level_extent = extent;
+	for (uint32_t level = 0; level < levels; level++)
+	{
+		level_extent.width = std::max(level_extent.width / 2, 1u);
+		level_extent.height = std::max(level_extent.height / 2, 1u);
+		level_extents[level] = level_extent;
+
+		RenderGraphImageInfo level_info = {};
+		level_info.format = POST_HDR_FORMAT;
+		level_info.extent = level_extent;
+		down_images[level] = graph->add_image("bloom down " + std::to_string(level), level_info);
+
+		// The smallest level is not blurred further, the upsample starts from it
+		if (level + 1 < levels)
+		{
+			up_images[level] = graph->add_image("bloom up " + std::to_string(level), level_info);
+		}
+	}
+
+	for (uint32_t level = 0; level < levels; level++)
+	{
+		uint32_t source = level == 0 ? hdr_image : down_images[level - 1];
+		uint32_t target = down_images[level];
+		VkExtent2D source_extent = level == 0 ? extent : level_extents[level - 1];
+		VkExtent2D target_extent = level_extents[level];
+		PostStage stage = level == 0 ? PostStage::prefilter : PostStage::downsample;
+
+		std::string name = level == 0 ? "bloom prefilter" : "bloom downsample " + std::to_string(level);
+		uint32_t timing = add_timing(name);
+
+		uint32_t pass = graph->add_pass(name, PassType::compute);
+		graph->add_storage_input(pass, source);
+		graph->add_storage_output(pass, target);
+		graph->set_record(pass, [this, source, target, source_extent, target_extent, stage, timing](VkCommandBuffer command_buffer,
+			render_graph& frame_graph, uint32_t) {
+			bool timed = begin_timing(command_buffer, timing);
+			VkImageView source_view = frame_graph.get_image_view(source);
+			dispatch(command_buffer, stage, source_view, source_view, frame_graph.get_image_view(target), source_extent, target_extent);
+			if (timed)
+				end_timing(command_buffer);
+		});
+	}
+
+	// Up level i is down level i plus the blurred up level i + 1, going back towards the full size
+	for (uint32_t level = levels > 0 ? levels - 1 : 0; level-- > 0;)
+	{
+		uint32_t source = level + 2 == levels ? down_images[level + 1] : up_images[level + 1];
+		uint32_t detail = down_images[level];
+		uint32_t target = up_images[level];
+		VkExtent2D source_extent = level_extents[level + 1];
+		VkExtent2D target_extent = level_extents[level];
+
+		std::string name = "bloom upsample " + std::to_string(level);
+		uint32_t timing = add_timing(name);
+
+		uint32_t pass = graph->add_pass(name, PassType::compute);
+		graph->add_storage_input(pass, source);
+		graph->add_storage_input(pass, detail);
+		graph->add_storage_output(pass, target);
+		graph->set_record(pass, [this, source, detail, target, source_extent, target_extent, timing](VkCommandBuffer command_buffer,
+			render_graph& frame_graph, uint32_t) {
+			bool timed = begin_timing(command_buffer, timing);
+			dispatch(command_buffer, PostStage::upsample, frame_graph.get_image_view(source), frame_graph.get_image_view(detail),
+				frame_graph.get_image_view(target), source_extent, target_extent);
+			if (timed)
+				end_timing(command_buffer);
+		});
+	}
+
+	// Without bloom the HDR target is bound in its place, the intensity of zero skips reading it
+	uint32_t bloom = hdr_image;
+	VkExtent2D bloom_extent = extent;
+	if (levels == 1)
+	{
+		bloom = down_images[0];
+		bloom_extent = level_extents[0];
+	}
+	else if (levels > 1)
+	{
+		bloom = up_images[0];
+		bloom_extent = level_extents[0];
+	}
+
+	RenderGraphImageInfo ldr_info = {};
+	ldr_info.format = POST_LDR_FORMAT;
+	ldr_info.extent = extent;
+	uint32_t ldr_image = graph->add_image("ldr", ldr_info);
+
+	uint32_t tonemap_timing = add_timing("tonemap");
+	uint32_t tonemap_pass = graph->add_pass("tonemap", PassType::compute);
+	graph->add_storage_input(tonemap_pass, hdr_image);
+	if (bloom != hdr_image)
+	{
+		graph->add_storage_input(tonemap_pass, bloom);
+	}
+	graph->add_storage_output(tonemap_pass, ldr_image);
+	graph->set_record(tonemap_pass, [this, hdr_image, bloom, ldr_image, bloom_extent, extent, tonemap_timing](
+		VkCommandBuffer command_buffer, render_graph& frame_graph, uint32_t) {
+		bool timed = begin_timing(command_buffer, tonemap_timing);
+		dispatch(command_buffer, PostStage::tonemap, frame_graph.get_image_view(hdr_image), frame_graph.get_image_view(bloom),
+			frame_graph.get_image_view(ldr_image), bloom_extent, extent);
+		if (timed)
+			end_timing(command_buffer);
+	});
+
+	// Swap chain formats are rarely usable as storage images, the tone mapped image is blitted into them instead
+	uint32_t copy_timing = add_timing("present copy");
+	uint32_t copy_pass = graph->add_pass("present copy", PassType::transfer);
+	graph->add_transfer_input(copy_pass, ldr_image);
+	graph->add_transfer_output(copy_pass, output);
+	graph->set_record(copy_pass, [this, ldr_image, output, extent, copy_timing](VkCommandBuffer command_buffer,
+		render_graph& frame_graph, uint32_t image_index) {
+		bool timed = begin_timing(command_buffer, copy_timing);
+
+		VkImageBlit blit_region = {};
+		blit_region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit_region.srcSubresource.layerCount = 1;
+		blit_region.srcOffsets[1] = { static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1 };
+		blit_region.dstSubresource = blit_region.srcSubresource;
+		blit_region.dstOffsets[1] = blit_region.srcOffsets[1];
+
+		// Same size, only the channel order and format change
+		vkCmdBlitImage(command_buffer, frame_graph.get_image(ldr_image), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			frame_graph.get_image(output, image_index), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit_region, VK_FILTER_NEAREST);
+
+		if (timed)
+			end_timing(command_buffer);
+	});
+}
+
+
+void post_process::dispatch(VkCommandBuffer command_buffer, PostStage stage, VkImageView source, VkImageView second_source,
+	VkImageView target, VkExtent2D source_extent, VkExtent2D target_extent)
+{
+	// Every binding is written, the shaders that use only two of them still get a valid set
+	DescriptorBinding bindings[3];
+	VkImageView views[3] = { source, second_source, target };
+	for (uint32_t binding = 0; binding < 3; binding++)
+	{
+		bindings[binding].binding = binding;
+		bindings[binding].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[binding].image_info.imageView = views[binding];
+		bindings[binding].image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	}
+
+	// The views of transient images change with every graph rebuild, so the sets live for one frame
+	VkDescriptorSet descriptor_set = descriptors->allocate(set_layout, bindings, 3);
+
+	PostPushConstants push_constants = {};
+	push_constants.source_size[0] = static_cast<int32_t>(source_extent.width);
+	push_constants.source_size[1] = static_cast<int32_t>(source_extent.height);
+	push_constants.target_size[0] = static_cast<int32_t>(target_extent.width);
+	push_constants.target_size[1] = static_cast<int32_t>(target_extent.height);
+	push_constants.threshold = settings.bloom_threshold;
+	push_constants.knee = settings.bloom_knee;
+	push_constants.intensity = source == second_source && stage == PostStage::tonemap ? 0.0f : settings.bloom_intensity;
+	push_constants.exposure = settings.exposure;
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[static_cast<uint32_t>(stage)]);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
+	vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PostPushConstants), &push_constants);
+
+	vkCmdDispatch(command_buffer, (target_extent.width + POST_GROUP_SIZE - 1) / POST_GROUP_SIZE,
+		(target_extent.height + POST_GROUP_SIZE - 1) / POST_GROUP_SIZE, 1);
+}
+
+
+uint32_t post_process::add_timing(const std::string& name)
+{
+	// Windows share the entry of a pass with the same name
+	for (uint32_t timing = 0; timing < timings.size(); timing++)
+	{
+		if (timings[timing].name == name)
+			return timing;
+	}
+
+	PostPassTiming timing;
+	timing.name = name;
+	timings.push_back(timing);
+
+	return static_cast<uint32_t>(timings.size() - 1);
+}
+
+
+bool post_process::begin_timing(VkCommandBuffer command_buffer, uint32_t timing)
+{
+	PostFrame& frame = frames[current_frame];
+
+	if (!timestamps_available || frame.timings.size() >= POST_MAX_TIMED_PASSES)
+		return false;
+
+	uint32_t query = static_cast<uint32_t>(frame.timings.size()) * 2;
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.pool, query);
+
+	frame.timings.push_back(timing);
+	frame.recorded = true;
+
+	return true;
+}
+
+
+void post_process::end_timing(VkCommandBuffer command_buffer)
+{
+	PostFrame& frame = frames[current_frame];
+
+	uint32_t query = static_cast<uint32_t>(frame.timings.size()) * 2 - 1;
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.pool, query);
+}
+
+
+void post_process::begin_frame(VkCommandBuffer command_buffer, uint32_t frame_slot)
+{
+	if (!available || frame_slot >= frames.size())
+		return;
+
+	current_frame = frame_slot;
+	PostFrame& frame = frames[frame_slot];
+
+	if (frame.recorded)
+	{
+		resolve_frame(frame);
+	}
+
+	frame.timings.clear();
+	frame.recorded = false;
+
+	if (timestamps_available)
+	{
+		vkCmdResetQueryPool(command_buffer, frame.pool, 0, POST_MAX_TIMED_PASSES * 2);
+	}
+}
+
+
+void post_process::resolve_frame(PostFrame& frame)
+{
+	uint32_t query_count = static_cast<uint32_t>(frame.timings.size()) * 2;
+	results.resize(query_count);
+
+	VkResult result = vkGetQueryPoolResults(device, frame.pool, 0, query_count, results.size() * sizeof(uint64_t), results.data(),
+		sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+	if (result != VK_SUCCESS)
+		return;
+
+	std::vector<bool> resolved(timings.size(), false);
+	for (PostPassTiming& timing : timings)
+	{
+		timing.last_ms = 0.0;
+	}
+
+	last_total_ms = 0.0;
+	for (size_t pass = 0; pass < frame.timings.size(); pass++)
+	{
+		uint64_t ticks = (results[pass * 2 + 1] - results[pass * 2]) & timestamp_mask;
+		double ms = static_cast<double>(ticks) * timestamp_period / 1000000.0;
+
+		timings[frame.timings[pass]].last_ms += ms;
+		resolved[frame.timings[pass]] = true;
+		last_total_ms += ms;
+	}
+
+	for (size_t timing = 0; timing < timings.size(); timing++)
+	{
+		if (resolved[timing])
+		{
+			timings[timing].total_ms += timings[timing].last_ms;
+			timings[timing].frame_count++;
+		}
+	}
+}
+
+
+const std::vector<PostPassTiming>& post_process::get_timings()
+{
+	return timings;
+}
+
+
+double post_process::get_last_total_ms()
+{
+	return last_total_ms;
+}
+
+
+void post_process::reset_timings()
+{
+	for (PostPassTiming& timing : timings)
+	{
+		timing.last_ms = 0.0;
+		timing.total_ms = 0.0;
+		timing.frame_count = 0;
+	}
+	last_total_ms = 0.0;
+}
+
+
+void post_process::print_stats()
+{
+	if (!available)
+		return;
+
+	double total_ms = 0.0;
+	for (const PostPassTiming& timing : timings)
+	{
+		if (timing.frame_count == 0)
+			continue;
+
+		double average_ms = timing.total_ms / static_cast<double>(timing.frame_count);
+		total_ms += average_ms;
+
+		printf("Post-processing : %-20s %.3f ms GPU over %llu frames \n", timing.name.c_str(), average_ms,
+			(unsigned long long)timing.frame_count);
+	}
+
+	printf("Post-processing : %.3f ms GPU per frame, exposure %.2f, %u bloom levels \n", total_ms, settings.exposure,
+		settings.bloom_levels);
+}
@@ -0,0 +1,480 @@
+#include "..\headers\profiler.h"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <algorithm>
+#include <limits>
+#include <fstream>
+#include <cstdio>
+
+profiler::profiler()
+{
+}
+
+
+void profiler::init(VkPhysicalDevice physical_device, VkDevice new_device, uint32_t queue_family, uint32_t frame_count,
+	bool calibrated_timestamps, const VkAllocationCallbacks* new_allocator)
+{
+	device = new_device;
+	allocator = new_allocator;
+
+	uint32_t family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+
+	std::vector<VkQueueFamilyProperties> families(family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+
+	uint32_t valid_bits = queue_family < family_count ? families[queue_family].timestampValidBits : 0;
+	gpu_available = valid_bits > 0;
+
+	if (!gpu_available)
+	{
+		printf("Profiler : no timestamps on the graphics queue, only CPU zones are recorded \n");
+		return;
+	}
+
+	timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	timestamp_period = properties.limits.timestampPeriod;
+
+	// The host domain has to be the clock of now_ns
+#if defined(_WIN32)
+	host_domain = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+#else
+	host_domain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+#endif
+
+	// The extension does not promise every domain, both ends are needed
+	calibration_available = false;
+	if (calibrated_timestamps && vkGetPhysicalDeviceCalibrateableTimeDomainsEXT != nullptr && vkGetCalibratedTimestampsEXT != nullptr)
+	{
+		uint32_t domain_count = 0;
+		vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(physical_device, &domain_count, nullptr);
+
+		std::vector<VkTimeDomainEXT> domains(domain_count);
+		vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(physical_device, &domain_count, domains.data());
+
+		bool device_domain = std::find(domains.begin(), domains.end(), VK_TIME_DOMAIN_DEVICE_EXT) != domains.end();
+		bool host = std::find(domains.begin(), domains.end(), host_domain) != domains.end();
+		calibration_available = device_domain && host;
+	}
+
+	frames.resize(frame_count);
+	for (ProfilerGpuFrame& frame : frames)
+	{
+		VkQueryPoolCreateInfo pool_create_info = {};
+		pool_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		pool_create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		pool_create_info.queryCount = PROFILER_GPU_QUERIES_PER_FRAME;
+
+		VkResult result = vkCreateQueryPool(device, &pool_create_info, allocator, &frame.pool);
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(" Error: Failed to create a timestamp query pool \n");
+		}
+	}
+
+	// A value and an availability word per timestamp
+	results.resize(static_cast<size_t>(PROFILER_GPU_QUERIES_PER_FRAME) * 2);
+
+	printf("Profiler creation is  a success \n");
+}
+
+
+void profiler::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+		return;
+
+	for (ProfilerGpuFrame& frame : frames)
+	{
+		vkDestroyQueryPool(device, frame.pool, allocator);
+	}
+	frames.clear();
+
+	gpu_available = false;
+	frame_active = false;
+	device = VK_NULL_HANDLE;
+}
+
+
+void profiler::start(const std::string& file)
+{
+	// Fails here rather than after the whole capture
+	std::ofstream trace(file, std::ios::trunc);
+
+	if (!trace.is_open())
+	{
+		std::string error_msg(" Error: Failed to open " + file + " \n");
+		throw std::runtime_error(error_msg.c_str());
+	}
+
+	std::lock_guard<std::mutex> lock(event_mutex);
+	events.clear();
+	stats = {};
+	trace_file = file;
+	start_ns = now_ns();
+
+	capturing = true;
+}
+
+
+void profiler::stop()
+{
+	if (!is_capturing())
+		return;
+
+	// Frames still in flight, their results are there once the device is idle
+	for (ProfilerGpuFrame& frame : frames)
+	{
+		resolve_frame(frame);
+	}
+
+	capturing = false;
+	frame_active = false;
+	open_zones.clear();
+
+	write_trace();
+}
+
+
+uint64_t profiler::now_ns()
+{
+#if defined(_WIN32)
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return host_ticks_to_ns(static_cast<uint64_t>(counter.QuadPart));
+#else
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec) * 1000000000ull + static_cast<uint64_t>(time.tv_nsec);
+#endif
+}
+
+
+uint64_t profiler::host_ticks_to_ns(uint64_t ticks)
+{
+#if defined(_WIN32)
+	static const uint64_t frequency = [] {
+		LARGE_INTEGER counter_frequency;
+		QueryPerformanceFrequency(&counter_frequency);
+		return static_cast<uint64_t>(counter_frequency.QuadPart);
+	}();
+
+	// Split so the multiplication does not overflow after a few days of uptime
+	return ticks / frequency * 1000000000ull + ticks % frequency * 1000000000ull / frequency;
+#else
+	// CLOCK_MONOTONIC counts nanoseconds already
+	return ticks;
+#endif
+}
+
+
+uint32_t profiler::get_track()
+{
+	static std::atomic<uint32_t> next_track{ PROFILER_GPU_TRACK + 1 };
+	thread_local uint32_t track = next_track++;
+
+	return track;
+}
+
+
+const char* profiler::intern(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(event_mutex);
+
+	// Elements of an unordered_set do not move when it grows
+	return names.insert(name).first->c_str();
+}
+
+
+void profiler::add_event(const ProfileEvent& event)
+{
+	std::lock_guard<std::mutex> lock(event_mutex);
+
+	// A zone that ends after stop is not part of the capture
+	if (!is_capturing())
+		return;
+
+	if (events.size() >= PROFILER_MAX_EVENTS)
+	{
+		stats.dropped_zones++;
+		return;
+	}
+
+	events.push_back(event);
+
+	if (event.track == PROFILER_GPU_TRACK)
+		stats.gpu_zones++;
+	else
+		stats.cpu_zones++;
+}
+
+
+void profiler::add_cpu_zone(const char* name, uint64_t begin_ns, uint64_t end_ns)
+{
+	ProfileEvent event;
+	event.name = name;
+	event.begin_ns = begin_ns;
+	event.end_ns = end_ns;
+	event.track = get_track();
+
+	add_event(event);
+}
+
+
+void profiler::begin_frame(VkCommandBuffer command_buffer, uint32_t frame_slot)
+{
+	if (!gpu_available)
+		return;
+
+	current_frame = frame_slot;
+	ProfilerGpuFrame& frame = frames[frame_slot];
+
+	resolve_frame(frame);
+	open_zones.clear();
+
+	frame_active = is_capturing();
+	if (!frame_active)
+		return;
+
+	vkCmdResetQueryPool(command_buffer, frame.pool, 0, PROFILER_GPU_QUERIES_PER_FRAME);
+
+	if (calibration_available)
+	{
+		calibrate(frame);
+	}
+}
+
+
+void profiler::calibrate(ProfilerGpuFrame& frame)
+{
+	VkCalibratedTimestampInfoEXT timestamp_infos[2] = {};
+	timestamp_infos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+	timestamp_infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+	timestamp_infos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+	timestamp_infos[1].timeDomain = host_domain;
+
+	// Taken together, max_deviation is how far apart they may be
+	uint64_t timestamps[2] = {};
+	uint64_t max_deviation = 0;
+	VkResult result = vkGetCalibratedTimestampsEXT(device, 2, timestamp_infos, timestamps, &max_deviation);
+
+	if (result != VK_SUCCESS)
+		return;
+
+	double device_ns = static_cast<double>(timestamps[0] & timestamp_mask) * timestamp_period;
+	frame.clock_offset_ns = static_cast<double>(host_ticks_to_ns(timestamps[1])) - device_ns;
+	frame.calibrated = true;
+
+	stats.calibrations++;
+	stats.max_deviation_ns = std::max(stats.max_deviation_ns, max_deviation);
+}
+
+
+void profiler::begin_gpu_zone(VkCommandBuffer command_buffer, const char* name)
+{
+	if (!frame_active)
+		return;
+
+	ProfilerGpuFrame& frame = frames[current_frame];
+
+	if (frame.query_count + 2 > PROFILER_GPU_QUERIES_PER_FRAME)
+	{
+		open_zones.push_back(UINT32_MAX);
+		stats.dropped_zones++;
+		return;
+	}
+
+	ProfilerGpuZone zone;
+	zone.name = name;
+	zone.begin_query = frame.query_count;
+	frame.query_count += 2;
+
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.pool, zone.begin_query);
+
+	frame.zones.push_back(zone);
+	open_zones.push_back(zone.begin_query);
+}
+
+
+void profiler::end_gpu_zone(VkCommandBuffer command_buffer)
+{
+	if (!frame_active || open_zones.empty())
+		return;
+
+	uint32_t begin_query = open_zones.back();
+	open_zones.pop_back();
+
+	if (begin_query == UINT32_MAX)
+		return;
+
+	// Written once every earlier command has finished
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frames[current_frame].pool, begin_query + 1);
+}
+
+
+void profiler::frame_submitted(uint32_t frame_slot)
+{
+	if (frame_active)
+	{
+		frames[frame_slot].submit_ns = now_ns();
+	}
+}
+
+
+void profiler::resolve_frame(ProfilerGpuFrame& frame)
+{
+	if (is_capturing() && frame.query_count > 0)
+	{
+		// A zone whose end was never written stays unavailable and is dropped
+		const uint32_t stride = 2;
+		vkGetQueryPoolResults(device, frame.pool, 0, frame.query_count, results.size() * sizeof(uint64_t), results.data(),
+			stride * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+		auto available = [&](uint32_t query) { return results[query * stride + 1] != 0; };
+		auto gpu_ns = [&](uint32_t query) { return static_cast<double>(results[query * stride] & timestamp_mask) * timestamp_period; };
+
+		// Without calibration the frame starts on the GPU when it was submitted
+		double offset_ns = frame.clock_offset_ns;
+		if (!frame.calibrated)
+		{
+			double first_ns = std::numeric_limits<double>::max();
+			for (const ProfilerGpuZone& zone : frame.zones)
+			{
+				if (available(zone.begin_query))
+					first_ns = std::min(first_ns, gpu_ns(zone.begin_query));
+			}
+			offset_ns = static_cast<double>(frame.submit_ns) - first_ns;
+		}
+
+		for (const ProfilerGpuZone& zone : frame.zones)
+		{
+			if (!available(zone.begin_query) || !available(zone.begin_query + 1))
+			{
+				stats.dropped_zones++;
+				continue;
+			}
+
+			ProfileEvent event;
+			event.name = zone.name;
+			event.begin_ns = static_cast<uint64_t>(std::max(0.0, gpu_ns(zone.begin_query) + offset_ns));
+			event.end_ns = static_cast<uint64_t>(std::max(0.0, gpu_ns(zone.begin_query + 1) + offset_ns));
+			event.end_ns = std::max(event.end_ns, event.begin_ns);
+			event.track = PROFILER_GPU_TRACK;
+
+			add_event(event);
+		}
+	}
+
+	frame.zones.clear();
+	frame.query_count = 0;
+	frame.calibrated = false;
+}
+
+
+void profiler::write_trace()
+{
+	std::lock_guard<std::mutex> lock(event_mutex);
+
+	std::ofstream file(trace_file, std::ios::trunc);
+
+	if (!file.is_open())
+	{
+		std::string error_msg(" Error: Failed to open " + trace_file + " \n");
+		throw std::runtime_error(error_msg.c_str());
+	}
+
+	// Names come from the code and from render graph passes, only quotes and backslashes need escaping
+	auto write_name = [&file](const char* name) {
+		file << '"';
+		for (const char* c = name; *c != '\0'; c++)
+		{
+			if (*c == '"' || *c == '\\')
+				file << '\\';
+			file << *c;
+		}
+		file << '"';
+	};
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"vulkan_renderer\"}}";
+
+	uint32_t track_count = 0;
+	for (const ProfileEvent& event : events)
+	{
+		track_count = std::max(track_count, event.track + 1);
+	}
+
+	// GPU track below the CPU threads
+	char line[160];
+	for (uint32_t track = 0; track < track_count; track++)
+	{
+		if (track == PROFILER_GPU_TRACK)
+			snprintf(line, sizeof(line), "\"GPU graphics queue\"");
+		else
+			snprintf(line, sizeof(line), "\"CPU thread %u\"", track);
+
+		file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track << ",\"args\":{\"name\":" << line << "}}";
+		file << ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track
+			<< ",\"args\":{\"sort_index\":" << (track == PROFILER_GPU_TRACK ? track_count : track) << "}}";
+	}
+
+	// Microseconds from start, the unit of the format
+	for (const ProfileEvent& event : events)
+	{
+		double begin_us = (static_cast<double>(event.begin_ns) - static_cast<double>(start_ns)) / 1000.0;
+		double duration_us = static_cast<double>(event.end_ns - event.begin_ns) / 1000.0;
+
+		file << ",\n{\"name\":";
+		write_name(event.name);
+		snprintf(line, sizeof(line), ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+			event.track == PROFILER_GPU_TRACK ? "gpu" : "cpu", begin_us, duration_us, event.track);
+		file << line;
+	}
+
+	file << "\n]}\n";
+
+	printf("Profiler : %zu zones written to %s \n", events.size(), trace_file.c_str());
+	events.clear();
+}
+
+
+const ProfilerStats& profiler::get_stats()
+{
+	return stats;
+}
+
+
+void profiler::print_stats()
+{
+	printf("Profiler : %llu CPU zones, %llu GPU zones, %llu dropped \n", (unsigned long long)stats.cpu_zones,
+		(unsigned long long)stats.gpu_zones, (unsigned long long)stats.dropped_zones);
+
+	if (!gpu_available)
+	{
+		printf("Profiler : no GPU zones on this queue \n");
+	}
+	else if (calibration_available)
+	{
+		printf("Profiler : GPU clock calibrated %llu times, %llu ns largest deviation \n",
+			(unsigned long long)stats.calibrations, (unsigned long long)stats.max_deviation_ns);
+	}
+	else
+	{
+		printf("Profiler : GPU clock aligned to the submit of each frame \n");
+	}
+}
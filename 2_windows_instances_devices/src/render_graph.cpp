@@ -0,0 +1,1361 @@
+#include "..\headers\render_graph.h"
+
+#include <chrono>
+
+static const VkAccessFlags write_access_mask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+	| VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+render_graph::render_graph()
+{
+}
+
+
+uint32_t render_graph::add_image(const std::string& name, const RenderGraphImageInfo& info)
+{
+	RenderGraphResource resource = {};
+	resource.name = name;
+	resource.info = info;
+	resource.imported = false;
+
+	resources.push_back(resource);
+	return static_cast<uint32_t>(resources.size() - 1);
+}
+
+
+uint32_t render_graph::import_image(const std::string& name, const RenderGraphImageInfo& info, const std::vector<VkImage>& images,
+	const std::vector<VkImageView>& image_views, VkImageLayout final_layout)
+{
+	RenderGraphResource resource = {};
+	resource.name = name;
+	resource.info = info;
+	resource.imported = true;
+	resource.final_layout = final_layout;
+	resource.images = images;
+	resource.image_views = image_views;
+
+	resources.push_back(resource);
+	return static_cast<uint32_t>(resources.size() - 1);
+}
+
+
+uint32_t render_graph::import_buffer(const std::string& name, VkBuffer buffer)
+{
+	RenderGraphResource resource = {};
+	resource.name = name;
+	resource.imported = true;
+	resource.buffer = buffer;
+
+	resources.push_back(resource);
+	return static_cast<uint32_t>(resources.size() - 1);
+}
+
+
+uint32_t render_graph::add_pass(const std::string& name, PassType type)
+{
+	RenderGraphPass pass = {};
+	pass.name = name;
+	pass.type = type;
+
+	passes.push_back(pass);
+	return static_cast<uint32_t>(passes.size() - 1);
+}
+
+
+void render_graph::add_access(uint32_t pass, uint32_t resource, ResourceUsage usage)
+{
+	RenderGraphPass& graph_pass = passes[pass];
+
+	VkPipelineStageFlags shader_stage = graph_pass.type == PassType::compute
+		? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+	PassAccess access = {};
+	access.resource = resource;
+	access.usage = usage;
+
+	switch (usage)
+	{
+	case ResourceUsage::color_attachment:
+		access.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		access.stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		access.access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		access.write = true;
+		resources[resource].usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		break;
+	case ResourceUsage::depth_attachment:
+		access.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		access.stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		access.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		access.write = true;
+		resources[resource].usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		break;
+	case ResourceUsage::sampled:
+		access.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		access.stages = shader_stage;
+		access.access = VK_ACCESS_SHADER_READ_BIT;
+		access.read = true;
+		resources[resource].usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+		break;
+	case ResourceUsage::storage_read:
+		access.layout = VK_IMAGE_LAYOUT_GENERAL;
+		access.stages = shader_stage;
+		access.access = VK_ACCESS_SHADER_READ_BIT;
+		access.read = true;
+		resources[resource].usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+		break;
+	case ResourceUsage::storage_write:
+		access.layout = VK_IMAGE_LAYOUT_GENERAL;
+		access.stages = shader_stage;
+		access.access = VK_ACCESS_SHADER_WRITE_BIT;
+		access.write = true;
+		resources[resource].usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+		break;
+	case ResourceUsage::transfer_src:
+		access.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		access.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		access.access = VK_ACCESS_TRANSFER_READ_BIT;
+		access.read = true;
+		resources[resource].usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		break;
+	case ResourceUsage::transfer_dst:
+		access.layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		access.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		access.access = VK_ACCESS_TRANSFER_WRITE_BIT;
+		access.write = true;
+		resources[resource].usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		break;
+	case ResourceUsage::buffer_read:
+		// Graphics passes mostly read buffers while fetching vertices
+		access.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		access.stages = graph_pass.type == PassType::compute
+			? shader_stage : VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		access.access = VK_ACCESS_SHADER_READ_BIT;
+		access.read = true;
+		break;
+	case ResourceUsage::buffer_write:
+		access.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		access.stages = shader_stage;
+		access.access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		access.write = true;
+		access.read = true;
+		break;
+	case ResourceUsage::indirect_read:
+		access.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		access.stages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+		access.access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		access.read = true;
+		break;
+	}
+
+	graph_pass.accesses.push_back(access);
+}
+
+
+void render_graph::add_color_output(uint32_t pass, uint32_t resource, const VkClearValue* clear_value)
+{
+	add_access(pass, resource, ResourceUsage::color_attachment);
+
+	// Without a clear the previous contents are loaded, so the attachment is also read
+	passes[pass].accesses.back().read = clear_value == nullptr;
+	passes[pass].color_outputs.push_back(resource);
+	passes[pass].color_clear.push_back(clear_value != nullptr);
+	passes[pass].color_clear_values.push_back(clear_value ? *clear_value : VkClearValue{});
+	passes[pass].color_resolves.push_back(-1);
+}
+
+
+void render_graph::set_depth_output(uint32_t pass, uint32_t resource, const VkClearValue* clear_value)
+{
+	add_access(pass, resource, ResourceUsage::depth_attachment);
+
+	passes[pass].accesses.back().read = clear_value == nullptr;
+	passes[pass].depth_output = static_cast<int>(resource);
+	passes[pass].depth_clear = clear_value != nullptr;
+	passes[pass].depth_clear_value = clear_value ? *clear_value : VkClearValue{};
+}
+
+
+// Multisampled colour output resolved into a single sample image at the end of the pass
+void render_graph::add_resolve_output(uint32_t pass, uint32_t color_resource, uint32_t resolve_resource)
+{
+	RenderGraphPass& graph_pass = passes[pass];
+
+	auto color = std::find(graph_pass.color_outputs.begin(), graph_pass.color_outputs.end(), color_resource);
+	if (color == graph_pass.color_outputs.end())
+	{
+		throw std::runtime_error(" Error: Resolve source is not a colour output of the pass \n");
+	}
+
+	add_access(pass, resolve_resource, ResourceUsage::color_attachment);
+
+	// Resolve overwrites every pixel
+	graph_pass.accesses.back().read = false;
+	graph_pass.color_resolves[color - graph_pass.color_outputs.begin()] = static_cast<int>(resolve_resource);
+}
+
+
+void render_graph::add_texture_input(uint32_t pass, uint32_t resource)
+{
+	add_access(pass, resource, ResourceUsage::sampled);
+}
+
+
+void render_graph::add_storage_input(uint32_t pass, uint32_t resource)
+{
+	add_access(pass, resource, ResourceUsage::storage_read);
+}
+
+
+void render_graph::add_storage_output(uint32_t pass, uint32_t resource)
+{
+	add_access(pass, resource, ResourceUsage::storage_write);
+}
+
+
+void render_graph::add_transfer_input(uint32_t pass, uint32_t resource)
+{
+	add_access(pass, resource, ResourceUsage::transfer_src);
+}
+
+
+void render_graph::add_transfer_output(uint32_t pass, uint32_t resource)
+{
+	add_access(pass, resource, ResourceUsage::transfer_dst);
+}
+
+
+void render_graph::add_buffer_input(uint32_t pass, uint32_t resource)
+{
+	add_access(pass, resource, ResourceUsage::buffer_read);
+}
+
+
+void render_graph::add_buffer_output(uint32_t pass, uint32_t resource)
+{
+	add_access(pass, resource, ResourceUsage::buffer_write);
+}
+
+
+void render_graph::add_indirect_input(uint32_t pass, uint32_t resource)
+{
+	add_access(pass, resource, ResourceUsage::indirect_read);
+}
+
+
+void render_graph::set_record(uint32_t pass, std::function<void(VkCommandBuffer)> record)
+{
+	passes[pass].record = [record](VkCommandBuffer command_buffer, render_graph&, uint32_t) {
+		record(command_buffer);
+	};
+}
+
+
+void render_graph::set_record(uint32_t pass, RenderGraphRecord record)
+{
+	passes[pass].record = record;
+}
+
+
+void render_graph::set_output(uint32_t resource)
+{
+	outputs.push_back(resource);
+}
+
+
+void render_graph::set_dynamic_rendering(bool enable)
+{
+	dynamic_rendering = enable;
+}
+
+
+bool render_graph::is_dynamic_rendering()
+{
+	return dynamic_rendering;
+}
+
+
+void render_graph::set_profiler(profiler* new_profile)
+{
+	profile = new_profile;
+}
+
+
+void render_graph::compile(VkPhysicalDevice new_physical_device, VkDevice new_device, memory_tracker* new_tracker,
+	const VkAllocationCallbacks* new_allocator)
+{
+	physical_device = new_physical_device;
+	device = new_device;
+	tracker = new_tracker;
+	allocator = new_allocator;
+	stats = {};
+
+	auto compile_start = std::chrono::high_resolution_clock::now();
+
+	cull_passes();
+	compute_lifetimes();
+	allocate_transient_images();
+	build_barriers();
+
+	stats.pass_count = static_cast<uint32_t>(pass_order.size());
+	stats.culled_pass_count = static_cast<uint32_t>(passes.size() - pass_order.size());
+	stats.compile_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - compile_start).count();
+
+	printf("Render graph compilation is  a success \n");
+}
+
+
+// Walk the passes backwards from the outputs. A pass is kept only if it writes
+// something a later kept pass (or the frame output) still needs.
+void render_graph::cull_passes()
+{
+	std::vector<bool> needed(resources.size(), false);
+
+	for (uint32_t output : outputs)
+	{
+		needed[output] = true;
+	}
+
+	for (int i = static_cast<int>(passes.size()) - 1; i >= 0; i--)
+	{
+		RenderGraphPass& pass = passes[i];
+		pass.culled = true;
+
+		for (const auto& access : pass.accesses)
+		{
+			if (access.write && needed[access.resource])
+			{
+				pass.culled = false;
+				break;
+			}
+		}
+
+		if (pass.culled)
+			continue;
+
+		// Fully overwritten resources do not need earlier writers
+		for (const auto& access : pass.accesses)
+		{
+			if (access.write && !access.read)
+			{
+				needed[access.resource] = false;
+			}
+		}
+
+		for (const auto& access : pass.accesses)
+		{
+			if (access.read)
+			{
+				needed[access.resource] = true;
+			}
+		}
+	}
+
+	pass_order.clear();
+	for (uint32_t i = 0; i < passes.size(); i++)
+	{
+		if (!passes[i].culled)
+		{
+			pass_order.push_back(i);
+		}
+		else
+		{
+			printf("Render graph culled pass %s \n", passes[i].name.c_str());
+		}
+	}
+}
+
+
+void render_graph::compute_lifetimes()
+{
+	for (auto& resource : resources)
+	{
+		resource.first_pass = -1;
+		resource.last_pass = -1;
+	}
+
+	for (size_t i = 0; i < pass_order.size(); i++)
+	{
+		for (const auto& access : passes[pass_order[i]].accesses)
+		{
+			RenderGraphResource& resource = resources[access.resource];
+
+			if (resource.first_pass < 0)
+			{
+				resource.first_pass = static_cast<int>(i);
+			}
+			resource.last_pass = static_cast<int>(i);
+		}
+	}
+}
+
+
+// Transient images whose lifetimes do not overlap share the same memory.
+// Images are placed largest first at the lowest offset that does not collide
+// with an already placed image that is alive at the same time.
+void render_graph::allocate_transient_images()
+{
+	std::vector<uint32_t> transient;
+
+	for (uint32_t i = 0; i < resources.size(); i++)
+	{
+		RenderGraphResource& resource = resources[i];
+
+		if (resource.imported || resource.first_pass < 0)
+			continue;
+
+		// Attachments that never leave their pass are never stored, so on tiled GPUs
+		// they can live entirely in tile memory
+		VkImageUsageFlags attachment_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		resource.lazily_allocated = resource.first_pass == resource.last_pass && (resource.usage & ~attachment_usage) == 0;
+
+		if (resource.lazily_allocated)
+		{
+			resource.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		}
+
+		VkImageCreateInfo image_create_info = {};
+		image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_create_info.imageType = VK_IMAGE_TYPE_2D;
+		image_create_info.format = resource.info.format;
+		image_create_info.extent.width = resource.info.extent.width;
+		image_create_info.extent.height = resource.info.extent.height;
+		image_create_info.extent.depth = 1;
+		image_create_info.mipLevels = 1;
+		image_create_info.arrayLayers = 1;
+		image_create_info.samples = resource.info.samples;
+		image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_create_info.usage = resource.usage;
+		image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		VkImage image;
+		VkResult result = vkCreateImage(device, &image_create_info, allocator, &image);
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(" Error: Failed to create a render graph image \n");
+		}
+
+		resource.images = { image };
+		vkGetImageMemoryRequirements(device, image, &resource.memory_requirements);
+
+		bool lazy_memory = false;
+		if (resource.lazily_allocated)
+		{
+			try
+			{
+				resource.memory_type = find_memory_type_index(physical_device, resource.memory_requirements.memoryTypeBits,
+					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+				lazy_memory = true;
+			}
+			catch (const std::runtime_error&)
+			{
+				// No lazily allocated memory on this device, fall back to plain device memory
+			}
+		}
+
+		if (!lazy_memory)
+		{
+			resource.memory_type = find_memory_type_index(physical_device, resource.memory_requirements.memoryTypeBits,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		}
+		else
+		{
+			stats.lazily_allocated_bytes += resource.memory_requirements.size;
+		}
+
+		stats.transient_bytes += resource.memory_requirements.size;
+		transient.push_back(i);
+	}
+
+	std::sort(transient.begin(), transient.end(), [this](uint32_t a, uint32_t b) {
+		return resources[a].memory_requirements.size > resources[b].memory_requirements.size;
+	});
+
+	// Memory block size for each memory type
+	std::vector<std::pair<uint32_t, VkDeviceSize>> block_sizes;
+	std::vector<uint32_t> placed;
+
+	for (uint32_t index : transient)
+	{
+		RenderGraphResource& resource = resources[index];
+
+		// Ranges already taken by images alive at the same time, sorted by offset
+		std::vector<std::pair<VkDeviceSize, VkDeviceSize>> taken;
+		for (uint32_t other_index : placed)
+		{
+			const RenderGraphResource& other = resources[other_index];
+
+			if (other.memory_type == resource.memory_type
+				&& other.first_pass <= resource.last_pass && resource.first_pass <= other.last_pass)
+			{
+				taken.push_back({ other.memory_offset, other.memory_offset + other.memory_requirements.size });
+			}
+		}
+		std::sort(taken.begin(), taken.end());
+
+		VkDeviceSize alignment = resource.memory_requirements.alignment;
+		VkDeviceSize offset = 0;
+		for (const auto& range : taken)
+		{
+			if (offset + resource.memory_requirements.size <= range.first)
+				break;
+
+			offset = std::max(offset, (range.second + alignment - 1) / alignment * alignment);
+		}
+
+		resource.memory_offset = offset;
+		placed.push_back(index);
+
+		auto block = std::find_if(block_sizes.begin(), block_sizes.end(),
+			[&resource](const std::pair<uint32_t, VkDeviceSize>& b) { return b.first == resource.memory_type; });
+
+		if (block == block_sizes.end())
+		{
+			block_sizes.push_back({ resource.memory_type, offset + resource.memory_requirements.size });
+		}
+		else
+		{
+			block->second = std::max(block->second, offset + resource.memory_requirements.size);
+		}
+	}
+
+	for (const auto& block : block_sizes)
+	{
+		VkMemoryAllocateInfo memory_alloc_info = {};
+		memory_alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memory_alloc_info.allocationSize = block.second;
+		memory_alloc_info.memoryTypeIndex = block.first;
+
+		VkDeviceMemory memory;
+		VkResult result = tracker->allocate(&memory_alloc_info, &memory, "render graph");
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(" Error: Failed to allocate render graph memory \n");
+		}
+
+		memory_blocks.push_back(memory);
+		stats.aliased_bytes += block.second;
+
+		for (uint32_t index : transient)
+		{
+			RenderGraphResource& resource = resources[index];
+
+			if (resource.memory_type == block.first)
+			{
+				vkBindImageMemory(device, resource.images[0], memory, resource.memory_offset);
+				tracker->add_bound_bytes(memory, resource.memory_requirements.size);
+			}
+		}
+	}
+
+	for (uint32_t index : transient)
+	{
+		RenderGraphResource& resource = resources[index];
+
+		VkImageViewCreateInfo imageview_create_info = {};
+		imageview_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		imageview_create_info.image = resource.images[0];
+		imageview_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageview_create_info.format = resource.info.format;
+		imageview_create_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+		imageview_create_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+		imageview_create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+		imageview_create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+		imageview_create_info.subresourceRange.aspectMask = resource.info.aspect;
+		imageview_create_info.subresourceRange.baseMipLevel = 0;
+		imageview_create_info.subresourceRange.levelCount = 1;
+		imageview_create_info.subresourceRange.baseArrayLayer = 0;
+		imageview_create_info.subresourceRange.layerCount = 1;
+
+		VkImageView image_view;
+		VkResult result = vkCreateImageView(device, &imageview_create_info, allocator, &image_view);
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(" Error: Failed to create a render graph image view \n");
+		}
+
+		resource.image_views = { image_view };
+	}
+}
+
+
+// Attachment order of a graphics pass: colour outputs, depth, then resolve targets
+std::vector<uint32_t> render_graph::get_attachment_resources(const RenderGraphPass& pass)
+{
+	std::vector<uint32_t> attachment_resources = pass.color_outputs;
+
+	if (pass.depth_output >= 0)
+	{
+		attachment_resources.push_back(static_cast<uint32_t>(pass.depth_output));
+	}
+
+	for (int resolve : pass.color_resolves)
+	{
+		if (resolve >= 0)
+		{
+			attachment_resources.push_back(static_cast<uint32_t>(resolve));
+		}
+	}
+
+	return attachment_resources;
+}
+
+
+int render_graph::find_next_use(uint32_t resource, size_t order_index)
+{
+	for (size_t i = order_index + 1; i < pass_order.size(); i++)
+	{
+		if (find_access(passes[pass_order[i]], resource))
+		{
+			return static_cast<int>(i);
+		}
+	}
+
+	return -1;
+}
+
+
+const PassAccess* render_graph::find_access(const RenderGraphPass& pass, uint32_t resource)
+{
+	for (const auto& access : pass.accesses)
+	{
+		if (access.resource == resource)
+		{
+			return &access;
+		}
+	}
+
+	return nullptr;
+}
+
+
+// Replays the frame in pass order tracking the state of every image.
+// A barrier is only emitted on a layout change or a real hazard, and all the
+// barriers a pass needs are merged into a single vkCmdPipelineBarrier.
+void render_graph::build_barriers()
+{
+	std::vector<ResourceState> states(resources.size());
+
+	// Last use of every image in the frame. Transient images must wait on it
+	// before being reused by the next frame, or by an image aliasing the same memory.
+	std::vector<ResourceState> last_states(resources.size());
+	for (size_t i = 0; i < pass_order.size(); i++)
+	{
+		for (const auto& access : passes[pass_order[i]].accesses)
+		{
+			last_states[access.resource].read_stages |= access.stages;
+			if (access.write)
+			{
+				last_states[access.resource].write_access |= access.access & write_access_mask;
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < resources.size(); i++)
+	{
+		RenderGraphResource& resource = resources[i];
+		resource.initial_state = {};
+
+		if (resource.first_pass < 0)
+			continue;
+
+		if (resource.imported && resource.buffer == VK_NULL_HANDLE)
+		{
+			// Imported images are handed over by a semaphore wait on the stages of their first use
+			resource.initial_state.write_stages = get_first_use_stages(i);
+		}
+		else
+		{
+			// Buffers only alias themselves, their previous frame is the hazard
+			for (uint32_t j = 0; j < resources.size(); j++)
+			{
+				const RenderGraphResource& other = resources[j];
+
+				bool same_memory = j == i || (!other.imported && other.first_pass >= 0
+					&& other.memory_type == resource.memory_type
+					&& other.memory_offset < resource.memory_offset + resource.memory_requirements.size
+					&& resource.memory_offset < other.memory_offset + other.memory_requirements.size);
+
+				if (same_memory)
+				{
+					resource.initial_state.write_stages |= last_states[j].read_stages;
+					resource.initial_state.write_access |= last_states[j].write_access;
+				}
+			}
+		}
+
+		states[i] = resource.initial_state;
+	}
+
+	for (size_t i = 0; i < pass_order.size(); i++)
+	{
+		RenderGraphPass& pass = passes[pass_order[i]];
+		pass.barriers.clear();
+		pass.barrier_src_stages = 0;
+		pass.barrier_dst_stages = 0;
+
+		// Load ops depend on the layout the attachments are in before the pass
+		if (pass.type == PassType::graphics && dynamic_rendering)
+		{
+			create_rendering_attachments(pass, i, states);
+		}
+
+		for (const auto& access : pass.accesses)
+		{
+			// Attachments are transitioned by the render pass itself, or by these barriers with dynamic rendering
+			bool attachment = access.usage == ResourceUsage::color_attachment || access.usage == ResourceUsage::depth_attachment;
+			if (pass.type == PassType::graphics && attachment && !dynamic_rendering)
+				continue;
+
+			ResourceState& state = states[access.resource];
+
+			bool needs_barrier = false;
+			VkPipelineStageFlags src_stages = 0;
+			VkAccessFlags src_access = 0;
+
+			if (state.layout != access.layout)
+			{
+				needs_barrier = true;
+				src_stages = state.write_stages | state.read_stages;
+				src_access = state.write_access;
+			}
+			else
+			{
+				// Read or write after write
+				if (state.write_access != 0 && (access.stages & ~state.visible_stages) != 0)
+				{
+					needs_barrier = true;
+					src_stages |= state.write_stages;
+					src_access = state.write_access;
+				}
+
+				// Write after read only needs an execution dependency
+				if (access.write && state.read_stages != 0)
+				{
+					needs_barrier = true;
+					src_stages |= state.read_stages;
+				}
+			}
+
+			if (needs_barrier)
+			{
+				// Cleared and resolved attachments do not keep the old contents
+				bool discard = attachment && !access.read;
+
+				PassBarrier barrier = {};
+				barrier.resource = access.resource;
+				barrier.old_layout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+				barrier.new_layout = access.layout;
+				barrier.src_access = src_access;
+				barrier.dst_access = access.access;
+
+				pass.barriers.push_back(barrier);
+				pass.barrier_src_stages |= src_stages != 0 ? src_stages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+				pass.barrier_dst_stages |= access.stages;
+
+				if (resources[access.resource].buffer != VK_NULL_HANDLE)
+					stats.buffer_barrier_count++;
+				else
+					stats.image_barrier_count++;
+
+				if (state.layout != access.layout)
+				{
+					state.read_stages = 0;
+					state.visible_stages = 0;
+				}
+				state.visible_stages |= access.stages;
+			}
+
+			state.layout = access.layout;
+			if (access.write)
+			{
+				state.write_stages = access.stages;
+				state.write_access = access.access & write_access_mask;
+				state.read_stages = 0;
+				state.visible_stages = 0;
+			}
+			else
+			{
+				state.read_stages |= access.stages;
+			}
+		}
+
+		if (!pass.barriers.empty())
+		{
+			stats.barrier_count++;
+		}
+
+		if (pass.type == PassType::graphics && !dynamic_rendering)
+		{
+			create_render_pass(pass, i, states);
+			create_framebuffers(pass);
+		}
+	}
+
+	build_final_barriers(states);
+}
+
+
+void render_graph::create_rendering_attachments(RenderGraphPass& pass, size_t order_index, const std::vector<ResourceState>& states)
+{
+	std::vector<uint32_t> attachment_resources = get_attachment_resources(pass);
+	pass.extent = resources[attachment_resources[0]].info.extent;
+	pass.attachments.clear();
+
+	size_t color_count = pass.color_outputs.size();
+	for (size_t i = 0; i < color_count + (pass.depth_output >= 0 ? 1 : 0); i++)
+	{
+		bool depth = i == color_count;
+
+		RenderGraphAttachment attachment = {};
+		attachment.resource = depth ? static_cast<uint32_t>(pass.depth_output) : pass.color_outputs[i];
+		attachment.resolve = depth ? -1 : pass.color_resolves[i];
+
+		bool clear = depth ? pass.depth_clear : pass.color_clear[i];
+		attachment.clear_value = depth ? pass.depth_clear_value : pass.color_clear_values[i];
+
+		// Same choices as the render pass path
+		if (clear)
+		{
+			attachment.load_op = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		}
+		else if (states[attachment.resource].layout != VK_IMAGE_LAYOUT_UNDEFINED)
+		{
+			attachment.load_op = VK_ATTACHMENT_LOAD_OP_LOAD;
+		}
+
+		bool keep_contents = find_next_use(attachment.resource, order_index) >= 0 || resources[attachment.resource].imported;
+		attachment.store_op = keep_contents ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+		pass.attachments.push_back(attachment);
+	}
+}
+
+
+// With render passes the final layout is part of the last attachment description,
+// otherwise imported images still in another layout need a barrier after the last pass
+void render_graph::build_final_barriers(const std::vector<ResourceState>& states)
+{
+	final_barriers.clear();
+	final_src_stages = 0;
+
+	for (uint32_t i = 0; i < resources.size(); i++)
+	{
+		const RenderGraphResource& resource = resources[i];
+		const ResourceState& state = states[i];
+
+		if (!resource.imported || resource.first_pass < 0 || state.layout == resource.final_layout)
+			continue;
+
+		PassBarrier barrier = {};
+		barrier.resource = i;
+		barrier.old_layout = state.layout;
+		barrier.new_layout = resource.final_layout;
+		barrier.src_access = state.write_access;
+		barrier.dst_access = 0;
+
+		final_barriers.push_back(barrier);
+		final_src_stages |= state.write_stages | state.read_stages;
+		stats.image_barrier_count++;
+	}
+
+	if (!final_barriers.empty())
+	{
+		stats.barrier_count++;
+	}
+}
+
+
+// Builds the VkRenderPass of a graphics pass. Load/store ops, initial/final
+// layouts and the external subpass dependencies all come from the neighbouring passes.
+void render_graph::create_render_pass(RenderGraphPass& pass, size_t order_index, std::vector<ResourceState>& states)
+{
+	std::vector<uint32_t> attachment_resources = get_attachment_resources(pass);
+
+	// Clear values are indexed by attachment, resolve targets never clear
+	pass.clear_values = pass.color_clear_values;
+	if (pass.depth_output >= 0)
+	{
+		pass.clear_values.push_back(pass.depth_clear_value);
+	}
+	pass.clear_values.resize(attachment_resources.size(), VkClearValue{});
+
+	size_t color_count = pass.color_outputs.size();
+	size_t resolve_begin = color_count + (pass.depth_output >= 0 ? 1 : 0);
+
+	std::vector<VkAttachmentDescription> attachments;
+	std::vector<VkAttachmentReference> color_references;
+	VkAttachmentReference depth_reference = {};
+
+	VkAttachmentReference unused_reference = {};
+	unused_reference.attachment = VK_ATTACHMENT_UNUSED;
+	unused_reference.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	std::vector<VkAttachmentReference> resolve_references(color_count, unused_reference);
+	bool has_resolve = false;
+
+	VkSubpassDependency incoming = {};
+	incoming.srcSubpass = VK_SUBPASS_EXTERNAL;
+	incoming.dstSubpass = 0;
+
+	VkSubpassDependency outgoing = {};
+	outgoing.srcSubpass = 0;
+	outgoing.dstSubpass = VK_SUBPASS_EXTERNAL;
+
+	for (size_t i = 0; i < attachment_resources.size(); i++)
+	{
+		uint32_t resource_index = attachment_resources[i];
+		const RenderGraphResource& resource = resources[resource_index];
+		const PassAccess* access = find_access(pass, resource_index);
+		ResourceState& state = states[resource_index];
+
+		int next_use = find_next_use(resource_index, order_index);
+		const PassAccess* next_access = next_use >= 0 ? find_access(passes[pass_order[next_use]], resource_index) : nullptr;
+
+		bool keep_contents = next_access != nullptr || resource.imported;
+
+		VkAttachmentDescription attachment = {};
+		attachment.format = resource.info.format;
+		attachment.samples = resource.info.samples;
+		attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.storeOp = keep_contents ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+		bool clear = i < color_count ? pass.color_clear[i] : (i < resolve_begin && pass.depth_clear);
+		bool resolve = i >= resolve_begin;
+
+		if (clear)
+		{
+			attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		}
+		else if (state.layout != VK_IMAGE_LAYOUT_UNDEFINED && !resolve)
+		{
+			attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+			attachment.initialLayout = state.layout;
+		}
+		else
+		{
+			attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		}
+
+		// Leave the image in the layout its next user wants, saving a barrier there
+		if (next_access)
+		{
+			attachment.finalLayout = next_access->layout;
+		}
+		else if (resource.imported)
+		{
+			attachment.finalLayout = resource.final_layout;
+		}
+		else
+		{
+			attachment.finalLayout = access->layout;
+		}
+
+		VkAttachmentReference reference = {};
+		reference.attachment = static_cast<uint32_t>(attachments.size());
+		reference.layout = access->layout;
+
+		if (resolve)
+		{
+			size_t color_index = std::find(pass.color_resolves.begin(), pass.color_resolves.end(),
+				static_cast<int>(resource_index)) - pass.color_resolves.begin();
+			resolve_references[color_index] = reference;
+			has_resolve = true;
+		}
+		else if (access->usage == ResourceUsage::depth_attachment)
+		{
+			depth_reference = reference;
+		}
+		else
+		{
+			color_references.push_back(reference);
+		}
+
+		attachments.push_back(attachment);
+
+		incoming.srcStageMask |= state.write_stages | state.read_stages;
+		incoming.srcAccessMask |= state.write_access;
+		incoming.dstStageMask |= access->stages;
+		incoming.dstAccessMask |= access->access;
+
+		outgoing.srcStageMask |= access->stages;
+		outgoing.srcAccessMask |= access->access & write_access_mask;
+
+		state.layout = attachment.finalLayout;
+		state.write_stages = access->stages;
+		state.write_access = access->access & write_access_mask;
+		state.read_stages = 0;
+		state.visible_stages = 0;
+
+		if (next_access)
+		{
+			outgoing.dstStageMask |= next_access->stages;
+			outgoing.dstAccessMask |= next_access->access;
+			state.visible_stages = next_access->stages;
+		}
+		else if (resource.imported)
+		{
+			outgoing.dstStageMask |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		}
+	}
+
+	if (incoming.srcStageMask == 0)
+	{
+		incoming.srcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	}
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = static_cast<uint32_t>(color_references.size());
+	subpass.pColorAttachments = color_references.data();
+	subpass.pResolveAttachments = has_resolve ? resolve_references.data() : nullptr;
+	subpass.pDepthStencilAttachment = pass.depth_output >= 0 ? &depth_reference : nullptr;
+
+	std::vector<VkSubpassDependency> subpass_dependencies = { incoming };
+	if (outgoing.dstStageMask != 0)
+	{
+		subpass_dependencies.push_back(outgoing);
+	}
+
+	VkRenderPassCreateInfo renderpass_create_info = {};
+	renderpass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderpass_create_info.attachmentCount = static_cast<uint32_t>(attachments.size());
+	renderpass_create_info.pAttachments = attachments.data();
+	renderpass_create_info.subpassCount = 1;
+	renderpass_create_info.pSubpasses = &subpass;
+	renderpass_create_info.dependencyCount = static_cast<uint32_t>(subpass_dependencies.size());
+	renderpass_create_info.pDependencies = subpass_dependencies.data();
+
+	VkResult result = vkCreateRenderPass(device, &renderpass_create_info, allocator, &pass.render_pass);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the RenderPass \n");
+	}
+
+	stats.render_pass_count++;
+
+	pass.extent = resources[attachment_resources[0]].info.extent;
+}
+
+
+void render_graph::create_framebuffers(RenderGraphPass& pass)
+{
+	std::vector<uint32_t> attachment_resources = get_attachment_resources(pass);
+
+	// One framebuffer per swap chain image if any attachment is imported per image
+	size_t framebuffer_count = 1;
+	for (uint32_t resource : attachment_resources)
+	{
+		framebuffer_count = std::max(framebuffer_count, resources[resource].image_views.size());
+	}
+
+	pass.framebuffers.resize(framebuffer_count);
+
+	for (size_t i = 0; i < framebuffer_count; i++)
+	{
+		std::vector<VkImageView> attachments;
+		for (uint32_t resource : attachment_resources)
+		{
+			attachments.push_back(get_image_view(resource, static_cast<uint32_t>(i)));
+		}
+
+		VkFramebufferCreateInfo framebuffer_create_info = {};
+		framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebuffer_create_info.renderPass = pass.render_pass;
+		framebuffer_create_info.attachmentCount = static_cast<uint32_t>(attachments.size());
+		framebuffer_create_info.pAttachments = attachments.data();
+		framebuffer_create_info.width = pass.extent.width;
+		framebuffer_create_info.height = pass.extent.height;
+		framebuffer_create_info.layers = 1;
+
+		VkResult result = vkCreateFramebuffer(device, &framebuffer_create_info, allocator, &pass.framebuffers[i]);
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(" Error: Failed to create the framebuffer \n");
+		}
+
+		stats.framebuffer_count++;
+	}
+}
+
+
+void render_graph::record_barriers(VkCommandBuffer command_buffer, const std::vector<PassBarrier>& barriers,
+	VkPipelineStageFlags src_stages, VkPipelineStageFlags dst_stages, uint32_t image_index)
+{
+	std::vector<VkImageMemoryBarrier> image_barriers;
+	std::vector<VkBufferMemoryBarrier> buffer_barriers;
+	image_barriers.reserve(barriers.size());
+
+	for (const auto& barrier : barriers)
+	{
+		VkBuffer buffer = resources[barrier.resource].buffer;
+		if (buffer != VK_NULL_HANDLE)
+		{
+			VkBufferMemoryBarrier buffer_barrier = {};
+			buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			buffer_barrier.srcAccessMask = barrier.src_access;
+			buffer_barrier.dstAccessMask = barrier.dst_access;
+			buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			buffer_barrier.buffer = buffer;
+			buffer_barrier.offset = 0;
+			buffer_barrier.size = VK_WHOLE_SIZE;
+
+			buffer_barriers.push_back(buffer_barrier);
+			continue;
+		}
+
+		VkImageMemoryBarrier image_barrier = {};
+		image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		image_barrier.oldLayout = barrier.old_layout;
+		image_barrier.newLayout = barrier.new_layout;
+		image_barrier.srcAccessMask = barrier.src_access;
+		image_barrier.dstAccessMask = barrier.dst_access;
+		image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		image_barrier.image = get_image(barrier.resource, image_index);
+		image_barrier.subresourceRange.aspectMask = resources[barrier.resource].info.aspect;
+		image_barrier.subresourceRange.baseMipLevel = 0;
+		image_barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+		image_barrier.subresourceRange.baseArrayLayer = 0;
+		image_barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+		image_barriers.push_back(image_barrier);
+	}
+
+	vkCmdPipelineBarrier(command_buffer, src_stages, dst_stages, 0, 0, nullptr,
+		static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
+		static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+}
+
+
+void render_graph::begin_rendering(VkCommandBuffer command_buffer, const RenderGraphPass& pass, uint32_t image_index)
+{
+	rendering_attachments.clear();
+
+	for (const RenderGraphAttachment& attachment : pass.attachments)
+	{
+		const PassAccess* access = find_access(pass, attachment.resource);
+
+		VkRenderingAttachmentInfoKHR attachment_info = {};
+		attachment_info.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+		attachment_info.imageView = get_image_view(attachment.resource, image_index);
+		attachment_info.imageLayout = access->layout;
+		attachment_info.loadOp = attachment.load_op;
+		attachment_info.storeOp = attachment.store_op;
+		attachment_info.clearValue = attachment.clear_value;
+
+		if (attachment.resolve >= 0)
+		{
+			uint32_t resolve = static_cast<uint32_t>(attachment.resolve);
+			attachment_info.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+			attachment_info.resolveImageView = get_image_view(resolve, image_index);
+			attachment_info.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		}
+
+		rendering_attachments.push_back(attachment_info);
+	}
+
+	uint32_t color_count = static_cast<uint32_t>(pass.color_outputs.size());
+
+	VkRenderingInfoKHR rendering_info = {};
+	rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+	rendering_info.renderArea.offset = { 0, 0 };
+	rendering_info.renderArea.extent = pass.extent;
+	rendering_info.layerCount = 1;
+	rendering_info.colorAttachmentCount = color_count;
+	rendering_info.pColorAttachments = rendering_attachments.data();
+	rendering_info.pDepthAttachment = pass.depth_output >= 0 ? &rendering_attachments[color_count] : nullptr;
+
+	vkCmdBeginRenderingKHR(command_buffer, &rendering_info);
+}
+
+
+void render_graph::execute(VkCommandBuffer command_buffer, uint32_t image_index)
+{
+	bool profiled = profile != nullptr && profile->is_capturing();
+
+	for (uint32_t pass_index : pass_order)
+	{
+		RenderGraphPass& pass = passes[pass_index];
+
+		if (profiled)
+		{
+			if (pass.profile_name == nullptr)
+			{
+				pass.profile_name = profile->intern(pass.name);
+			}
+			profile->begin_gpu_zone(command_buffer, pass.profile_name);
+		}
+
+		if (!pass.barriers.empty())
+		{
+			record_barriers(command_buffer, pass.barriers, pass.barrier_src_stages, pass.barrier_dst_stages, image_index);
+		}
+
+		if (pass.type == PassType::graphics && dynamic_rendering)
+		{
+			begin_rendering(command_buffer, pass, image_index);
+
+			if (pass.record)
+			{
+				pass.record(command_buffer, *this, image_index);
+			}
+
+			vkCmdEndRenderingKHR(command_buffer);
+		}
+		else if (pass.type == PassType::graphics)
+		{
+			VkRenderPassBeginInfo rp_begin_info = {};
+			rp_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			rp_begin_info.renderPass = pass.render_pass;
+			rp_begin_info.framebuffer = pass.framebuffers[image_index % pass.framebuffers.size()];
+			rp_begin_info.renderArea.offset = { 0,0 };
+			rp_begin_info.renderArea.extent = pass.extent;
+			rp_begin_info.clearValueCount = static_cast<uint32_t>(pass.clear_values.size());
+			rp_begin_info.pClearValues = pass.clear_values.data();
+
+			vkCmdBeginRenderPass(command_buffer, &rp_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+
+			if (pass.record)
+			{
+				pass.record(command_buffer, *this, image_index);
+			}
+
+			vkCmdEndRenderPass(command_buffer);
+		}
+		else if (pass.record)
+		{
+			pass.record(command_buffer, *this, image_index);
+		}
+
+		if (profiled)
+		{
+			profile->end_gpu_zone(command_buffer);
+		}
+	}
+
+	if (!final_barriers.empty())
+	{
+		record_barriers(command_buffer, final_barriers, final_src_stages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, image_index);
+	}
+}
+
+
+void render_graph::destroy()
+{
+	for (auto& pass : passes)
+	{
+		for (auto framebuffer : pass.framebuffers)
+		{
+			vkDestroyFramebuffer(device, framebuffer, allocator);
+		}
+
+		if (pass.render_pass != VK_NULL_HANDLE)
+		{
+			vkDestroyRenderPass(device, pass.render_pass, allocator);
+		}
+	}
+
+	for (auto& resource : resources)
+	{
+		if (resource.imported)
+			continue;
+
+		for (auto image_view : resource.image_views)
+		{
+			vkDestroyImageView(device, image_view, allocator);
+		}
+
+		for (auto image : resource.images)
+		{
+			vkDestroyImage(device, image, allocator);
+		}
+	}
+
+	for (auto memory : memory_blocks)
+	{
+		tracker->free(memory);
+	}
+
+	memory_blocks.clear();
+	final_barriers.clear();
+	pass_order.clear();
+	outputs.clear();
+	passes.clear();
+	resources.clear();
+}
+
+
+VkRenderPass render_graph::get_render_pass(uint32_t pass)
+{
+	return passes[pass].render_pass;
+}
+
+
+void render_graph::get_attachment_formats(uint32_t pass, std::vector<VkFormat>* color_formats, VkFormat* depth_format)
+{
+	const RenderGraphPass& graph_pass = passes[pass];
+
+	color_formats->clear();
+	for (uint32_t resource : graph_pass.color_outputs)
+	{
+		color_formats->push_back(resources[resource].info.format);
+	}
+
+	*depth_format = graph_pass.depth_output >= 0 ? resources[graph_pass.depth_output].info.format : VK_FORMAT_UNDEFINED;
+}
+
+
+VkImage render_graph::get_image(uint32_t resource, uint32_t image_index)
+{
+	const auto& images = resources[resource].images;
+	return images[image_index % images.size()];
+}
+
+
+VkImageView render_graph::get_image_view(uint32_t resource, uint32_t image_index)
+{
+	const auto& image_views = resources[resource].image_views;
+	return image_views[image_index % image_views.size()];
+}
+
+
+VkBuffer render_graph::get_buffer(uint32_t resource)
+{
+	return resources[resource].buffer;
+}
+
+
+VkPipelineStageFlags render_graph::get_first_use_stages(uint32_t resource)
+{
+	if (resources[resource].first_pass < 0)
+		return VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+	const PassAccess* access = find_access(passes[pass_order[resources[resource].first_pass]], resource);
+	return access->stages;
+}
+
+
+const RenderGraphStats& render_graph::get_stats()
+{
+	return stats;
+}
+
+
+void render_graph::print_stats()
+{
+	printf("Render graph : %u passes (%u culled), %u barriers (%u image barriers, %u buffer barriers) \n",
+		stats.pass_count, stats.culled_pass_count, stats.barrier_count, stats.image_barrier_count, stats.buffer_barrier_count);
+	printf("Render graph : transient memory %llu bytes, %llu bytes after aliasing, %llu bytes lazily allocated \n",
+		(unsigned long long)stats.transient_bytes, (unsigned long long)stats.aliased_bytes,
+		(unsigned long long)stats.lazily_allocated_bytes);
+	printf("Render graph : %s, %u render passes, %u framebuffers, compiled in %.3f ms \n",
+		dynamic_rendering ? "dynamic rendering" : "render passes", stats.render_pass_count, stats.framebuffer_count, stats.compile_ms);
+}
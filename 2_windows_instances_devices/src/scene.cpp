@@ -0,0 +1,543 @@
+#include "..\headers\scene.h"
+
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#include <cmath>
+
+scene::scene()
+{
+}
+
+
+void scene::init(thread_pool* new_workers)
+{
+	workers = new_workers;
+}
+
+
+void scene::clear()
+{
+	for (uint32_t k = 0; k < transform_components; k++)
+	{
+		local_transforms[k].clear();
+		world_transforms[k].clear();
+	}
+
+	bounds_x.clear(); bounds_y.clear(); bounds_z.clear(); bounds_radius.clear();
+	world_x.clear(); world_y.clear(); world_z.clear(); world_radius.clear();
+
+	parents.clear();
+	depths.clear();
+	draw_keys.clear();
+	handle_indices.clear();
+	handles.clear();
+	level_ends.clear();
+	visible.clear();
+
+	layout_dirty = false;
+	stats = {};
+}
+
+
+uint32_t scene::add_object(uint32_t parent, const SceneTransform& transform, const SceneBounds& bounds, uint64_t draw_key)
+{
+	uint32_t depth = 0;
+	uint32_t parent_index = SCENE_NO_PARENT;
+
+	if (parent != SCENE_NO_PARENT)
+	{
+		if (parent >= handle_indices.size())
+		{
+			throw std::runtime_error(" Error: Scene object parent does not exist \n");
+		}
+
+		parent_index = handle_indices[parent];
+		depth = depths[parent_index] + 1;
+	}
+
+	uint32_t index = static_cast<uint32_t>(parents.size());
+	uint32_t handle = static_cast<uint32_t>(handle_indices.size());
+
+	for (uint32_t k = 0; k < transform_components; k++)
+	{
+		local_transforms[k].push_back(transform.rows[k / 4][k % 4]);
+		world_transforms[k].push_back(transform.rows[k / 4][k % 4]);
+	}
+
+	bounds_x.push_back(bounds.center[0]);
+	bounds_y.push_back(bounds.center[1]);
+	bounds_z.push_back(bounds.center[2]);
+	bounds_radius.push_back(bounds.radius);
+	world_x.push_back(bounds.center[0]);
+	world_y.push_back(bounds.center[1]);
+	world_z.push_back(bounds.center[2]);
+	world_radius.push_back(bounds.radius);
+
+	// Appending keeps the arrays sorted as long as the depth does not go back up
+	if (!depths.empty() && depth < depths.back())
+	{
+		layout_dirty = true;
+	}
+	else if (!layout_dirty)
+	{
+		if (depth == level_ends.size())
+			level_ends.push_back(index + 1);
+		else
+			level_ends.back() = index + 1;
+	}
+
+	parents.push_back(parent_index);
+	depths.push_back(depth);
+	draw_keys.push_back(draw_key);
+	handles.push_back(handle);
+	handle_indices.push_back(index);
+
+	return handle;
+}
+
+
+void scene::set_local_transform(uint32_t handle, const SceneTransform& transform)
+{
+	uint32_t index = handle_indices[handle];
+
+	for (uint32_t k = 0; k < transform_components; k++)
+	{
+		local_transforms[k][index] = transform.rows[k / 4][k % 4];
+	}
+}
+
+
+void scene::set_draw_key(uint32_t handle, uint64_t draw_key)
+{
+	draw_keys[handle_indices[handle]] = draw_key;
+}
+
+
+void scene::sort_by_depth()
+{
+	uint32_t count = static_cast<uint32_t>(parents.size());
+
+	// Counting sort, stable so siblings stay next to each other
+	uint32_t max_depth = 0;
+	for (uint32_t depth : depths)
+	{
+		max_depth = std::max(max_depth, depth);
+	}
+
+	level_ends.assign(max_depth + 1, 0);
+	for (uint32_t depth : depths)
+	{
+		level_ends[depth]++;
+	}
+
+	std::vector<uint32_t> level_cursor(max_depth + 1, 0);
+	for (uint32_t depth = 1; depth <= max_depth; depth++)
+	{
+		level_ends[depth] += level_ends[depth - 1];
+		level_cursor[depth] = level_ends[depth - 1];
+	}
+
+	std::vector<uint32_t> new_indices(count);
+	std::vector<uint32_t> order(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t new_index = level_cursor[depths[i]]++;
+		new_indices[i] = new_index;
+		order[new_index] = i;
+	}
+
+	auto permute = [&order, count](auto& values) {
+		auto sorted = values;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			sorted[i] = values[order[i]];
+		}
+		values.swap(sorted);
+	};
+
+	for (uint32_t k = 0; k < transform_components; k++)
+	{
+		permute(local_transforms[k]);
+		permute(world_transforms[k]);
+	}
+
+	permute(bounds_x); permute(bounds_y); permute(bounds_z); permute(bounds_radius);
+	permute(world_x); permute(world_y); permute(world_z); permute(world_radius);
+	permute(depths);
+	permute(draw_keys);
+	permute(handles);
+	permute(parents);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (parents[i] != SCENE_NO_PARENT)
+			parents[i] = new_indices[parents[i]];
+
+		handle_indices[handles[i]] = i;
+	}
+
+	layout_dirty = false;
+}
+
+
+void scene::run(uint32_t begin, uint32_t end, const std::function<void(uint32_t, uint32_t, uint32_t)>& job)
+{
+	uint32_t chunk_count = (end - begin + grain - 1) / grain;
+
+	auto run_chunks = [&](uint32_t first_chunk, uint32_t last_chunk) {
+		for (uint32_t chunk = first_chunk; chunk < last_chunk; chunk++)
+		{
+			uint32_t chunk_begin = begin + chunk * grain;
+			job(chunk, chunk_begin, std::min(chunk_begin + grain, end));
+		}
+	};
+
+	if (workers != nullptr)
+		workers->parallel_for(chunk_count, 1, run_chunks);
+	else
+		run_chunks(0, chunk_count);
+}
+
+
+void scene::update_level(uint32_t begin, uint32_t end, bool root)
+{
+	float* world[transform_components];
+	const float* local[transform_components];
+	for (uint32_t k = 0; k < transform_components; k++)
+	{
+		world[k] = world_transforms[k].data();
+		local[k] = local_transforms[k].data();
+	}
+
+	uint32_t i = begin;
+
+	// Four objects at a time, each register holds one matrix component of four objects
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 l[transform_components];
+		__m128 w[transform_components];
+
+		for (uint32_t k = 0; k < transform_components; k++)
+		{
+			l[k] = _mm_loadu_ps(local[k] + i);
+		}
+
+		if (root)
+		{
+			for (uint32_t k = 0; k < transform_components; k++)
+			{
+				w[k] = l[k];
+			}
+		}
+		else
+		{
+			// Siblings share a parent, so the gather mostly hits the same cache lines
+			uint32_t p0 = parents[i], p1 = parents[i + 1], p2 = parents[i + 2], p3 = parents[i + 3];
+
+			__m128 p[transform_components];
+			for (uint32_t k = 0; k < transform_components; k++)
+			{
+				p[k] = _mm_set_ps(world[k][p3], world[k][p2], world[k][p1], world[k][p0]);
+			}
+
+			for (uint32_t r = 0; r < 3; r++)
+			{
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					__m128 value = _mm_add_ps(_mm_add_ps(
+						_mm_mul_ps(p[r * 4 + 0], l[0 * 4 + c]),
+						_mm_mul_ps(p[r * 4 + 1], l[1 * 4 + c])),
+						_mm_mul_ps(p[r * 4 + 2], l[2 * 4 + c]));
+
+					if (c == 3)
+						value = _mm_add_ps(value, p[r * 4 + 3]);
+
+					w[r * 4 + c] = value;
+				}
+			}
+		}
+
+		for (uint32_t k = 0; k < transform_components; k++)
+		{
+			_mm_storeu_ps(world[k] + i, w[k]);
+		}
+
+		// Bounding sphere: move the center, scale the radius by the largest axis scale
+		__m128 x = _mm_loadu_ps(&bounds_x[i]);
+		__m128 y = _mm_loadu_ps(&bounds_y[i]);
+		__m128 z = _mm_loadu_ps(&bounds_z[i]);
+
+		__m128 center[3];
+		for (uint32_t r = 0; r < 3; r++)
+		{
+			center[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w[r * 4 + 0], x), _mm_mul_ps(w[r * 4 + 1], y)),
+				_mm_add_ps(_mm_mul_ps(w[r * 4 + 2], z), w[r * 4 + 3]));
+		}
+
+		__m128 max_scale = _mm_setzero_ps();
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			__m128 scale = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w[c], w[c]), _mm_mul_ps(w[4 + c], w[4 + c])),
+				_mm_mul_ps(w[8 + c], w[8 + c]));
+			max_scale = _mm_max_ps(max_scale, scale);
+		}
+
+		_mm_storeu_ps(&world_x[i], center[0]);
+		_mm_storeu_ps(&world_y[i], center[1]);
+		_mm_storeu_ps(&world_z[i], center[2]);
+		_mm_storeu_ps(&world_radius[i], _mm_mul_ps(_mm_loadu_ps(&bounds_radius[i]), _mm_sqrt_ps(max_scale)));
+	}
+
+	// Remaining objects one by one
+	for (; i < end; i++)
+	{
+		float w[transform_components];
+
+		if (root)
+		{
+			for (uint32_t k = 0; k < transform_components; k++)
+			{
+				w[k] = local[k][i];
+			}
+		}
+		else
+		{
+			uint32_t parent = parents[i];
+			for (uint32_t r = 0; r < 3; r++)
+			{
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					w[r * 4 + c] = world[r * 4 + 0][parent] * local[0 * 4 + c][i]
+						+ world[r * 4 + 1][parent] * local[1 * 4 + c][i]
+						+ world[r * 4 + 2][parent] * local[2 * 4 + c][i]
+						+ (c == 3 ? world[r * 4 + 3][parent] : 0.0f);
+				}
+			}
+		}
+
+		for (uint32_t k = 0; k < transform_components; k++)
+		{
+			world[k][i] = w[k];
+		}
+
+		float center[3];
+		for (uint32_t r = 0; r < 3; r++)
+		{
+			center[r] = w[r * 4 + 0] * bounds_x[i] + w[r * 4 + 1] * bounds_y[i] + w[r * 4 + 2] * bounds_z[i] + w[r * 4 + 3];
+		}
+
+		float max_scale = 0.0f;
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			max_scale = std::max(max_scale, w[c] * w[c] + w[4 + c] * w[4 + c] + w[8 + c] * w[8 + c]);
+		}
+
+		world_x[i] = center[0];
+		world_y[i] = center[1];
+		world_z[i] = center[2];
+		world_radius[i] = bounds_radius[i] * std::sqrt(max_scale);
+	}
+}
+
+
+void scene::update_transforms()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	if (layout_dirty)
+	{
+		sort_by_depth();
+	}
+
+	// Levels run one after the other, the objects of a level in parallel
+	uint32_t level_begin = 0;
+	for (uint32_t level = 0; level < level_ends.size(); level++)
+	{
+		uint32_t level_end = level_ends[level];
+		bool root = level == 0;
+
+		run(level_begin, level_end, [this, root](uint32_t, uint32_t begin, uint32_t end) {
+			update_level(begin, end, root);
+		});
+
+		level_begin = level_end;
+	}
+
+	stats.object_count = static_cast<uint32_t>(parents.size());
+	stats.level_count = static_cast<uint32_t>(level_ends.size());
+	stats.transform_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+
+void scene::cull_range(const FrustumPlanes& frustum, uint32_t begin, uint32_t end, std::vector<uint32_t>& out_visible)
+{
+	__m128 planes[6][4];
+	for (uint32_t p = 0; p < 6; p++)
+	{
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+		}
+	}
+
+	const __m128 all_inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+	uint32_t i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&world_x[i]);
+		__m128 y = _mm_loadu_ps(&world_y[i]);
+		__m128 z = _mm_loadu_ps(&world_z[i]);
+		__m128 negative_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&world_radius[i]));
+
+		__m128 inside = all_inside;
+		for (uint32_t p = 0; p < 6; p++)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+				_mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negative_radius));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			if (mask & (1 << lane))
+				out_visible.push_back(i + lane);
+		}
+	}
+
+	for (; i < end; i++)
+	{
+		bool inside = true;
+		for (uint32_t p = 0; p < 6 && inside; p++)
+		{
+			float distance = frustum.planes[p][0] * world_x[i] + frustum.planes[p][1] * world_y[i]
+				+ frustum.planes[p][2] * world_z[i] + frustum.planes[p][3];
+			inside = distance >= -world_radius[i];
+		}
+
+		if (inside)
+			out_visible.push_back(i);
+	}
+}
+
+
+void scene::cull(const FrustumPlanes& frustum)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	uint32_t count = static_cast<uint32_t>(parents.size());
+	job_visible.resize((count + grain - 1) / grain);
+
+	run(0, count, [this, &frustum](uint32_t chunk, uint32_t begin, uint32_t end) {
+		job_visible[chunk].clear();
+		cull_range(frustum, begin, end, job_visible[chunk]);
+	});
+
+	// Chunks are joined in order so the visible list stays sorted by index
+	visible.clear();
+	for (const std::vector<uint32_t>& chunk_visible : job_visible)
+	{
+		visible.insert(visible.end(), chunk_visible.begin(), chunk_visible.end());
+	}
+
+	stats.visible_count = static_cast<uint32_t>(visible.size());
+	stats.cull_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+
+void scene::update(const FrustumPlanes& frustum)
+{
+	update_transforms();
+	cull(frustum);
+}
+
+
+FrustumPlanes scene::extract_frustum(const glm::mat4& view_projection)
+{
+	// glm matrices are column major, row r is (m[0][r], m[1][r], m[2][r], m[3][r])
+	float rows[4][4];
+	for (uint32_t r = 0; r < 4; r++)
+	{
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			rows[r][c] = view_projection[c][r];
+		}
+	}
+
+	FrustumPlanes frustum;
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		frustum.planes[0][c] = rows[3][c] + rows[0][c];	// left
+		frustum.planes[1][c] = rows[3][c] - rows[0][c];	// right
+		frustum.planes[2][c] = rows[3][c] + rows[1][c];	// bottom
+		frustum.planes[3][c] = rows[3][c] - rows[1][c];	// top
+		frustum.planes[4][c] = rows[2][c];				// near, depth starts at zero
+		frustum.planes[5][c] = rows[3][c] - rows[2][c];	// far
+	}
+
+	// Normalized so the plane distance can be compared with the sphere radius
+	for (uint32_t p = 0; p < 6; p++)
+	{
+		float length = std::sqrt(frustum.planes[p][0] * frustum.planes[p][0] + frustum.planes[p][1] * frustum.planes[p][1]
+			+ frustum.planes[p][2] * frustum.planes[p][2]);
+
+		if (length > 0.0f)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				frustum.planes[p][c] /= length;
+			}
+		}
+	}
+
+	return frustum;
+}
+
+
+const std::vector<uint32_t>& scene::get_visible()
+{
+	return visible;
+}
+
+
+uint32_t scene::get_object_count()
+{
+	return static_cast<uint32_t>(parents.size());
+}
+
+
+uint32_t scene::get_handle(uint32_t index)
+{
+	return handles[index];
+}
+
+
+uint64_t scene::get_draw_key(uint32_t index)
+{
+	return draw_keys[index];
+}
+
+
+void scene::get_world_transform(uint32_t index, float* rows)
+{
+	for (uint32_t k = 0; k < transform_components; k++)
+	{
+		rows[k] = world_transforms[k][index];
+	}
+}
+
+
+void scene::get_world_bounds(uint32_t index, float* center, float* radius)
+{
+	center[0] = world_x[index];
+	center[1] = world_y[index];
+	center[2] = world_z[index];
+	*radius = world_radius[index];
+}
+
+
+const SceneStats& scene::get_stats()
+{
+	return stats;
+}
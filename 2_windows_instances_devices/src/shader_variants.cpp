@@ -0,0 +1,66 @@
+#include "..\headers\shader_variants.h"
+
+#include <cstddef>
+
+shader_variants::shader_variants()
+{
+	map_entries[0].constantID = 0;
+	map_entries[0].offset = offsetof(ShaderSpecialization, features);
+	map_entries[0].size = sizeof(uint32_t);
+
+	map_entries[1].constantID = 1;
+	map_entries[1].offset = offsetof(ShaderSpecialization, light_count);
+	map_entries[1].size = sizeof(uint32_t);
+}
+
+
+void shader_variants::init(uint32_t light_count)
+{
+	uint32_t variant_count = 1 + (1u << SHADER_FEATURE_BITS);
+
+	specializations.assign(variant_count, ShaderSpecialization());
+	specialization_infos.resize(variant_count);
+
+	for (uint32_t variant = 0; variant < variant_count; variant++)
+	{
+		ShaderSpecialization& specialization = specializations[variant];
+		specialization.features = variant == SHADER_VARIANT_UBER ? SHADER_FEATURE_DYNAMIC : variant - 1;
+		specialization.light_count = light_count;
+
+		// Points into specializations, which is not resized again until the next init
+		VkSpecializationInfo& info = specialization_infos[variant];
+		info.mapEntryCount = static_cast<uint32_t>(map_entries.size());
+		info.pMapEntries = map_entries.data();
+		info.dataSize = sizeof(ShaderSpecialization);
+		info.pData = &specialization;
+	}
+}
+
+
+uint32_t shader_variants::get_variant_count()
+{
+	return static_cast<uint32_t>(specializations.size());
+}
+
+
+uint32_t shader_variants::get_variant(uint32_t features)
+{
+	if (features >= (1u << SHADER_FEATURE_BITS))
+	{
+		throw std::runtime_error(" Error: Unknown shader feature \n");
+	}
+
+	return features + 1;
+}
+
+
+const VkSpecializationInfo* shader_variants::get_specialization_info(uint32_t variant)
+{
+	return &specialization_infos[variant];
+}
+
+
+const ShaderSpecialization& shader_variants::get_specialization(uint32_t variant)
+{
+	return specializations[variant];
+}
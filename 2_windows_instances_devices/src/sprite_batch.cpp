@@ -0,0 +1,567 @@
+#include "..\headers\sprite_batch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+
+sprite_batch::sprite_batch()
+{
+}
+
+
+void sprite_batch::init(VkPhysicalDevice new_physical_device, VkDevice new_device, uint32_t frame_count,
+	const std::vector<char>& vertex_code, const std::vector<char>& fragment_code, memory_tracker* new_tracker,
+	bindless_heap* new_bindless, texture_manager* new_textures, const VkAllocationCallbacks* new_allocator)
+{
+	physical_device = new_physical_device;
+	device = new_device;
+	tracker = new_tracker;
+	bindless = new_bindless;
+	textures = new_textures;
+	allocator = new_allocator;
+
+	if (vertex_code.empty() || fragment_code.empty())
+	{
+		printf("Sprites are not available, sprite_vert.spv or sprite_frag.spv is missing \n");
+		return;
+	}
+
+	create_layout(vertex_code, fragment_code);
+
+	streams.resize(frame_count);
+	for (SpriteStream& stream : streams)
+	{
+		create_stream(&stream, SPRITE_INITIAL_CAPACITY);
+	}
+
+	sprites.reserve(SPRITE_INITIAL_CAPACITY);
+	order.reserve(SPRITE_INITIAL_CAPACITY);
+
+	available = true;
+
+	printf("Sprite batch creation is  a success \n");
+}
+
+
+void sprite_batch::create_stream(SpriteStream* stream, uint32_t capacity)
+{
+	VkDeviceSize size = static_cast<VkDeviceSize>(capacity) * sizeof(SpriteInstance);
+
+	VkBufferCreateInfo buffer_create_info = {};
+	buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_create_info.size = size;
+	buffer_create_info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkResult result = vkCreateBuffer(device, &buffer_create_info, allocator, &stream->buffer);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create a sprite vertex stream \n");
+	}
+
+	VkMemoryRequirements memory_requirements;
+	vkGetBufferMemoryRequirements(device, stream->buffer, &memory_requirements);
+
+	// Written once in order and read once by the GPU, device local when the host can write it directly
+	uint32_t memory_type;
+	try
+	{
+		memory_type = find_memory_type_index(physical_device, memory_requirements.memoryTypeBits,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	}
+	catch (const std::runtime_error&)
+	{
+		memory_type = find_memory_type_index(physical_device, memory_requirements.memoryTypeBits,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	}
+
+	VkMemoryAllocateInfo allocate_info = {};
+	allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocate_info.allocationSize = memory_requirements.size;
+	allocate_info.memoryTypeIndex = memory_type;
+
+	result = tracker->allocate(&allocate_info, &stream->memory, "sprite stream");
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to allocate a sprite vertex stream \n");
+	}
+
+	vkBindBufferMemory(device, stream->buffer, stream->memory, 0);
+	tracker->add_bound_bytes(stream->memory, size);
+
+	// Stays mapped, the stream is rewritten every time its frame comes round
+	void* mapped = nullptr;
+	result = vkMapMemory(device, stream->memory, 0, size, 0, &mapped);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to map a sprite vertex stream \n");
+	}
+
+	stream->mapped = static_cast<SpriteInstance*>(mapped);
+	stream->capacity = capacity;
+
+	stats.capacity = std::max(stats.capacity, capacity);
+}
+
+
+void sprite_batch::destroy_stream(SpriteStream* stream)
+{
+	if (stream->buffer == VK_NULL_HANDLE)
+		return;
+
+	vkUnmapMemory(device, stream->memory);
+	vkDestroyBuffer(device, stream->buffer, allocator);
+	tracker->free(stream->memory);
+
+	stream->buffer = VK_NULL_HANDLE;
+	stream->memory = VK_NULL_HANDLE;
+	stream->mapped = nullptr;
+	stream->capacity = 0;
+}
+
+
+void sprite_batch::create_layout(const std::vector<char>& vertex_code, const std::vector<char>& fragment_code)
+{
+	// Pages are read through the bindless heap, the rest is in push constants
+	VkPushConstantRange push_constant_range = {};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(SpritePushConstants);
+
+	VkDescriptorSetLayout set_layout = bindless->get_set_layout();
+
+	VkPipelineLayoutCreateInfo layout_create_info = {};
+	layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layout_create_info.setLayoutCount = 1;
+	layout_create_info.pSetLayouts = &set_layout;
+	layout_create_info.pushConstantRangeCount = 1;
+	layout_create_info.pPushConstantRanges = &push_constant_range;
+
+	VkResult result = vkCreatePipelineLayout(device, &layout_create_info, allocator, &pipeline_layout);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the sprite pipeline layout \n");
+	}
+
+	VkShaderModuleCreateInfo shader_create_info = {};
+	shader_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shader_create_info.codeSize = vertex_code.size();
+	shader_create_info.pCode = reinterpret_cast<const uint32_t*>(vertex_code.data());
+
+	result = vkCreateShaderModule(device, &shader_create_info, allocator, &vertex_module);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the sprite vertex shader module \n");
+	}
+
+	shader_create_info.codeSize = fragment_code.size();
+	shader_create_info.pCode = reinterpret_cast<const uint32_t*>(fragment_code.data());
+
+	result = vkCreateShaderModule(device, &shader_create_info, allocator, &fragment_module);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the sprite fragment shader module \n");
+	}
+}
+
+
+void sprite_batch::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+		return;
+
+	for (SpriteStream& stream : streams)
+	{
+		destroy_stream(&stream);
+	}
+	streams.clear();
+
+	if (available)
+	{
+		destroy_pipeline();
+
+		vkDestroyPipelineLayout(device, pipeline_layout, allocator);
+		vkDestroyShaderModule(device, fragment_module, allocator);
+		vkDestroyShaderModule(device, vertex_module, allocator);
+	}
+
+	sprites.clear();
+	order.clear();
+	batches.clear();
+
+	available = false;
+	device = VK_NULL_HANDLE;
+}
+
+
+bool sprite_batch::is_available()
+{
+	return available;
+}
+
+
+void sprite_batch::add(const Sprite& sprite)
+{
+	if (!available)
+		return;
+
+	sprites.push_back(sprite);
+}
+
+
+void sprite_batch::add_rect(float x, float y, float width, float height, uint32_t colour, uint32_t layer)
+{
+	Sprite sprite;
+	sprite.position[0] = x;
+	sprite.position[1] = y;
+	sprite.size[0] = width;
+	sprite.size[1] = height;
+	sprite.colour = colour;
+	sprite.layer = layer;
+
+	add(sprite);
+}
+
+
+void sprite_batch::clear()
+{
+	sprites.clear();
+}
+
+
+uint32_t sprite_batch::get_pending_count()
+{
+	return static_cast<uint32_t>(sprites.size());
+}
+
+
+void sprite_batch::create_pipeline(VkRenderPass render_pass, const VkPipelineRenderingCreateInfoKHR* rendering_info)
+{
+	if (!available)
+		return;
+
+	VkPipelineShaderStageCreateInfo shader_stages[2] = {};
+	shader_stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shader_stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shader_stages[0].module = vertex_module;
+	shader_stages[0].pName = "main";
+	shader_stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shader_stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shader_stages[1].module = fragment_module;
+	shader_stages[1].pName = "main";
+
+	// One instance per sprite, the corner comes from the vertex index
+	VkVertexInputBindingDescription binding_description = {};
+	binding_description.binding = 0;
+	binding_description.stride = sizeof(SpriteInstance);
+	binding_description.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+	VkVertexInputAttributeDescription attribute_descriptions[3] = {};
+	attribute_descriptions[0].location = 0;
+	attribute_descriptions[0].binding = 0;
+	attribute_descriptions[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+	attribute_descriptions[0].offset = offsetof(SpriteInstance, rect);
+	attribute_descriptions[1].location = 1;
+	attribute_descriptions[1].binding = 0;
+	attribute_descriptions[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+	attribute_descriptions[1].offset = offsetof(SpriteInstance, uv_rect);
+	attribute_descriptions[2].location = 2;
+	attribute_descriptions[2].binding = 0;
+	attribute_descriptions[2].format = VK_FORMAT_R8G8B8A8_UNORM;
+	attribute_descriptions[2].offset = offsetof(SpriteInstance, colour);
+
+	VkPipelineVertexInputStateCreateInfo vertex_input_state_info = {};
+	vertex_input_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertex_input_state_info.vertexBindingDescriptionCount = 1;
+	vertex_input_state_info.pVertexBindingDescriptions = &binding_description;
+	vertex_input_state_info.vertexAttributeDescriptionCount = 3;
+	vertex_input_state_info.pVertexAttributeDescriptions = attribute_descriptions;
+
+	VkPipelineInputAssemblyStateCreateInfo input_assembly_info = {};
+	input_assembly_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	input_assembly_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	input_assembly_info.primitiveRestartEnable = VK_FALSE;
+
+	VkPipelineViewportStateCreateInfo viewport_create_info = {};
+	viewport_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewport_create_info.viewportCount = 1;
+	viewport_create_info.scissorCount = 1;
+
+	VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+	VkPipelineDynamicStateCreateInfo dynamic_state_create_info = {};
+	dynamic_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamic_state_create_info.dynamicStateCount = 2;
+	dynamic_state_create_info.pDynamicStates = dynamic_states;
+
+	// Sprites may be mirrored with a negative size, no culling
+	VkPipelineRasterizationStateCreateInfo rasterizer_create_info = {};
+	rasterizer_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer_create_info.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer_create_info.lineWidth = 1.0f;
+	rasterizer_create_info.cullMode = VK_CULL_MODE_NONE;
+	rasterizer_create_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling_create_info = {};
+	multisampling_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling_create_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineColorBlendAttachmentState blend_attach_state = {};
+	blend_attach_state.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT
+		| VK_COLOR_COMPONENT_A_BIT;
+	blend_attach_state.blendEnable = VK_TRUE;
+	blend_attach_state.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	blend_attach_state.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	blend_attach_state.colorBlendOp = VK_BLEND_OP_ADD;
+	blend_attach_state.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	blend_attach_state.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	blend_attach_state.alphaBlendOp = VK_BLEND_OP_ADD;
+
+	VkPipelineColorBlendStateCreateInfo color_blend_state_create_info = {};
+	color_blend_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	color_blend_state_create_info.logicOpEnable = VK_FALSE;
+	color_blend_state_create_info.attachmentCount = 1;
+	color_blend_state_create_info.pAttachments = &blend_attach_state;
+
+	// Over everything, the pass has no depth attachment
+	VkPipelineDepthStencilStateCreateInfo depth_stencil_create_info = {};
+	depth_stencil_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depth_stencil_create_info.depthTestEnable = VK_FALSE;
+	depth_stencil_create_info.depthWriteEnable = VK_FALSE;
+
+	VkGraphicsPipelineCreateInfo pipeline_create_info = {};
+	pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipeline_create_info.pNext = rendering_info;
+	pipeline_create_info.stageCount = 2;
+	pipeline_create_info.pStages = shader_stages;
+	pipeline_create_info.pVertexInputState = &vertex_input_state_info;
+	pipeline_create_info.pInputAssemblyState = &input_assembly_info;
+	pipeline_create_info.pViewportState = &viewport_create_info;
+	pipeline_create_info.pDynamicState = &dynamic_state_create_info;
+	pipeline_create_info.pRasterizationState = &rasterizer_create_info;
+	pipeline_create_info.pMultisampleState = &multisampling_create_info;
+	pipeline_create_info.pColorBlendState = &color_blend_state_create_info;
+	pipeline_create_info.pDepthStencilState = &depth_stencil_create_info;
+	pipeline_create_info.layout = pipeline_layout;
+	pipeline_create_info.renderPass = rendering_info != nullptr ? VK_NULL_HANDLE : render_pass;
+	pipeline_create_info.subpass = 0;
+
+	VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, allocator, &pipeline);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the sprite pipeline \n");
+	}
+}
+
+
+void sprite_batch::destroy_pipeline()
+{
+	if (pipeline != VK_NULL_HANDLE)
+	{
+		vkDestroyPipeline(device, pipeline, allocator);
+		pipeline = VK_NULL_HANDLE;
+	}
+}
+
+
+void sprite_batch::flush(uint32_t frame_slot)
+{
+	batches.clear();
+	flushed_frame = frame_slot;
+
+	stats.sprites = 0;
+	stats.batches = 0;
+	stats.skipped = 0;
+	stats.flush_ms = 0.0;
+
+	if (!available || sprites.empty())
+	{
+		sprites.clear();
+		return;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	SpriteStream& stream = streams[frame_slot];
+	uint32_t sprite_count = static_cast<uint32_t>(sprites.size());
+
+	// The fence of this frame was waited on, its stream can be replaced by a larger one
+	if (sprite_count > stream.capacity)
+	{
+		uint32_t capacity = std::max(stream.capacity, SPRITE_INITIAL_CAPACITY);
+		while (capacity < sprite_count)
+		{
+			capacity *= 2;
+		}
+
+		destroy_stream(&stream);
+		create_stream(&stream, capacity);
+		stats.stream_resizes++;
+	}
+
+	// Sprites usually come grouped already, the sort is skipped when they do
+	order.resize(sprite_count);
+	bool sorted = true;
+	for (uint32_t i = 0; i < sprite_count; i++)
+	{
+		order[i].key = (static_cast<uint64_t>(sprites[i].layer) << 32) | sprites[i].texture;
+		order[i].sprite = i;
+		sorted = sorted && (i == 0 || order[i - 1].key <= order[i].key);
+	}
+
+	if (!sorted)
+	{
+		std::sort(order.begin(), order.end(), [](const SpriteSortEntry& a, const SpriteSortEntry& b) {
+			return a.key < b.key || (a.key == b.key && a.sprite < b.sprite);
+		});
+	}
+
+	// Written front to back in one pass, the memory may be write combined
+	SpriteInstance* instances = stream.mapped;
+	uint32_t written = 0;
+	uint32_t current_texture = SPRITE_NO_TEXTURE;
+	uint32_t current_index = BINDLESS_INVALID_INDEX;
+	uint64_t current_key = ~0ull;
+
+	for (uint32_t i = 0; i < sprite_count; i++)
+	{
+		const Sprite& sprite = sprites[order[i].sprite];
+
+		// A new batch at every change of layer or page, pages resolve to their bindless slot once per batch
+		if (order[i].key != current_key)
+		{
+			current_key = order[i].key;
+
+			if (sprite.texture != current_texture || batches.empty())
+			{
+				current_texture = sprite.texture;
+				current_index = BINDLESS_INVALID_INDEX;
+
+				if (current_texture != SPRITE_NO_TEXTURE)
+				{
+					current_index = textures->get_bindless_index(current_texture);
+					textures->mark_used(current_texture);
+				}
+			}
+
+			SpriteDrawBatch batch = {};
+			batch.texture_index = current_index;
+			batch.first_instance = written;
+			batch.instance_count = 0;
+			batches.push_back(batch);
+		}
+
+		// Still loading, left out rather than drawn untextured
+		if (current_texture != SPRITE_NO_TEXTURE && current_index == BINDLESS_INVALID_INDEX)
+		{
+			stats.skipped++;
+			continue;
+		}
+
+		SpriteInstance& instance = instances[written++];
+		instance.rect[0] = sprite.position[0];
+		instance.rect[1] = sprite.position[1];
+		instance.rect[2] = sprite.size[0];
+		instance.rect[3] = sprite.size[1];
+		instance.uv_rect[0] = sprite.uv_min[0];
+		instance.uv_rect[1] = sprite.uv_min[1];
+		instance.uv_rect[2] = sprite.uv_max[0];
+		instance.uv_rect[3] = sprite.uv_max[1];
+		instance.colour = sprite.colour;
+
+		batches.back().instance_count++;
+	}
+
+	// Batches left empty by skipped sprites are dropped, neighbours on the same page merge since their instances follow each other
+	size_t kept = 0;
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		if (batches[i].instance_count == 0)
+			continue;
+
+		if (kept > 0 && batches[kept - 1].texture_index == batches[i].texture_index)
+		{
+			batches[kept - 1].instance_count += batches[i].instance_count;
+			continue;
+		}
+
+		batches[kept++] = batches[i];
+	}
+	batches.resize(kept);
+
+	sprites.clear();
+
+	stats.sprites = written;
+	stats.batches = static_cast<uint32_t>(batches.size());
+	stats.flush_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	stats.frames++;
+	stats.total_sprites += written;
+	stats.total_batches += batches.size();
+	stats.total_flush_ms += stats.flush_ms;
+}
+
+
+void sprite_batch::record(VkCommandBuffer command_buffer, VkExtent2D extent)
+{
+	if (!available || pipeline == VK_NULL_HANDLE || batches.empty())
+		return;
+
+	VkViewport viewport = {};
+	viewport.width = static_cast<float>(extent.width);
+	viewport.height = static_cast<float>(extent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = {};
+	scissor.extent = extent;
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+	bindless->bind(command_buffer, pipeline_layout, VK_PIPELINE_BIND_POINT_GRAPHICS, flushed_frame);
+
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(command_buffer, 0, 1, &streams[flushed_frame].buffer, &offset);
+
+	// Pixels to clip space, y down in both
+	SpritePushConstants push_constants = {};
+	push_constants.scale[0] = 2.0f / static_cast<float>(extent.width);
+	push_constants.scale[1] = 2.0f / static_cast<float>(extent.height);
+	push_constants.offset[0] = -1.0f;
+	push_constants.offset[1] = -1.0f;
+
+	for (const SpriteDrawBatch& batch : batches)
+	{
+		push_constants.texture_index = batch.texture_index;
+		vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+			sizeof(SpritePushConstants), &push_constants);
+
+		vkCmdDraw(command_buffer, 6, batch.instance_count, 0, batch.first_instance);
+	}
+}
+
+
+const SpriteStats& sprite_batch::get_stats()
+{
+	return stats;
+}
+
+
+void sprite_batch::print_stats()
+{
+	if (!available || stats.frames == 0)
+		return;
+
+	double frames = static_cast<double>(stats.frames);
+	printf("Sprites : %.0f sprites in %.1f batches per frame over %llu frames, %.3f ms to flush, stream of %u sprites (%u resizes) \n",
+		static_cast<double>(stats.total_sprites) / frames, static_cast<double>(stats.total_batches) / frames,
+		(unsigned long long)stats.frames, stats.total_flush_ms / frames, stats.capacity, stats.stream_resizes);
+}
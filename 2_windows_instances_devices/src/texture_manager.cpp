@@ -0,0 +1,810 @@
+#include "..\headers\texture_manager.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+static uint32_t mip_size(uint32_t size, uint32_t level)
+{
+	return std::max(1u, size >> level);
+}
+
+
+// Approximate memory of a RGBA8 mip chain, used to plan against the budget before the image exists
+static VkDeviceSize mip_chain_bytes(uint32_t width, uint32_t height, uint32_t mip_levels)
+{
+	VkDeviceSize bytes = 0;
+	for (uint32_t level = 0; level < mip_levels; level++)
+	{
+		bytes += (VkDeviceSize)mip_size(width, level) * mip_size(height, level) * 4;
+	}
+	return bytes;
+}
+
+
+static void transition_mips(VkCommandBuffer command_buffer, VkImage image, uint32_t base_level, uint32_t level_count,
+	VkImageLayout old_layout, VkImageLayout new_layout, VkAccessFlags src_access, VkAccessFlags dst_access,
+	VkPipelineStageFlags src_stages, VkPipelineStageFlags dst_stages)
+{
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = old_layout;
+	barrier.newLayout = new_layout;
+	barrier.srcAccessMask = src_access;
+	barrier.dstAccessMask = dst_access;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = base_level;
+	barrier.subresourceRange.levelCount = level_count;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	vkCmdPipelineBarrier(command_buffer, src_stages, dst_stages, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+
+texture_manager::texture_manager()
+{
+}
+
+
+void texture_manager::init(VkPhysicalDevice new_physical_device, VkDevice new_device, VkQueue new_queue,
+	uint32_t queue_family, thread_pool* new_workers, bindless_heap* new_heap, memory_tracker* new_tracker,
+	const VkAllocationCallbacks* new_allocator)
+{
+	physical_device = new_physical_device;
+	device = new_device;
+	queue = new_queue;
+	workers = new_workers;
+	heap = new_heap;
+	tracker = new_tracker;
+	allocator = new_allocator;
+
+	// The mip tail is generated with linear blits
+	VkFormatProperties format_properties;
+	vkGetPhysicalDeviceFormatProperties(physical_device, texture_format, &format_properties);
+
+	VkFormatFeatureFlags required_features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT
+		| VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+	if ((format_properties.optimalTilingFeatures & required_features) != required_features)
+	{
+		throw std::runtime_error(" Error: Texture format does not support linear blits \n");
+	}
+
+	VkCommandPoolCreateInfo pool_create_info = {};
+	pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	pool_create_info.queueFamilyIndex = queue_family;
+
+	VkResult result = vkCreateCommandPool(device, &pool_create_info, allocator, &command_pool);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the texture command pool \n");
+	}
+
+	// One sampler for every texture, the views only cover the resident levels
+	VkSamplerCreateInfo sampler_create_info = {};
+	sampler_create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	sampler_create_info.magFilter = VK_FILTER_LINEAR;
+	sampler_create_info.minFilter = VK_FILTER_LINEAR;
+	sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	sampler_create_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	sampler_create_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	sampler_create_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	sampler_create_info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	sampler_create_info.unnormalizedCoordinates = VK_FALSE;
+	sampler_create_info.compareEnable = VK_FALSE;
+	sampler_create_info.anisotropyEnable = VK_FALSE;
+	sampler_create_info.maxAnisotropy = 1.0f;
+	sampler_create_info.mipLodBias = 0.0f;
+	sampler_create_info.minLod = 0.0f;
+	sampler_create_info.maxLod = VK_LOD_CLAMP_NONE;
+
+	result = vkCreateSampler(device, &sampler_create_info, allocator, &sampler);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the texture sampler \n");
+	}
+
+	stats.budget_bytes = budget;
+
+	printf("Texture manager creation is  a success \n");
+}
+
+
+uint32_t texture_manager::load_texture(const std::string& file)
+{
+	Texture texture = {};
+	texture.file = file;
+	texture.state = TextureState::loading;
+	texture.last_used_frame = frame_index;
+
+	textures.push_back(texture);
+	uint32_t index = static_cast<uint32_t>(textures.size() - 1);
+
+	// The worker picks the first resident mip once it knows the image size
+	textures[index].request_in_flight = true;
+	workers->submit([this, index, file]() { decode_texture(index, file, -1); });
+
+	return index;
+}
+
+
+void texture_manager::decode_texture(uint32_t texture, const std::string& file, int requested_mip)
+{
+	TextureDecodeResult result = {};
+	result.texture = texture;
+
+	int width, height, channels;
+	stbi_uc* pixels = stbi_load(file.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+
+	if (pixels != nullptr)
+	{
+		result.full_width = static_cast<uint32_t>(width);
+		result.full_height = static_cast<uint32_t>(height);
+
+		uint32_t largest = std::max(result.full_width, result.full_height);
+		while ((largest >> result.mip_count) > 0)
+		{
+			result.mip_count++;
+		}
+
+		if (requested_mip < 0)
+		{
+			while (result.top_mip + 1 < result.mip_count && (largest >> result.top_mip) > initial_size)
+			{
+				result.top_mip++;
+			}
+		}
+		else
+		{
+			result.top_mip = std::min(static_cast<uint32_t>(requested_mip), result.mip_count - 1);
+		}
+
+		// Box filter down to the requested level so only that level goes through the staging buffer
+		uint32_t src_width = result.full_width;
+		uint32_t src_height = result.full_height;
+		std::vector<unsigned char> level(pixels, pixels + (size_t)src_width * src_height * 4);
+		stbi_image_free(pixels);
+
+		for (uint32_t mip = 0; mip < result.top_mip; mip++)
+		{
+			uint32_t dst_width = std::max(1u, src_width / 2);
+			uint32_t dst_height = std::max(1u, src_height / 2);
+			std::vector<unsigned char> next((size_t)dst_width * dst_height * 4);
+
+			for (uint32_t y = 0; y < dst_height; y++)
+			{
+				uint32_t y0 = std::min(y * 2, src_height - 1);
+				uint32_t y1 = std::min(y * 2 + 1, src_height - 1);
+
+				for (uint32_t x = 0; x < dst_width; x++)
+				{
+					uint32_t x0 = std::min(x * 2, src_width - 1);
+					uint32_t x1 = std::min(x * 2 + 1, src_width - 1);
+
+					for (uint32_t c = 0; c < 4; c++)
+					{
+						uint32_t sum = level[((size_t)y0 * src_width + x0) * 4 + c] + level[((size_t)y0 * src_width + x1) * 4 + c]
+							+ level[((size_t)y1 * src_width + x0) * 4 + c] + level[((size_t)y1 * src_width + x1) * 4 + c];
+						next[((size_t)y * dst_width + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+					}
+				}
+			}
+
+			level.swap(next);
+			src_width = dst_width;
+			src_height = dst_height;
+		}
+
+		result.extent = { src_width, src_height };
+		result.pixels.swap(level);
+	}
+
+	std::lock_guard<std::mutex> lock(results_mutex);
+	decode_results.push_back(std::move(result));
+}
+
+
+void texture_manager::request_mip(uint32_t texture, uint32_t top_mip)
+{
+	textures[texture].request_in_flight = true;
+
+	std::string file = textures[texture].file;
+	workers->submit([this, texture, file, top_mip]() { decode_texture(texture, file, static_cast<int>(top_mip)); });
+}
+
+
+void texture_manager::update()
+{
+	frame_index++;
+
+	finish_uploads();
+	destroy_retired_images(false);
+
+	// Take the finished decodes, anything over the per frame upload limit waits for the next frame
+	std::vector<TextureDecodeResult> results;
+	{
+		std::lock_guard<std::mutex> lock(results_mutex);
+		size_t count = std::min(decode_results.size(), static_cast<size_t>(max_uploads_per_frame));
+		results.insert(results.end(), std::make_move_iterator(decode_results.begin()),
+			std::make_move_iterator(decode_results.begin() + count));
+		decode_results.erase(decode_results.begin(), decode_results.begin() + count);
+	}
+
+	for (TextureDecodeResult& result : results)
+	{
+		begin_upload(result);
+	}
+
+	update_residency();
+}
+
+
+void texture_manager::begin_upload(TextureDecodeResult& result)
+{
+	Texture& texture = textures[result.texture];
+
+	if (result.pixels.empty())
+	{
+		texture.state = TextureState::failed;
+		texture.request_in_flight = false;
+		printf("Failed to load the texture %s \n", texture.file.c_str());
+		return;
+	}
+
+	texture.full_width = result.full_width;
+	texture.full_height = result.full_height;
+	texture.mip_count = result.mip_count;
+
+	TextureUpload upload = {};
+	upload.texture = result.texture;
+	upload.image = create_texture_image(result.extent, result.top_mip, result.mip_count - result.top_mip);
+
+	// Staging buffer with the top level, the rest of the chain is blitted from it
+	VkDeviceSize staging_size = result.pixels.size();
+
+	VkBufferCreateInfo buffer_create_info = {};
+	buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_create_info.size = staging_size;
+	buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkResult vk_result = vkCreateBuffer(device, &buffer_create_info, allocator, &upload.staging_buffer);
+
+	if (vk_result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create a texture staging buffer \n");
+	}
+
+	VkMemoryRequirements memory_requirements;
+	vkGetBufferMemoryRequirements(device, upload.staging_buffer, &memory_requirements);
+
+	VkMemoryAllocateInfo allocate_info = {};
+	allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocate_info.allocationSize = memory_requirements.size;
+	allocate_info.memoryTypeIndex = find_memory_type_index(physical_device, memory_requirements.memoryTypeBits,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	vk_result = tracker->allocate(&allocate_info, &upload.staging_memory, "texture staging");
+
+	if (vk_result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to allocate texture staging memory \n");
+	}
+
+	vkBindBufferMemory(device, upload.staging_buffer, upload.staging_memory, 0);
+	tracker->add_bound_bytes(upload.staging_memory, staging_size);
+
+	void* data;
+	vkMapMemory(device, upload.staging_memory, 0, staging_size, 0, &data);
+	memcpy(data, result.pixels.data(), static_cast<size_t>(staging_size));
+	vkUnmapMemory(device, upload.staging_memory);
+
+	upload.command_buffer = begin_commands(&upload.fence);
+
+	VkImage image = upload.image.image;
+	uint32_t mip_levels = upload.image.mip_levels;
+
+	transition_mips(upload.command_buffer, image, 0, mip_levels, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	VkBufferImageCopy copy_region = {};
+	copy_region.bufferOffset = 0;
+	copy_region.bufferRowLength = 0;
+	copy_region.bufferImageHeight = 0;
+	copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	copy_region.imageSubresource.mipLevel = 0;
+	copy_region.imageSubresource.baseArrayLayer = 0;
+	copy_region.imageSubresource.layerCount = 1;
+	copy_region.imageOffset = { 0, 0, 0 };
+	copy_region.imageExtent = { result.extent.width, result.extent.height, 1 };
+
+	vkCmdCopyBufferToImage(upload.command_buffer, upload.staging_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy_region);
+
+	// Each level is blitted from the one above it, which is then done and can be sampled
+	int32_t mip_width = static_cast<int32_t>(result.extent.width);
+	int32_t mip_height = static_cast<int32_t>(result.extent.height);
+
+	for (uint32_t level = 1; level < mip_levels; level++)
+	{
+		transition_mips(upload.command_buffer, image, level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		int32_t next_width = std::max(1, mip_width / 2);
+		int32_t next_height = std::max(1, mip_height / 2);
+
+		VkImageBlit blit = {};
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = level - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = 1;
+		blit.srcOffsets[0] = { 0, 0, 0 };
+		blit.srcOffsets[1] = { mip_width, mip_height, 1 };
+		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.mipLevel = level;
+		blit.dstSubresource.baseArrayLayer = 0;
+		blit.dstSubresource.layerCount = 1;
+		blit.dstOffsets[0] = { 0, 0, 0 };
+		blit.dstOffsets[1] = { next_width, next_height, 1 };
+
+		vkCmdBlitImage(upload.command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blit, VK_FILTER_LINEAR);
+
+		transition_mips(upload.command_buffer, image, level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+		mip_width = next_width;
+		mip_height = next_height;
+	}
+
+	transition_mips(upload.command_buffer, image, mip_levels - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+	submit_commands(upload.command_buffer, upload.fence);
+	uploads.push_back(upload);
+}
+
+
+void texture_manager::begin_demote(uint32_t texture)
+{
+	Texture& source = textures[texture];
+	TextureImage& old_image = source.resident;
+
+	source.request_in_flight = true;
+
+	// Dropping a level needs no decode, the remaining levels are copied on the GPU
+	TextureUpload upload = {};
+	upload.texture = texture;
+	upload.image = create_texture_image({ mip_size(old_image.extent.width, 1), mip_size(old_image.extent.height, 1) },
+		old_image.top_mip + 1, old_image.mip_levels - 1);
+
+	upload.command_buffer = begin_commands(&upload.fence);
+
+	transition_mips(upload.command_buffer, old_image.image, 1, upload.image.mip_levels, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	transition_mips(upload.command_buffer, upload.image.image, 0, upload.image.mip_levels, VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	std::vector<VkImageCopy> regions(upload.image.mip_levels);
+	for (uint32_t level = 0; level < upload.image.mip_levels; level++)
+	{
+		VkImageCopy& region = regions[level];
+		region = {};
+		region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.srcSubresource.mipLevel = level + 1;
+		region.srcSubresource.baseArrayLayer = 0;
+		region.srcSubresource.layerCount = 1;
+		region.dstSubresource = region.srcSubresource;
+		region.dstSubresource.mipLevel = level;
+		region.extent = { mip_size(upload.image.extent.width, level), mip_size(upload.image.extent.height, level), 1 };
+	}
+
+	vkCmdCopyImage(upload.command_buffer, old_image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, upload.image.image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+
+	// Frames recorded before the swap keep sampling the old image, so it goes back to its read layout
+	transition_mips(upload.command_buffer, old_image.image, 1, upload.image.mip_levels, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	transition_mips(upload.command_buffer, upload.image.image, 0, upload.image.mip_levels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+	submit_commands(upload.command_buffer, upload.fence);
+	uploads.push_back(upload);
+}
+
+
+void texture_manager::finish_uploads()
+{
+	for (size_t i = 0; i < uploads.size();)
+	{
+		TextureUpload& upload = uploads[i];
+
+		if (vkGetFenceStatus(device, upload.fence) != VK_SUCCESS)
+		{
+			i++;
+			continue;
+		}
+
+		Texture& texture = textures[upload.texture];
+
+		if (texture.resident.image != VK_NULL_HANDLE)
+		{
+			if (upload.image.top_mip < texture.resident.top_mip)
+				stats.mips_streamed_in++;
+			else
+				stats.mips_streamed_out++;
+
+			retired_images.push_back({ texture.resident, frame_index });
+		}
+
+		texture.resident = upload.image;
+		texture.state = TextureState::resident;
+		texture.request_in_flight = false;
+
+		// Shaders keep using the same index, only the descriptor behind it changes
+		if (texture.bindless_index == BINDLESS_INVALID_INDEX)
+			texture.bindless_index = heap->add_texture(texture.resident.image_view, sampler);
+		else
+			heap->update_texture(texture.bindless_index, texture.resident.image_view, sampler);
+
+		vkFreeCommandBuffers(device, command_pool, 1, &upload.command_buffer);
+		vkDestroyFence(device, upload.fence, allocator);
+
+		if (upload.staging_buffer != VK_NULL_HANDLE)
+		{
+			vkDestroyBuffer(device, upload.staging_buffer, allocator);
+			tracker->free(upload.staging_memory);
+		}
+
+		uploads.erase(uploads.begin() + i);
+	}
+}
+
+
+void texture_manager::destroy_retired_images(bool force)
+{
+	for (size_t i = 0; i < retired_images.size();)
+	{
+		// Every frame that could have sampled the image has finished after MAX_FRAME_DRAWS frames
+		if (force || frame_index > retired_images[i].retire_frame + MAX_FRAME_DRAWS)
+		{
+			destroy_texture_image(retired_images[i].image);
+			retired_images.erase(retired_images.begin() + i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+
+void texture_manager::update_residency()
+{
+	VkDeviceSize resident_bytes = get_resident_bytes();
+
+	// Over budget, drop the top mip of the least recently used textures
+	while (resident_bytes > budget)
+	{
+		int victim = -1;
+		for (size_t i = 0; i < textures.size(); i++)
+		{
+			const Texture& texture = textures[i];
+			if (texture.state != TextureState::resident || texture.request_in_flight || texture.resident.mip_levels < 2)
+				continue;
+
+			if (victim < 0 || texture.last_used_frame < textures[victim].last_used_frame)
+			{
+				victim = static_cast<int>(i);
+			}
+		}
+
+		if (victim < 0)
+			break;
+
+		const TextureImage& image = textures[victim].resident;
+		VkDeviceSize freed = mip_chain_bytes(image.extent.width, image.extent.height, 1);
+		begin_demote(static_cast<uint32_t>(victim));
+		resident_bytes -= std::min(resident_bytes, freed);
+	}
+
+	// Under budget, bring in the next level of the most recently used texture that fits
+	int candidate = -1;
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		const Texture& texture = textures[i];
+		if (texture.state != TextureState::resident || texture.request_in_flight || texture.resident.top_mip == 0)
+			continue;
+
+		if (candidate < 0 || texture.last_used_frame > textures[candidate].last_used_frame)
+		{
+			candidate = static_cast<int>(i);
+		}
+	}
+
+	if (candidate >= 0)
+	{
+		const Texture& texture = textures[candidate];
+		uint32_t top_mip = texture.resident.top_mip - 1;
+		VkDeviceSize added = mip_chain_bytes(mip_size(texture.full_width, top_mip), mip_size(texture.full_height, top_mip), 1);
+
+		if (resident_bytes + added <= budget)
+		{
+			request_mip(static_cast<uint32_t>(candidate), top_mip);
+		}
+	}
+}
+
+
+TextureImage texture_manager::create_texture_image(VkExtent2D extent, uint32_t top_mip, uint32_t mip_levels)
+{
+	TextureImage texture_image = {};
+	texture_image.extent = extent;
+	texture_image.top_mip = top_mip;
+	texture_image.mip_levels = mip_levels;
+
+	VkImageCreateInfo image_create_info = {};
+	image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_create_info.imageType = VK_IMAGE_TYPE_2D;
+	image_create_info.format = texture_format;
+	image_create_info.extent = { extent.width, extent.height, 1 };
+	image_create_info.mipLevels = mip_levels;
+	image_create_info.arrayLayers = 1;
+	image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	VkResult result = vkCreateImage(device, &image_create_info, allocator, &texture_image.image);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create a texture image \n");
+	}
+
+	VkMemoryRequirements memory_requirements;
+	vkGetImageMemoryRequirements(device, texture_image.image, &memory_requirements);
+
+	VkMemoryAllocateInfo allocate_info = {};
+	allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocate_info.allocationSize = memory_requirements.size;
+	allocate_info.memoryTypeIndex = find_memory_type_index(physical_device, memory_requirements.memoryTypeBits,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	result = tracker->allocate(&allocate_info, &texture_image.memory, "textures");
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to allocate texture memory \n");
+	}
+
+	vkBindImageMemory(device, texture_image.image, texture_image.memory, 0);
+	texture_image.bytes = memory_requirements.size;
+
+	// Padding the driver adds beyond the texels shows up as fragmentation
+	tracker->add_bound_bytes(texture_image.memory, mip_chain_bytes(extent.width, extent.height, mip_levels));
+
+	VkImageViewCreateInfo view_create_info = {};
+	view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	view_create_info.image = texture_image.image;
+	view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	view_create_info.format = texture_format;
+	view_create_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+	view_create_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+	view_create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+	view_create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+	view_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	view_create_info.subresourceRange.baseMipLevel = 0;
+	view_create_info.subresourceRange.levelCount = mip_levels;
+	view_create_info.subresourceRange.baseArrayLayer = 0;
+	view_create_info.subresourceRange.layerCount = 1;
+
+	result = vkCreateImageView(device, &view_create_info, allocator, &texture_image.image_view);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create a texture image view \n");
+	}
+
+	return texture_image;
+}
+
+
+void texture_manager::destroy_texture_image(TextureImage& image)
+{
+	vkDestroyImageView(device, image.image_view, allocator);
+	vkDestroyImage(device, image.image, allocator);
+	tracker->free(image.memory);
+	image = {};
+}
+
+
+VkCommandBuffer texture_manager::begin_commands(VkFence* fence)
+{
+	VkCommandBufferAllocateInfo allocate_info = {};
+	allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocate_info.commandPool = command_pool;
+	allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocate_info.commandBufferCount = 1;
+
+	VkCommandBuffer command_buffer;
+	VkResult result = vkAllocateCommandBuffers(device, &allocate_info, &command_buffer);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to allocate a texture command buffer \n");
+	}
+
+	VkCommandBufferBeginInfo begin_info = {};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(command_buffer, &begin_info);
+
+	VkFenceCreateInfo fence_create_info = {};
+	fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	result = vkCreateFence(device, &fence_create_info, allocator, fence);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create a texture upload fence \n");
+	}
+
+	return command_buffer;
+}
+
+
+void texture_manager::submit_commands(VkCommandBuffer command_buffer, VkFence fence)
+{
+	vkEndCommandBuffer(command_buffer);
+
+	VkSubmitInfo submit_info = {};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &command_buffer;
+
+	VkResult result = vkQueueSubmit(queue, 1, &submit_info, fence);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to submit a texture upload \n");
+	}
+}
+
+
+VkDeviceSize texture_manager::get_resident_bytes()
+{
+	// Images being uploaded count as well, they are already allocated
+	VkDeviceSize bytes = 0;
+	for (const Texture& texture : textures)
+	{
+		bytes += texture.resident.bytes;
+	}
+	for (const TextureUpload& upload : uploads)
+	{
+		bytes += upload.image.bytes;
+	}
+	return bytes;
+}
+
+
+void texture_manager::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+		return;
+
+	// Let the workers finish so no decode result arrives after this point
+	workers->wait_idle();
+	vkQueueWaitIdle(queue);
+
+	for (TextureUpload& upload : uploads)
+	{
+		destroy_texture_image(upload.image);
+		vkDestroyFence(device, upload.fence, allocator);
+		if (upload.staging_buffer != VK_NULL_HANDLE)
+		{
+			vkDestroyBuffer(device, upload.staging_buffer, allocator);
+			tracker->free(upload.staging_memory);
+		}
+	}
+	uploads.clear();
+
+	destroy_retired_images(true);
+
+	for (Texture& texture : textures)
+	{
+		if (texture.resident.image != VK_NULL_HANDLE)
+		{
+			destroy_texture_image(texture.resident);
+		}
+		if (texture.bindless_index != BINDLESS_INVALID_INDEX)
+		{
+			heap->remove_texture(texture.bindless_index);
+		}
+	}
+	textures.clear();
+	decode_results.clear();
+
+	vkDestroySampler(device, sampler, allocator);
+	vkDestroyCommandPool(device, command_pool, allocator);
+
+	sampler = VK_NULL_HANDLE;
+	command_pool = VK_NULL_HANDLE;
+	device = VK_NULL_HANDLE;
+	stats = {};
+}
+
+
+void texture_manager::mark_used(uint32_t texture)
+{
+	textures[texture].last_used_frame = frame_index;
+}
+
+
+void texture_manager::set_budget(VkDeviceSize new_budget)
+{
+	budget = new_budget;
+	stats.budget_bytes = budget;
+}
+
+
+bool texture_manager::is_resident(uint32_t texture)
+{
+	return textures[texture].state == TextureState::resident;
+}
+
+
+VkImageView texture_manager::get_image_view(uint32_t texture)
+{
+	return textures[texture].resident.image_view;
+}
+
+
+uint32_t texture_manager::get_bindless_index(uint32_t texture)
+{
+	return textures[texture].bindless_index;
+}
+
+
+VkSampler texture_manager::get_sampler()
+{
+	return sampler;
+}
+
+
+const TextureStats& texture_manager::get_stats()
+{
+	stats.texture_count = static_cast<uint32_t>(textures.size());
+	stats.resident_count = 0;
+	for (const Texture& texture : textures)
+	{
+		if (texture.state == TextureState::resident)
+			stats.resident_count++;
+	}
+	stats.resident_bytes = get_resident_bytes();
+	stats.uploads_in_flight = static_cast<uint32_t>(uploads.size());
+
+	return stats;
+}
+
+
+void texture_manager::print_stats()
+{
+	get_stats();
+
+	printf("Textures : %u of %u resident, %llu of %llu bytes, %u uploads in flight \n",
+		stats.resident_count, stats.texture_count, (unsigned long long)stats.resident_bytes,
+		(unsigned long long)stats.budget_bytes, stats.uploads_in_flight);
+	printf("Textures : %u mips streamed in, %u mips streamed out \n", stats.mips_streamed_in, stats.mips_streamed_out);
+}
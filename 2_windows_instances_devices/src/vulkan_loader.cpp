@@ -0,0 +1,108 @@
+#include "..\headers\vulkan_loader.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#define VULKAN_DEFINE_FUNCTION(name) PFN_##name name = nullptr;
+VULKAN_EXPORTED_FUNCTIONS(VULKAN_DEFINE_FUNCTION)
+VULKAN_GLOBAL_FUNCTIONS(VULKAN_DEFINE_FUNCTION)
+VULKAN_INSTANCE_FUNCTIONS(VULKAN_DEFINE_FUNCTION)
+VULKAN_DEVICE_FUNCTIONS(VULKAN_DEFINE_FUNCTION)
+#undef VULKAN_DEFINE_FUNCTION
+
+void* vulkan_loader::library = nullptr;
+VkInstance vulkan_loader::loaded_instance = VK_NULL_HANDLE;
+VulkanDispatch vulkan_loader::dispatch = VulkanDispatch::device_direct;
+
+void vulkan_loader::init()
+{
+	if (library != nullptr)
+		return;
+
+#if defined(_WIN32)
+	HMODULE module = LoadLibraryA("vulkan-1.dll");
+	if (module == nullptr)
+	{
+		throw std::runtime_error(" Error: Failed to load vulkan-1.dll \n");
+	}
+
+	library = module;
+	vkGetInstanceProcAddr = reinterpret_cast<PFN_vkGetInstanceProcAddr>(GetProcAddress(module, "vkGetInstanceProcAddr"));
+#else
+	library = dlopen("libvulkan.so.1", RTLD_NOW | RTLD_LOCAL);
+	if (library == nullptr)
+	{
+		throw std::runtime_error(" Error: Failed to load libvulkan.so.1 \n");
+	}
+
+	vkGetInstanceProcAddr = reinterpret_cast<PFN_vkGetInstanceProcAddr>(dlsym(library, "vkGetInstanceProcAddr"));
+#endif
+
+	if (vkGetInstanceProcAddr == nullptr)
+	{
+		throw std::runtime_error(" Error: Vulkan library does not export vkGetInstanceProcAddr \n");
+	}
+
+#define VULKAN_LOAD_GLOBAL(name) name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(VK_NULL_HANDLE, #name));
+	VULKAN_GLOBAL_FUNCTIONS(VULKAN_LOAD_GLOBAL)
+#undef VULKAN_LOAD_GLOBAL
+
+	printf("Vulkan library loading is  a success \n");
+}
+
+
+void vulkan_loader::load_instance(VkInstance instance)
+{
+	loaded_instance = instance;
+
+#define VULKAN_LOAD_INSTANCE(name) name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(instance, #name));
+	VULKAN_INSTANCE_FUNCTIONS(VULKAN_LOAD_INSTANCE)
+#undef VULKAN_LOAD_INSTANCE
+}
+
+
+void vulkan_loader::load_device(VkDevice device, VulkanDispatch new_dispatch)
+{
+	dispatch = new_dispatch;
+
+	// Both tables call the same driver entry points, so they can be swapped between frames
+	if (dispatch == VulkanDispatch::device_direct)
+	{
+#define VULKAN_LOAD_DEVICE(name) name = reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name));
+		VULKAN_DEVICE_FUNCTIONS(VULKAN_LOAD_DEVICE)
+#undef VULKAN_LOAD_DEVICE
+	}
+	else
+	{
+#define VULKAN_LOAD_TRAMPOLINE(name) name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(loaded_instance, #name));
+		VULKAN_DEVICE_FUNCTIONS(VULKAN_LOAD_TRAMPOLINE)
+#undef VULKAN_LOAD_TRAMPOLINE
+	}
+}
+
+
+void vulkan_loader::shutdown()
+{
+	if (library == nullptr)
+		return;
+
+#if defined(_WIN32)
+	FreeLibrary(static_cast<HMODULE>(library));
+#else
+	dlclose(library);
+#endif
+
+	library = nullptr;
+	loaded_instance = VK_NULL_HANDLE;
+}
+
+
+VulkanDispatch vulkan_loader::get_dispatch()
+{
+	return dispatch;
+}
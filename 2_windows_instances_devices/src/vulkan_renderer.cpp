@@ -7,22 +7,121 @@ vulkan_renderer::vulkan_renderer()
 
 int vulkan_renderer::init(GLFWwindow* new_window)
 {
-	window = new_window;
+	windows.resize(1);
+	windows[0].window = new_window;
+
+	host_memory.init(host_allocator_mode);
+	allocator = host_memory.get_callbacks();
 
 	try
 	{
-		create_instance();
-		create_surface();
-		get_physical_device();
-		create_logical_device();
-		create_swap_chain();
-		create_renderpass();
-		create_graphic_pipeline();
-		create_framebuffers();
-		create_command_pool();
-		create_commandbuffer();
-		record_commands();
-		create_synchronization();
+		profile_zone init_zone(&profile, "init");
+
+		vulkan_loader::init();
+
+		// Stages only wait on what they actually use, shader loading does not need a device
+		// and the pipeline layout does not need the swap chain
+		task_graph init_tasks;
+
+		// Each stage is a zone on the thread that ran it
+		auto add_stage = [this, &init_tasks](const char* name, std::function<void()> job) {
+			return init_tasks.add_task(name, [this, name, job] {
+				profile_zone stage_zone(&profile, name);
+				job();
+			});
+		};
+
+		uint32_t instance_task = add_stage("instance", [this] { create_instance(); });
+		uint32_t surface_task = add_stage("surface", [this] {
+			if (!offscreen)
+				create_surface(&windows[0]);
+		});
+		uint32_t physical_device_task = add_stage("physical device", [this] { get_physical_device(); });
+		uint32_t device_task = add_stage("logical device", [this] { create_logical_device(); });
+		uint32_t memory_task = add_stage("memory tracker", [this] { create_memory_tracker(); });
+		uint32_t swap_chain_task = add_stage("swap chain", [this] {
+			if (offscreen)
+				create_offscreen_target(&windows[0]);
+			else
+				create_swap_chain(&windows[0]);
+		});
+		uint32_t bindless_task = add_stage("bindless heap", [this] { create_bindless_heap(); });
+		uint32_t descriptor_task = add_stage("descriptor allocator", [this] { create_descriptor_allocator(); });
+		uint32_t render_graph_task = add_stage("render graph", [this] { create_render_graph(); });
+		uint32_t shader_file_task = add_stage("shader files", [this] { load_shader_files(); });
+		uint32_t shader_module_task = add_stage("shader modules", [this] { create_shader_modules(); });
+		uint32_t layout_task = add_stage("pipeline layout", [this] { create_pipeline_layout(); });
+		uint32_t pipeline_task = add_stage("graphics pipeline", [this] { create_graphic_pipeline(); });
+		uint32_t command_pool_task = add_stage("command pool", [this] { create_command_pool(); });
+		uint32_t texture_task = add_stage("texture manager", [this] { create_texture_manager(); });
+		uint32_t mesh_task = add_stage("mesh manager", [this] { create_mesh_manager(); });
+		uint32_t capture_task = add_stage("frame capture", [this] { create_frame_capture(); });
+		uint32_t query_task = add_stage("gpu queries", [this] { create_gpu_queries(); });
+		uint32_t profiler_task = add_stage("profiler", [this] { create_profiler(); });
+		uint32_t occlusion_task = add_stage("occlusion culler", [this] { create_occlusion_culler(); });
+		uint32_t particle_task = add_stage("particle system", [this] { create_particle_system(); });
+		uint32_t post_task = add_stage("post process", [this] { create_post_process(); });
+		uint32_t sprite_task = add_stage("sprite batch", [this] { create_sprite_batch(); });
+		uint32_t commandbuffer_task = add_stage("command buffers", [this] { create_commandbuffer(); });
+		uint32_t synchronization_task = add_stage("synchronization", [this] { create_synchronization(); });
+		uint32_t scene_task = add_stage("scene", [this] { create_scene(); });
+
+		init_tasks.add_dependency(surface_task, instance_task);
+		init_tasks.add_dependency(physical_device_task, surface_task);
+		init_tasks.add_dependency(device_task, physical_device_task);
+		init_tasks.add_dependency(memory_task, device_task);
+		init_tasks.add_dependency(swap_chain_task, device_task);
+		// Offscreen images are allocated through the tracker
+		init_tasks.add_dependency(swap_chain_task, memory_task);
+		// The texture manager, mesh manager, scene and sprite batch stages use the bindless heap and run in
+		// parallel once it exists, so they can register textures and buffers in it at the same time. The heap
+		// locks around its slots and writes, a new stage using it only has to depend on bindless_task
+		init_tasks.add_dependency(bindless_task, device_task);
+		init_tasks.add_dependency(descriptor_task, device_task);
+		init_tasks.add_dependency(render_graph_task, swap_chain_task);
+		init_tasks.add_dependency(render_graph_task, memory_task);
+		init_tasks.add_dependency(render_graph_task, occlusion_task);
+		init_tasks.add_dependency(render_graph_task, particle_task);
+		init_tasks.add_dependency(render_graph_task, post_task);
+		init_tasks.add_dependency(render_graph_task, sprite_task);
+		init_tasks.add_dependency(shader_module_task, shader_file_task);
+		init_tasks.add_dependency(shader_module_task, device_task);
+		init_tasks.add_dependency(layout_task, bindless_task);
+		init_tasks.add_dependency(pipeline_task, render_graph_task);
+		init_tasks.add_dependency(pipeline_task, shader_module_task);
+		init_tasks.add_dependency(pipeline_task, layout_task);
+		init_tasks.add_dependency(command_pool_task, device_task);
+		init_tasks.add_dependency(texture_task, bindless_task);
+		init_tasks.add_dependency(texture_task, memory_task);
+		init_tasks.add_dependency(mesh_task, bindless_task);
+		init_tasks.add_dependency(mesh_task, memory_task);
+		init_tasks.add_dependency(capture_task, swap_chain_task);
+		init_tasks.add_dependency(capture_task, memory_task);
+		init_tasks.add_dependency(query_task, device_task);
+		init_tasks.add_dependency(profiler_task, device_task);
+		init_tasks.add_dependency(occlusion_task, swap_chain_task);
+		init_tasks.add_dependency(occlusion_task, memory_task);
+		init_tasks.add_dependency(occlusion_task, shader_file_task);
+		init_tasks.add_dependency(occlusion_task, descriptor_task);
+		init_tasks.add_dependency(particle_task, memory_task);
+		init_tasks.add_dependency(particle_task, shader_file_task);
+		init_tasks.add_dependency(particle_task, descriptor_task);
+		init_tasks.add_dependency(post_task, device_task);
+		init_tasks.add_dependency(post_task, shader_file_task);
+		init_tasks.add_dependency(post_task, descriptor_task);
+		init_tasks.add_dependency(sprite_task, memory_task);
+		init_tasks.add_dependency(sprite_task, bindless_task);
+		init_tasks.add_dependency(sprite_task, texture_task);
+		init_tasks.add_dependency(sprite_task, shader_file_task);
+		init_tasks.add_dependency(commandbuffer_task, command_pool_task);
+		init_tasks.add_dependency(synchronization_task, device_task);
+		init_tasks.add_dependency(scene_task, swap_chain_task);
+		init_tasks.add_dependency(scene_task, memory_task);
+		init_tasks.add_dependency(scene_task, bindless_task);
+
+		init_tasks.run(parallel_init ? &workers : nullptr);
+		init_tasks.print_timings("Init stage");
+		init_ms = init_tasks.get_total_ms();
 	}
 	catch (const std::runtime_error &e)
 	{
@@ -34,91 +133,273 @@ int vulkan_renderer::init(GLFWwindow* new_window)
 }
 
 
+int vulkan_renderer::init_offscreen(VkExtent2D extent)
+{
+	offscreen = true;
+	offscreen_extent = extent;
+
+	return init(nullptr);
+}
+
+
+bool vulkan_renderer::is_offscreen()
+{
+	return offscreen;
+}
+
+
+void vulkan_renderer::set_offscreen_extent(VkExtent2D extent)
+{
+	if (!offscreen)
+	{
+		throw std::runtime_error(" Error: Only an offscreen renderer can change its size \n");
+	}
+
+	vkDeviceWaitIdle(main_device.logical_device);
+
+	// Frame capture copies images of the old size
+	capture.destroy();
+	destroy_window(&windows[0]);
+
+	offscreen_extent = extent;
+	create_offscreen_target(&windows[0]);
+	recreate_render_targets();
+	create_frame_capture();
+}
+
+
+VkExtent2D vulkan_renderer::get_offscreen_extent()
+{
+	return offscreen_extent;
+}
+
+
 void vulkan_renderer::draw()
 {
-	//Get the next image
-	uint32_t image_index;
-	vkAcquireNextImageKHR(main_device.logical_device, swap_chain, std::numeric_limits<uint32_t>::max(), image_available, VK_NULL_HANDLE, &image_index);
+	profile_zone frame_zone(&profile, "draw");
+
+	// Wait until the GPU is done with the previous use of this frame's resources
+	{
+		profile_zone zone(&profile, "wait for frame");
+		vkWaitForFences(main_device.logical_device, 1, &draw_fences[current_frame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+		vkResetFences(main_device.logical_device, 1, &draw_fences[current_frame]);
+	}
+
+	// Frames copied the last time this slot was used can now be read on the CPU
+	capture.frame_complete(current_frame);
+	occlusion.frame_complete(current_frame);
+	particles.frame_complete(current_frame);
+	descriptors.begin_frame(current_frame);
+
+	// Finish uploads and stream mips in or out of the texture budget
+	{
+		profile_zone zone(&profile, "texture streaming");
+		textures.update();
+	}
+
+	//Get the next image of every window
+	{
+		profile_zone zone(&profile, "acquire");
+		for (WindowTarget& target : windows)
+		{
+			target.acquired = false;
+
+			// An offscreen image is only used by its frame in flight, the fence above covers its last use
+			if (target.window == nullptr)
+			{
+				target.image_index = current_frame;
+				target.acquired = true;
+				continue;
+			}
+
+			if (target.out_of_date && !recreate_window(&target))
+				continue;
+
+			VkResult acquire_result = vkAcquireNextImageKHR(main_device.logical_device, target.swap_chain,
+				std::numeric_limits<uint64_t>::max(), target.image_available[current_frame], VK_NULL_HANDLE, &target.image_index);
+
+			// Resized or moved to another display, the window sits this frame out
+			if (acquire_result == VK_ERROR_OUT_OF_DATE_KHR || acquire_result == VK_SUBOPTIMAL_KHR)
+			{
+				recreate_window(&target);
+				continue;
+			}
+
+			if (acquire_result != VK_SUCCESS)
+			{
+				throw std::runtime_error(" Error: Failed to acquire a swap chain image \n");
+			}
+
+			target.acquired = true;
+		}
+	}
+
+	// A resized scene buffer queues a bindless write, so this comes before the set is updated
+	{
+		profile_zone zone(&profile, "update scene");
+		update_scene();
+	}
+
+	// The set and command buffer of this frame are no longer in use by the GPU
+	bindless.begin_frame(current_frame);
+
+	// Sprites added since the last frame go into the vertex stream of this one
+	{
+		profile_zone zone(&profile, "flush sprites");
+		sprites.flush(current_frame);
+	}
+
+	auto record_start = std::chrono::high_resolution_clock::now();
+	{
+		profile_zone zone(&profile, "record");
+		record_commands();
+	}
+	last_record_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - record_start).count();
+
+	// Wait for each image at the first stage its render graph touches it
+	acquire_semaphores.clear();
+	acquire_stages.clear();
+	present_swap_chains.clear();
+	present_image_indices.clear();
+	present_targets.clear();
+
+	for (WindowTarget& target : windows)
+	{
+		if (target.window == nullptr || !target.acquired)
+			continue;
+
+		acquire_semaphores.push_back(target.image_available[current_frame]);
+		acquire_stages.push_back(target.graph.get_first_use_stages(target.backbuffer));
+		present_swap_chains.push_back(target.swap_chain);
+		present_image_indices.push_back(target.image_index);
+		present_targets.push_back(&target);
+	}
+	present_results.resize(present_swap_chains.size());
 
 	// submit command buffer to render
 	VkSubmitInfo submit_info = {};
 	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submit_info.waitSemaphoreCount = 1;
-	submit_info.pWaitSemaphores = &image_available;
-	
-	VkPipelineStageFlags wait_stages[] = {
-		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
-	};
-	
-	submit_info.pWaitDstStageMask = wait_stages;
+	submit_info.waitSemaphoreCount = static_cast<uint32_t>(acquire_semaphores.size());
+	submit_info.pWaitSemaphores = acquire_semaphores.data();
+	submit_info.pWaitDstStageMask = acquire_stages.data();
 	submit_info.commandBufferCount = 1;
-	submit_info.pCommandBuffers = &commandbuffers[image_index];
-	submit_info.signalSemaphoreCount = 1;
-	submit_info.pSignalSemaphores = &render_finished;
+	submit_info.pCommandBuffers = &commandbuffers[current_frame];
+	// Offscreen nothing waits for the frame but its fence
+	submit_info.signalSemaphoreCount = present_swap_chains.empty() ? 0 : 1;
+	submit_info.pSignalSemaphores = &render_finished[current_frame];
 
-	VkResult result = vkQueueSubmit( graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
+	VkResult result;
+	{
+		profile_zone zone(&profile, "submit");
+		result = vkQueueSubmit( graphics_queue, 1, &submit_info, draw_fences[current_frame]);
+	}
 
 	if (result != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to submit the commands to the queue \n");
 	}
-	else
+
+	profile.frame_submitted(current_frame);
+
+	if (present_swap_chains.empty())
 	{
-		printf("Submit to queue for drawing is success \n");
+		current_frame = (current_frame + 1) % MAX_FRAME_DRAWS;
+		return;
 	}
 
-
+	// One present for every window, they all wait on the same submit
 	VkPresentInfoKHR present_info = {};
 	present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	present_info.waitSemaphoreCount = 1;
-	present_info.pWaitSemaphores = &render_finished;
-	present_info.swapchainCount = 1;
-	present_info.pSwapchains = &swap_chain;
-	present_info.pImageIndices = &image_index;
+	present_info.pWaitSemaphores = &render_finished[current_frame];
+	present_info.swapchainCount = static_cast<uint32_t>(present_swap_chains.size());
+	present_info.pSwapchains = present_swap_chains.data();
+	present_info.pImageIndices = present_image_indices.data();
+	present_info.pResults = present_results.data();
 
-	result = vkQueuePresentKHR(graphics_queue, &present_info);
+	{
+		profile_zone zone(&profile, "present");
+		result = vkQueuePresentKHR(graphics_queue, &present_info);
+	}
 
-	if (result != VK_SUCCESS)
+	if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR)
 	{
 		throw std::runtime_error("Failed to present image \n");
 	}
-	else
+
+	// The images were presented, a window whose swap chain no longer matches it gets a new one at its next acquire
+	for (size_t i = 0; i < present_results.size(); i++)
 	{
-		printf("Presenting image is success \n");
+		if (present_results[i] == VK_ERROR_OUT_OF_DATE_KHR || present_results[i] == VK_SUBOPTIMAL_KHR)
+		{
+			present_targets[i]->out_of_date = true;
+		}
+		else if (present_results[i] != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to present image \n");
+		}
 	}
 
+	current_frame = (current_frame + 1) % MAX_FRAME_DRAWS;
 }
 
 
-void vulkan_renderer::cleanup()
+void vulkan_renderer::wait_idle()
 {
 	vkDeviceWaitIdle(main_device.logical_device);
+}
 
-	vkDestroySemaphore(main_device.logical_device, render_finished, nullptr);
-	vkDestroySemaphore(main_device.logical_device, image_available, nullptr);
 
-	vkDestroyCommandPool(main_device.logical_device, graphics_cmd_pool, nullptr);
+void vulkan_renderer::cleanup()
+{
+	vkDeviceWaitIdle(main_device.logical_device);
+
+	for (SceneObjectBuffer& scene_buffer : scene_buffers)
+	{
+		destroy_scene_buffer(&scene_buffer);
+	}
 
-	for (auto framebuffer : swapchain_framebuffers)
+	capture.destroy();
+	queries.destroy();
+	profile.destroy();
+	occlusion.destroy();
+	particles.destroy();
+	post.destroy();
+	sprites.destroy();
+	descriptors.destroy();
+	textures.destroy();
+	meshes.destroy();
+	bindless.destroy();
+
+	for (int i = 0; i < MAX_FRAME_DRAWS; i++)
 	{
-		vkDestroyFramebuffer(main_device.logical_device, framebuffer, nullptr);
+		vkDestroyFence(main_device.logical_device, draw_fences[i], allocator);
+		vkDestroySemaphore(main_device.logical_device, render_finished[i], allocator);
 	}
 
-	vkDestroyPipeline(main_device.logical_device, graphics_pipeline, nullptr);
+	vkDestroyCommandPool(main_device.logical_device, graphics_cmd_pool, allocator);
+
+	for (VkPipeline pipeline : graphics_pipelines)
+	{
+		vkDestroyPipeline(main_device.logical_device, pipeline, allocator);
+	}
 
-	vkDestroyPipelineLayout(main_device.logical_device, pipeline_layout, nullptr);
+	vkDestroyPipelineLayout(main_device.logical_device, pipeline_layout, allocator);
 
-	vkDestroyRenderPass(main_device.logical_device, render_pass, nullptr);
+	vkDestroyShaderModule(main_device.logical_device, fragment_shader_module, allocator);
+	vkDestroyShaderModule(main_device.logical_device, vertex_shader_module, allocator);
 
-	for (auto image: swap_chain_images)
+	// Render passes, framebuffers, transient images and the swap chains
+	for (WindowTarget& target : windows)
 	{
-		vkDestroyImageView(main_device.logical_device, image.image_view, nullptr);
+		destroy_window(&target);
 	}
+	windows.clear();
+
+	vkDestroyDevice(main_device.logical_device, allocator);
+	vkDestroyInstance(instance, allocator);
 
-	vkDestroySwapchainKHR(main_device.logical_device, swap_chain, nullptr);
-	vkDestroySurfaceKHR(instance, surface, nullptr);
-	vkDestroyDevice(main_device.logical_device, nullptr);
-	vkDestroyInstance(instance, nullptr);
+	vulkan_loader::shutdown();
 }
 
 
@@ -137,8 +418,12 @@ void vulkan_renderer::create_instance()
 	std::vector<const char*> instance_extensions	= std::vector<const char*>();
 	uint32_t extension_count						= 0;
 	
-	const char** glfw_extensions;
-	glfw_extensions	= glfwGetRequiredInstanceExtensions( &extension_count );
+	// Offscreen there is no surface, and GLFW is not initialised
+	const char** glfw_extensions = nullptr;
+	if (!offscreen)
+	{
+		glfw_extensions	= glfwGetRequiredInstanceExtensions( &extension_count );
+	}
 
 	for ( size_t i = 0; i < extension_count; i++ )
 	{
@@ -160,7 +445,7 @@ void vulkan_renderer::create_instance()
 	create_info.enabledLayerCount		= 0;
 	create_info.ppEnabledLayerNames		= nullptr;
 
-	VkResult result = vkCreateInstance(&create_info, nullptr, &instance);
+	VkResult result = vkCreateInstance(&create_info, allocator, &instance);
 
 	if (result != VK_SUCCESS)
 	{
@@ -171,6 +456,8 @@ void vulkan_renderer::create_instance()
 		printf("Instance creation is  a success \n");
 	}
 
+	vulkan_loader::load_instance(instance);
+
 }
 
 
@@ -198,14 +485,54 @@ void vulkan_renderer::create_logical_device()
 	logical_device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	logical_device_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
 	logical_device_info.pQueueCreateInfos = queue_create_infos.data();
-	logical_device_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
-	logical_device_info.ppEnabledExtensionNames = device_extensions.data();
+	enabled_optional_extensions = get_supported_optional_extensions(main_device.physical_device);
+
+	std::vector<const char*> enabled_extensions = get_required_device_extensions();
+	for (const char* extension : enabled_optional_extensions)
+	{
+		enabled_extensions.push_back(extension);
+
+		if (!strcmp(extension, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+			memory_budget_supported = true;
+
+		if (!strcmp(extension, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME))
+			dynamic_rendering_supported = true;
+
+		if (!strcmp(extension, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME))
+			calibrated_timestamps_supported = true;
+	}
+
+	logical_device_info.enabledExtensionCount = static_cast<uint32_t>(enabled_extensions.size());
+	logical_device_info.ppEnabledExtensionNames = enabled_extensions.data();
+
+	// Query features are optional, statistics are left out on devices without them
+	enabled_features = gpu_queries::get_optional_features(main_device.physical_device);
+
+	logical_device_info.pEnabledFeatures = &enabled_features;
+
+	// Descriptor indexing for the bindless heap
+	VkPhysicalDeviceVulkan12Features vulkan12_features = bindless_heap::get_required_features();
+	logical_device_info.pNext = &vulkan12_features;
+
+	// Render graph passes without VkRenderPass and framebuffers, render passes are the fallback
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering_features = {};
+	dynamic_rendering_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
 
-	VkPhysicalDeviceFeatures physical_device_features = {};
+	if (dynamic_rendering_supported)
+	{
+		VkPhysicalDeviceFeatures2 features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &dynamic_rendering_features;
+		vkGetPhysicalDeviceFeatures2(main_device.physical_device, &features);
 
-	logical_device_info.pEnabledFeatures = &physical_device_features;
+		dynamic_rendering_supported = dynamic_rendering_features.dynamicRendering == VK_TRUE;
+		if (dynamic_rendering_supported)
+		{
+			vulkan12_features.pNext = &dynamic_rendering_features;
+		}
+	}
 	
-	VkResult result = vkCreateDevice(main_device.physical_device,&logical_device_info,nullptr,&main_device.logical_device);
+	VkResult result = vkCreateDevice(main_device.physical_device,&logical_device_info,allocator,&main_device.logical_device);
 
 	if (result != VK_SUCCESS)
 	{
@@ -216,6 +543,9 @@ void vulkan_renderer::create_logical_device()
 		printf("Logical device creation is  a success \n");
 	}
 
+	// Device functions have to be loaded before the first device call
+	vulkan_loader::load_device(main_device.logical_device, dispatch_mode);
+
 	// Queues are created at the same time as device.
 	// 0 since only one queue
 	vkGetDeviceQueue( main_device.logical_device, indicies.graphics_family, 0, &graphics_queue );
@@ -223,9 +553,15 @@ void vulkan_renderer::create_logical_device()
 }
 
 
-void vulkan_renderer::create_surface()
+void vulkan_renderer::create_memory_tracker()
+{
+	memory.init(main_device.physical_device, main_device.logical_device, memory_budget_supported, allocator);
+}
+
+
+void vulkan_renderer::create_surface(WindowTarget* target)
 {
-	VkResult result = glfwCreateWindowSurface(instance, window, nullptr, &surface);
+	VkResult result = glfwCreateWindowSurface(instance, target->window, allocator, &target->surface);
 
 	if (result != VK_SUCCESS)
 	{
@@ -238,18 +574,30 @@ void vulkan_renderer::create_surface()
 }
 
 
-void vulkan_renderer::create_swap_chain()
+void vulkan_renderer::create_swap_chain(WindowTarget* target)
 {
-	SwapChainDetails details = get_swap_chain_details(main_device.physical_device);
+	bool main_window = target == &windows.front();
+	SwapChainDetails details = get_swap_chain_details(main_device.physical_device, target->surface);
 
-	// Choose best format
+	// Choose best format, other windows take the one of the main window for its pipelines
 	VkSurfaceFormatKHR surface_format = choose_best_surface_format(details.surface_formats);
+	if (!main_window)
+	{
+		auto format = std::find_if(details.surface_formats.begin(), details.surface_formats.end(),
+			[this](const VkSurfaceFormatKHR& candidate) { return candidate.format == swap_chain_image_format; });
+
+		if (format == details.surface_formats.end())
+		{
+			throw std::runtime_error(" Error: Window surface does not support the swap chain format \n");
+		}
+		surface_format = *format;
+	}
 
 	// Choose best presentation mode
 	VkPresentModeKHR present_mode = choose_best_present_mode(details.present_modes);
 	
 	// Choose best swap chain image resolution
-	VkExtent2D extent = choose_swap_extent(details.surface_capabilities);
+	VkExtent2D extent = choose_swap_extent(details.surface_capabilities, target->window);
 
 	uint32_t image_count = details.surface_capabilities.minImageCount + 1;
 
@@ -261,13 +609,40 @@ void vulkan_renderer::create_swap_chain()
 
 	VkSwapchainCreateInfoKHR swap_chain_create_info = {};
 	swap_chain_create_info.sType			=	VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-	swap_chain_create_info.surface			=	surface;
+	swap_chain_create_info.surface			=	target->surface;
 	swap_chain_create_info.imageFormat		=	surface_format.format;
 	swap_chain_create_info.presentMode		=	present_mode;
 	swap_chain_create_info.imageExtent		=	extent;
 	swap_chain_create_info.minImageCount	=	image_count;
 	swap_chain_create_info.imageArrayLayers =	1 ;
 	swap_chain_create_info.imageUsage		=	VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+	// Frame capture copies out of the swap chain images of the main window
+	if (main_window)
+	{
+		capture_supported = (details.surface_capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+			&& frame_capture::is_format_supported(surface_format.format);
+		if (capture_supported)
+		{
+			swap_chain_create_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		}
+	}
+
+	// Post-processing blits its tone mapped image into the swap chain images
+	bool blit_supported = (details.surface_capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) != 0;
+	if (blit_supported)
+	{
+		swap_chain_create_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
+
+	if (main_window)
+	{
+		post_blit_supported = blit_supported;
+	}
+	else if (!blit_supported && is_post_processing_active())
+	{
+		throw std::runtime_error(" Error: Window surface can not be written by post-processing \n");
+	}
 	swap_chain_create_info.preTransform		=	details.surface_capabilities.currentTransform;
 	swap_chain_create_info.compositeAlpha	=	VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	swap_chain_create_info.clipped			=	VK_TRUE;
@@ -281,279 +656,1574 @@ void vulkan_renderer::create_swap_chain()
 			(uint32_t)indices.presentation_family
 		};
 
-		swap_chain_create_info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-		swap_chain_create_info.queueFamilyIndexCount = 2;
-		swap_chain_create_info.pQueueFamilyIndices = queue_family_indices;
+		swap_chain_create_info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+		swap_chain_create_info.queueFamilyIndexCount = 2;
+		swap_chain_create_info.pQueueFamilyIndices = queue_family_indices;
+
+	}
+	else
+	{
+		swap_chain_create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE ;
+		swap_chain_create_info.queueFamilyIndexCount = 0 ;
+		swap_chain_create_info.pQueueFamilyIndices = nullptr;
+	}
+
+	swap_chain_create_info.oldSwapchain = VK_NULL_HANDLE;
+
+	//create the swap_chain
+	VkResult result =  vkCreateSwapchainKHR(main_device.logical_device, &swap_chain_create_info, allocator, &target->swap_chain);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error : Faild to create swap chain \n");
+	}
+	else
+	{
+		printf("Swap chain creation sucessful \n");
+	}
+
+	swap_chain_image_format = surface_format.format;
+	target->extent = extent;
+
+	uint32_t swap_chain_image_count;
+	vkGetSwapchainImagesKHR(main_device.logical_device, target->swap_chain, &swap_chain_image_count, nullptr);
+	std::vector<VkImage> images(swap_chain_image_count);
+	vkGetSwapchainImagesKHR(main_device.logical_device, target->swap_chain, &swap_chain_image_count, images.data());
+
+	for ( VkImage image : images)
+	{
+		SwapChainImage swap_chain_image = {};
+		swap_chain_image.image = image;
+		swap_chain_image.image_view = create_image_view(image, swap_chain_image_format, VK_IMAGE_ASPECT_COLOR_BIT);
+		//Create image view
+
+		target->images.push_back(swap_chain_image);
+	}
+
+}
+
+
+void vulkan_renderer::create_offscreen_target(WindowTarget* target)
+{
+	// A format frame capture reads, post-processing blits into the images like into a swap chain
+	swap_chain_image_format = VK_FORMAT_R8G8B8A8_UNORM;
+	capture_supported = true;
+	post_blit_supported = true;
+	target->extent = offscreen_extent;
+
+	VkImageCreateInfo image_create_info = {};
+	image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_create_info.imageType = VK_IMAGE_TYPE_2D;
+	image_create_info.format = swap_chain_image_format;
+	image_create_info.extent.width = offscreen_extent.width;
+	image_create_info.extent.height = offscreen_extent.height;
+	image_create_info.extent.depth = 1;
+	image_create_info.mipLevels = 1;
+	image_create_info.arrayLayers = 1;
+	image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_create_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	// One per frame in flight, so a frame never waits on the image of the one before
+	for (int i = 0; i < MAX_FRAME_DRAWS; i++)
+	{
+		SwapChainImage offscreen_image = {};
+		VkResult result = vkCreateImage(main_device.logical_device, &image_create_info, allocator, &offscreen_image.image);
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(" Error: Failed to create the offscreen image \n");
+		}
+
+		VkMemoryRequirements memory_requirements;
+		vkGetImageMemoryRequirements(main_device.logical_device, offscreen_image.image, &memory_requirements);
+
+		VkMemoryAllocateInfo allocate_info = {};
+		allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocate_info.allocationSize = memory_requirements.size;
+		allocate_info.memoryTypeIndex = find_memory_type_index(main_device.physical_device, memory_requirements.memoryTypeBits,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		VkDeviceMemory image_memory = VK_NULL_HANDLE;
+		result = memory.allocate(&allocate_info, &image_memory, "offscreen target");
+
+		if (result != VK_SUCCESS)
+		{
+			vkDestroyImage(main_device.logical_device, offscreen_image.image, allocator);
+			throw std::runtime_error(" Error: Failed to allocate the offscreen image \n");
+		}
+
+		vkBindImageMemory(main_device.logical_device, offscreen_image.image, image_memory, 0);
+		memory.add_bound_bytes(image_memory, memory_requirements.size);
+
+		target->images.push_back(offscreen_image);
+		target->image_memory.push_back(image_memory);
+
+		target->images.back().image_view = create_image_view(offscreen_image.image, swap_chain_image_format, VK_IMAGE_ASPECT_COLOR_BIT);
+	}
+
+	printf("Offscreen target creation is  a success \n");
+}
+
+
+void vulkan_renderer::create_render_graph()
+{
+	for (size_t i = 0; i < windows.size(); i++)
+	{
+		create_window_graph(&windows[i], i == 0);
+	}
+
+	// Pipelines are created against the main window, the render passes of the others are compatible with it
+	render_pass = windows[0].graph.get_render_pass(windows[0].main_pass);
+}
+
+
+void vulkan_renderer::create_window_graph(WindowTarget* target, bool main_window)
+{
+	render_graph& frame_graph = target->graph;
+
+	std::vector<VkImage> images;
+	std::vector<VkImageView> image_views;
+
+	for (const auto& swap_chain_image : target->images)
+	{
+		images.push_back(swap_chain_image.image);
+		image_views.push_back(swap_chain_image.image_view);
+	}
+
+	//Swap chain images are owned by the swap chain, the graph only transitions them.
+	//Offscreen images are left ready to be copied out instead of presented
+	RenderGraphImageInfo backbuffer_info = {};
+	backbuffer_info.format = swap_chain_image_format;
+	backbuffer_info.extent = target->extent;
+	VkImageLayout backbuffer_layout = target->window != nullptr ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	uint32_t backbuffer = frame_graph.import_image("backbuffer", backbuffer_info, images, image_views, backbuffer_layout);
+	target->backbuffer = backbuffer;
+
+	// With post-processing the scene is drawn into an HDR image, the post chain writes the swap chain image
+	bool post_processing = is_post_processing_active();
+	uint32_t scene_target = backbuffer;
+	RenderGraphImageInfo scene_info = backbuffer_info;
+	if (post_processing)
+	{
+		scene_info.format = POST_HDR_FORMAT;
+		scene_target = frame_graph.add_image("hdr", scene_info);
+	}
+
+	//With multisampling the pass renders into a transient image resolved into the scene target
+	uint32_t color_target = scene_target;
+	if (msaa_samples != VK_SAMPLE_COUNT_1_BIT)
+	{
+		RenderGraphImageInfo msaa_info = scene_info;
+		msaa_info.samples = msaa_samples;
+		color_target = frame_graph.add_image("msaa_color", msaa_info);
+	}
+
+	depth_format = choose_supported_format(
+		{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+		VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+
+	RenderGraphImageInfo depth_info = {};
+	depth_info.format = depth_format;
+	depth_info.extent = target->extent;
+	depth_info.samples = msaa_samples;
+	depth_info.aspect = depth_format == VK_FORMAT_D32_SFLOAT
+		? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+	uint32_t depth_target = frame_graph.add_image("depth", depth_info);
+
+	VkClearValue clear_value = {};
+	clear_value.color = { 0.6f, 0.65f, 0.4f, 1.0f };
+
+	VkClearValue depth_clear_value = {};
+	depth_clear_value.depthStencil.depth = 1.0f;
+
+	// Simulated first, the main pass of the main window draws the survivors over the scene
+	bool draw_particles = main_window && is_particles_active();
+	uint32_t particle_buffer = 0;
+	uint32_t particle_counters = 0;
+	if (draw_particles)
+	{
+		particle_buffer = frame_graph.import_buffer("particles", particles.get_particle_buffer());
+		particle_counters = frame_graph.import_buffer("particle counters", particles.get_counter_buffer());
+
+		uint32_t particle_pass = frame_graph.add_pass("particles", PassType::compute);
+		frame_graph.add_buffer_output(particle_pass, particle_buffer);
+		frame_graph.add_buffer_output(particle_pass, particle_counters);
+		frame_graph.set_record(particle_pass, [this](VkCommandBuffer command_buffer) {
+			particles.record_simulation(command_buffer, current_frame);
+		});
+	}
+
+	//Main pass draws the scene
+	uint32_t main_pass = frame_graph.add_pass("main", PassType::graphics);
+	target->main_pass = main_pass;
+	frame_graph.add_color_output(main_pass, color_target, &clear_value);
+	if (color_target != scene_target)
+	{
+		frame_graph.add_resolve_output(main_pass, color_target, scene_target);
+	}
+	frame_graph.set_depth_output(main_pass, depth_target, &depth_clear_value);
+	if (draw_particles)
+	{
+		frame_graph.add_buffer_input(main_pass, particle_buffer);
+		frame_graph.add_indirect_input(main_pass, particle_counters);
+	}
+	VkExtent2D extent = target->extent;
+	frame_graph.set_record(main_pass, [this, extent, draw_particles](VkCommandBuffer command_buffer) {
+		record_scene(command_buffer, extent, draw_particles);
+	});
+
+	if (post_processing)
+	{
+		post.add_passes(&frame_graph, scene_target, backbuffer, target->extent);
+	}
+
+	// Over the finished image, loaded rather than cleared
+	if (main_window && sprites.is_available())
+	{
+		uint32_t sprite_pass = frame_graph.add_pass("sprites", PassType::graphics);
+		target->sprite_pass = sprite_pass;
+		frame_graph.add_color_output(sprite_pass, backbuffer);
+		frame_graph.set_record(sprite_pass, [this, extent](VkCommandBuffer command_buffer) {
+			sprites.record(command_buffer, extent);
+		});
+	}
+
+	frame_graph.set_output(backbuffer);
+
+	// The pyramid is reduced from this frame's depth and read back for a later frame,
+	// a multisampled depth buffer would need a resolve first so it is left out
+	bool build_pyramid = main_window && occlusion_enabled && occlusion.is_available() && msaa_samples == VK_SAMPLE_COUNT_1_BIT;
+	if (build_pyramid)
+	{
+		RenderGraphImageInfo hiz_info = {};
+		hiz_info.format = VK_FORMAT_R32_SFLOAT;
+		hiz_info.extent = occlusion.get_extent();
+		uint32_t hiz = frame_graph.import_image("hi-z", hiz_info, { occlusion.get_image() }, { occlusion.get_image_view() },
+			VK_IMAGE_LAYOUT_GENERAL);
+
+		uint32_t hiz_pass = frame_graph.add_pass("hi-z", PassType::compute);
+		frame_graph.add_texture_input(hiz_pass, depth_target);
+		frame_graph.add_storage_output(hiz_pass, hiz);
+		frame_graph.set_record(hiz_pass, [this](VkCommandBuffer command_buffer) {
+			occlusion.record(command_buffer, current_frame, view_projection);
+		});
+
+		frame_graph.set_output(hiz);
+	}
+
+	frame_graph.set_dynamic_rendering(dynamic_rendering_supported && use_dynamic_rendering);
+	frame_graph.set_profiler(&profile);
+	frame_graph.compile(main_device.physical_device, main_device.logical_device, &memory, allocator);
+	frame_graph.print_stats();
+
+	if (build_pyramid)
+	{
+		occlusion.set_depth_source(frame_graph.get_image(depth_target), depth_format, target->extent);
+	}
+	else if (main_window)
+	{
+		occlusion.reset();
+	}
+}
+
+
+void vulkan_renderer::create_command_pool()
+{
+	QueueFamilyIndicies queue_family_indicies = get_queue_family(main_device.physical_device);
+
+	VkCommandPoolCreateInfo cmd_pool_create_info = {};
+	cmd_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	cmd_pool_create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	cmd_pool_create_info.queueFamilyIndex = queue_family_indicies.graphics_family;
+
+	VkResult result = vkCreateCommandPool(main_device.logical_device, &cmd_pool_create_info, allocator, &graphics_cmd_pool);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the Command pool \n");
+	}
+	else
+	{
+		printf("Command pool creation is  a success \n");
+	}
+
+}
+
+
+void vulkan_renderer::create_texture_manager()
+{
+	QueueFamilyIndicies indices = get_queue_family(main_device.physical_device);
+
+	// Mips are generated with blits, so uploads go through the graphics queue
+	textures.init(main_device.physical_device, main_device.logical_device, graphics_queue,
+		static_cast<uint32_t>(indices.graphics_family), &workers, &bindless, &memory, allocator);
+}
+
+
+void vulkan_renderer::create_mesh_manager()
+{
+	QueueFamilyIndicies indices = get_queue_family(main_device.physical_device);
+
+	meshes.init(main_device.physical_device, main_device.logical_device, graphics_queue,
+		static_cast<uint32_t>(indices.graphics_family), &bindless, &memory, allocator);
+}
+
+
+void vulkan_renderer::create_frame_capture()
+{
+	if (!capture_supported)
+	{
+		printf("Frame capture is not supported by the swap chain \n");
+		return;
+	}
+
+	capture.init(main_device.physical_device, main_device.logical_device, windows[0].extent, swap_chain_image_format,
+		0, &memory, allocator);
+}
+
+
+void vulkan_renderer::create_gpu_queries()
+{
+	// A query per region and frame, regions are begun once per pass for now
+	const uint32_t queries_per_frame = 32;
+
+	queries.init(main_device.logical_device, enabled_features, MAX_FRAME_DRAWS, queries_per_frame, allocator);
+	main_query_region = queries.add_region("main");
+}
+
+
+void vulkan_renderer::create_profiler()
+{
+	QueueFamilyIndicies indices = get_queue_family(main_device.physical_device);
+
+	profile.init(main_device.physical_device, main_device.logical_device, static_cast<uint32_t>(indices.graphics_family),
+		MAX_FRAME_DRAWS, calibrated_timestamps_supported, allocator);
+}
+
+
+void vulkan_renderer::create_occlusion_culler()
+{
+	occlusion.init(main_device.physical_device, main_device.logical_device, windows[0].extent, MAX_FRAME_DRAWS,
+		hiz_shader_code, &memory, &descriptors, allocator);
+}
+
+
+void vulkan_renderer::create_particle_system()
+{
+	QueueFamilyIndicies indices = get_queue_family(main_device.physical_device);
+
+	particles.init(main_device.physical_device, main_device.logical_device, static_cast<uint32_t>(indices.graphics_family),
+		particle_capacity, MAX_FRAME_DRAWS, particle_compute_code, particle_vertex_code, particle_fragment_code,
+		&memory, &descriptors, allocator);
+}
+
+
+void vulkan_renderer::create_post_process()
+{
+	QueueFamilyIndicies indices = get_queue_family(main_device.physical_device);
+
+	post.init(main_device.physical_device, main_device.logical_device, static_cast<uint32_t>(indices.graphics_family),
+		MAX_FRAME_DRAWS, bloom_downsample_code, bloom_upsample_code, tonemap_code, &descriptors, allocator);
+}
+
+
+void vulkan_renderer::create_sprite_batch()
+{
+	sprites.init(main_device.physical_device, main_device.logical_device, MAX_FRAME_DRAWS, sprite_vertex_code,
+		sprite_fragment_code, &memory, &bindless, &textures, allocator);
+}
+
+
+void vulkan_renderer::create_bindless_heap()
+{
+	bindless.init(main_device.physical_device, main_device.logical_device, MAX_FRAME_DRAWS, allocator);
+}
+
+
+void vulkan_renderer::create_descriptor_allocator()
+{
+	descriptors.init(main_device.logical_device, MAX_FRAME_DRAWS, allocator);
+}
+
+
+void vulkan_renderer::create_commandbuffer()
+{
+	// Recorded every frame, one for each frame in flight
+	commandbuffers.resize(MAX_FRAME_DRAWS);
+
+	VkCommandBufferAllocateInfo cb_alloc_info = {};
+	cb_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	cb_alloc_info.commandPool = graphics_cmd_pool;
+	cb_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	cb_alloc_info.commandBufferCount = static_cast<uint32_t>(commandbuffers.size());
+
+	VkResult result=  vkAllocateCommandBuffers(main_device.logical_device, &cb_alloc_info, commandbuffers.data());
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to allocate command buffer \n");
+	}
+	else
+	{
+		printf("Command buffer allocation is  a success \n");
+	}
+}
+
+
+void vulkan_renderer::create_synchronization()
+{
+	render_finished.resize(MAX_FRAME_DRAWS);
+	draw_fences.resize(MAX_FRAME_DRAWS);
+
+	VkSemaphoreCreateInfo semaphore_ci = {};
+	semaphore_ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	// Fences start signaled so the first wait in draw() does not block
+	VkFenceCreateInfo fence_ci = {};
+	fence_ci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fence_ci.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+	for (int i = 0; i < MAX_FRAME_DRAWS; i++)
+	{
+		if ((vkCreateSemaphore(main_device.logical_device, &semaphore_ci, allocator, &render_finished[i]) != VK_SUCCESS)
+			|| (vkCreateFence(main_device.logical_device, &fence_ci, allocator, &draw_fences[i]) != VK_SUCCESS))
+		{
+			throw std::runtime_error(" Error: Failed to create Semaphore \n");
+		}
+	}
+
+	create_window_semaphores(&windows[0]);
+}
+
+
+void vulkan_renderer::create_window_semaphores(WindowTarget* target)
+{
+	// Offscreen images are not acquired
+	if (target->window == nullptr)
+		return;
+
+	VkSemaphoreCreateInfo semaphore_ci = {};
+	semaphore_ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	for (VkSemaphore& semaphore : target->image_available)
+	{
+		if (vkCreateSemaphore(main_device.logical_device, &semaphore_ci, allocator, &semaphore) != VK_SUCCESS)
+		{
+			throw std::runtime_error(" Error: Failed to create Semaphore \n");
+		}
+	}
+}
+
+
+void vulkan_renderer::destroy_window(WindowTarget* target)
+{
+	for (VkSemaphore semaphore : target->image_available)
+	{
+		vkDestroySemaphore(main_device.logical_device, semaphore, allocator);
+	}
+
+	target->graph.destroy();
+
+	for (auto image : target->images)
+	{
+		vkDestroyImageView(main_device.logical_device, image.image_view, allocator);
+	}
+
+	// Offscreen images belong to the target, without a swap chain or surface to destroy
+	for (size_t i = 0; i < target->image_memory.size(); i++)
+	{
+		vkDestroyImage(main_device.logical_device, target->images[i].image, allocator);
+		memory.free(target->image_memory[i]);
+	}
+	target->images.clear();
+	target->image_memory.clear();
+
+	if (target->swap_chain != VK_NULL_HANDLE)
+	{
+		vkDestroySwapchainKHR(main_device.logical_device, target->swap_chain, allocator);
+		vkDestroySurfaceKHR(instance, target->surface, allocator);
+	}
+}
+
+
+bool vulkan_renderer::recreate_window(WindowTarget* target)
+{
+	// No swap chain can be created for a minimized window
+	int width = 0;
+	int height = 0;
+	glfwGetFramebufferSize(target->window, &width, &height);
+	if (width == 0 || height == 0)
+	{
+		target->out_of_date = true;
+		return false;
+	}
+
+	vkDeviceWaitIdle(main_device.logical_device);
+
+	bool main_window = target == &windows.front();
+	if (main_window)
+	{
+		// Frame capture copies images of the old size
+		capture.destroy();
+	}
+
+	// The surface is kept. A suboptimal acquire signalled a semaphore no submit waits on, so they are replaced too
+	for (VkSemaphore& semaphore : target->image_available)
+	{
+		vkDestroySemaphore(main_device.logical_device, semaphore, allocator);
+		semaphore = VK_NULL_HANDLE;
+	}
+
+	target->graph.destroy();
+
+	for (auto image : target->images)
+	{
+		vkDestroyImageView(main_device.logical_device, image.image_view, allocator);
+	}
+	target->images.clear();
+
+	vkDestroySwapchainKHR(main_device.logical_device, target->swap_chain, allocator);
+	target->swap_chain = VK_NULL_HANDLE;
+
+	create_swap_chain(target);
+	create_window_semaphores(target);
+
+	// The pipelines and the size dependent targets of the other subsystems follow the main window
+	if (main_window)
+	{
+		recreate_render_targets();
+		create_frame_capture();
+	}
+	else
+	{
+		create_window_graph(target, false);
+	}
+
+	target->out_of_date = false;
+	return true;
+}
+
+
+void vulkan_renderer::create_scene()
+{
+	frame_scene.init(&workers);
+
+	// Default camera looking down -z at the origin, y flipped for Vulkan clip space
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f),
+		static_cast<float>(windows[0].extent.width) / static_cast<float>(windows[0].extent.height), 0.1f, 1000.0f);
+	projection[1][1] *= -1.0f;
+	set_camera(view, projection);
+
+	// Material 0 is untextured
+	materials.push_back(BINDLESS_INVALID_INDEX);
+	material_tints.push_back(0xFFFFFFFF);
+
+	DrawGeometry triangle = {};
+	triangle.vertex_count = 3;
+	geometries.push_back(triangle);
+	geometry_meshes.push_back(SCENE_NO_MESH);
+
+	scene_buffers.resize(MAX_FRAME_DRAWS);
+	for (SceneObjectBuffer& scene_buffer : scene_buffers)
+	{
+		create_scene_buffer(&scene_buffer, 1024);
+	}
+}
+
+
+void vulkan_renderer::create_scene_buffer(SceneObjectBuffer* scene_buffer, uint32_t capacity)
+{
+	VkDeviceSize size = sizeof(SceneObjectHeader) + static_cast<VkDeviceSize>(capacity) * sizeof(SceneTransform);
+
+	VkBufferCreateInfo buffer_create_info = {};
+	buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_create_info.size = size;
+	buffer_create_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkResult result = vkCreateBuffer(main_device.logical_device, &buffer_create_info, allocator, &scene_buffer->buffer);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to create the scene buffer \n");
+	}
+
+	VkMemoryRequirements memory_requirements;
+	vkGetBufferMemoryRequirements(main_device.logical_device, scene_buffer->buffer, &memory_requirements);
+
+	VkMemoryAllocateInfo allocate_info = {};
+	allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocate_info.allocationSize = memory_requirements.size;
+	allocate_info.memoryTypeIndex = find_memory_type_index(main_device.physical_device, memory_requirements.memoryTypeBits,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	result = memory.allocate(&allocate_info, &scene_buffer->memory, "scene objects");
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed to allocate the scene buffer memory \n");
+	}
+
+	vkBindBufferMemory(main_device.logical_device, scene_buffer->buffer, scene_buffer->memory, 0);
+	memory.add_bound_bytes(scene_buffer->memory, size);
+
+	// Stays mapped, the buffer is rewritten every frame
+	vkMapMemory(main_device.logical_device, scene_buffer->memory, 0, size, 0, &scene_buffer->mapped);
+	scene_buffer->capacity = capacity;
+
+	if (scene_buffer->bindless_index == BINDLESS_INVALID_INDEX)
+		scene_buffer->bindless_index = bindless.add_storage_buffer(scene_buffer->buffer);
+	else
+		bindless.update_storage_buffer(scene_buffer->bindless_index, scene_buffer->buffer);
+}
+
+
+void vulkan_renderer::destroy_scene_buffer(SceneObjectBuffer* scene_buffer)
+{
+	if (scene_buffer->buffer == VK_NULL_HANDLE)
+		return;
+
+	vkDestroyBuffer(main_device.logical_device, scene_buffer->buffer, allocator);
+	memory.free(scene_buffer->memory);
+
+	scene_buffer->buffer = VK_NULL_HANDLE;
+	scene_buffer->memory = VK_NULL_HANDLE;
+	scene_buffer->mapped = nullptr;
+	scene_buffer->capacity = 0;
+}
+
+
+// Mesh positions are unorm16 inside the bounds of the mesh, folding the range into the
+// transform lets the shader use the unpacked values as they are
+static void apply_position_dequantization(const MeshFileHeader& header, float* rows)
+{
+	for (int row = 0; row < 3; row++)
+	{
+		float* r = rows + row * 4;
+		r[3] += r[0] * header.position_min[0] + r[1] * header.position_min[1] + r[2] * header.position_min[2];
+
+		for (int column = 0; column < 3; column++)
+		{
+			r[column] *= header.position_scale[column] * 65535.0f;
+		}
+	}
+}
+
+
+void vulkan_renderer::update_scene()
+{
+	if (frame_scene.get_object_count() == 0)
+		return;
+
+	frame_scene.update(scene::extract_frustum(view_projection));
+
+	const std::vector<uint32_t>& visible = frame_scene.get_visible();
+	SceneObjectBuffer& scene_buffer = scene_buffers[current_frame];
+
+	// The fence of this frame has been waited on, so its buffer can be replaced
+	if (visible.size() > scene_buffer.capacity)
+	{
+		uint32_t capacity = scene_buffer.capacity;
+		while (capacity < visible.size())
+		{
+			capacity *= 2;
+		}
+
+		destroy_scene_buffer(&scene_buffer);
+		create_scene_buffer(&scene_buffer, capacity);
+	}
+
+	// Specialized variants follow the material, a texture still loading has no bindless index yet
+	if (specialized_shaders)
+	{
+		material_features.resize(materials.size());
+		for (size_t i = 0; i < materials.size(); i++)
+		{
+			material_features[i] = 0;
+			if (materials[i] != BINDLESS_INVALID_INDEX && textures.get_bindless_index(materials[i]) != BINDLESS_INVALID_INDEX)
+			{
+				material_features[i] |= SHADER_FEATURE_TEXTURE;
+			}
+			if (material_tints[i] != 0xFFFFFFFF)
+			{
+				material_features[i] |= SHADER_FEATURE_TINT;
+			}
+		}
+	}
+
+	// Object draw keys hold pass, pipeline, material and geometry, the LOD and the depth are filled in from the camera
+	draws.clear();
+	lod_counts.fill(0);
+	for (uint32_t index : visible)
+	{
+		uint64_t key = frame_scene.get_draw_key(index);
+
+		float center[3];
+		float radius;
+		frame_scene.get_world_bounds(index, center, &radius);
+
+		// Clip space w is the distance along the view direction
+		float view_depth = view_projection[0][3] * center[0] + view_projection[1][3] * center[1]
+			+ view_projection[2][3] * center[2] + view_projection[3][3];
+
+		if (occlusion_enabled && occlusion.is_occluded(center, radius))
+			continue;
+
+		uint32_t geometry = draw_list::get_geometry(key);
+		if (geometry >= geometries.size())
+		{
+			throw std::runtime_error(" Error: Draw key uses an unknown geometry \n");
+		}
+
+		// LODs of a mesh have consecutive geometry ids
+		if (geometry_meshes[geometry] != SCENE_NO_MESH)
+		{
+			uint32_t lod = select_lod(geometry_meshes[geometry], index, view_depth, radius);
+			key += static_cast<uint64_t>(lod) << DRAW_KEY_GEOMETRY_SHIFT;
+			lod_counts[lod]++;
+		}
+
+		bool back_to_front = draw_list::get_pipeline(key) == SCENE_PIPELINE_BLENDED;
+		key |= static_cast<uint64_t>(draw_list::make_depth(view_depth, back_to_front)) << DRAW_KEY_DEPTH_SHIFT;
+
+		// The blend pipeline of the key moves to the same blend pipeline of the variant
+		if (specialized_shaders)
+		{
+			uint32_t material = draw_list::get_material(key);
+			if (material >= materials.size())
+			{
+				throw std::runtime_error(" Error: Draw key uses an unknown material \n");
+			}
+
+			uint32_t features = material_features[material];
+			if (geometry_meshes[geometry] != SCENE_NO_MESH)
+			{
+				features |= SHADER_FEATURE_MESH;
+			}
+
+			uint32_t first_pipeline = shader_variants::get_variant(features) * SCENE_PIPELINE_COUNT;
+			key += static_cast<uint64_t>(first_pipeline) << DRAW_KEY_PIPELINE_SHIFT;
+		}
+
+		draws.add(key, index);
+	}
+	draws.sort();
+
+	SceneObjectHeader* header = static_cast<SceneObjectHeader*>(scene_buffer.mapped);
+	header->view_projection = view_projection;
+
+	// Instance slots follow the sorted order, so draws sharing state cover a contiguous range
+	float* rows = reinterpret_cast<float*>(header + 1);
+	for (const DrawItem& item : draws.get_items())
+	{
+		frame_scene.get_world_transform(item.object, rows);
+
+		uint32_t mesh = geometry_meshes[draw_list::get_geometry(item.key)];
+		if (mesh != SCENE_NO_MESH)
+		{
+			apply_position_dequantization(meshes.get_mesh(mesh).header, rows);
+		}
+
+		rows += 12;
+	}
+}
+
+
+uint32_t vulkan_renderer::select_lod(uint32_t mesh, uint32_t object, float view_depth, float radius)
+{
+	const GpuMesh& gpu_mesh = meshes.get_mesh(mesh);
+
+	// Distance to the nearest point of the bounds, full detail once the camera is inside them
+	float distance = view_depth - radius;
+	if (lod_error_pixels <= 0.0f || distance <= 0.0f)
+		return 0;
+
+	// LOD errors are in object space, the largest axis scale of the transform brings them to world space
+	float transform[12];
+	frame_scene.get_world_transform(object, transform);
+
+	float scale = 0.0f;
+	for (int column = 0; column < 3; column++)
+	{
+		scale = std::max(scale, transform[column] * transform[column] + transform[4 + column] * transform[4 + column]
+			+ transform[8 + column] * transform[8 + column]);
+	}
+	scale = std::sqrt(scale);
+
+	float pixels_per_unit = lod_projection_scale * windows[0].extent.height * 0.5f / distance;
+
+	uint32_t lod = 0;
+	while (lod + 1 < gpu_mesh.lods.size() && gpu_mesh.lods[lod + 1].error * scale * pixels_per_unit <= lod_error_pixels)
+	{
+		lod++;
+	}
+
+	return lod;
+}
+
+
+void vulkan_renderer::recreate_render_targets()
+{
+	vkDeviceWaitIdle(main_device.logical_device);
+
+	profile_zone zone(&profile, "recreate render targets");
+	auto start = std::chrono::high_resolution_clock::now();
+
+	vkFreeCommandBuffers(main_device.logical_device, graphics_cmd_pool, static_cast<uint32_t>(commandbuffers.size()), commandbuffers.data());
+	for (VkPipeline pipeline : graphics_pipelines)
+	{
+		vkDestroyPipeline(main_device.logical_device, pipeline, allocator);
+	}
+	particles.destroy_draw_pipeline();
+	sprites.destroy_pipeline();
+	for (WindowTarget& target : windows)
+	{
+		target.graph.destroy();
+	}
+
+	create_render_graph();
+	create_graphic_pipeline();
+	create_commandbuffer();
+
+	last_recreate_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+
+void vulkan_renderer::set_dynamic_rendering(bool enable)
+{
+	if (enable == use_dynamic_rendering)
+		return;
+
+	use_dynamic_rendering = enable;
+
+	// Before init the choice is picked up by the first render graph
+	if (!graphics_pipelines.empty())
+	{
+		recreate_render_targets();
+	}
+}
+
+
+bool vulkan_renderer::is_dynamic_rendering_active()
+{
+	return windows[0].graph.is_dynamic_rendering();
+}
+
+
+double vulkan_renderer::get_last_recreate_ms()
+{
+	return last_recreate_ms;
+}
+
+
+void vulkan_renderer::set_parallel_init(bool parallel)
+{
+	parallel_init = parallel;
+}
+
+
+double vulkan_renderer::get_init_ms()
+{
+	return init_ms;
+}
+
+
+void vulkan_renderer::set_preferred_device(const std::string& name)
+{
+	preferred_device = name;
+}
+
+
+std::string vulkan_renderer::get_device_name()
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(main_device.physical_device, &properties);
+	return properties.deviceName;
+}
+
+
+double vulkan_renderer::get_pipeline_creation_ms()
+{
+	return pipeline_creation_ms;
+}
+
+
+void vulkan_renderer::add_window(GLFWwindow* new_window)
+{
+	if (offscreen)
+	{
+		throw std::runtime_error(" Error: Windows can not be added to an offscreen renderer \n");
+	}
+
+	windows.emplace_back();
+	WindowTarget& target = windows.back();
+	target.window = new_window;
+
+	try
+	{
+		create_surface(&target);
+
+		// Frames are presented from the graphics queue's presentation family
+		VkBool32 presentation_support = VK_FALSE;
+		QueueFamilyIndicies indices = get_queue_family(main_device.physical_device);
+		vkGetPhysicalDeviceSurfaceSupportKHR(main_device.physical_device, indices.presentation_family, target.surface, &presentation_support);
+
+		if (!presentation_support)
+		{
+			throw std::runtime_error(" Error: Window can not be presented from the presentation queue \n");
+		}
+
+		create_swap_chain(&target);
+		create_window_semaphores(&target);
+		create_window_graph(&target, false);
+	}
+	catch (const std::runtime_error&)
+	{
+		// Handles that were not created are still null and ignored by the destroy calls
+		destroy_window(&target);
+		windows.pop_back();
+		throw;
+	}
+}
+
+
+void vulkan_renderer::remove_window(GLFWwindow* old_window)
+{
+	for (size_t i = 1; i < windows.size(); i++)
+	{
+		if (windows[i].window == old_window)
+		{
+			// The frames in flight may still present to it
+			vkDeviceWaitIdle(main_device.logical_device);
+
+			destroy_window(&windows[i]);
+			windows.erase(windows.begin() + i);
+			return;
+		}
+	}
+
+	throw std::runtime_error(" Error: Window was not added to the renderer \n");
+}
+
+
+uint32_t vulkan_renderer::get_window_count()
+{
+	return static_cast<uint32_t>(windows.size());
+}
+
+
+std::vector<VkSampleCountFlagBits> vulkan_renderer::get_supported_sample_counts()
+{
+	VkPhysicalDeviceProperties physical_device_props;
+	vkGetPhysicalDeviceProperties(main_device.physical_device, &physical_device_props);
+
+	// Both the colour and the depth attachment must support the sample count
+	VkSampleCountFlags counts = physical_device_props.limits.framebufferColorSampleCounts
+		& physical_device_props.limits.framebufferDepthSampleCounts;
+
+	std::vector<VkSampleCountFlagBits> sample_counts;
+	for (VkSampleCountFlags count = VK_SAMPLE_COUNT_1_BIT; count <= VK_SAMPLE_COUNT_64_BIT; count <<= 1)
+	{
+		if (counts & count)
+		{
+			sample_counts.push_back(static_cast<VkSampleCountFlagBits>(count));
+		}
+	}
+
+	return sample_counts;
+}
+
+
+VkSampleCountFlagBits vulkan_renderer::get_msaa_samples()
+{
+	return msaa_samples;
+}
+
+
+void vulkan_renderer::set_msaa_samples(VkSampleCountFlagBits samples)
+{
+	std::vector<VkSampleCountFlagBits> sample_counts = get_supported_sample_counts();
+
+	if (std::find(sample_counts.begin(), sample_counts.end(), samples) == sample_counts.end())
+	{
+		throw std::runtime_error(" Error: Sample count is not supported by the device \n");
+	}
+
+	if (samples == msaa_samples)
+		return;
+
+	msaa_samples = samples;
+	recreate_render_targets();
+
+	printf("MSAA set to %u samples \n", static_cast<uint32_t>(msaa_samples));
+}
+
+
+const RenderGraphStats& vulkan_renderer::get_render_graph_stats()
+{
+	return windows[0].graph.get_stats();
+}
+
+
+void vulkan_renderer::set_dispatch(VulkanDispatch dispatch)
+{
+	dispatch_mode = dispatch;
+	vulkan_loader::load_device(main_device.logical_device, dispatch_mode);
+}
+
+
+void vulkan_renderer::set_draw_count(uint32_t count)
+{
+	draw_count = std::max(1u, count);
+}
+
+
+double vulkan_renderer::get_last_record_ms()
+{
+	return last_record_ms;
+}
+
+
+void vulkan_renderer::set_host_allocator_mode(HostAllocatorMode mode)
+{
+	host_allocator_mode = mode;
+}
+
+
+host_allocator& vulkan_renderer::get_host_allocator()
+{
+	return host_memory;
+}
+
+
+MemoryReport vulkan_renderer::get_memory_report()
+{
+	return memory.get_report();
+}
+
+
+void vulkan_renderer::print_memory_report()
+{
+	memory.print_report();
+}
+
+
+uint32_t vulkan_renderer::load_texture(const std::string& file)
+{
+	return textures.load_texture(file);
+}
+
+
+void vulkan_renderer::set_texture_budget(VkDeviceSize budget)
+{
+	textures.set_budget(budget);
+}
+
+
+texture_manager& vulkan_renderer::get_textures()
+{
+	return textures;
+}
+
+
+uint32_t vulkan_renderer::load_mesh(const std::string& file)
+{
+	uint32_t mesh = meshes.load(file);
+	const GpuMesh& gpu_mesh = meshes.get_mesh(mesh);
+
+	if (geometries.size() + gpu_mesh.lods.size() > (1u << DRAW_KEY_GEOMETRY_BITS))
+	{
+		throw std::runtime_error(" Error: Too many mesh LODs for the draw key \n");
+	}
+
+	// Indices are relative to the start of the index section, vertices are pulled in the shader
+	mesh_geometries.push_back(static_cast<uint32_t>(geometries.size()));
+	for (const MeshLod& lod : gpu_mesh.lods)
+	{
+		DrawGeometry geometry = {};
+		geometry.index_buffer = gpu_mesh.buffer;
+		geometry.index_buffer_offset = gpu_mesh.index_offset;
+		geometry.first_index = lod.index_offset;
+		geometry.index_count = lod.index_count;
+		geometry.vertex_buffer = gpu_mesh.bindless_index;
+
+		for (int axis = 0; axis < 2; axis++)
+		{
+			geometry.uv_offset[axis] = gpu_mesh.header.uv_min[axis];
+			geometry.uv_scale[axis] = gpu_mesh.header.uv_scale[axis] * 65535.0f;
+		}
+
+		geometries.push_back(geometry);
+		geometry_meshes.push_back(mesh);
+	}
+
+	return mesh;
+}
+
+
+mesh_manager& vulkan_renderer::get_meshes()
+{
+	return meshes;
+}
+
+
+frame_capture& vulkan_renderer::get_capture()
+{
+	return capture;
+}
+
+
+descriptor_allocator& vulkan_renderer::get_descriptors()
+{
+	return descriptors;
+}
+
+
+profiler& vulkan_renderer::get_profiler()
+{
+	return profile;
+}
+
+
+void vulkan_renderer::set_gpu_queries_enabled(bool enable)
+{
+	queries.set_enabled(enable);
+}
+
+
+gpu_queries& vulkan_renderer::get_queries()
+{
+	return queries;
+}
+
+
+void vulkan_renderer::print_gpu_stats()
+{
+	// Samples rather than pixels so overdraw reads the same with multisampling
+	uint64_t sample_count = static_cast<uint64_t>(windows[0].extent.width) * windows[0].extent.height * msaa_samples;
+	queries.print_stats(sample_count);
+}
+
+
+void vulkan_renderer::set_occlusion_culling(bool enable)
+{
+	if (enable == occlusion_enabled)
+		return;
+
+	occlusion_enabled = enable;
+	recreate_render_targets();
+
+	if (enable && !is_occlusion_culling_active())
+	{
+		printf("Occlusion culling stays off, it needs hiz_reduce.spv and no MSAA \n");
+	}
+}
+
+
+bool vulkan_renderer::is_occlusion_culling_active()
+{
+	return occlusion_enabled && occlusion.is_available() && msaa_samples == VK_SAMPLE_COUNT_1_BIT;
+}
+
+
+void vulkan_renderer::set_particles_enabled(bool enable)
+{
+	if (enable == particles.is_enabled())
+		return;
+
+	particles.set_enabled(enable);
+	recreate_render_targets();
+
+	if (enable && !is_particles_active())
+	{
+		printf("Particles stay off, they need particles.spv, particle_vert.spv and particle_frag.spv \n");
+	}
+}
+
+
+bool vulkan_renderer::is_particles_active()
+{
+	return particles.is_enabled() && particles.is_available();
+}
+
+
+void vulkan_renderer::set_particle_capacity(uint32_t capacity)
+{
+	particle_capacity = capacity;
+
+	if (!particles.is_available())
+		return;
+
+	// The graph imports the buffers, it is rebuilt around the new ones
+	vkDeviceWaitIdle(main_device.logical_device);
+	particles.set_capacity(capacity);
+	recreate_render_targets();
+}
+
+
+particle_system& vulkan_renderer::get_particles()
+{
+	return particles;
+}
+
+
+void vulkan_renderer::set_post_processing(bool enable)
+{
+	if (enable == post_enabled)
+		return;
+
+	post_enabled = enable;
+
+	// Before init the choice is picked up by the first render graph
+	if (graphics_pipelines.empty())
+		return;
+
+	recreate_render_targets();
+
+	if (enable && !is_post_processing_active())
+	{
+		printf("Post-processing stays off, it needs bloom_downsample.spv, bloom_upsample.spv, tonemap.spv and blits to the swap chain \n");
+	}
+}
+
+
+bool vulkan_renderer::is_post_processing_active()
+{
+	return post_enabled && post.is_available() && post_blit_supported;
+}
+
+
+void vulkan_renderer::set_post_settings(const PostSettings& settings)
+{
+	uint32_t old_levels = post.get_settings().bloom_levels;
+	post.set_settings(settings);
+
+	// The other settings are push constants, only the bloom levels change the graph
+	if (post.get_settings().bloom_levels != old_levels && is_post_processing_active() && !graphics_pipelines.empty())
+	{
+		recreate_render_targets();
+	}
+}
+
+
+post_process& vulkan_renderer::get_post_process()
+{
+	return post;
+}
+
+
+sprite_batch& vulkan_renderer::get_sprites()
+{
+	return sprites;
+}
+
+
+const OcclusionStats& vulkan_renderer::get_occlusion_stats()
+{
+	return occlusion.get_stats();
+}
 
-	}
-	else
+
+uint32_t vulkan_renderer::get_mesh_geometry(uint32_t mesh)
+{
+	if (mesh >= mesh_geometries.size())
 	{
-		swap_chain_create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE ;
-		swap_chain_create_info.queueFamilyIndexCount = 0 ;
-		swap_chain_create_info.pQueueFamilyIndices = nullptr;
+		throw std::runtime_error(" Error: Invalid mesh handle \n");
 	}
 
-	swap_chain_create_info.oldSwapchain = VK_NULL_HANDLE;
+	return mesh_geometries[mesh];
+}
 
-	//create the swap_chain
-	VkResult result =  vkCreateSwapchainKHR(main_device.logical_device, &swap_chain_create_info, nullptr, &swap_chain);
 
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error(" Error : Faild to create swap chain \n");
-	}
-	else
+void vulkan_renderer::set_lod_error(float pixels)
+{
+	lod_error_pixels = pixels;
+}
+
+
+const std::array<uint32_t, MESH_MAX_LODS>& vulkan_renderer::get_lod_counts()
+{
+	return lod_counts;
+}
+
+
+scene& vulkan_renderer::get_scene()
+{
+	return frame_scene;
+}
+
+
+uint32_t vulkan_renderer::add_material(uint32_t texture, uint32_t tint)
+{
+	if (materials.size() >= (1u << DRAW_KEY_MATERIAL_BITS))
 	{
-		printf("Swap chain creation sucessful \n");
+		throw std::runtime_error(" Error: Too many materials for the draw key \n");
 	}
 
-	swap_chain_image_format = surface_format.format;
-	swap_chain_extent = extent;
+	materials.push_back(texture);
+	material_tints.push_back(tint);
+	return static_cast<uint32_t>(materials.size() - 1);
+}
 
-	uint32_t swap_chain_image_count;
-	vkGetSwapchainImagesKHR(main_device.logical_device, swap_chain, &swap_chain_image_count, nullptr);
-	std::vector<VkImage> images(swap_chain_image_count);
-	vkGetSwapchainImagesKHR(main_device.logical_device, swap_chain, &swap_chain_image_count, images.data());
 
-	for ( VkImage image : images)
-	{
-		SwapChainImage swap_chain_image = {};
-		swap_chain_image.image = image;
-		swap_chain_image.image_view = create_image_view(image, swap_chain_image_format, VK_IMAGE_ASPECT_COLOR_BIT);
-		//Create image view
+void vulkan_renderer::set_specialized_shaders(bool specialized)
+{
+	specialized_shaders = specialized;
+}
 
-		swap_chain_images.push_back(swap_chain_image);
-	}
 
+void vulkan_renderer::set_shader_light_count(uint32_t count)
+{
+	if (count == shader_light_count)
+		return;
+
+	shader_light_count = count;
+	recreate_render_targets();
 }
 
 
-void vulkan_renderer::create_renderpass()
+void vulkan_renderer::set_sort_draws(bool sort)
 {
-	//Color attachment of the renderpass
-	VkAttachmentDescription color_attachment = {};
-	color_attachment.format = swap_chain_image_format;
-	color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	draws.set_sort_enabled(sort);
+}
 
-	color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
-	VkAttachmentReference color_attachment_reference = {};
-	color_attachment_reference.attachment = 0;
-	color_attachment_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+const DrawListStats& vulkan_renderer::get_draw_list_stats()
+{
+	return draws.get_stats();
+}
+
 
-	//Subpass
-	VkSubpassDescription subpass = {};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &color_attachment_reference;
+void vulkan_renderer::set_camera(const glm::mat4& view, const glm::mat4& projection)
+{
+	camera_view = view;
+	view_projection = projection * view;
 
-	//layout transition using subpass dependencies
-	std::array<VkSubpassDependency, 2> subpass_dependencies;
+	// Pixels per world unit at distance one is this times half the viewport height
+	lod_projection_scale = std::abs(projection[1][1]);
+}
 
-	subpass_dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-	subpass_dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	subpass_dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
 
-	subpass_dependencies[0].dstSubpass = 0;
-	subpass_dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpass_dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	subpass_dependencies[0].dependencyFlags = 0;
+void vulkan_renderer::set_display_texture(uint32_t texture)
+{
+	display_texture = texture;
+}
 
-	subpass_dependencies[1].srcSubpass = 0;
-	subpass_dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpass_dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
-	subpass_dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-	subpass_dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	subpass_dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-	subpass_dependencies[1].dependencyFlags = 0;
+void vulkan_renderer::record_commands()
+{
+	VkCommandBufferBeginInfo cb_begin_info = {};
+	cb_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cb_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-	VkRenderPassCreateInfo renderpass_create_info = {};
-	renderpass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderpass_create_info.attachmentCount = 1;
-	renderpass_create_info.pAttachments = &color_attachment;
-	renderpass_create_info.subpassCount = 1;
-	renderpass_create_info.pSubpasses = &subpass;
-	renderpass_create_info.dependencyCount = static_cast<uint32_t>(subpass_dependencies.size());
-	renderpass_create_info.pDependencies = subpass_dependencies.data();
+	VkCommandBuffer command_buffer = commandbuffers[current_frame];
 
-	VkResult result = vkCreateRenderPass(main_device.logical_device, &renderpass_create_info, nullptr, &render_pass);
+	VkResult result = vkBeginCommandBuffer(command_buffer, &cb_begin_info);
 
 	if (result != VK_SUCCESS)
 	{
-		throw std::runtime_error(" Error: Failed to create the RenderPass \n");
+		throw std::runtime_error(" Error: Failed record command buffer \n");
 	}
-	else
+
+	// Results of the last use of this command buffer are read before its queries are reset
+	queries.begin_frame(command_buffer, current_frame);
+	profile.begin_frame(command_buffer, current_frame);
+	post.begin_frame(command_buffer, current_frame);
+	profile.begin_gpu_zone(command_buffer, "frame");
+
+	//render passes, barriers and layout transitions come from the render graph of each window
+	for (WindowTarget& target : windows)
 	{
-		printf("RenderPass creation is  a success \n");
+		if (target.acquired)
+			target.graph.execute(command_buffer, target.image_index);
+	}
+
+	// After the graph, which leaves the backbuffer ready to present or, offscreen, to copy
+	if (windows[0].acquired)
+	{
+		profile.begin_gpu_zone(command_buffer, "frame capture");
+		VkImageLayout backbuffer_layout = windows[0].window != nullptr ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		capture.record(command_buffer, windows[0].images[windows[0].image_index].image, backbuffer_layout, current_frame);
+		profile.end_gpu_zone(command_buffer);
+	}
+
+	profile.end_gpu_zone(command_buffer);
+
+	result = vkEndCommandBuffer(command_buffer);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(" Error: Failed Stop record command buffer \n");
 	}
 }
 
 
-void vulkan_renderer::create_framebuffers()
+void vulkan_renderer::record_scene(VkCommandBuffer command_buffer, VkExtent2D extent, bool main_window)
 {
-	//There will be one framebuffer for each image in swapchain
-	swapchain_framebuffers.resize(swap_chain_images.size());
+	// Pipelines are shared by windows of any size
+	VkViewport viewport = {};
+	viewport.width = static_cast<float>(extent.width);
+	viewport.height = static_cast<float>(extent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+	VkRect2D scissor = {};
+	scissor.extent = extent;
+	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+	// Every pipeline shares the layout, so the set stays bound for the whole pass
+	bindless.bind(command_buffer, pipeline_layout, VK_PIPELINE_BIND_POINT_GRAPHICS, current_frame);
+
+	queries.begin_region(command_buffer, main_query_region);
 
-	for (size_t i = 0; i < swapchain_framebuffers.size(); i++)
+	// Scene objects come sorted from the draw list, the instance index picks the transform in the scene buffer
+	if (frame_scene.get_object_count() > 0)
 	{
-		std::array<VkImageView, 1> attachments = {
-			swap_chain_images[i].image_view
-		};
+		material_constants.resize(materials.size());
 
-		VkFramebufferCreateInfo framebuffer_create_info = {};
-		framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebuffer_create_info.renderPass = render_pass;
-		framebuffer_create_info.attachmentCount = static_cast<uint32_t>(attachments.size());
-		framebuffer_create_info.pAttachments = attachments.data();
-		framebuffer_create_info.width = swap_chain_extent.width;
-		framebuffer_create_info.height = swap_chain_extent.height;
-		framebuffer_create_info.layers = 1;
+		for (size_t i = 0; i < materials.size(); i++)
+		{
+			material_constants[i].buffer_index = scene_buffers[current_frame].bindless_index;
+			material_constants[i].texture_index = BINDLESS_INVALID_INDEX;
+			material_constants[i].tint = material_tints[i];
 
-		VkResult result = vkCreateFramebuffer(main_device.logical_device, &framebuffer_create_info, nullptr, &swapchain_framebuffers[i]);
+			if (materials[i] != BINDLESS_INVALID_INDEX)
+			{
+				textures.mark_used(materials[i]);
+				material_constants[i].texture_index = textures.get_bindless_index(materials[i]);
+			}
+		}
 
-		if (result != VK_SUCCESS)
+		draws.record(command_buffer, pipeline_layout, graphics_pipelines, material_constants, geometries);
+	}
+	else
+	{
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipelines[SCENE_PIPELINE_BLENDED]);
+
+		DrawPushConstants push_constants = {};
+		if (display_texture != BINDLESS_INVALID_INDEX)
 		{
-			throw std::runtime_error(" Error: Failed to create the framebuffer \n");
+			textures.mark_used(display_texture);
+			push_constants.texture_index = textures.get_bindless_index(display_texture);
 		}
-		else
+
+		// More than one draw only to load the command path, see set_draw_count
+		for (uint32_t i = 0; i < draw_count; i++)
 		{
-			printf("Framebuffer creation is  a success \n");
+			vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+				0, sizeof(DrawPushConstants), &push_constants);
+			vkCmdDraw(command_buffer, 3, 1, 0, 0);
 		}
 	}
 
+	// Last, they are depth tested against the scene without writing depth
+	if (main_window)
+	{
+		particles.record_draw(command_buffer, camera_view, view_projection);
+	}
+
+	queries.end_region(command_buffer);
 }
 
 
-void vulkan_renderer::create_command_pool()
+void vulkan_renderer::load_shader_files()
 {
-	QueueFamilyIndicies queue_family_indicies = get_queue_family(main_device.physical_device);
-
-	VkCommandPoolCreateInfo cmd_pool_create_info = {};
-	cmd_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	cmd_pool_create_info.queueFamilyIndex = queue_family_indicies.graphics_family;
-
-	VkResult result = vkCreateCommandPool(main_device.logical_device, &cmd_pool_create_info, nullptr, &graphics_cmd_pool);
+	vertex_shader_code = read_shader_file("../shaders/vert.spv");
+	fragment_shader_code = read_shader_file("../shaders/frag.spv");
 
-	if (result != VK_SUCCESS)
+	// Optional, occlusion culling stays unavailable without it
+	try
 	{
-		throw std::runtime_error(" Error: Failed to create the Command pool \n");
+		hiz_shader_code = read_shader_file("../shaders/hiz_reduce.spv");
 	}
-	else
+	catch (const std::runtime_error&)
 	{
-		printf("Command pool creation is  a success \n");
+		hiz_shader_code.clear();
 	}
 
-}
-
-
-void vulkan_renderer::create_commandbuffer()
-{
-	commandbuffers.resize(swapchain_framebuffers.size());
-
-	VkCommandBufferAllocateInfo cb_alloc_info = {};
-	cb_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	cb_alloc_info.commandPool = graphics_cmd_pool;
-	cb_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	cb_alloc_info.commandBufferCount = static_cast<uint32_t>(commandbuffers.size());
+	// Optional, the particle system stays unavailable without all three
+	try
+	{
+		particle_compute_code = read_shader_file("../shaders/particles.spv");
+		particle_vertex_code = read_shader_file("../shaders/particle_vert.spv");
+		particle_fragment_code = read_shader_file("../shaders/particle_frag.spv");
+	}
+	catch (const std::runtime_error&)
+	{
+		particle_compute_code.clear();
+		particle_vertex_code.clear();
+		particle_fragment_code.clear();
+	}
 
-	VkResult result=  vkAllocateCommandBuffers(main_device.logical_device, &cb_alloc_info, commandbuffers.data());
+	// Optional, without all three the scene is drawn straight into the swap chain
+	try
+	{
+		bloom_downsample_code = read_shader_file("../shaders/bloom_downsample.spv");
+		bloom_upsample_code = read_shader_file("../shaders/bloom_upsample.spv");
+		tonemap_code = read_shader_file("../shaders/tonemap.spv");
+	}
+	catch (const std::runtime_error&)
+	{
+		bloom_downsample_code.clear();
+		bloom_upsample_code.clear();
+		tonemap_code.clear();
+	}
 
-	if (result != VK_SUCCESS)
+	// Optional, sprites are dropped without both
+	try
 	{
-		throw std::runtime_error(" Error: Failed to allocate command buffer \n");
+		sprite_vertex_code = read_shader_file("../shaders/sprite_vert.spv");
+		sprite_fragment_code = read_shader_file("../shaders/sprite_frag.spv");
 	}
-	else
+	catch (const std::runtime_error&)
 	{
-		printf("Command buffer allocation is  a success \n");
+		sprite_vertex_code.clear();
+		sprite_fragment_code.clear();
 	}
 }
 
 
-void vulkan_renderer::create_synchronization()
+void vulkan_renderer::create_shader_modules()
 {
-	VkSemaphoreCreateInfo semaphore_ci = {};
-	semaphore_ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-
-	if ((vkCreateSemaphore(main_device.logical_device, &semaphore_ci, nullptr, &image_available) != VK_SUCCESS)
-		|| (vkCreateSemaphore(main_device.logical_device, &semaphore_ci, nullptr, &render_finished) != VK_SUCCESS))
-	{
-		throw std::runtime_error(" Error: Failed to create Semaphore \n");
-	}
+	// Kept until cleanup so the pipeline can be rebuilt without reading the files again
+	vertex_shader_module = create_shader_module(vertex_shader_code);
+	fragment_shader_module = create_shader_module(fragment_shader_code);
 }
 
 
-void vulkan_renderer::record_commands()
+void vulkan_renderer::create_pipeline_layout()
 {
-	VkCommandBufferBeginInfo cb_begin_info = {};
-	cb_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	cb_begin_info.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+	VkPipelineLayoutCreateInfo layout_create_info = {};
+	layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	VkDescriptorSetLayout set_layout = bindless.get_set_layout();
+	VkPushConstantRange push_constant_range = bindless.get_push_constant_range();
 
-	VkRenderPassBeginInfo rp_begin_info = {};
-	rp_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	rp_begin_info.renderPass = render_pass;
-	rp_begin_info.renderArea.offset = { 0,0 };	//start point of render pass
-	rp_begin_info.renderArea.extent = swap_chain_extent;
-	
-	VkClearValue clear_value[] = {
-		{ 0.6f, 0.65f, 0.4f, 1.0f }
-	};
+	layout_create_info.setLayoutCount = 1;
+	layout_create_info.pSetLayouts = &set_layout;
+	layout_create_info.pushConstantRangeCount = 1;
+	layout_create_info.pPushConstantRanges = &push_constant_range;
 
-	rp_begin_info.pClearValues = clear_value;
-	rp_begin_info.clearValueCount = 1;
+	VkResult result = vkCreatePipelineLayout(main_device.logical_device, &layout_create_info, allocator, &pipeline_layout);
 
-	for (size_t i = 0; i < commandbuffers.size(); i++)
+	if (result != VK_SUCCESS)
 	{
-		rp_begin_info.framebuffer = swapchain_framebuffers[i];
-
-		VkResult result = vkBeginCommandBuffer(commandbuffers[i], &cb_begin_info);
-
-		if (result != VK_SUCCESS)
-		{
-			throw std::runtime_error(" Error: Failed record command buffer \n");
-		}
-		else
-		{
-			printf("Command buffer Recording is  a success \n");
-		}
-
-		//render pass
-		vkCmdBeginRenderPass(commandbuffers[i], &rp_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-		
-		{
-			vkCmdBindPipeline(commandbuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline);
-			vkCmdDraw(commandbuffers[i], 3, 1, 0, 0);
-		}
-		
-		vkCmdEndRenderPass(commandbuffers[i]);
-
-		result = vkEndCommandBuffer(commandbuffers[i]);
-
-		if (result != VK_SUCCESS)
-		{
-			throw std::runtime_error(" Error: Failed Stop record command buffer \n");
-		}
-		else
-		{
-			printf("Command buffer Recording Stopping is  a success \n");
-		}
+		throw std::runtime_error("Failed to create a Pipeline layout");
+	}
+	else
+	{
+		printf("Pipeline layout creation is  a success \n");
 	}
 }
 
 
 void vulkan_renderer::create_graphic_pipeline()
 {
-	auto vertex_shader_code = read_shader_file("../shaders/vert.spv");
-	auto fragment_shader_code = read_shader_file("../shaders/frag.spv");
-
-	//build shader modules
-	VkShaderModule vertex_shader_module = create_shader_module(vertex_shader_code);
-	VkShaderModule fragment_shader_module = create_shader_module(fragment_shader_code);
+	variants.init(shader_light_count);
 
 	//vertex shader creation info
 	VkPipelineShaderStageCreateInfo vertex_shader_create_info = {};
@@ -587,28 +2257,21 @@ void vulkan_renderer::create_graphic_pipeline()
 	input_assembly_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 	input_assembly_info.primitiveRestartEnable = false;
 
-	// PIPELINE - Viewport & Scissor
-	VkViewport viewport = {};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = (float)swap_chain_extent.width;
-	viewport.height = (float)swap_chain_extent.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-	VkRect2D scissor = {};
-	scissor.offset = {0,0};
-	scissor.extent = swap_chain_extent;
-
+	// PIPELINE - Viewport & Scissor, set by record_scene for the window being drawn
 	VkPipelineViewportStateCreateInfo viewport_create_info = {};
 	viewport_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 	viewport_create_info.viewportCount = 1;
-	viewport_create_info.pViewports = &viewport;
+	viewport_create_info.pViewports = nullptr;
 	viewport_create_info.scissorCount = 1;
-	viewport_create_info.pScissors = &scissor;
+	viewport_create_info.pScissors = nullptr;
 
-	// PIPELINE - dynamic state for resize and etc:
-	// for now not implemented.
+	// PIPELINE - dynamic state, every window shares the pipelines whatever its size
+	VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+	VkPipelineDynamicStateCreateInfo dynamic_state_create_info = {};
+	dynamic_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamic_state_create_info.dynamicStateCount = 2;
+	dynamic_state_create_info.pDynamicStates = dynamic_states;
 
 	// PIPELINE - Rasterizer
 	VkPipelineRasterizationStateCreateInfo rasterizer_create_info = {};
@@ -618,14 +2281,15 @@ void vulkan_renderer::create_graphic_pipeline()
 	rasterizer_create_info.polygonMode = VK_POLYGON_MODE_FILL;
 	rasterizer_create_info.lineWidth = 1.0f;
 	rasterizer_create_info.cullMode = VK_CULL_MODE_BACK_BIT;
-	rasterizer_create_info.frontFace = VK_FRONT_FACE_CLOCKWISE;
+	// Counter clockwise in a y up world, the projection flip keeps it counter clockwise on screen
+	rasterizer_create_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
 	rasterizer_create_info.depthBiasEnable = VK_FALSE;
 
 	// PIPELINE - Multisampling
 	VkPipelineMultisampleStateCreateInfo multisampling_create_info = {};
 	multisampling_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
 	multisampling_create_info.sampleShadingEnable = VK_FALSE;
-	multisampling_create_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	multisampling_create_info.rasterizationSamples = msaa_samples;
 
 	// PIPELINE - Blending
 	VkPipelineColorBlendAttachmentState blend_attach_state = {};
@@ -647,26 +2311,22 @@ void vulkan_renderer::create_graphic_pipeline()
 	color_blend_state_create_info.attachmentCount = 1;
 	color_blend_state_create_info.pAttachments = &blend_attach_state;
 
-	// PIPELINE - Layout
-	VkPipelineLayoutCreateInfo layout_create_info = {};
-	layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	layout_create_info.setLayoutCount = 0;
-	layout_create_info.pSetLayouts = nullptr;
-	layout_create_info.pushConstantRangeCount = 0;
-	layout_create_info.pPushConstantRanges = nullptr;
+	// Opaque variant, same state without blending
+	VkPipelineColorBlendAttachmentState opaque_attach_state = blend_attach_state;
+	opaque_attach_state.blendEnable = VK_FALSE;
 
-	VkResult result = vkCreatePipelineLayout(main_device.logical_device, &layout_create_info, nullptr, &pipeline_layout);
+	VkPipelineColorBlendStateCreateInfo opaque_blend_state_create_info = color_blend_state_create_info;
+	opaque_blend_state_create_info.pAttachments = &opaque_attach_state;
 
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create a Pipeline layout");
-	}
-	else
-	{
-		printf("Pipeline layout creation is  a success \n");
-	}
+	// PIPELINE - Depth/Stencil configuration
+	VkPipelineDepthStencilStateCreateInfo depth_stencil_create_info = {};
+	depth_stencil_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depth_stencil_create_info.depthTestEnable = VK_TRUE;
+	depth_stencil_create_info.depthWriteEnable = VK_TRUE;
+	depth_stencil_create_info.depthCompareOp = VK_COMPARE_OP_LESS;
+	depth_stencil_create_info.depthBoundsTestEnable = VK_FALSE;
+	depth_stencil_create_info.stencilTestEnable = VK_FALSE;
 
-	// PIPELINE - Deapth/Stencil configuration. TODO
 	VkGraphicsPipelineCreateInfo pipeline_create_info = {};
 	pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 	pipeline_create_info.stageCount = 2;
@@ -674,20 +2334,57 @@ void vulkan_renderer::create_graphic_pipeline()
 	pipeline_create_info.pVertexInputState = &vertex_input_state_info;
 	pipeline_create_info.pInputAssemblyState = &input_assembly_info;
 	pipeline_create_info.pViewportState = &viewport_create_info;
-	pipeline_create_info.pDynamicState = nullptr;
+	pipeline_create_info.pDynamicState = &dynamic_state_create_info;
 	pipeline_create_info.pRasterizationState = &rasterizer_create_info;
 	pipeline_create_info.pMultisampleState = &multisampling_create_info;
 	pipeline_create_info.pColorBlendState = &color_blend_state_create_info;
-	pipeline_create_info.pDepthStencilState = nullptr;
+	pipeline_create_info.pDepthStencilState = &depth_stencil_create_info;
 	pipeline_create_info.layout = pipeline_layout;
 	pipeline_create_info.renderPass = render_pass;
 	pipeline_create_info.subpass = 0;
 
+	// Without a render pass the pipeline only needs the attachment formats of the main pass
+	std::vector<VkFormat> color_formats;
+	VkPipelineRenderingCreateInfoKHR rendering_create_info = {};
+	rendering_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+
+	if (windows[0].graph.is_dynamic_rendering())
+	{
+		windows[0].graph.get_attachment_formats(windows[0].main_pass, &color_formats, &rendering_create_info.depthAttachmentFormat);
+		rendering_create_info.colorAttachmentCount = static_cast<uint32_t>(color_formats.size());
+		rendering_create_info.pColorAttachmentFormats = color_formats.data();
+
+		pipeline_create_info.pNext = &rendering_create_info;
+		pipeline_create_info.renderPass = VK_NULL_HANDLE;
+	}
+
 	// Piepeline derivatives
 	pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
 	pipeline_create_info.basePipelineIndex = 0;
 
-	result = vkCreateGraphicsPipelines(main_device.logical_device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &graphics_pipeline);
+	// Draw keys select the pipeline by its index in graphics_pipelines, the blend
+	// pipelines of every shader variant one after the other, the uber shader first
+	uint32_t variant_count = variants.get_variant_count();
+	std::vector<std::array<VkPipelineShaderStageCreateInfo, 2>> variant_stages(variant_count);
+	std::vector<VkGraphicsPipelineCreateInfo> pipeline_create_infos(variant_count * SCENE_PIPELINE_COUNT, pipeline_create_info);
+
+	for (uint32_t variant = 0; variant < variant_count; variant++)
+	{
+		variant_stages[variant] = { vertex_shader_create_info, fragment_shader_create_info };
+		variant_stages[variant][0].pSpecializationInfo = variants.get_specialization_info(variant);
+		variant_stages[variant][1].pSpecializationInfo = variants.get_specialization_info(variant);
+
+		uint32_t first_pipeline = variant * SCENE_PIPELINE_COUNT;
+		pipeline_create_infos[first_pipeline + SCENE_PIPELINE_BLENDED].pStages = variant_stages[variant].data();
+		pipeline_create_infos[first_pipeline + SCENE_PIPELINE_OPAQUE].pStages = variant_stages[variant].data();
+		pipeline_create_infos[first_pipeline + SCENE_PIPELINE_OPAQUE].pColorBlendState = &opaque_blend_state_create_info;
+	}
+
+	graphics_pipelines.resize(pipeline_create_infos.size());
+	auto pipeline_start = std::chrono::high_resolution_clock::now();
+	VkResult result = vkCreateGraphicsPipelines(main_device.logical_device, VK_NULL_HANDLE, static_cast<uint32_t>(pipeline_create_infos.size()),
+		pipeline_create_infos.data(), allocator, graphics_pipelines.data());
+	pipeline_creation_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - pipeline_start).count();
 
 	if (result != VK_SUCCESS)
 	{
@@ -698,9 +2395,24 @@ void vulkan_renderer::create_graphic_pipeline()
 		printf("Graphics pipeline creation is  a success \n");
 	}
 
-	// Destroy shader modules
-	vkDestroyShaderModule(main_device.logical_device, fragment_shader_module, nullptr);
-	vkDestroyShaderModule(main_device.logical_device, vertex_shader_module, nullptr);
+	// Drawn in the same pass, so it follows the same attachments
+	particles.create_draw_pipeline(render_pass, windows[0].graph.is_dynamic_rendering() ? &rendering_create_info : nullptr,
+		msaa_samples);
+
+	// The sprite pass has only the swap chain image, single sampled
+	if (sprites.is_available())
+	{
+		std::vector<VkFormat> sprite_formats;
+		VkPipelineRenderingCreateInfoKHR sprite_rendering_info = {};
+		sprite_rendering_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+
+		windows[0].graph.get_attachment_formats(windows[0].sprite_pass, &sprite_formats, &sprite_rendering_info.depthAttachmentFormat);
+		sprite_rendering_info.colorAttachmentCount = static_cast<uint32_t>(sprite_formats.size());
+		sprite_rendering_info.pColorAttachmentFormats = sprite_formats.data();
+
+		sprites.create_pipeline(windows[0].graph.get_render_pass(windows[0].sprite_pass),
+			windows[0].graph.is_dynamic_rendering() ? &sprite_rendering_info : nullptr);
+	}
 }
 
 
@@ -719,12 +2431,26 @@ void vulkan_renderer::get_physical_device()
 
 	for( const auto &device: physical_devices)
 	{
+		if (!preferred_device.empty())
+		{
+			VkPhysicalDeviceProperties properties;
+			vkGetPhysicalDeviceProperties(device, &properties);
+			if (std::string(properties.deviceName).find(preferred_device) == std::string::npos)
+				continue;
+		}
+
 		if (check_device_suitable(device))
 		{
 			main_device.physical_device = device;
-			break;
+			return;
 		}
 	}
+
+	// Measurements on another GPU than the one asked for would be meaningless
+	if (!preferred_device.empty())
+	{
+		throw std::runtime_error(" Error: Cannot find a suitable GPU named " + preferred_device + " \n");
+	}
 }
 
 
@@ -772,7 +2498,7 @@ bool vulkan_renderer::check_device_extension_support(VkPhysicalDevice physical_d
 	std::vector<VkExtensionProperties> extensions(extension_count);
 	vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, extensions.data());
 
-	for (const auto& check_extension : device_extensions)
+	for (const auto& check_extension : get_required_device_extensions())
 	{
 		bool has_extension = false;
 
@@ -795,6 +2521,42 @@ bool vulkan_renderer::check_device_extension_support(VkPhysicalDevice physical_d
 }
 
 
+std::vector<const char*> vulkan_renderer::get_required_device_extensions()
+{
+	// The swap chain extension is all there is, an offscreen renderer does not present
+	if (offscreen)
+		return std::vector<const char*>();
+
+	return device_extensions;
+}
+
+
+std::vector<const char*> vulkan_renderer::get_supported_optional_extensions(VkPhysicalDevice physical_device)
+{
+	uint32_t extension_count = 0;
+	vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, nullptr);
+
+	std::vector<VkExtensionProperties> extensions(extension_count);
+	vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, extensions.data());
+
+	std::vector<const char*> supported_extensions;
+
+	for (const auto& check_extension : optional_device_extensions)
+	{
+		for (const auto& extension : extensions)
+		{
+			if (!strcmp(check_extension, extension.extensionName))
+			{
+				supported_extensions.push_back(check_extension);
+				break;
+			}
+		}
+	}
+
+	return supported_extensions;
+}
+
+
 bool vulkan_renderer::check_device_suitable(VkPhysicalDevice physical_device)
 {
 	//VkPhysicalDeviceProperties physical_device_props;
@@ -804,15 +2566,17 @@ bool vulkan_renderer::check_device_suitable(VkPhysicalDevice physical_device)
 	//vkGetPhysicalDeviceFeatures(physical_device, &physical_device_features);
 	bool extension_supported = check_device_extension_support(physical_device);
 
-	bool swap_chain_valid = false;
-	if (extension_supported)
+	bool swap_chain_valid = offscreen;
+	if (extension_supported && !offscreen)
 	{
-		SwapChainDetails swap_chain_details = get_swap_chain_details(physical_device);
+		SwapChainDetails swap_chain_details = get_swap_chain_details(physical_device, windows[0].surface);
 		swap_chain_valid = !swap_chain_details.present_modes.empty() && !swap_chain_details.surface_formats.empty();
 	}
 
 	QueueFamilyIndicies indicies = get_queue_family(physical_device);
-	return indicies.is_valid() && extension_supported && swap_chain_valid;
+	bool bindless_supported = bindless_heap::check_device_support(physical_device);
+
+	return indicies.is_valid() && extension_supported && swap_chain_valid && bindless_supported;
 }
 
 
@@ -836,7 +2600,15 @@ QueueFamilyIndicies vulkan_renderer::get_queue_family( VkPhysicalDevice physical
 
 		////check if queue family support presentation
 		VkBool32 presentation_support = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR( physical_device, i, surface, &presentation_support );
+		if (offscreen)
+		{
+			// Nothing is presented, the graphics queue stands in for the presentation queue
+			presentation_support = (queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+		}
+		else
+		{
+			vkGetPhysicalDeviceSurfaceSupportKHR( physical_device, i, windows[0].surface, &presentation_support );
+		}
 
 		//check if queue is presentation type, can be both graphics and presentation
 		if (queue_family.queueCount > 0 && presentation_support)
@@ -855,7 +2627,7 @@ QueueFamilyIndicies vulkan_renderer::get_queue_family( VkPhysicalDevice physical
 }
 
 
-SwapChainDetails vulkan_renderer::get_swap_chain_details(VkPhysicalDevice physical_device)
+SwapChainDetails vulkan_renderer::get_swap_chain_details(VkPhysicalDevice physical_device, VkSurfaceKHR surface)
 {
 	SwapChainDetails swap_chain_details;
 
@@ -928,7 +2700,7 @@ VkPresentModeKHR vulkan_renderer::choose_best_present_mode(std::vector<VkPresent
 }
 
 
-VkExtent2D vulkan_renderer::choose_swap_extent(const VkSurfaceCapabilitiesKHR surface_capabilities)
+VkExtent2D vulkan_renderer::choose_swap_extent(const VkSurfaceCapabilitiesKHR surface_capabilities, GLFWwindow* window)
 {
 	if (surface_capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max())
 	{
@@ -951,6 +2723,26 @@ VkExtent2D vulkan_renderer::choose_swap_extent(const VkSurfaceCapabilitiesKHR su
 }
 
 
+VkFormat vulkan_renderer::choose_supported_format(const std::vector<VkFormat>& formats, VkImageTiling tiling, VkFormatFeatureFlags feature_flags)
+{
+	for (VkFormat format : formats)
+	{
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(main_device.physical_device, format, &properties);
+
+		VkFormatFeatureFlags supported = tiling == VK_IMAGE_TILING_LINEAR
+			? properties.linearTilingFeatures : properties.optimalTilingFeatures;
+
+		if ((supported & feature_flags) == feature_flags)
+		{
+			return format;
+		}
+	}
+
+	throw std::runtime_error(" Error: Failed to find a matching format \n");
+}
+
+
 VkImageView vulkan_renderer::create_image_view(VkImage image, VkFormat format, VkImageAspectFlags flags)
 {
 	VkImageViewCreateInfo imageview_create_info = {};
@@ -967,10 +2759,10 @@ VkImageView vulkan_renderer::create_image_view(VkImage image, VkFormat format, V
 	imageview_create_info.subresourceRange.baseMipLevel = 0;
 	imageview_create_info.subresourceRange.levelCount = 1;
 	imageview_create_info.subresourceRange.baseArrayLayer = 0;
-	imageview_create_info.subresourceRange.layerCount = 0;
+	imageview_create_info.subresourceRange.layerCount = 1;
 
 	VkImageView image_view;
-	VkResult result = vkCreateImageView(main_device.logical_device, &imageview_create_info, nullptr, &image_view);
+	VkResult result = vkCreateImageView(main_device.logical_device, &imageview_create_info, allocator, &image_view);
 
 	if (result != VK_SUCCESS)
 	{
@@ -993,7 +2785,7 @@ VkShaderModule vulkan_renderer::create_shader_module(const std::vector<char> cod
 	shader_module_info.pCode = reinterpret_cast<const uint32_t*>(code.data());
 
 	VkShaderModule shader_module;
-	VkResult result = vkCreateShaderModule(main_device.logical_device, &shader_module_info, nullptr, &shader_module);
+	VkResult result = vkCreateShaderModule(main_device.logical_device, &shader_module_info, allocator, &shader_module);
 
 	if (result != VK_SUCCESS)
 	{
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <string>
+#include <stdexcept>
+#include <cstdint>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Read only memory mapping of a whole file.
+// Pages are read in by the OS on first touch, so copying from the mapping is
+// the only pass over the data.
+class mapped_file {
+
+	const uint8_t* data = nullptr;
+	uint64_t size = 0;
+
+#if defined(_WIN32)
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#else
+	int file = -1;
+#endif
+
+public:
+	mapped_file()
+	{
+	}
+
+	~mapped_file()
+	{
+		close();
+	}
+
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+
+	void open(const std::string& file_name)
+	{
+		close();
+
+#if defined(_WIN32)
+		file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			throw std::runtime_error("Fail to open the file " + file_name);
+		}
+
+		LARGE_INTEGER file_size;
+		GetFileSizeEx(file, &file_size);
+		size = static_cast<uint64_t>(file_size.QuadPart);
+
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr)
+		{
+			close();
+			throw std::runtime_error("Fail to map the file " + file_name);
+		}
+
+		data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+		file = ::open(file_name.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			throw std::runtime_error("Fail to open the file " + file_name);
+		}
+
+		struct stat file_stat;
+		fstat(file, &file_stat);
+		size = static_cast<uint64_t>(file_stat.st_size);
+
+		void* view = mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_PRIVATE, file, 0);
+		data = view == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(view);
+
+		// The whole file is copied out right away
+		if (data != nullptr)
+			madvise(view, static_cast<size_t>(size), MADV_WILLNEED);
+#endif
+
+		if (data == nullptr)
+		{
+			close();
+			throw std::runtime_error("Fail to map the file " + file_name);
+		}
+	}
+
+	void close()
+	{
+#if defined(_WIN32)
+		if (data != nullptr)
+			UnmapViewOfFile(data);
+		if (mapping != nullptr)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (data != nullptr)
+			munmap(const_cast<uint8_t*>(data), static_cast<size_t>(size));
+		if (file >= 0)
+			::close(file);
+
+		file = -1;
+#endif
+
+		data = nullptr;
+		size = 0;
+	}
+
+	const uint8_t* get_data()
+	{
+		return data;
+	}
+
+	uint64_t get_size()
+	{
+		return size;
+	}
+};
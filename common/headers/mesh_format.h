@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+
+// Binary mesh format written by mesh_converter and read by the renderer as is.
+// File layout, every section starting on a MESH_SECTION_ALIGNMENT boundary:
+//
+//	MeshFileHeader
+//	MeshLod[lod_count]
+//	Meshlet[meshlet_count]
+//	PackedVertex[vertex_count]
+//	uint32_t indices[index_count]
+//
+// Vertices and indices are adjacent so they reach the GPU with a single copy.
+// Indices are in vertex cache and overdraw optimized order, every LOD owns a
+// range of them and the meshlets of a LOD split that range in order.
+// Any change to these structs needs a new MESH_FILE_VERSION.
+
+const uint32_t MESH_FILE_MAGIC = 0x4853454D;	// "MESH"
+const uint32_t MESH_FILE_VERSION = 1;
+const uint32_t MESH_SECTION_ALIGNMENT = 16;
+
+const uint32_t MESH_MAX_LODS = 8;
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// Quantized vertex, 16 bytes
+struct PackedVertex {
+	uint16_t position[4];	// unorm16 inside the mesh bounds, w unused
+	int8_t normal[4];		// snorm8, w unused
+	uint16_t uv[2];			// unorm16 inside the uv range
+};
+
+struct MeshLod {
+	uint32_t index_offset;
+	uint32_t index_count;
+	uint32_t meshlet_offset;
+	uint32_t meshlet_count;
+
+	// Object space distance the level deviates from LOD 0
+	float error;
+	uint32_t padding[3];
+};
+
+struct Meshlet {
+	uint32_t index_offset;
+	uint32_t triangle_count;
+	uint32_t vertex_count;
+
+	// Bounding sphere and normal cone, every triangle faces away from a viewer at
+	// position p when dot(center - p, cone_axis) >= cone_cutoff * length(center - p) + radius.
+	// A cutoff above one means the normals are too spread out to ever pass
+	float center[3];
+	float radius;
+	float cone_axis[3];
+	float cone_cutoff;
+	uint32_t padding;
+};
+
+struct MeshFileHeader {
+	uint32_t magic;
+	uint32_t version;
+
+	uint32_t vertex_count;
+	uint32_t index_count;
+	uint32_t lod_count;
+	uint32_t meshlet_count;
+	uint32_t vertex_stride;
+	uint32_t index_size;
+
+	// position = position_min + unorm * position_scale, the same for uv
+	float position_min[3];
+	float position_scale[3];
+	float uv_min[2];
+	float uv_scale[2];
+
+	// Bounding sphere of the whole mesh
+	float center[3];
+	float radius;
+
+	// Byte offsets of the sections from the start of the file
+	uint64_t lod_offset;
+	uint64_t meshlet_offset;
+	uint64_t vertex_offset;
+	uint64_t index_offset;
+	uint64_t file_size;
+};
+
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex layout changed");
+static_assert(sizeof(MeshLod) == 32, "MeshLod layout changed");
+static_assert(sizeof(Meshlet) == 48, "Meshlet layout changed");
+static_assert(sizeof(MeshFileHeader) % MESH_SECTION_ALIGNMENT == 0, "MeshFileHeader must keep the sections aligned");
+
+inline uint64_t align_mesh_section(uint64_t offset)
+{
+	return (offset + MESH_SECTION_ALIGNMENT - 1) & ~static_cast<uint64_t>(MESH_SECTION_ALIGNMENT - 1);
+}
+
+// Only checks the header against the file size, nothing else in the file is read
+inline bool validate_mesh_header(const MeshFileHeader* header, uint64_t file_size)
+{
+	if (file_size < sizeof(MeshFileHeader))
+		return false;
+
+	if (header->magic != MESH_FILE_MAGIC || header->version != MESH_FILE_VERSION
+		|| header->vertex_stride != sizeof(PackedVertex) || header->index_size != sizeof(uint32_t)
+		|| header->lod_count == 0 || header->lod_count > MESH_MAX_LODS || header->file_size != file_size)
+		return false;
+
+	return header->lod_offset + static_cast<uint64_t>(header->lod_count) * sizeof(MeshLod) <= header->meshlet_offset
+		&& header->meshlet_offset + static_cast<uint64_t>(header->meshlet_count) * sizeof(Meshlet) <= header->vertex_offset
+		&& header->vertex_offset + static_cast<uint64_t>(header->vertex_count) * sizeof(PackedVertex) <= header->index_offset
+		&& header->index_offset + static_cast<uint64_t>(header->index_count) * sizeof(uint32_t) <= file_size;
+}
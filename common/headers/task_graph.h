@@ -0,0 +1,207 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <cstdio>
+
+#include "thread_pool.h"
+
+struct TaskTiming {
+	std::string name;
+	double start_ms = 0.0;
+	double duration_ms = 0.0;
+};
+
+struct Task {
+	std::string name;
+	std::function<void()> job;
+
+	// Tasks waiting on this one
+	std::vector<uint32_t> dependents;
+	uint32_t dependency_count = 0;
+
+	// Dependencies not finished yet while the graph runs
+	uint32_t pending = 0;
+
+	TaskTiming timing;
+};
+
+// Set of jobs with dependencies between them.
+// A task is submitted to the thread pool as soon as every task it depends on
+// has finished, so independent branches run at the same time. The first
+// exception thrown by a task stops new tasks from starting and is rethrown by
+// run() once the tasks already running are done.
+class task_graph {
+
+	std::vector<Task> tasks;
+
+	std::mutex graph_mutex;
+	std::condition_variable graph_done;
+	uint32_t running = 0;
+	uint32_t finished = 0;
+	std::exception_ptr error;
+
+	std::chrono::high_resolution_clock::time_point start_time;
+	double total_ms = 0.0;
+
+	double elapsed_ms()
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+	}
+
+	void run_task(thread_pool* pool, uint32_t index)
+	{
+		Task& task = tasks[index];
+
+		double start_ms = elapsed_ms();
+		std::exception_ptr task_error;
+
+		bool failed;
+		{
+			std::lock_guard<std::mutex> lock(graph_mutex);
+			failed = error != nullptr;
+		}
+
+		try
+		{
+			if (!failed)
+				task.job();
+		}
+		catch (...)
+		{
+			task_error = std::current_exception();
+		}
+
+		double end_ms = elapsed_ms();
+
+		std::vector<uint32_t> ready;
+		{
+			std::lock_guard<std::mutex> lock(graph_mutex);
+			task.timing.start_ms = start_ms;
+			task.timing.duration_ms = end_ms - start_ms;
+			running--;
+			finished++;
+
+			if (task_error && !error)
+				error = task_error;
+
+			if (!error)
+			{
+				for (uint32_t dependent : task.dependents)
+				{
+					if (--tasks[dependent].pending == 0)
+						ready.push_back(dependent);
+				}
+				running += static_cast<uint32_t>(ready.size());
+			}
+
+			if (running == 0)
+				graph_done.notify_all();
+		}
+
+		for (uint32_t dependent : ready)
+		{
+			dispatch(pool, dependent);
+		}
+	}
+
+	void dispatch(thread_pool* pool, uint32_t index)
+	{
+		if (pool != nullptr)
+			pool->submit([this, pool, index] { run_task(pool, index); });
+		else
+			run_task(nullptr, index);
+	}
+
+public:
+	uint32_t add_task(const std::string& name, std::function<void()> job)
+	{
+		Task task;
+		task.name = name;
+		task.job = std::move(job);
+		task.timing.name = name;
+
+		tasks.push_back(std::move(task));
+		return static_cast<uint32_t>(tasks.size() - 1);
+	}
+
+	// task does not start before dependency has finished
+	void add_dependency(uint32_t task, uint32_t dependency)
+	{
+		tasks[dependency].dependents.push_back(task);
+		tasks[task].dependency_count++;
+	}
+
+	// Without a pool the tasks run one after the other on the calling thread, still in dependency order
+	void run(thread_pool* pool)
+	{
+		std::vector<uint32_t> roots;
+
+		for (uint32_t i = 0; i < tasks.size(); i++)
+		{
+			tasks[i].pending = tasks[i].dependency_count;
+			tasks[i].timing.start_ms = 0.0;
+			tasks[i].timing.duration_ms = 0.0;
+
+			if (tasks[i].dependency_count == 0)
+				roots.push_back(i);
+		}
+
+		running = static_cast<uint32_t>(roots.size());
+		finished = 0;
+		error = nullptr;
+		start_time = std::chrono::high_resolution_clock::now();
+
+		for (uint32_t root : roots)
+		{
+			dispatch(pool, root);
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(graph_mutex);
+			graph_done.wait(lock, [this] { return running == 0; });
+		}
+
+		total_ms = elapsed_ms();
+
+		if (error)
+			std::rethrow_exception(error);
+
+		if (finished != tasks.size())
+			throw std::runtime_error(" Error: Task graph has a dependency cycle \n");
+	}
+
+	std::vector<TaskTiming> get_timings()
+	{
+		std::vector<TaskTiming> timings;
+		for (const Task& task : tasks)
+		{
+			timings.push_back(task.timing);
+		}
+		return timings;
+	}
+
+	double get_total_ms()
+	{
+		return total_ms;
+	}
+
+	void print_timings(const char* label)
+	{
+		double serial_ms = 0.0;
+
+		for (const Task& task : tasks)
+		{
+			printf("%s : %-20s starts at %8.2f ms, takes %8.2f ms \n", label, task.name.c_str(), task.timing.start_ms, task.timing.duration_ms);
+			serial_ms += task.timing.duration_ms;
+		}
+
+		printf("%s : %.2f ms wall time for %.2f ms of work \n", label, total_ms, serial_ms);
+	}
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+// Fixed size pool of worker threads running queued jobs in submission order
+class thread_pool {
+
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> jobs;
+
+	std::mutex jobs_mutex;
+	std::condition_variable job_available;
+	std::condition_variable all_done;
+
+	uint32_t active_jobs = 0;
+	bool stopping = false;
+
+	void worker_loop()
+	{
+		while (true)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(jobs_mutex);
+				job_available.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+				if (stopping && jobs.empty())
+					return;
+
+				job = std::move(jobs.front());
+				jobs.pop();
+				active_jobs++;
+			}
+
+			job();
+
+			{
+				std::lock_guard<std::mutex> lock(jobs_mutex);
+				active_jobs--;
+				if (active_jobs == 0 && jobs.empty())
+				{
+					all_done.notify_all();
+				}
+			}
+		}
+	}
+
+public:
+	explicit thread_pool(uint32_t thread_count = 0)
+	{
+		if (thread_count == 0)
+		{
+			// Leave one hardware thread for the render loop
+			uint32_t hardware_threads = std::thread::hardware_concurrency();
+			thread_count = hardware_threads > 1 ? hardware_threads - 1 : 1;
+		}
+
+		for (uint32_t i = 0; i < thread_count; i++)
+		{
+			workers.emplace_back(&thread_pool::worker_loop, this);
+		}
+	}
+
+	~thread_pool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(jobs_mutex);
+			stopping = true;
+		}
+		job_available.notify_all();
+
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+
+	void submit(std::function<void()> job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(jobs_mutex);
+			jobs.push(std::move(job));
+		}
+		job_available.notify_one();
+	}
+
+	// Block until every submitted job has finished
+	void wait_idle()
+	{
+		std::unique_lock<std::mutex> lock(jobs_mutex);
+		all_done.wait(lock, [this] { return active_jobs == 0 && jobs.empty(); });
+	}
+
+	// Split [0, count) into ranges of at least grain items and run them on the workers.
+	// The calling thread takes a range too and returns once every range is done,
+	// jobs submitted by others are not waited on.
+	void parallel_for(uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t)>& job)
+	{
+		if (count == 0)
+			return;
+
+		grain = std::max(grain, 1u);
+		uint32_t range_count = std::min(static_cast<uint32_t>(workers.size()) + 1, (count + grain - 1) / grain);
+		uint32_t range_size = (count + range_count - 1) / range_count;
+
+		if (range_count <= 1)
+		{
+			job(0, count);
+			return;
+		}
+
+		std::mutex ranges_mutex;
+		std::condition_variable ranges_done;
+		uint32_t ranges_left = range_count - 1;
+
+		for (uint32_t i = 1; i < range_count; i++)
+		{
+			uint32_t begin = i * range_size;
+			uint32_t end = std::min(begin + range_size, count);
+
+			submit([&, begin, end] {
+				if (begin < end)
+					job(begin, end);
+
+				std::lock_guard<std::mutex> lock(ranges_mutex);
+				if (--ranges_left == 0)
+					ranges_done.notify_one();
+			});
+		}
+
+		job(0, std::min(range_size, count));
+
+		std::unique_lock<std::mutex> lock(ranges_mutex);
+		ranges_done.wait(lock, [&] { return ranges_left == 0; });
+	}
+
+	uint32_t get_thread_count()
+	{
+		return static_cast<uint32_t>(workers.size());
+	}
+};
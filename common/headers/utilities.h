@@ -2,11 +2,22 @@
 
 #include <fstream>
 
+// Number of frames the CPU can record ahead of the GPU
+const int MAX_FRAME_DRAWS = 2;
+
 const std::vector< const char*> device_extensions
 {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+// Enabled when the device supports them
+const std::vector< const char*> optional_device_extensions
+{
+	VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+	VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
+	VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME
+};
+
 struct QueueFamilyIndicies{
 	int graphics_family = -1;
 	int presentation_family = -1;
@@ -32,6 +43,24 @@ struct SwapChainImage {
 
 };
 
+inline uint32_t find_memory_type_index(VkPhysicalDevice physical_device, uint32_t allowed_types, VkMemoryPropertyFlags properties)
+{
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+
+	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
+	{
+		// Memory type must be allowed by the resource and have all the requested properties
+		if ((allowed_types & (1 << i))
+			&& (memory_properties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return i;
+		}
+	}
+
+	throw std::runtime_error("Failed to find a suitable memory type \n");
+}
+
 inline std::vector<char> read_shader_file(const std::string file_name)
 {
 	std::ifstream file(file_name, std::ios::binary| std::ios::ate);
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// Full precision mesh the converter works on before it is quantized and written
+struct MeshVertex {
+	float position[3];
+	float normal[3];
+	float uv[2];
+};
+
+struct MeshData {
+	std::vector<MeshVertex> vertices;
+	std::vector<uint32_t> indices;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "mesh_data.h"
+#include "mesh_format.h"
+
+// Offline index and vertex reordering.
+// The order matters: vertex cache first, then overdraw which keeps the cache
+// order inside clusters, then vertex fetch which renumbers the vertices.
+
+// Average number of vertex shader runs per triangle with a FIFO post transform cache
+float compute_acmr(const std::vector<uint32_t>& indices, uint32_t vertex_count, uint32_t cache_size);
+
+// Forsyth's linear speed vertex cache optimization on a list of triangles
+void optimize_vertex_cache(std::vector<uint32_t>& indices, uint32_t vertex_count);
+
+// Split at the triangles where the cache starts over, then draw the clusters facing
+// outwards first so they occlude the ones behind them
+void optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices, uint32_t cache_size);
+
+// Renumber vertices in the order they are first used and drop the unused ones
+void optimize_vertex_fetch(std::vector<uint32_t>& indices, std::vector<MeshVertex>& vertices);
+
+// Split [index_offset, index_offset + index_count) into meshlets in order
+std::vector<Meshlet> build_meshlets(const std::vector<uint32_t>& indices, uint32_t index_offset, uint32_t index_count,
+	const std::vector<MeshVertex>& vertices);
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "mesh_data.h"
+
+// Quadric error edge collapse simplification.
+// Vertices are never moved, an edge collapses onto one of its endpoints, so
+// every level of detail keeps indexing the same vertex array. Vertices on open
+// borders and on attribute seams (several vertices at the same position) are
+// locked, which keeps the outline and the uv layout intact.
+//
+// Stops once the index count is at most target_index_count or no collapse is
+// left. out_error receives the largest object space distance between the result
+// and the input surface.
+std::vector<uint32_t> simplify_mesh(const std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices,
+	uint32_t target_index_count, float* out_error);
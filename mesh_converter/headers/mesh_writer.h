@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "mesh_data.h"
+#include "mesh_format.h"
+
+// Quantizes the vertices and writes the sections described in mesh_format.h.
+// The indices must already be in their final order, lods and meshlets refer to them.
+// Returns the size of the file in bytes
+uint64_t write_mesh_file(const std::string& file_name, const MeshData& mesh,
+	const std::vector<MeshLod>& lods, const std::vector<Meshlet>& meshlets);
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+#include <stdexcept>
+
+#include "mesh_data.h"
+
+// Wavefront OBJ reader, polygons are split into triangle fans and every unique
+// position / uv / normal combination becomes one vertex. Missing normals are
+// generated from the faces.
+MeshData load_obj(const std::string& file_name);
@@ -0,0 +1,130 @@
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "..\headers\obj_loader.h"
+#include "..\headers\mesh_optimizer.h"
+#include "..\headers\mesh_simplifier.h"
+#include "..\headers\mesh_writer.h"
+
+// Cache size used to report ACMR, close to the post transform cache of current GPUs
+const uint32_t REPORT_CACHE_SIZE = 32;
+
+// Each LOD aims for half the triangles of the one before, a level that keeps more than
+// LOD_MIN_REDUCTION of them or falls under LOD_MIN_TRIANGLES ends the chain
+const float LOD_MIN_REDUCTION = 0.8f;
+const uint32_t LOD_MIN_TRIANGLES = 32;
+
+int main(int argc, char* argv[])
+{
+	// mesh_converter input.obj output.mesh
+	if (argc < 3)
+	{
+		printf("usage : mesh_converter input.obj output.mesh \n");
+		return EXIT_FAILURE;
+	}
+
+	std::string input = argv[1];
+	std::string output = argv[2];
+
+	try
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		MeshData mesh = load_obj(input);
+		uint32_t vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+		uint32_t triangle_count = static_cast<uint32_t>(mesh.indices.size() / 3);
+
+		float acmr_before = compute_acmr(mesh.indices, vertex_count, REPORT_CACHE_SIZE);
+
+		// Every level is simplified from LOD 0 so its error is measured against the full mesh
+		std::vector<std::vector<uint32_t>> lod_indices(1, mesh.indices);
+		std::vector<float> lod_errors(1, 0.0f);
+
+		while (lod_indices.size() < MESH_MAX_LODS)
+		{
+			uint32_t previous_count = static_cast<uint32_t>(lod_indices.back().size());
+			uint32_t target_count = previous_count / 6 * 3;
+			if (target_count < LOD_MIN_TRIANGLES * 3)
+				break;
+
+			float error = 0.0f;
+			std::vector<uint32_t> simplified = simplify_mesh(mesh.indices, mesh.vertices, target_count, &error);
+
+			// Locked borders and seams can stop the simplifier early
+			if (simplified.size() > previous_count * LOD_MIN_REDUCTION)
+				break;
+
+			lod_indices.push_back(std::move(simplified));
+			lod_errors.push_back(std::max(error, lod_errors.back()));
+		}
+
+		float acmr_cache = 0.0f;
+		float acmr_overdraw = 0.0f;
+
+		for (size_t lod = 0; lod < lod_indices.size(); lod++)
+		{
+			optimize_vertex_cache(lod_indices[lod], vertex_count);
+			if (lod == 0)
+				acmr_cache = compute_acmr(lod_indices[lod], vertex_count, REPORT_CACHE_SIZE);
+
+			optimize_overdraw(lod_indices[lod], mesh.vertices, REPORT_CACHE_SIZE);
+			if (lod == 0)
+				acmr_overdraw = compute_acmr(lod_indices[lod], vertex_count, REPORT_CACHE_SIZE);
+		}
+
+		// All levels share the vertices, LOD 0 comes first so its vertices are fetched in order
+		std::vector<MeshLod> lods(lod_indices.size());
+		mesh.indices.clear();
+		for (size_t lod = 0; lod < lod_indices.size(); lod++)
+		{
+			lods[lod] = {};
+			lods[lod].index_offset = static_cast<uint32_t>(mesh.indices.size());
+			lods[lod].index_count = static_cast<uint32_t>(lod_indices[lod].size());
+			lods[lod].error = lod_errors[lod];
+			mesh.indices.insert(mesh.indices.end(), lod_indices[lod].begin(), lod_indices[lod].end());
+		}
+
+		optimize_vertex_fetch(mesh.indices, mesh.vertices);
+
+		std::vector<Meshlet> meshlets;
+		for (MeshLod& lod : lods)
+		{
+			std::vector<Meshlet> lod_meshlets = build_meshlets(mesh.indices, lod.index_offset, lod.index_count, mesh.vertices);
+			lod.meshlet_offset = static_cast<uint32_t>(meshlets.size());
+			lod.meshlet_count = static_cast<uint32_t>(lod_meshlets.size());
+			meshlets.insert(meshlets.end(), lod_meshlets.begin(), lod_meshlets.end());
+		}
+
+		uint64_t file_size = write_mesh_file(output, mesh, lods, meshlets);
+
+		auto end = std::chrono::high_resolution_clock::now();
+		double total_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+		uint64_t source_size = static_cast<uint64_t>(mesh.vertices.size()) * sizeof(MeshVertex) + mesh.indices.size() * sizeof(uint32_t);
+
+		printf("mesh converter : %s -> %s \n", input.c_str(), output.c_str());
+		printf("  vertices %u (%u unused dropped), triangles %u, meshlets %u \n",
+			static_cast<uint32_t>(mesh.vertices.size()), vertex_count - static_cast<uint32_t>(mesh.vertices.size()),
+			triangle_count, static_cast<uint32_t>(meshlets.size()));
+		printf("  ACMR (cache %u) : input %.3f, vertex cache %.3f, overdraw %.3f \n",
+			REPORT_CACHE_SIZE, acmr_before, acmr_cache, acmr_overdraw);
+		for (size_t lod = 0; lod < lods.size(); lod++)
+		{
+			printf("  LOD %u : %u triangles, %u meshlets, error %f \n", static_cast<uint32_t>(lod),
+				lods[lod].index_count / 3, lods[lod].meshlet_count, lods[lod].error);
+		}
+		printf("  size : %.2f KB unpacked, %.2f KB written \n", source_size / 1024.0, file_size / 1024.0);
+		printf("  converted in %.2f ms \n", total_ms);
+	}
+	catch (const std::runtime_error& e)
+	{
+		printf("ERROR : %s \n", e.what());
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
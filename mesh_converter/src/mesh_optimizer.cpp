@@ -0,0 +1,445 @@
+#include "..\headers\mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const uint32_t forsyth_cache_size = 32;
+
+static void triangle_normal(const std::vector<MeshVertex>& vertices, uint32_t a, uint32_t b, uint32_t c, float* normal)
+{
+	const float* pa = vertices[a].position;
+	const float* pb = vertices[b].position;
+	const float* pc = vertices[c].position;
+
+	float ab[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+	float ac[3] = { pc[0] - pa[0], pc[1] - pa[1], pc[2] - pa[2] };
+
+	// Not normalized, the length is twice the area
+	normal[0] = ab[1] * ac[2] - ab[2] * ac[1];
+	normal[1] = ab[2] * ac[0] - ab[0] * ac[2];
+	normal[2] = ab[0] * ac[1] - ab[1] * ac[0];
+}
+
+
+float compute_acmr(const std::vector<uint32_t>& indices, uint32_t vertex_count, uint32_t cache_size)
+{
+	if (indices.empty())
+		return 0.0f;
+
+	// A vertex is in the FIFO while fewer than cache_size misses happened after it was loaded
+	std::vector<uint32_t> load_time(vertex_count, 0);
+	uint32_t time = cache_size + 1;
+	uint32_t misses = 0;
+
+	for (uint32_t index : indices)
+	{
+		if (time - load_time[index] > cache_size)
+		{
+			load_time[index] = time++;
+			misses++;
+		}
+	}
+
+	return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+}
+
+
+static float vertex_score(int cache_position, uint32_t valence)
+{
+	// No triangles left, the vertex must not attract anything
+	if (valence == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cache_position >= 0)
+	{
+		// The last triangle's vertices get a fixed score so the next one does not simply reuse its edge
+		if (cache_position < 3)
+			score = 0.75f;
+		else
+			score = std::pow(1.0f - static_cast<float>(cache_position - 3) / (forsyth_cache_size - 3), 1.5f);
+	}
+
+	// Vertices with few triangles left are finished first
+	return score + 2.0f * std::pow(static_cast<float>(valence), -0.5f);
+}
+
+
+void optimize_vertex_cache(std::vector<uint32_t>& indices, uint32_t vertex_count)
+{
+	uint32_t triangle_count = static_cast<uint32_t>(indices.size() / 3);
+
+	std::vector<uint32_t> valence(vertex_count, 0);
+	for (uint32_t index : indices)
+	{
+		valence[index]++;
+	}
+
+	// Triangles of every vertex, the first valence[v] entries are the ones not emitted yet
+	std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+	for (uint32_t v = 0; v < vertex_count; v++)
+	{
+		adjacency_offsets[v + 1] = adjacency_offsets[v] + valence[v];
+	}
+
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill = adjacency_offsets;
+	for (uint32_t i = 0; i < indices.size(); i++)
+	{
+		adjacency[fill[indices[i]]++] = i / 3;
+	}
+
+	std::vector<int> cache_positions(vertex_count, -1);
+	std::vector<float> vertex_scores(vertex_count);
+	for (uint32_t v = 0; v < vertex_count; v++)
+	{
+		vertex_scores[v] = vertex_score(-1, valence[v]);
+	}
+
+	std::vector<float> triangle_scores(triangle_count);
+	std::vector<bool> emitted(triangle_count, false);
+	for (uint32_t t = 0; t < triangle_count; t++)
+	{
+		triangle_scores[t] = vertex_scores[indices[t * 3]] + vertex_scores[indices[t * 3 + 1]] + vertex_scores[indices[t * 3 + 2]];
+	}
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> new_cache;
+
+	int best_triangle = static_cast<int>(std::max_element(triangle_scores.begin(), triangle_scores.end()) - triangle_scores.begin());
+	uint32_t next_unemitted = 0;
+
+	while (output.size() < indices.size())
+	{
+		// Nothing in the cache has triangles left, continue with the next one in the input order
+		if (best_triangle < 0)
+		{
+			while (emitted[next_unemitted])
+			{
+				next_unemitted++;
+			}
+			best_triangle = static_cast<int>(next_unemitted);
+		}
+
+		const uint32_t* triangle = &indices[best_triangle * 3];
+		output.insert(output.end(), { triangle[0], triangle[1], triangle[2] });
+		emitted[best_triangle] = true;
+
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			uint32_t v = triangle[corner];
+			uint32_t* first = &adjacency[adjacency_offsets[v]];
+			uint32_t* last = first + valence[v];
+			uint32_t* found = std::find(first, last, static_cast<uint32_t>(best_triangle));
+
+			if (found != last)
+			{
+				std::swap(*found, *(last - 1));
+				valence[v]--;
+			}
+		}
+
+		// The triangle's vertices move to the front, the rest keep their order
+		new_cache.assign(triangle, triangle + 3);
+		for (uint32_t v : cache)
+		{
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				new_cache.push_back(v);
+		}
+
+		for (size_t i = 0; i < new_cache.size(); i++)
+		{
+			cache_positions[new_cache[i]] = i < forsyth_cache_size ? static_cast<int>(i) : -1;
+		}
+
+		// Rescore every vertex that entered, moved or left, and the triangles still using them
+		best_triangle = -1;
+		float best_score = -1.0f;
+
+		for (size_t i = 0; i < new_cache.size(); i++)
+		{
+			uint32_t v = new_cache[i];
+			float score = vertex_score(cache_positions[v], valence[v]);
+			float delta = score - vertex_scores[v];
+			vertex_scores[v] = score;
+
+			for (uint32_t a = adjacency_offsets[v]; a < adjacency_offsets[v] + valence[v]; a++)
+			{
+				triangle_scores[adjacency[a]] += delta;
+			}
+		}
+
+		if (new_cache.size() > forsyth_cache_size)
+			new_cache.resize(forsyth_cache_size);
+
+		for (uint32_t v : new_cache)
+		{
+			for (uint32_t a = adjacency_offsets[v]; a < adjacency_offsets[v] + valence[v]; a++)
+			{
+				uint32_t t = adjacency[a];
+				if (triangle_scores[t] > best_score)
+				{
+					best_score = triangle_scores[t];
+					best_triangle = static_cast<int>(t);
+				}
+			}
+		}
+
+		cache.swap(new_cache);
+	}
+
+	indices.swap(output);
+}
+
+
+void optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices, uint32_t cache_size)
+{
+	uint32_t triangle_count = static_cast<uint32_t>(indices.size() / 3);
+	if (triangle_count == 0)
+		return;
+
+	// Clusters start where all three vertices miss the cache, reordering them costs no extra misses
+	std::vector<uint32_t> cluster_starts;
+	std::vector<uint32_t> load_time(vertices.size(), 0);
+	uint32_t time = cache_size + 1;
+
+	for (uint32_t t = 0; t < triangle_count; t++)
+	{
+		uint32_t misses = 0;
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			uint32_t v = indices[t * 3 + corner];
+			if (time - load_time[v] > cache_size)
+			{
+				load_time[v] = time++;
+				misses++;
+			}
+		}
+
+		if (t == 0 || misses == 3)
+			cluster_starts.push_back(t);
+	}
+	cluster_starts.push_back(triangle_count);
+
+	uint32_t cluster_count = static_cast<uint32_t>(cluster_starts.size() - 1);
+
+	// Area weighted centroid and normal of every cluster and of the whole mesh
+	std::vector<float> cluster_data(cluster_count * 6, 0.0f);
+	float mesh_centroid[3] = {};
+	float mesh_area = 0.0f;
+
+	for (uint32_t cluster = 0; cluster < cluster_count; cluster++)
+	{
+		float* centroid = &cluster_data[cluster * 6];
+		float* normal = centroid + 3;
+		float cluster_area = 0.0f;
+
+		for (uint32_t t = cluster_starts[cluster]; t < cluster_starts[cluster + 1]; t++)
+		{
+			uint32_t a = indices[t * 3], b = indices[t * 3 + 1], c = indices[t * 3 + 2];
+
+			float face_normal[3];
+			triangle_normal(vertices, a, b, c, face_normal);
+			float area = std::sqrt(face_normal[0] * face_normal[0] + face_normal[1] * face_normal[1] + face_normal[2] * face_normal[2]);
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float center = (vertices[a].position[axis] + vertices[b].position[axis] + vertices[c].position[axis]) / 3.0f;
+				centroid[axis] += center * area;
+				mesh_centroid[axis] += center * area;
+				normal[axis] += face_normal[axis];
+			}
+
+			cluster_area += area;
+		}
+
+		mesh_area += cluster_area;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			centroid[axis] = cluster_area > 0.0f ? centroid[axis] / cluster_area : 0.0f;
+		}
+	}
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		mesh_centroid[axis] = mesh_area > 0.0f ? mesh_centroid[axis] / mesh_area : 0.0f;
+	}
+
+	// Clusters far out along their own normal are drawn first
+	std::vector<float> sort_keys(cluster_count);
+	for (uint32_t cluster = 0; cluster < cluster_count; cluster++)
+	{
+		const float* centroid = &cluster_data[cluster * 6];
+		const float* normal = centroid + 3;
+		float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+		float key = 0.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			key += (centroid[axis] - mesh_centroid[axis]) * (length > 0.0f ? normal[axis] / length : 0.0f);
+		}
+		sort_keys[cluster] = key;
+	}
+
+	std::vector<uint32_t> cluster_order(cluster_count);
+	for (uint32_t cluster = 0; cluster < cluster_count; cluster++)
+	{
+		cluster_order[cluster] = cluster;
+	}
+
+	std::stable_sort(cluster_order.begin(), cluster_order.end(),
+		[&sort_keys](uint32_t a, uint32_t b) { return sort_keys[a] > sort_keys[b]; });
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	for (uint32_t cluster : cluster_order)
+	{
+		output.insert(output.end(), indices.begin() + cluster_starts[cluster] * 3, indices.begin() + cluster_starts[cluster + 1] * 3);
+	}
+
+	indices.swap(output);
+}
+
+
+void optimize_vertex_fetch(std::vector<uint32_t>& indices, std::vector<MeshVertex>& vertices)
+{
+	std::vector<uint32_t> remap(vertices.size(), ~0u);
+	std::vector<MeshVertex> output;
+	output.reserve(vertices.size());
+
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == ~0u)
+		{
+			remap[index] = static_cast<uint32_t>(output.size());
+			output.push_back(vertices[index]);
+		}
+
+		index = remap[index];
+	}
+
+	vertices.swap(output);
+}
+
+
+static void finish_meshlet(Meshlet& meshlet, const std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices)
+{
+	uint32_t first = meshlet.index_offset;
+	uint32_t last = first + meshlet.triangle_count * 3;
+
+	float min[3] = { vertices[indices[first]].position[0], vertices[indices[first]].position[1], vertices[indices[first]].position[2] };
+	float max[3] = { min[0], min[1], min[2] };
+
+	float axis[3] = {};
+	for (uint32_t i = first; i < last; i += 3)
+	{
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			const float* position = vertices[indices[i + corner]].position;
+			for (int a = 0; a < 3; a++)
+			{
+				min[a] = std::min(min[a], position[a]);
+				max[a] = std::max(max[a], position[a]);
+			}
+		}
+
+		float normal[3];
+		triangle_normal(vertices, indices[i], indices[i + 1], indices[i + 2], normal);
+		float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (length > 0.0f)
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				axis[a] += normal[a] / length;
+			}
+		}
+	}
+
+	float radius = 0.0f;
+	for (int a = 0; a < 3; a++)
+	{
+		meshlet.center[a] = (min[a] + max[a]) * 0.5f;
+	}
+
+	for (uint32_t i = first; i < last; i++)
+	{
+		const float* position = vertices[indices[i]].position;
+		float dx = position[0] - meshlet.center[0], dy = position[1] - meshlet.center[1], dz = position[2] - meshlet.center[2];
+		radius = std::max(radius, std::sqrt(dx * dx + dy * dy + dz * dz));
+	}
+	meshlet.radius = radius;
+
+	float axis_length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	float min_dot = axis_length > 0.0f ? 1.0f : -1.0f;
+
+	for (int a = 0; a < 3; a++)
+	{
+		meshlet.cone_axis[a] = axis_length > 0.0f ? axis[a] / axis_length : 0.0f;
+	}
+
+	for (uint32_t i = first; i < last && axis_length > 0.0f; i += 3)
+	{
+		float normal[3];
+		triangle_normal(vertices, indices[i], indices[i + 1], indices[i + 2], normal);
+		float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (length > 0.0f)
+		{
+			float dot = (normal[0] * meshlet.cone_axis[0] + normal[1] * meshlet.cone_axis[1] + normal[2] * meshlet.cone_axis[2]) / length;
+			min_dot = std::min(min_dot, dot);
+		}
+	}
+
+	// The normal cone widened by 90 degrees on each side is the backfacing view cone, sin of its half angle
+	meshlet.cone_cutoff = min_dot <= 0.1f ? 2.0f : std::sqrt(1.0f - min_dot * min_dot);
+}
+
+
+std::vector<Meshlet> build_meshlets(const std::vector<uint32_t>& indices, uint32_t index_offset, uint32_t index_count,
+	const std::vector<MeshVertex>& vertices)
+{
+	std::vector<Meshlet> meshlets;
+
+	// A vertex belongs to the current meshlet when its stamp is the meshlet number
+	std::vector<uint32_t> stamps(vertices.size(), ~0u);
+	uint32_t meshlet_number = 0;
+
+	Meshlet meshlet = {};
+	meshlet.index_offset = index_offset;
+
+	for (uint32_t i = index_offset; i < index_offset + index_count; i += 3)
+	{
+		uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+
+		uint32_t new_vertices = (stamps[a] != meshlet_number) + (stamps[b] != meshlet_number && b != a)
+			+ (stamps[c] != meshlet_number && c != a && c != b);
+
+		if (meshlet.triangle_count == MESHLET_MAX_TRIANGLES || meshlet.vertex_count + new_vertices > MESHLET_MAX_VERTICES)
+		{
+			finish_meshlet(meshlet, indices, vertices);
+			meshlets.push_back(meshlet);
+
+			meshlet = {};
+			meshlet.index_offset = i;
+			meshlet_number++;
+
+			new_vertices = 1 + (b != a) + (c != a && c != b);
+		}
+
+		stamps[a] = stamps[b] = stamps[c] = meshlet_number;
+		meshlet.vertex_count += new_vertices;
+		meshlet.triangle_count++;
+	}
+
+	if (meshlet.triangle_count > 0)
+	{
+		finish_meshlet(meshlet, indices, vertices);
+		meshlets.push_back(meshlet);
+	}
+
+	return meshlets;
+}
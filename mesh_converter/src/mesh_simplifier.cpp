@@ -0,0 +1,303 @@
+#include "..\headers\mesh_simplifier.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+// Sum of squared distances to a set of planes, weighted by triangle area
+struct Quadric {
+	double a00 = 0.0, a11 = 0.0, a22 = 0.0, a01 = 0.0, a02 = 0.0, a12 = 0.0;
+	double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+	double c = 0.0;
+	double weight = 0.0;
+
+	void add(const Quadric& other)
+	{
+		a00 += other.a00; a11 += other.a11; a22 += other.a22;
+		a01 += other.a01; a02 += other.a02; a12 += other.a12;
+		b0 += other.b0; b1 += other.b1; b2 += other.b2;
+		c += other.c;
+		weight += other.weight;
+	}
+
+	// Weighted mean of the squared distances from p to the planes
+	double evaluate(const float* p) const
+	{
+		double x = p[0], y = p[1], z = p[2];
+		double error = a00 * x * x + a11 * y * y + a22 * z * z
+			+ 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+			+ 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+
+		return weight > 0.0 ? std::max(error, 0.0) / weight : 0.0;
+	}
+};
+
+struct Collapse {
+	uint32_t from;
+	uint32_t to;
+	double cost;
+};
+
+
+static void cross(const float* a, const float* b, const float* c, double* normal)
+{
+	double ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+	double ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+
+	normal[0] = ab[1] * ac[2] - ab[2] * ac[1];
+	normal[1] = ab[2] * ac[0] - ab[0] * ac[2];
+	normal[2] = ab[0] * ac[1] - ab[1] * ac[0];
+}
+
+
+static Quadric plane_quadric(const float* a, const float* b, const float* c)
+{
+	double normal[3];
+	cross(a, b, c, normal);
+
+	Quadric quadric;
+	double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+	if (length == 0.0)
+		return quadric;
+
+	double area = length * 0.5;
+	double nx = normal[0] / length, ny = normal[1] / length, nz = normal[2] / length;
+	double d = -(nx * a[0] + ny * a[1] + nz * a[2]);
+
+	quadric.a00 = nx * nx * area;
+	quadric.a11 = ny * ny * area;
+	quadric.a22 = nz * nz * area;
+	quadric.a01 = nx * ny * area;
+	quadric.a02 = nx * nz * area;
+	quadric.a12 = ny * nz * area;
+	quadric.b0 = nx * d * area;
+	quadric.b1 = ny * d * area;
+	quadric.b2 = nz * d * area;
+	quadric.c = d * d * area;
+	quadric.weight = area;
+
+	return quadric;
+}
+
+
+// Vertices that share their position with another vertex sit on a uv or normal seam,
+// vertices on an edge used by a single triangle sit on an open border
+static std::vector<bool> find_locked_vertices(const std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices)
+{
+	std::vector<bool> locked(vertices.size(), false);
+
+	struct PositionHash {
+		size_t operator()(const std::array<uint32_t, 3>& key) const
+		{
+			return (key[0] * 73856093u) ^ (key[1] * 19349663u) ^ (key[2] * 83492791u);
+		}
+	};
+
+	std::unordered_map<std::array<uint32_t, 3>, uint32_t, PositionHash> positions;
+	for (uint32_t v = 0; v < vertices.size(); v++)
+	{
+		std::array<uint32_t, 3> key;
+		memcpy(key.data(), vertices[v].position, sizeof(float) * 3);
+
+		auto found = positions.find(key);
+		if (found == positions.end())
+		{
+			positions[key] = v;
+		}
+		else
+		{
+			locked[v] = true;
+			locked[found->second] = true;
+		}
+	}
+
+	std::unordered_map<uint64_t, uint32_t> edge_counts;
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			uint32_t a = indices[i + corner];
+			uint32_t b = indices[i + (corner + 1) % 3];
+			uint64_t edge = (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+			edge_counts[edge]++;
+		}
+	}
+
+	for (const auto& edge : edge_counts)
+	{
+		if (edge.second == 1)
+		{
+			locked[static_cast<uint32_t>(edge.first >> 32)] = true;
+			locked[static_cast<uint32_t>(edge.first & 0xFFFFFFFF)] = true;
+		}
+	}
+
+	return locked;
+}
+
+
+// Moving from onto to must not turn any remaining triangle around from
+static bool collapse_flips(uint32_t from, uint32_t to, const std::vector<uint32_t>& indices,
+	const std::vector<uint32_t>& offsets, const std::vector<uint32_t>& adjacency, const std::vector<MeshVertex>& vertices)
+{
+	for (uint32_t a = offsets[from]; a < offsets[from + 1]; a++)
+	{
+		const uint32_t* triangle = &indices[adjacency[a] * 3];
+		if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+			continue;
+
+		const float* corners[3];
+		const float* moved[3];
+		for (int corner = 0; corner < 3; corner++)
+		{
+			corners[corner] = vertices[triangle[corner]].position;
+			moved[corner] = triangle[corner] == from ? vertices[to].position : corners[corner];
+		}
+
+		double before[3], after[3];
+		cross(corners[0], corners[1], corners[2], before);
+		cross(moved[0], moved[1], moved[2], after);
+
+		double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+		double lengths = std::sqrt((before[0] * before[0] + before[1] * before[1] + before[2] * before[2])
+			* (after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+
+		if (lengths == 0.0 || dot < 0.25 * lengths)
+			return true;
+	}
+
+	return false;
+}
+
+
+std::vector<uint32_t> simplify_mesh(const std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices,
+	uint32_t target_index_count, float* out_error)
+{
+	std::vector<uint32_t> result = indices;
+	uint32_t vertex_count = static_cast<uint32_t>(vertices.size());
+
+	std::vector<bool> locked = find_locked_vertices(indices, vertices);
+
+	std::vector<Quadric> quadrics(vertex_count);
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		Quadric quadric = plane_quadric(vertices[result[i]].position, vertices[result[i + 1]].position, vertices[result[i + 2]].position);
+		for (int corner = 0; corner < 3; corner++)
+		{
+			quadrics[result[i + corner]].add(quadric);
+		}
+	}
+
+	double max_error = 0.0;
+
+	std::vector<uint32_t> offsets(vertex_count + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> remap(vertex_count);
+	std::vector<bool> touched(vertex_count);
+
+	// Each pass collapses independent edges in order of cost, then rebuilds the adjacency
+	while (result.size() > target_index_count)
+	{
+		uint32_t triangle_count = static_cast<uint32_t>(result.size() / 3);
+
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (uint32_t index : result)
+		{
+			offsets[index + 1]++;
+		}
+		for (uint32_t v = 0; v < vertex_count; v++)
+		{
+			offsets[v + 1] += offsets[v];
+		}
+
+		adjacency.resize(result.size());
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (uint32_t i = 0; i < result.size(); i++)
+		{
+			adjacency[fill[result[i]]++] = i / 3;
+		}
+
+		collapses.clear();
+		for (uint32_t t = 0; t < triangle_count; t++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				uint32_t a = result[t * 3 + corner];
+				uint32_t b = result[t * 3 + (corner + 1) % 3];
+
+				if (!locked[a])
+					collapses.push_back({ a, b, quadrics[a].evaluate(vertices[b].position) });
+				if (!locked[b])
+					collapses.push_back({ b, a, quadrics[b].evaluate(vertices[a].position) });
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		for (uint32_t v = 0; v < vertex_count; v++)
+		{
+			remap[v] = v;
+		}
+		std::fill(touched.begin(), touched.end(), false);
+
+		uint32_t remaining = triangle_count;
+		uint32_t collapse_count = 0;
+
+		for (const Collapse& collapse : collapses)
+		{
+			if (remaining * 3 <= target_index_count)
+				break;
+
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			if (collapse_flips(collapse.from, collapse.to, result, offsets, adjacency, vertices))
+				continue;
+
+			// The neighbours are locked for the rest of the pass so every flip test sees current positions
+			uint32_t removed = 0;
+			for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1]; a++)
+			{
+				const uint32_t* triangle = &result[adjacency[a] * 3];
+				removed += (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to);
+
+				for (int corner = 0; corner < 3; corner++)
+				{
+					touched[triangle[corner]] = true;
+				}
+			}
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].add(quadrics[collapse.from]);
+			max_error = std::max(max_error, collapse.cost);
+
+			remaining -= std::min(removed, remaining);
+			collapse_count++;
+		}
+
+		if (collapse_count == 0)
+			break;
+
+		// Triangles that lost a corner become degenerate and are dropped
+		size_t write = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+			if (a != b && b != c && a != c)
+			{
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+		}
+		result.resize(write);
+	}
+
+	if (out_error != nullptr)
+		*out_error = static_cast<float>(std::sqrt(max_error));
+
+	return result;
+}
@@ -0,0 +1,134 @@
+#include "..\headers\mesh_writer.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static uint16_t quantize_unorm16(float value, float min, float scale)
+{
+	float normalized = scale > 0.0f ? (value - min) / scale : 0.0f;
+	normalized = std::min(std::max(normalized, 0.0f), 65535.0f);
+	return static_cast<uint16_t>(normalized + 0.5f);
+}
+
+
+static int8_t quantize_snorm8(float value)
+{
+	value = std::min(std::max(value, -1.0f), 1.0f);
+	return static_cast<int8_t>(std::lround(value * 127.0f));
+}
+
+
+uint64_t write_mesh_file(const std::string& file_name, const MeshData& mesh,
+	const std::vector<MeshLod>& lods, const std::vector<Meshlet>& meshlets)
+{
+	if (mesh.vertices.empty() || lods.empty() || lods.size() > MESH_MAX_LODS)
+	{
+		throw std::runtime_error(" Error: mesh has no vertices or an invalid number of LODs \n");
+	}
+
+	MeshFileHeader header = {};
+	header.magic = MESH_FILE_MAGIC;
+	header.version = MESH_FILE_VERSION;
+	header.vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+	header.index_count = static_cast<uint32_t>(mesh.indices.size());
+	header.lod_count = static_cast<uint32_t>(lods.size());
+	header.meshlet_count = static_cast<uint32_t>(meshlets.size());
+	header.vertex_stride = sizeof(PackedVertex);
+	header.index_size = sizeof(uint32_t);
+
+	// Quantization ranges
+	float position_max[3];
+	float uv_max[2];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		header.position_min[axis] = position_max[axis] = mesh.vertices[0].position[axis];
+	}
+	for (int axis = 0; axis < 2; axis++)
+	{
+		header.uv_min[axis] = uv_max[axis] = mesh.vertices[0].uv[axis];
+	}
+
+	for (const MeshVertex& vertex : mesh.vertices)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			header.position_min[axis] = std::min(header.position_min[axis], vertex.position[axis]);
+			position_max[axis] = std::max(position_max[axis], vertex.position[axis]);
+		}
+		for (int axis = 0; axis < 2; axis++)
+		{
+			header.uv_min[axis] = std::min(header.uv_min[axis], vertex.uv[axis]);
+			uv_max[axis] = std::max(uv_max[axis], vertex.uv[axis]);
+		}
+	}
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		header.position_scale[axis] = (position_max[axis] - header.position_min[axis]) / 65535.0f;
+		header.center[axis] = (position_max[axis] + header.position_min[axis]) * 0.5f;
+	}
+	for (int axis = 0; axis < 2; axis++)
+	{
+		header.uv_scale[axis] = (uv_max[axis] - header.uv_min[axis]) / 65535.0f;
+	}
+
+	for (const MeshVertex& vertex : mesh.vertices)
+	{
+		float dx = vertex.position[0] - header.center[0];
+		float dy = vertex.position[1] - header.center[1];
+		float dz = vertex.position[2] - header.center[2];
+		header.radius = std::max(header.radius, std::sqrt(dx * dx + dy * dy + dz * dz));
+	}
+
+	std::vector<PackedVertex> packed(mesh.vertices.size());
+	for (size_t v = 0; v < mesh.vertices.size(); v++)
+	{
+		const MeshVertex& vertex = mesh.vertices[v];
+		PackedVertex& out = packed[v];
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			out.position[axis] = quantize_unorm16(vertex.position[axis], header.position_min[axis], header.position_scale[axis]);
+			out.normal[axis] = quantize_snorm8(vertex.normal[axis]);
+		}
+		out.position[3] = 0;
+		out.normal[3] = 0;
+
+		for (int axis = 0; axis < 2; axis++)
+		{
+			out.uv[axis] = quantize_unorm16(vertex.uv[axis], header.uv_min[axis], header.uv_scale[axis]);
+		}
+	}
+
+	// Section offsets
+	header.lod_offset = align_mesh_section(sizeof(MeshFileHeader));
+	header.meshlet_offset = align_mesh_section(header.lod_offset + lods.size() * sizeof(MeshLod));
+	header.vertex_offset = align_mesh_section(header.meshlet_offset + meshlets.size() * sizeof(Meshlet));
+	header.index_offset = header.vertex_offset + packed.size() * sizeof(PackedVertex);
+	header.file_size = header.index_offset + mesh.indices.size() * sizeof(uint32_t);
+
+	std::vector<uint8_t> contents(static_cast<size_t>(header.file_size), 0);
+	std::memcpy(contents.data(), &header, sizeof(header));
+	std::memcpy(contents.data() + header.lod_offset, lods.data(), lods.size() * sizeof(MeshLod));
+	if (!meshlets.empty())
+		std::memcpy(contents.data() + header.meshlet_offset, meshlets.data(), meshlets.size() * sizeof(Meshlet));
+	std::memcpy(contents.data() + header.vertex_offset, packed.data(), packed.size() * sizeof(PackedVertex));
+	std::memcpy(contents.data() + header.index_offset, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+
+	std::ofstream file(file_name, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::string error_msg("Fail to open the file " + file_name);
+		throw std::runtime_error(error_msg.c_str());
+	}
+
+	file.write(reinterpret_cast<const char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+	if (!file)
+	{
+		throw std::runtime_error(" Error: failed to write the mesh file \n");
+	}
+
+	return header.file_size;
+}
@@ -0,0 +1,215 @@
+#include "..\headers\obj_loader.h"
+
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <cmath>
+#include <cstdlib>
+
+struct ObjIndex {
+	int position;
+	int uv;
+	int normal;
+
+	bool operator==(const ObjIndex& other) const
+	{
+		return position == other.position && uv == other.uv && normal == other.normal;
+	}
+};
+
+struct ObjIndexHash {
+	size_t operator()(const ObjIndex& index) const
+	{
+		size_t hash = static_cast<size_t>(index.position) * 73856093u;
+		hash ^= static_cast<size_t>(index.uv) * 19349663u;
+		hash ^= static_cast<size_t>(index.normal) * 83492791u;
+		return hash;
+	}
+};
+
+// "p", "p/t", "p//n" or "p/t/n", negative values count back from the last element
+static ObjIndex parse_face_index(const std::string& token, size_t position_count, size_t uv_count, size_t normal_count)
+{
+	ObjIndex index = { -1, -1, -1 };
+	int* fields[3] = { &index.position, &index.uv, &index.normal };
+	size_t counts[3] = { position_count, uv_count, normal_count };
+
+	size_t start = 0;
+	for (int field = 0; field < 3 && start <= token.size(); field++)
+	{
+		size_t end = token.find('/', start);
+		if (end == std::string::npos)
+			end = token.size();
+
+		if (end > start)
+		{
+			int value = std::atoi(token.substr(start, end - start).c_str());
+			*fields[field] = value < 0 ? static_cast<int>(counts[field]) + value : value - 1;
+
+			if (*fields[field] < 0 || *fields[field] >= static_cast<int>(counts[field]))
+			{
+				throw std::runtime_error(" Error: OBJ face index out of range \n");
+			}
+		}
+
+		start = end + 1;
+	}
+
+	if (index.position < 0)
+	{
+		throw std::runtime_error(" Error: OBJ face without a position \n");
+	}
+
+	return index;
+}
+
+
+static void generate_normals(MeshData& mesh, const std::vector<bool>& has_normal)
+{
+	std::vector<float> normals(mesh.vertices.size() * 3, 0.0f);
+
+	// Area weighted, the cross product length is twice the triangle area
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		const float* a = mesh.vertices[mesh.indices[i]].position;
+		const float* b = mesh.vertices[mesh.indices[i + 1]].position;
+		const float* c = mesh.vertices[mesh.indices[i + 2]].position;
+
+		float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		float face_normal[3] = {
+			ab[1] * ac[2] - ab[2] * ac[1],
+			ab[2] * ac[0] - ab[0] * ac[2],
+			ab[0] * ac[1] - ab[1] * ac[0]
+		};
+
+		for (size_t corner = 0; corner < 3; corner++)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				normals[mesh.indices[i + corner] * 3 + axis] += face_normal[axis];
+			}
+		}
+	}
+
+	for (size_t v = 0; v < mesh.vertices.size(); v++)
+	{
+		if (has_normal[v])
+			continue;
+
+		float* n = &normals[v * 3];
+		float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			mesh.vertices[v].normal[axis] = length > 0.0f ? n[axis] / length : (axis == 2 ? 1.0f : 0.0f);
+		}
+	}
+}
+
+
+MeshData load_obj(const std::string& file_name)
+{
+	std::ifstream file(file_name);
+
+	if (!file.is_open())
+	{
+		std::string error_msg("Fail to open the file " + file_name);
+		throw std::runtime_error(error_msg.c_str());
+	}
+
+	std::vector<float> positions;
+	std::vector<float> uvs;
+	std::vector<float> normals;
+
+	MeshData mesh;
+	std::vector<bool> has_normal;
+	std::unordered_map<ObjIndex, uint32_t, ObjIndexHash> vertex_lookup;
+	std::vector<uint32_t> polygon;
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream stream(line);
+		std::string type;
+		stream >> type;
+
+		if (type == "v")
+		{
+			float x = 0.0f, y = 0.0f, z = 0.0f;
+			stream >> x >> y >> z;
+			positions.insert(positions.end(), { x, y, z });
+		}
+		else if (type == "vt")
+		{
+			float u = 0.0f, v = 0.0f;
+			stream >> u >> v;
+
+			// OBJ puts the uv origin at the bottom left, Vulkan samples from the top left
+			uvs.insert(uvs.end(), { u, 1.0f - v });
+		}
+		else if (type == "vn")
+		{
+			float x = 0.0f, y = 0.0f, z = 0.0f;
+			stream >> x >> y >> z;
+			normals.insert(normals.end(), { x, y, z });
+		}
+		else if (type == "f")
+		{
+			polygon.clear();
+
+			std::string token;
+			while (stream >> token)
+			{
+				ObjIndex index = parse_face_index(token, positions.size() / 3, uvs.size() / 2, normals.size() / 3);
+
+				auto found = vertex_lookup.find(index);
+				if (found != vertex_lookup.end())
+				{
+					polygon.push_back(found->second);
+					continue;
+				}
+
+				MeshVertex vertex = {};
+				for (int axis = 0; axis < 3; axis++)
+				{
+					vertex.position[axis] = positions[index.position * 3 + axis];
+				}
+
+				if (index.uv >= 0)
+				{
+					vertex.uv[0] = uvs[index.uv * 2];
+					vertex.uv[1] = uvs[index.uv * 2 + 1];
+				}
+
+				if (index.normal >= 0)
+				{
+					for (int axis = 0; axis < 3; axis++)
+					{
+						vertex.normal[axis] = normals[index.normal * 3 + axis];
+					}
+				}
+
+				uint32_t vertex_index = static_cast<uint32_t>(mesh.vertices.size());
+				mesh.vertices.push_back(vertex);
+				has_normal.push_back(index.normal >= 0);
+				vertex_lookup[index] = vertex_index;
+				polygon.push_back(vertex_index);
+			}
+
+			for (size_t i = 2; i < polygon.size(); i++)
+			{
+				mesh.indices.insert(mesh.indices.end(), { polygon[0], polygon[i - 1], polygon[i] });
+			}
+		}
+	}
+
+	if (mesh.indices.empty())
+	{
+		throw std::runtime_error(" Error: OBJ file has no faces \n");
+	}
+
+	generate_normals(mesh, has_normal);
+
+	return mesh;
+}
@@ -1,3 +1,12 @@
-C:/VulkanSDK/1.2.154.1/Bin32/glslangValidator.exe -V shader.vert
-C:/VulkanSDK/1.2.154.1/Bin32/glslangValidator.exe -V shader.frag
+C:/VulkanSDK/1.3.204.1/Bin32/glslangValidator.exe -V shader.vert
+C:/VulkanSDK/1.3.204.1/Bin32/glslangValidator.exe -V shader.frag
+C:/VulkanSDK/1.3.204.1/Bin32/glslangValidator.exe -V hiz_reduce.comp -o hiz_reduce.spv
+C:/VulkanSDK/1.3.204.1/Bin32/glslangValidator.exe -V particles.comp -o particles.spv
+C:/VulkanSDK/1.3.204.1/Bin32/glslangValidator.exe -V particle.vert -o particle_vert.spv
+C:/VulkanSDK/1.3.204.1/Bin32/glslangValidator.exe -V particle.frag -o particle_frag.spv
+C:/VulkanSDK/1.3.204.1/Bin32/glslangValidator.exe -V bloom_downsample.comp -o bloom_downsample.spv
+C:/VulkanSDK/1.3.204.1/Bin32/glslangValidator.exe -V bloom_upsample.comp -o bloom_upsample.spv
+C:/VulkanSDK/1.3.204.1/Bin32/glslangValidator.exe -V tonemap.comp -o tonemap.spv
+C:/VulkanSDK/1.3.204.1/Bin32/glslangValidator.exe -V sprite.vert -o sprite_vert.spv
+C:/VulkanSDK/1.3.204.1/Bin32/glslangValidator.exe -V sprite.frag -o sprite_frag.spv
 pause
\ No newline at end of file
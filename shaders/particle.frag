@@ -0,0 +1,12 @@
+#version 450 		// Use GLSL 4.5
+
+layout(location = 0) in vec2 fragCorner;
+layout(location = 1) in vec4 fragColour;
+
+layout(location = 0) out vec4 outColour;
+
+void main() {
+	// Round soft sprite, blended additively
+	float falloff = max(1.0 - dot(fragCorner, fragCorner), 0.0);
+	outColour = vec4(fragColour.rgb * fragColour.a * falloff, falloff);
+}
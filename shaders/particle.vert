@@ -0,0 +1,50 @@
+#version 450 		// Use GLSL 4.5
+
+// Camera facing quad per alive particle, the instance picks the particle from the alive list
+layout(location = 0) out vec2 fragCorner;	// -1 to 1 across the quad
+layout(location = 1) out vec4 fragColour;
+
+struct Particle {
+	vec4 positionLife;	// xyz position, w seconds left
+	vec4 velocityAge;	// xyz velocity, w seconds lived
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Particles {
+	Particle particles[];
+};
+
+// Survivors of this frame's simulation, the list the draw count belongs to
+layout(std430, set = 0, binding = 2) readonly buffer TargetList {
+	uint targetList[];
+};
+
+// Must match ParticleDrawPushConstants
+layout(push_constant) uniform ParticleDrawPushConstants {
+	mat4 viewProjection;
+	vec4 cameraRight;	// w particle size
+	vec4 cameraUp;
+} pushConstants;
+
+// Two triangles
+vec2 corners[6] = vec2[](
+	vec2(-1.0, -1.0),
+	vec2(1.0, -1.0),
+	vec2(1.0, 1.0),
+	vec2(-1.0, -1.0),
+	vec2(1.0, 1.0),
+	vec2(-1.0, 1.0)
+);
+
+void main() {
+	Particle particle = particles[targetList[gl_InstanceIndex]];
+
+	vec2 corner = corners[gl_VertexIndex];
+	vec3 offset = (pushConstants.cameraRight.xyz * corner.x + pushConstants.cameraUp.xyz * corner.y) * pushConstants.cameraRight.w;
+	gl_Position = pushConstants.viewProjection * vec4(particle.positionLife.xyz + offset, 1.0);
+
+	// Hot and bright when young, fading out as the life runs down
+	float age = particle.velocityAge.w;
+	float fade = clamp(particle.positionLife.w / max(age + particle.positionLife.w, 0.0001), 0.0, 1.0);
+	fragColour = vec4(mix(vec3(0.9, 0.2, 0.05), vec3(1.0, 0.85, 0.4), fade), fade);
+	fragCorner = corner;
+}
@@ -1,9 +1,65 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec3 fragColour;	// Interpolated colour from vertex (location must match)
+layout(location = 1) in vec2 fragUV;
+layout(location = 2) in vec3 fragWorldPosition;
 
 layout(location = 0) out vec4 outColour; 	// Final output colour (must also have location
 
+// Feature bits (must match SHADER_FEATURE_* in shader_variants.h)
+const uint FEATURE_TEXTURE = 1u;
+const uint FEATURE_TINT = 2u;
+const uint FEATURE_DYNAMIC = 0x80000000u;
+
+// Set per pipeline, the uber shader by default. The light loop is unrolled by the driver
+layout(constant_id = 0) const uint shaderFeatures = FEATURE_DYNAMIC;
+layout(constant_id = 1) const uint lightCount = 0u;
+const bool dynamicFeatures = (shaderFeatures & FEATURE_DYNAMIC) != 0u;
+const bool textureFeature = (shaderFeatures & FEATURE_TEXTURE) != 0u;
+const bool tintFeature = (shaderFeatures & FEATURE_TINT) != 0u;
+
+// Bindless heap, every texture lives in this array (must match bindless_heap)
+layout(set = 0, binding = 0) uniform sampler2D textures[];
+
+layout(push_constant) uniform DrawPushConstants {
+	uint textureIndex;
+	uint bufferIndex;
+	uint tint;
+	uint vertexBufferIndex;
+	vec2 uvOffset;
+	vec2 uvScale;
+} pushConstants;
+
 void main() {
-	outColour = vec4(fragColour, 1.0);
-}
\ No newline at end of file
+	vec4 texColour = vec4(1.0);
+	bool textured = dynamicFeatures ? pushConstants.textureIndex != 0xFFFFFFFFu : textureFeature;
+	if (textured)
+	{
+		texColour = texture(textures[nonuniformEXT(pushConstants.textureIndex)], fragUV);
+	}
+
+	// A white tint changes nothing, so the uber shader applies it to every draw
+	if (dynamicFeatures || tintFeature)
+	{
+		texColour *= unpackUnorm4x8(pushConstants.tint);
+	}
+
+	// Point lights on a ring above the origin, the face normal comes from the position derivatives
+	vec3 colour = fragColour;
+	if (lightCount > 0u)
+	{
+		vec3 normal = normalize(cross(dFdx(fragWorldPosition), dFdy(fragWorldPosition)));
+		float lighting = 0.0;
+		for (uint i = 0u; i < lightCount; i++)
+		{
+			float angle = 6.2831853 * float(i) / float(lightCount);
+			vec3 toLight = vec3(cos(angle) * 20.0, 10.0, sin(angle) * 20.0) - fragWorldPosition;
+			float distanceSquared = dot(toLight, toLight);
+			lighting += abs(dot(normal, toLight)) * inversesqrt(distanceSquared) / (1.0 + 0.01 * distanceSquared);
+		}
+		colour *= 0.25 + lighting * (4.0 / float(lightCount));
+	}
+
+	outColour = vec4(colour, 1.0) * texColour;
+}
@@ -1,22 +1,95 @@
 #version 450 		// Use GLSL 4.5
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) out vec3 fragColour;	// Output colour for vertex (location is required)
+layout(location = 1) out vec2 fragUV;		// Texture coordinate, taken from the position
+layout(location = 2) out vec3 fragWorldPosition;	// For the lights, zero outside the scene
+
+// Feature bits (must match SHADER_FEATURE_* in shader_variants.h)
+const uint FEATURE_MESH = 4u;
+const uint FEATURE_DYNAMIC = 0x80000000u;
+
+// Set per pipeline, the default is the uber shader that tests the push constants instead.
+// Specialized variants are only used by scene draws, which are always instanced
+layout(constant_id = 0) const uint shaderFeatures = FEATURE_DYNAMIC;
+const bool dynamicFeatures = (shaderFeatures & FEATURE_DYNAMIC) != 0u;
+const bool meshFeature = (shaderFeatures & FEATURE_MESH) != 0u;
+
+// Indices into the bindless arrays and the geometry of the draw (must match DrawPushConstants)
+layout(push_constant) uniform DrawPushConstants {
+	uint textureIndex;
+	uint bufferIndex;
+	uint tint;
+	uint vertexBufferIndex;
+	vec2 uvOffset;
+	vec2 uvScale;
+} pushConstants;
+
+// Scene objects: camera first, then three rows of the world transform per visible object (must match SceneObjectHeader)
+layout(std430, set = 0, binding = 1) readonly buffer SceneObjects {
+	mat4 viewProjection;
+	vec4 objectRows[];
+} sceneObjects[];
+
+// Mesh vertices pulled by index, 16 bytes each (must match PackedVertex):
+// position unorm16 x3 + padding, normal snorm8 x4, uv unorm16 x2
+layout(std430, set = 0, binding = 1) readonly buffer MeshVertices {
+	uvec4 vertices[];
+} meshVertices[];
 
 // Triangle vertex positions (will put in to vertex buffer later!)
 vec3 positions[3] = vec3[](
 	vec3(0.0, -0.4, 0.0),
-	vec3(0.4, 0.4, 0.0),
-	vec3(-0.4, 0.4, 0.0)
+	vec3(-0.4, 0.4, 0.0),
+	vec3(0.4, 0.4, 0.0)
 );
 
 // Triangle vertex colours
 vec3 colours[3] = vec3[](
 	vec3(1.0, 0.0, 0.0),
-	vec3(0.0, 1.0, 0.0),
-	vec3(0.0, 0.0, 1.0)
+	vec3(0.0, 0.0, 1.0),
+	vec3(0.0, 1.0, 0.0)
 );
 
 void main() {
+	// Meshes: the transform rows already hold the dequantization of the positions
+	bool mesh = dynamicFeatures ? pushConstants.vertexBufferIndex != 0xFFFFFFFFu : meshFeature;
+	if (mesh)
+	{
+		uvec4 packedVertex = meshVertices[pushConstants.vertexBufferIndex].vertices[gl_VertexIndex];
+		vec4 localPosition = vec4(unpackUnorm2x16(packedVertex.x), unpackUnorm2x16(packedVertex.y).x, 1.0);
+		vec3 normal = unpackSnorm4x8(packedVertex.z).xyz;
+
+		uint row = gl_InstanceIndex * 3;
+		vec3 worldPosition = vec3(
+			dot(sceneObjects[pushConstants.bufferIndex].objectRows[row], localPosition),
+			dot(sceneObjects[pushConstants.bufferIndex].objectRows[row + 1], localPosition),
+			dot(sceneObjects[pushConstants.bufferIndex].objectRows[row + 2], localPosition));
+
+		gl_Position = sceneObjects[pushConstants.bufferIndex].viewProjection * vec4(worldPosition, 1.0);
+		fragWorldPosition = worldPosition;
+		fragColour = normal * 0.5 + 0.5;
+		fragUV = pushConstants.uvOffset + unpackUnorm2x16(packedVertex.w) * pushConstants.uvScale;
+		return;
+	}
+
 	gl_Position = vec4(positions[gl_VertexIndex], 1.0);
+	fragWorldPosition = vec3(0.0);
+
+	// Scene draws are instanced, y is flipped back since the projection already flips it
+	if (!dynamicFeatures || pushConstants.bufferIndex != 0xFFFFFFFFu)
+	{
+		uint row = gl_InstanceIndex * 3;
+		vec4 localPosition = vec4(positions[gl_VertexIndex].x, -positions[gl_VertexIndex].y, 0.0, 1.0);
+		vec3 worldPosition = vec3(
+			dot(sceneObjects[pushConstants.bufferIndex].objectRows[row], localPosition),
+			dot(sceneObjects[pushConstants.bufferIndex].objectRows[row + 1], localPosition),
+			dot(sceneObjects[pushConstants.bufferIndex].objectRows[row + 2], localPosition));
+
+		gl_Position = sceneObjects[pushConstants.bufferIndex].viewProjection * vec4(worldPosition, 1.0);
+		fragWorldPosition = worldPosition;
+	}
+
 	fragColour = colours[gl_VertexIndex];
+	fragUV = positions[gl_VertexIndex].xy / 0.8 + 0.5;
 }
\ No newline at end of file
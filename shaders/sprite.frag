@@ -0,0 +1,28 @@
+#version 450 		// Use GLSL 4.5
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec2 fragUV;
+layout(location = 1) in vec4 fragColour;
+
+layout(location = 0) out vec4 outColour;
+
+// Bindless heap, the page of the batch is picked by its index
+layout(set = 0, binding = 0) uniform sampler2D textures[];
+
+// Must match SpritePushConstants
+layout(push_constant) uniform SpritePushConstants {
+	vec2 scale;
+	vec2 offset;
+	uint textureIndex;
+} pushConstants;
+
+void main() {
+	// Same page for the whole draw, no texture means the sprite is a plain rectangle
+	vec4 texColour = vec4(1.0);
+	if (pushConstants.textureIndex != 0xFFFFFFFFu)
+	{
+		texColour = texture(textures[pushConstants.textureIndex], fragUV);
+	}
+
+	outColour = fragColour * texColour;
+}
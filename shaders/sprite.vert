@@ -0,0 +1,35 @@
+#version 450 		// Use GLSL 4.5
+
+// Quad per sprite instance, corners in pixels of the target with y down
+layout(location = 0) in vec4 rect;		// xy top left, zw size
+layout(location = 1) in vec4 uvRect;	// xy uv of the top left corner, zw of the bottom right
+layout(location = 2) in vec4 colour;	// RGBA8
+
+layout(location = 0) out vec2 fragUV;
+layout(location = 1) out vec4 fragColour;
+
+// Must match SpritePushConstants
+layout(push_constant) uniform SpritePushConstants {
+	vec2 scale;
+	vec2 offset;
+	uint textureIndex;
+} pushConstants;
+
+// Two triangles
+vec2 corners[6] = vec2[](
+	vec2(0.0, 0.0),
+	vec2(1.0, 0.0),
+	vec2(1.0, 1.0),
+	vec2(0.0, 0.0),
+	vec2(1.0, 1.0),
+	vec2(0.0, 1.0)
+);
+
+void main() {
+	vec2 corner = corners[gl_VertexIndex];
+	vec2 pixel = rect.xy + rect.zw * corner;
+
+	gl_Position = vec4(pixel * pushConstants.scale + pushConstants.offset, 0.0, 1.0);
+	fragUV = mix(uvRect.xy, uvRect.zw, corner);
+	fragColour = colour;
+}